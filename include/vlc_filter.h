@@ -214,6 +214,44 @@ static inline int filter_GetInputAttachments( filter_t *p_filter,
                                          ppp_attachment, pi_attachment );
 }
 
+/**
+ * Slice callback of a video filter
+ *
+ * Processes the part of the pictures belonging to one slice, see
+ * filter_GetSliceRows(). The slices of a picture run concurrently.
+ *
+ * \param data opaque pointer passed to filter_RunSlices()
+ * \param slice index of the slice to process
+ * \param slices total number of slices
+ */
+typedef void (*filter_slice_cb)( filter_t *, void *data,
+                                 unsigned slice, unsigned slices );
+
+/**
+ * Processes pictures by slices, on the shared worker threads of the
+ * process, and waits for all the slices to complete.
+ *
+ * A filter is slice-capable if it can process independent ranges of rows
+ * of each plane. The callback is run once per slice, possibly
+ * concurrently and possibly on the calling thread.
+ *
+ * \param slices number of slices, or 0 for the number of worker threads
+ */
+VLC_API void filter_RunSlices( filter_t *, filter_slice_cb, void *data,
+                               unsigned slices );
+
+/**
+ * Gets the range of rows of a slice, in a plane of the given height.
+ * The first row is included, the last one is excluded.
+ */
+static inline void filter_GetSliceRows( int i_lines, unsigned slice,
+                                        unsigned slices,
+                                        int *pi_first, int *pi_last )
+{
+    *pi_first = (int64_t)i_lines * slice / slices;
+    *pi_last = (int64_t)i_lines * (slice + 1) / slices;
+}
+
 /**
  * It creates a blend filter.
  *
@@ -370,11 +408,49 @@ VLC_API const es_format_t *filter_chain_GetFmtOut(filter_chain_t *chain);
 VLC_API picture_t *filter_chain_VideoFilter(filter_chain_t *chain,
                                             picture_t *pic);
 
+/**
+ * Gets the next picture out of a video filter chain.
+ *
+ * Unlike filter_chain_VideoFilter(chain, NULL), it waits for the pictures
+ * being filtered by a pipelined chain.
+ *
+ * \return the next filtered picture, or NULL if the chain is empty
+ */
+VLC_API picture_t *filter_chain_VideoDrain( filter_chain_t * );
+
+/**
+ * Checks if a pipelined video filter chain holds no pictures, neither being
+ * filtered nor out of the last filter. It can be called from any thread.
+ *
+ * The pictures pending in a synchronous chain are not accounted for.
+ */
+VLC_API bool filter_chain_VideoIsEmpty( filter_chain_t * );
+
 /**
  * Flush a video filter chain.
  */
 VLC_API void filter_chain_VideoFlush( filter_chain_t * );
 
+/**
+ * Runs each filter of a video filter chain on its own thread.
+ *
+ * filter_chain_VideoFilter() then queues the picture to the first filter
+ * and returns the next picture out of the last one, if any. It only waits
+ * when the filters hold more than the given number of pictures. Flushing or
+ * changing the filters drops the pictures being filtered.
+ *
+ * The video buffer callback of the chain owner is then called from the
+ * filter threads.
+ *
+ * \param depth maximum number of pictures in the filters, or 0 to run the
+ *              filters synchronously on the calling thread
+ * \param ready callback run by the last filter thread when a picture is
+ *              ready to be taken, or NULL
+ * \param opaque data for the callback
+ */
+VLC_API void filter_chain_SetPipeline( filter_chain_t *, unsigned depth,
+                                       void (*ready)( void * ), void *opaque );
+
 /**
  * Apply the filter chain to a audio block.
  * \bug Deal with block chains and document.
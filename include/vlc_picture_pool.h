@@ -166,6 +166,16 @@ unsigned picture_pool_Reset( picture_pool_t * );
  */
 void picture_pool_Cancel( picture_pool_t *, bool canceled );
 
+/**
+ * Gets the contention statistics of the pool.
+ *
+ * @param retries number of times a free picture was taken concurrently
+ * by another thread [OUT]
+ * @param waits number of times picture_pool_Wait() had to block [OUT]
+ */
+void picture_pool_GetStats( picture_pool_t *, unsigned long *retries,
+                            unsigned long *waits );
+
 /**
  * Reserves pictures from a pool and creates a new pool with those.
  *
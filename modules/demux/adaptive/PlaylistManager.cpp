@@ -32,6 +32,7 @@
 #include "http/HTTPConnectionManager.h"
 #include "logic/AlwaysBestAdaptationLogic.h"
 #include "logic/RateBasedAdaptationLogic.h"
+#include "logic/HybridAdaptationLogic.hpp"
 #include "logic/AlwaysLowestAdaptationLogic.hpp"
 #include "tools/Debug.hpp"
 #include <vlc_stream.h>
@@ -95,6 +96,8 @@ bool PlaylistManager::setupPeriod()
             SegmentTracker *tracker = new (std::nothrow) SegmentTracker(logic, set);
             if(!tracker)
                 continue;
+            tracker->setPrefetchDepth(var_InheritInteger(p_demux, "adaptive-prefetch"),
+                                      CLOCK_FREQ * var_InheritInteger(p_demux, "adaptive-prefetch-time"));
 
             AbstractStream *st = streamFactory->create(p_demux, set->getStreamFormat(),
                                                        tracker, conManager);
@@ -132,6 +135,10 @@ bool PlaylistManager::start()
     if(!conManager && !(conManager = new (std::nothrow) HTTPConnectionManager(VLC_OBJECT(p_demux->s))))
         return false;
 
+    /* Whether segments are cached is decided per representation, once
+     * its playlist is loaded */
+    conManager->enableCache();
+
     if(!setupPeriod())
         return false;
 
@@ -461,6 +468,15 @@ AbstractAdaptationLogic *PlaylistManager::createLogic(AbstractAdaptationLogic::L
             conn->setDownloadRateObserver(logic);
             return logic;
         }
+        case AbstractAdaptationLogic::Hybrid:
+        {
+            int width = var_InheritInteger(p_demux, "adaptive-width");
+            int height = var_InheritInteger(p_demux, "adaptive-height");
+            HybridAdaptationLogic *logic =
+                    new (std::nothrow) HybridAdaptationLogic(VLC_OBJECT(p_demux), width, height);
+            conn->setDownloadRateObserver(logic);
+            return logic;
+        }
         default:
             return NULL;
     }
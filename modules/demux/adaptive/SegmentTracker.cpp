@@ -48,6 +48,14 @@ SegmentTrackerEvent::SegmentTrackerEvent(const StreamFormat *fmt)
     u.format.f = fmt;
 }
 
+SegmentTrackerEvent::SegmentTrackerEvent(BaseAdaptationSet *set, mtime_t current, mtime_t target)
+{
+    type = BUFFERING_STATE;
+    u.buffering.set = set;
+    u.buffering.current = current;
+    u.buffering.target = target;
+}
+
 SegmentTracker::SegmentTracker(AbstractAdaptationLogic *logic_, BaseAdaptationSet *adaptSet)
 {
     first = true;
@@ -59,6 +67,8 @@ SegmentTracker::SegmentTracker(AbstractAdaptationLogic *logic_, BaseAdaptationSe
     setAdaptationLogic(logic_);
     adaptationSet = adaptSet;
     format = StreamFormat::UNSUPPORTED;
+    prefetchSegments = 0;
+    prefetchDuration = 0;
 }
 
 SegmentTracker::~SegmentTracker()
@@ -94,6 +104,7 @@ bool SegmentTracker::segmentsListReady() const
 
 void SegmentTracker::reset()
 {
+    resetPrefetch();
     notify(SegmentTrackerEvent(curRepresentation, NULL));
     curRepresentation = NULL;
     init_sent = false;
@@ -132,6 +143,8 @@ SegmentChunk * SegmentTracker::getNextChunk(bool switch_allowed, HTTPConnectionM
     if(rep != curRepresentation)
     {
         notify(SegmentTrackerEvent(curRepresentation, rep));
+        /* Look-ahead chunks belong to previous representation */
+        resetPrefetch();
         prevRep = curRepresentation;
         curRepresentation = rep;
         init_sent = false;
@@ -193,7 +206,9 @@ SegmentChunk * SegmentTracker::getNextChunk(bool switch_allowed, HTTPConnectionM
         initializing = false;
     }
 
-    SegmentChunk *chunk = segment->toChunk(next, rep, connManager);
+    SegmentChunk *chunk = getPrefetchedChunk(rep, next);
+    if(!chunk)
+        chunk = segment->toChunk(next, rep, connManager);
 
     /* We need to check segment/chunk format changes, as we can't rely on representation's (HLS)*/
     if(chunk && format != chunk->getStreamFormat())
@@ -212,11 +227,120 @@ SegmentChunk * SegmentTracker::getNextChunk(bool switch_allowed, HTTPConnectionM
     {
         curNumber = next;
         next++;
+        prefetch(rep, connManager);
+    }
+
+    return chunk;
+}
+
+void SegmentTracker::setPrefetchDepth(unsigned segments, mtime_t duration)
+{
+    prefetchSegments = segments;
+    prefetchDuration = duration;
+}
+
+void SegmentTracker::prefetch(BaseRepresentation *rep, HTTPConnectionManager *connManager)
+{
+    if(!prefetchSegments && !prefetchDuration)
+        return;
+
+    const bool b_live = rep->getPlaylist()->isLive();
+    const mtime_t start = rep->getPlaybackTimeBySegmentNumber(next);
+    uint64_t number = (prefetched.empty()) ? next : prefetched.back().number + 1;
+
+    while(!prefetchSegments || prefetched.size() < prefetchSegments)
+    {
+        /* Don't request segments not yet announced by a live playlist */
+        if(b_live && (number == 0 || rep->getMinAheadTime(number - 1) == 0))
+            break;
+
+        bool b_gap;
+        ISegment *segment = rep->getNextSegment(BaseRepresentation::INFOTYPE_MEDIA,
+                                                number, &number, &b_gap);
+        if(!segment)
+            break;
+
+        if(prefetchDuration)
+        {
+            const mtime_t time = rep->getPlaybackTimeBySegmentNumber(number);
+            if(start == VLC_TS_INVALID || time == VLC_TS_INVALID ||
+               time - start >= prefetchDuration)
+                break;
+        }
+
+        SegmentChunk *chunk = segment->toChunk(number, rep, connManager);
+        if(!chunk)
+            break;
+
+        PrefetchedChunk pf = { number, rep, chunk };
+        prefetched.push_back(pf);
+        number++;
+    }
+}
+
+SegmentChunk * SegmentTracker::getPrefetchedChunk(BaseRepresentation *rep, uint64_t number)
+{
+    if(prefetched.empty())
+        return NULL;
+
+    const PrefetchedChunk &pf = prefetched.front();
+    if(pf.rep != rep || pf.number != number)
+    {
+        /* Stale look-ahead (gap, position change) */
+        resetPrefetch();
+        return NULL;
     }
 
+    SegmentChunk *chunk = pf.chunk;
+    prefetched.pop_front();
     return chunk;
 }
 
+mtime_t SegmentTracker::getPrefetchedTime() const
+{
+    /* Media time of the completely downloaded look-ahead */
+    mtime_t duration = 0;
+    std::list<PrefetchedChunk>::const_iterator it;
+    for(it = prefetched.begin(); it != prefetched.end(); ++it)
+    {
+        const PrefetchedChunk &pf = *it;
+        if(!pf.chunk->isDownloaded())
+            break;
+        const mtime_t start = pf.rep->getPlaybackTimeBySegmentNumber(pf.number);
+        const mtime_t end = pf.rep->getPlaybackTimeBySegmentNumber(pf.number + 1);
+        if(start == VLC_TS_INVALID || end <= start)
+            break;
+        duration += end - start;
+    }
+    return duration;
+}
+
+void SegmentTracker::notifyBufferingState(mtime_t demuxed)
+{
+    if(!curRepresentation)
+        return;
+
+    mtime_t target = prefetchDuration;
+    if(!target)
+    {
+        const mtime_t start = curRepresentation->getPlaybackTimeBySegmentNumber(curNumber);
+        const mtime_t end = curRepresentation->getPlaybackTimeBySegmentNumber(curNumber + 1);
+        if(start != VLC_TS_INVALID && end > start)
+            target = (end - start) * prefetchSegments;
+    }
+
+    notify(SegmentTrackerEvent(adaptationSet, demuxed + getPrefetchedTime(), target));
+}
+
+void SegmentTracker::resetPrefetch()
+{
+    /* Deleting chunks cancels their pending downloads */
+    std::list<PrefetchedChunk>::const_iterator it;
+    for(it = prefetched.begin(); it != prefetched.end(); ++it)
+        delete (*it).chunk;
+    prefetched.clear();
+}
+
 bool SegmentTracker::setPositionByTime(mtime_t time, bool restarted, bool tryonly)
 {
     uint64_t segnumber;
@@ -236,6 +360,7 @@ bool SegmentTracker::setPositionByTime(mtime_t time, bool restarted, bool tryonl
 
 void SegmentTracker::setPositionByNumber(uint64_t segnumber, bool restarted)
 {
+    resetPrefetch();
     if(restarted)
     {
         initializing = true;
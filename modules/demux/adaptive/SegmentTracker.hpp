@@ -58,11 +58,13 @@ namespace adaptive
             SegmentTrackerEvent(SegmentChunk *);
             SegmentTrackerEvent(BaseRepresentation *, BaseRepresentation *);
             SegmentTrackerEvent(const StreamFormat *);
+            SegmentTrackerEvent(BaseAdaptationSet *, mtime_t, mtime_t);
             enum
             {
                 DISCONTINUITY,
                 SWITCHING,
                 FORMATCHANGE,
+                BUFFERING_STATE,
             } type;
             union
             {
@@ -79,6 +81,12 @@ namespace adaptive
                {
                     const StreamFormat *f;
                } format;
+               struct
+               {
+                    BaseAdaptationSet *set;
+                    mtime_t current; /* media time buffered ahead */
+                    mtime_t target;
+               } buffering;
             } u;
     };
 
@@ -105,9 +113,15 @@ namespace adaptive
             mtime_t getMinAheadTime() const;
             void registerListener(SegmentTrackerListenerInterface *);
             void updateSelected();
+            void setPrefetchDepth(unsigned, mtime_t);
+            void notifyBufferingState(mtime_t);
 
         private:
             void notify(const SegmentTrackerEvent &);
+            void prefetch(BaseRepresentation *, HTTPConnectionManager *);
+            SegmentChunk * getPrefetchedChunk(BaseRepresentation *, uint64_t);
+            void resetPrefetch();
+            mtime_t getPrefetchedTime() const;
             bool first;
             bool initializing;
             bool index_sent;
@@ -119,6 +133,17 @@ namespace adaptive
             BaseAdaptationSet *adaptationSet;
             BaseRepresentation *curRepresentation;
             std::list<SegmentTrackerListenerInterface *> listeners;
+
+            /* Look-ahead of already scheduled media chunks */
+            struct PrefetchedChunk
+            {
+                uint64_t number;
+                BaseRepresentation *rep;
+                SegmentChunk *chunk;
+            };
+            std::list<PrefetchedChunk> prefetched;
+            unsigned prefetchSegments; /* 0 for unbounded */
+            mtime_t prefetchDuration; /* 0 for unbounded */
     };
 }
 
@@ -277,6 +277,10 @@ AbstractStream::status AbstractStream::demux(mtime_t nz_deadline, bool send)
     AdvDebug(msg_Dbg(p_realdemux, "Stream %s pcr %ld dts %ld deadline %ld buflevel %ld",
              description.c_str(), getPCR(), getFirstDTS(), nz_deadline, getBufferingLevel()));
 
+    /* Report buffer occupancy to the adaptation logic */
+    const mtime_t i_demuxed = getBufferingLevel() - (VLC_TS_0 + nz_deadline);
+    segmentTracker->notifyBufferingState((i_demuxed > 0) ? i_demuxed : 0);
+
     if(send)
         pcr = fakeesout->commandsqueue.Process( p_realdemux->out, VLC_TS_0 + nz_deadline );
 
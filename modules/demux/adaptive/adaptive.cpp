@@ -75,12 +75,34 @@ static void Close   (vlc_object_t *);
 #define ADAPT_ACCESS_TEXT N_("Use regular HTTP modules")
 #define ADAPT_ACCESS_LONGTEXT N_("Connect using http access instead of custom http code")
 
+#define ADAPT_DOWNLOADS_TEXT N_("Parallel downloads")
+#define ADAPT_DOWNLOADS_LONGTEXT N_("Number of segments downloaded simultaneously")
+
+#define ADAPT_MAXCONN_TEXT N_("Maximum connections per host")
+#define ADAPT_MAXCONN_LONGTEXT N_("Maximum number of simultaneous connections to a single host (0 for unlimited)")
+
+#define ADAPT_PREFETCH_TEXT N_("Prefetched segments")
+#define ADAPT_PREFETCH_LONGTEXT N_("Number of upcoming segments requested ahead of playback. " \
+                                   "0 means no limit when a prefetch duration is set, no prefetching otherwise.")
+
+#define ADAPT_PREFETCHTIME_TEXT N_("Prefetch duration (seconds)")
+#define ADAPT_PREFETCHTIME_LONGTEXT N_("Maximum duration of upcoming segments requested ahead of playback (0 for no limit)")
+
+#define ADAPT_CACHESIZE_TEXT N_("Segment cache size (MiB)")
+#define ADAPT_CACHESIZE_LONGTEXT N_("Keeps downloaded segments of on-demand streams on disk, " \
+                                    "up to this size, for later playback (0 to disable)")
+
+#define ADAPT_CACHEDIR_TEXT N_("Segment cache directory")
+#define ADAPT_CACHEDIR_LONGTEXT N_("Where to store cached segments. Defaults to the user cache directory.")
+
 static const int pi_logics[] = {AbstractAdaptationLogic::RateBased,
+                                AbstractAdaptationLogic::Hybrid,
                                 AbstractAdaptationLogic::FixedRate,
                                 AbstractAdaptationLogic::AlwaysLowest,
                                 AbstractAdaptationLogic::AlwaysBest};
 
 static const char *const ppsz_logics[] = { N_("Bandwidth Adaptive"),
+                                           N_("Bandwidth and Buffer Adaptive"),
                                            N_("Fixed Bandwidth"),
                                            N_("Lowest Bandwidth/Quality"),
                                            N_("Highest Bandwidth/Quality")};
@@ -98,13 +120,23 @@ vlc_module_begin ()
         add_integer( "adaptive-height", 360, ADAPT_HEIGHT_TEXT, ADAPT_HEIGHT_TEXT, true )
         add_integer( "adaptive-bw",     250, ADAPT_BW_TEXT,     ADAPT_BW_LONGTEXT,     false )
         add_bool   ( "adaptive-use-access", false, ADAPT_ACCESS_TEXT, ADAPT_ACCESS_LONGTEXT, true );
+        add_integer_with_range( "adaptive-maxdownloads", 3, 1, 16,
+                                ADAPT_DOWNLOADS_TEXT, ADAPT_DOWNLOADS_LONGTEXT, true )
+        add_integer_with_range( "adaptive-maxconnections", 4, 0, 32,
+                                ADAPT_MAXCONN_TEXT, ADAPT_MAXCONN_LONGTEXT, true )
+        add_integer_with_range( "adaptive-prefetch", 1, 0, 32,
+                                ADAPT_PREFETCH_TEXT, ADAPT_PREFETCH_LONGTEXT, true )
+        add_integer_with_range( "adaptive-prefetch-time", 0, 0, 3600,
+                                ADAPT_PREFETCHTIME_TEXT, ADAPT_PREFETCHTIME_LONGTEXT, true )
+        add_integer( "adaptive-cache-size", 0, ADAPT_CACHESIZE_TEXT, ADAPT_CACHESIZE_LONGTEXT, true )
+        add_directory( "adaptive-cache-dir", NULL, ADAPT_CACHEDIR_TEXT, ADAPT_CACHEDIR_LONGTEXT, true )
         set_callbacks( Open, Close )
 vlc_module_end ()
 
 /*****************************************************************************
  * Local prototypes
  *****************************************************************************/
-static PlaylistManager * HandleDash(demux_t *, DOMParser &,
+static PlaylistManager * HandleDash(demux_t *,
                                     const std::string &, AbstractAdaptationLogic::LogicType);
 static PlaylistManager * HandleSmooth(demux_t *, DOMParser &,
                                       const std::string &, AbstractAdaptationLogic::LogicType);
@@ -155,7 +187,7 @@ static int Open(vlc_object_t *p_obj)
         DOMParser xmlParser; /* Share that xml reader */
         if(dashmime)
         {
-            p_manager = HandleDash(p_demux, xmlParser, playlisturl, logic);
+            p_manager = HandleDash(p_demux, playlisturl, logic);
         }
         else if(smoothmime)
         {
@@ -175,7 +207,7 @@ static int Open(vlc_object_t *p_obj)
                     {
                         if(DASHManager::isDASH(xmlParser.getRootNode()))
                         {
-                            p_manager = HandleDash(p_demux, xmlParser, playlisturl, logic);
+                            p_manager = HandleDash(p_demux, playlisturl, logic);
                         }
                         else if(SmoothManager::isSmoothStreaming(xmlParser.getRootNode()))
                         {
@@ -217,21 +249,15 @@ static void Close(vlc_object_t *p_obj)
 /*****************************************************************************
  *
  *****************************************************************************/
-static PlaylistManager * HandleDash(demux_t *p_demux, DOMParser &xmlParser,
+static PlaylistManager * HandleDash(demux_t *p_demux,
                                     const std::string & playlisturl,
                                     AbstractAdaptationLogic::LogicType logic)
 {
-    if(!xmlParser.reset(p_demux->s) || !xmlParser.parse(true))
-    {
-        msg_Err(p_demux, "Cannot parse MPD");
-        return NULL;
-    }
-    IsoffMainParser mpdparser(xmlParser.getRootNode(), VLC_OBJECT(p_demux),
-                              p_demux->s, playlisturl);
+    IsoffMainParser mpdparser(VLC_OBJECT(p_demux), p_demux->s, playlisturl);
     MPD *p_playlist = mpdparser.parse();
     if(p_playlist == NULL)
     {
-        msg_Err( p_demux, "Cannot create/unknown MPD for profile");
+        msg_Err( p_demux, "Cannot parse MPD");
         return NULL;
     }
 
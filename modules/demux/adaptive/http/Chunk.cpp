@@ -59,6 +59,11 @@ const BytesRange & AbstractChunkSource::getBytesRange() const
     return bytesRange;
 }
 
+bool AbstractChunkSource::isDownloaded() const
+{
+    return !hasMoreData();
+}
+
 AbstractChunk::AbstractChunk(AbstractChunkSource *source_)
 {
     bytesRead = 0;
@@ -98,6 +103,11 @@ bool AbstractChunk::isEmpty() const
     return !source->hasMoreData();
 }
 
+bool AbstractChunk::isDownloaded() const
+{
+    return source->isDownloaded();
+}
+
 block_t * AbstractChunk::readBlock()
 {
     return doRead(0, true);
@@ -123,7 +133,7 @@ HTTPChunkSource::HTTPChunkSource(const std::string& url, HTTPConnectionManager *
 HTTPChunkSource::~HTTPChunkSource()
 {
     if(connection)
-        connection->setUsed(false);
+        connManager->releaseConnection(connection);
 }
 
 bool HTTPChunkSource::init(const std::string &url)
@@ -208,8 +218,11 @@ bool HTTPChunkSource::prepare()
             return false;
     }
 
+    mtime_t time = mdate();
     if( connection->request(params.getPath(), bytesRange) != VLC_SUCCESS )
         return false;
+    const mtime_t handshake = connection->getHandshakeTime();
+    connManager->updateRequestStats(handshake, mdate() - time - handshake);
     /* Because we don't know Chunk size at start, we need to get size
            from content length */
     contentLength = connection->getContentLength();
@@ -223,7 +236,8 @@ block_t * HTTPChunkSource::readBlock()
     return read(HTTPChunkSource::CHUNK_SIZE);
 }
 
-HTTPChunkBufferedSource::HTTPChunkBufferedSource(const std::string& url, HTTPConnectionManager *manager) :
+HTTPChunkBufferedSource::HTTPChunkBufferedSource(const std::string& url, HTTPConnectionManager *manager,
+                                                 bool cacheable_) :
     HTTPChunkSource(url, manager),
     p_head     (NULL),
     pp_tail    (&p_head),
@@ -234,10 +248,16 @@ HTTPChunkBufferedSource::HTTPChunkBufferedSource(const std::string& url, HTTPCon
     done = false;
     eof = false;
     downloadstart = 0;
+    cacheable = cacheable_;
+    cacheWriter = NULL;
 }
 
 HTTPChunkBufferedSource::~HTTPChunkBufferedSource()
 {
+    /* Ensures no downloader thread is still writing to us */
+    if(connManager->downloader)
+        connManager->downloader->cancel(this);
+
     vlc_mutex_lock(&lock);
     if(p_head)
     {
@@ -249,7 +269,7 @@ HTTPChunkBufferedSource::~HTTPChunkBufferedSource()
     buffered = 0;
     vlc_mutex_unlock(&lock);
 
-    connManager->downloader->cancel(this);
+    delete cacheWriter;
 
     vlc_cond_destroy(&avail);
     vlc_mutex_destroy(&lock);
@@ -267,6 +287,13 @@ bool HTTPChunkBufferedSource::isDone() const
 void HTTPChunkBufferedSource::bufferize(size_t readsize)
 {
     vlc_mutex_lock(&lock);
+    if(!prepared && loadFromCache())
+    {
+        vlc_cond_signal(&avail);
+        vlc_mutex_unlock(&lock);
+        return;
+    }
+
     if(!prepare())
     {
         done = true;
@@ -275,8 +302,8 @@ void HTTPChunkBufferedSource::bufferize(size_t readsize)
         return;
     }
 
-    if(readsize < HTTPChunkSource::CHUNK_SIZE)
-        readsize = HTTPChunkSource::CHUNK_SIZE;
+    /* Fewer, larger blocks on fast links */
+    readsize = std::max(readsize, preferredBlockSize());
 
     if(contentLength && readsize > contentLength - buffered)
         readsize = contentLength - buffered;
@@ -294,6 +321,9 @@ void HTTPChunkBufferedSource::bufferize(size_t readsize)
     } rate = {0,0};
 
     ssize_t ret = connection->read(p_block->p_buffer, readsize);
+    if(ret > 0 && cacheWriter)
+        cacheWriter->write(p_block->p_buffer, ret);
+
     if(ret <= 0)
     {
         block_Release(p_block);
@@ -322,22 +352,83 @@ void HTTPChunkBufferedSource::bufferize(size_t readsize)
 
     if(rate.size)
     {
+        finishCaching(ret >= 0 && (!contentLength || rate.size == contentLength));
         connManager->updateDownloadRate(rate.size, rate.time);
+        /* Give back the connection so it can be reused by next chunk
+         * while this one is still being consumed */
+        releaseConnection();
     }
 
     vlc_cond_signal(&avail);
 }
 
+size_t HTTPChunkBufferedSource::preferredBlockSize() const
+{
+    const size_t downloaded = buffered + consumed;
+    const mtime_t elapsed = mdate() - downloadstart;
+    if(!downloadstart || elapsed <= 0 || downloaded < HTTPChunkSource::CHUNK_SIZE)
+        return HTTPChunkSource::CHUNK_SIZE;
+
+    const uint64_t size = (uint64_t) downloaded * BLOCK_DURATION / elapsed;
+    return VLC_CLIP(size, HTTPChunkSource::CHUNK_SIZE, HTTPChunkSource::MAX_CHUNK_SIZE);
+}
+
+void HTTPChunkBufferedSource::releaseConnection()
+{
+    if(connection)
+    {
+        connManager->releaseConnection(connection);
+        connection = NULL;
+    }
+}
+
 bool HTTPChunkBufferedSource::prepare()
 {
     if(!prepared)
     {
         downloadstart = mdate();
-        return HTTPChunkSource::prepare();
+        if(!HTTPChunkSource::prepare())
+            return false;
+        if(cacheable && connManager->cache)
+            cacheWriter = connManager->cache->store(params.getUrl(), bytesRange);
     }
     return true;
 }
 
+/* Serves the whole chunk from the segment cache, without any request */
+bool HTTPChunkBufferedSource::loadFromCache()
+{
+    if(!cacheable || !connManager->cache)
+        return false;
+
+    block_t *p_block = connManager->cache->get(params.getUrl(), bytesRange);
+    if(!p_block)
+        return false;
+
+    contentLength = p_block->i_buffer;
+    buffered = p_block->i_buffer;
+    block_ChainLastAppend(&pp_tail, p_block);
+    prepared = true;
+    done = true;
+    return true;
+}
+
+void HTTPChunkBufferedSource::finishCaching(bool b_complete)
+{
+    if(cacheWriter)
+    {
+        if(b_complete)
+            cacheWriter->commit();
+        delete cacheWriter;
+        cacheWriter = NULL;
+    }
+}
+
+bool HTTPChunkBufferedSource::isDownloaded() const
+{
+    return isDone();
+}
+
 bool HTTPChunkBufferedSource::hasMoreData() const
 {
     bool b_hasdata;
@@ -392,6 +483,25 @@ block_t * HTTPChunkBufferedSource::read(size_t readsize)
         vlc_cond_wait(&avail, &lock);
 
     block_t *p_block = NULL;
+
+    /* Hand out the buffered block itself if it matches the request */
+    if(readsize && p_head &&
+      (p_head->i_buffer == readsize ||
+      (done && !p_head->p_next && p_head->i_buffer < readsize)))
+    {
+        p_block = p_head;
+        p_head = p_head->p_next;
+        if(p_head == NULL)
+            pp_tail = &p_head;
+        p_block->p_next = NULL;
+        if(p_block->i_buffer < readsize)
+            eof = true;
+        consumed += p_block->i_buffer;
+        buffered -= p_block->i_buffer;
+        vlc_mutex_unlock(&lock);
+        return p_block;
+    }
+
     if(!readsize || !buffered || !(p_block = block_Alloc(readsize)) )
     {
         eof = true;
@@ -27,6 +27,7 @@
 
 #include "BytesRange.hpp"
 #include "ConnectionParams.hpp"
+#include "SegmentCache.hpp"
 #include <vector>
 #include <string>
 #include <stdint.h>
@@ -49,6 +50,7 @@ namespace adaptive
                 virtual block_t *   readBlock       () = 0;
                 virtual block_t *   read            (size_t) = 0;
                 virtual bool        hasMoreData     () const = 0;
+                virtual bool        isDownloaded    () const;
                 void                setBytesRange   (const BytesRange &);
                 const BytesRange &  getBytesRange   () const;
 
@@ -64,6 +66,7 @@ namespace adaptive
 
                 size_t              getBytesRead            () const;
                 bool                isEmpty                 () const;
+                bool                isDownloaded            () const;
 
                 virtual block_t *   readBlock       ();
                 virtual block_t *   read            (size_t);
@@ -89,6 +92,7 @@ namespace adaptive
                 virtual bool        hasMoreData     () const; /* impl */
 
                 static const size_t CHUNK_SIZE = 32768;
+                static const size_t MAX_CHUNK_SIZE = 1 << 20;
 
             protected:
                 virtual bool      prepare();
@@ -97,10 +101,10 @@ namespace adaptive
                 size_t              consumed; /* read pointer */
                 bool                prepared;
                 bool                eof;
+                ConnectionParams    params;
 
             private:
                 bool init(const std::string &);
-                ConnectionParams    params;
         };
 
         class HTTPChunkBufferedSource : public HTTPChunkSource
@@ -108,16 +112,24 @@ namespace adaptive
             friend class Downloader;
 
             public:
-                HTTPChunkBufferedSource(const std::string &url, HTTPConnectionManager *);
+                HTTPChunkBufferedSource(const std::string &url, HTTPConnectionManager *,
+                                        bool cacheable);
                 virtual ~HTTPChunkBufferedSource();
                 virtual block_t *  readBlock       (); /* reimpl */
                 virtual block_t *  read            (size_t); /* reimpl */
                 virtual bool       hasMoreData     () const; /* impl */
+                virtual bool       isDownloaded    () const; /* reimpl */
 
             protected:
                 virtual bool       prepare(); /* reimpl */
                 void               bufferize(size_t);
                 bool               isDone() const;
+                void               releaseConnection();
+                bool               loadFromCache();
+                void               finishCaching(bool);
+                size_t             preferredBlockSize() const;
+                /* download time for buffering one block at current rate */
+                static const mtime_t BLOCK_DURATION = CLOCK_FREQ / 10;
 
             private:
                 block_t            *p_head; /* read cache buffer */
@@ -126,6 +138,8 @@ namespace adaptive
                 bool                done;
                 bool                eof;
                 mtime_t             downloadstart;
+                bool                cacheable;
+                SegmentCache::Writer *cacheWriter;
                 vlc_mutex_t         lock;
                 vlc_cond_t          avail;
         };
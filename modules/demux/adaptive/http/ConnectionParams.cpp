@@ -70,6 +70,23 @@ uint16_t ConnectionParams::getPort() const
     return port;
 }
 
+bool ConnectionParams::sameHost(const ConnectionParams &other) const
+{
+    return hostname == other.hostname &&
+           scheme == other.scheme &&
+           port == other.port;
+}
+
+bool ConnectionParams::HostLess::operator()(const ConnectionParams &a,
+                                            const ConnectionParams &b) const
+{
+    if(a.port != b.port)
+        return a.port < b.port;
+    if(a.scheme != b.scheme)
+        return a.scheme < b.scheme;
+    return a.hostname < b.hostname;
+}
+
 void ConnectionParams::parse()
 {
     std::size_t pos = uri.find("://");
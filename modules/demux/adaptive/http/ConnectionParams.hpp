@@ -44,6 +44,15 @@ namespace adaptive
                 const std::string & getPath() const;
                 void setPath(const std::string &);
                 uint16_t getPort() const;
+                bool sameHost(const ConnectionParams &) const;
+
+                /* Orders by scheme, host and port only */
+                class HostLess
+                {
+                    public:
+                        bool operator()(const ConnectionParams &,
+                                        const ConnectionParams &) const;
+                };
 
             private:
                 void parse();
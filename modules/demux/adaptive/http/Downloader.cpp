@@ -22,50 +22,68 @@
 #include <vlc_threads.h>
 #include <vlc_atomic.h>
 
+#include <algorithm>
+
 using namespace adaptive::http;
 
-Downloader::Downloader()
+Downloader::Downloader(unsigned maxthreads_, unsigned maxperhost_)
 {
     vlc_mutex_init(&lock);
     vlc_cond_init(&waitcond);
+    vlc_cond_init(&updatedcond);
     killed = false;
-    thread_handle = { 0 };
-    thread_handle_valid = false;
+    maxthreads = (maxthreads_) ? maxthreads_ : 1;
+    maxperhost = maxperhost_;
 }
 
 bool Downloader::start()
 {
-    if(!thread_handle_valid &&
-       vlc_clone(&thread_handle, downloaderThread,
-                 reinterpret_cast<void *>(this), VLC_THREAD_PRIORITY_INPUT))
+    while(threads.size() < maxthreads)
     {
-        return false;
+        vlc_thread_t thread_handle;
+        if(vlc_clone(&thread_handle, downloaderThread,
+                     reinterpret_cast<void *>(this), VLC_THREAD_PRIORITY_INPUT))
+            break;
+        threads.push_back(thread_handle);
     }
-    thread_handle_valid = true;
-    return true;
+    return !threads.empty();
 }
 
 Downloader::~Downloader()
 {
+    vlc_mutex_lock(&lock);
     killed = true;
-    vlc_cond_signal(&waitcond);
-    if(thread_handle_valid)
-        vlc_join(thread_handle, NULL);
+    vlc_cond_broadcast(&waitcond);
+    vlc_mutex_unlock(&lock);
+    std::vector<vlc_thread_t>::const_iterator it;
+    for(it = threads.begin(); it != threads.end(); ++it)
+        vlc_join(*it, NULL);
     vlc_mutex_destroy(&lock);
     vlc_cond_destroy(&waitcond);
+    vlc_cond_destroy(&updatedcond);
 }
+
 void Downloader::schedule(HTTPChunkBufferedSource *source)
 {
     vlc_mutex_lock(&lock);
     chunks.push_back(source);
-    vlc_mutex_unlock(&lock);
     vlc_cond_signal(&waitcond);
+    vlc_mutex_unlock(&lock);
 }
 
 void Downloader::cancel(HTTPChunkBufferedSource *source)
 {
     vlc_mutex_lock(&lock);
+    /* wait for any worker still reading from it */
+    while(std::find(processing.begin(), processing.end(), source) != processing.end())
+        vlc_cond_wait(&updatedcond, &lock);
     chunks.remove(source);
+    if(std::find(active.begin(), active.end(), source) != active.end())
+    {
+        active.remove(source);
+        /* connection slot is now free for another source */
+        vlc_cond_broadcast(&waitcond);
+    }
     vlc_mutex_unlock(&lock);
 }
 
@@ -84,31 +102,71 @@ void Downloader::DownloadSource(HTTPChunkBufferedSource *source)
         source->bufferize(HTTPChunkSource::CHUNK_SIZE);
 }
 
-void Downloader::Run()
+bool Downloader::hasFreeSlot(const HTTPChunkBufferedSource *source) const
 {
-    while(1)
+    if(maxperhost == 0)
+        return true;
+
+    const ConnectionParams &params = source->params;
+    unsigned count = 0;
+    std::list<HTTPChunkBufferedSource *>::const_iterator it;
+    for(it = active.begin(); it != active.end(); ++it)
     {
-        vlc_mutex_lock(&lock);
-        if(killed)
-            break;
+        if((*it)->params.sameHost(params) && ++count >= maxperhost)
+            return false;
+    }
+    return true;
+}
 
-        while(chunks.empty() && !killed)
+HTTPChunkBufferedSource * Downloader::getNextSource()
+{
+    std::list<HTTPChunkBufferedSource *>::iterator it;
+    for(it = chunks.begin(); it != chunks.end(); ++it)
+    {
+        HTTPChunkBufferedSource *source = *it;
+        const bool started = std::find(active.begin(), active.end(), source) != active.end();
+        /* Don't open more connections than allowed to the same host */
+        if(!started && !hasFreeSlot(source))
+            continue;
+
+        chunks.erase(it);
+        if(!started)
+            active.push_back(source);
+        processing.push_back(source);
+        return source;
+    }
+    return NULL;
+}
+
+void Downloader::Run()
+{
+    vlc_mutex_lock(&lock);
+    while(!killed)
+    {
+        HTTPChunkBufferedSource *source = getNextSource();
+        if(!source)
         {
             vlc_cond_wait(&waitcond, &lock);
+            continue;
         }
 
-        if(killed)
-            break;
+        vlc_mutex_unlock(&lock);
+        DownloadSource(source);
+        vlc_mutex_lock(&lock);
 
-        if(!chunks.empty())
+        processing.remove(source);
+        if(source->isDone())
         {
-            HTTPChunkBufferedSource *source = chunks.front();
-            DownloadSource(source);
-            if(source->isDone())
-                chunks.pop_front();
+            active.remove(source);
+            vlc_cond_broadcast(&waitcond);
         }
-
-        vlc_mutex_unlock(&lock);
+        else
+        {
+            /* Round robin, so every stream gets its share of workers */
+            chunks.push_back(source);
+            vlc_cond_signal(&waitcond);
+        }
+        vlc_cond_broadcast(&updatedcond);
     }
     vlc_mutex_unlock(&lock);
 }
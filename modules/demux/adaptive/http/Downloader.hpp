@@ -27,6 +27,7 @@
 #endif
 
 #include <vlc_common.h>
+#include <vector>
 #include <list>
 
 namespace adaptive
@@ -38,7 +39,7 @@ namespace adaptive
         class Downloader
         {
             public:
-                Downloader();
+                Downloader(unsigned = 1, unsigned = 0);
                 ~Downloader();
                 bool start();
                 void schedule(HTTPChunkBufferedSource *);
@@ -48,13 +49,21 @@ namespace adaptive
                 static void * downloaderThread(void *);
                 void Run();
                 void DownloadSource(HTTPChunkBufferedSource *);
-                vlc_thread_t thread_handle;
+                HTTPChunkBufferedSource * getNextSource();
+                bool hasFreeSlot(const HTTPChunkBufferedSource *) const;
+                std::vector<vlc_thread_t> threads;
+                unsigned     maxthreads;
+                unsigned     maxperhost; /* 0 for unlimited */
                 vlc_mutex_t  lock;
                 vlc_cond_t   waitcond;
-                vlc_mutex_t  processlock;
-                bool         thread_handle_valid;
+                vlc_cond_t   updatedcond;
                 bool         killed;
+                /* Sources waiting for their next read, in round robin order */
                 std::list<HTTPChunkBufferedSource *> chunks;
+                /* Sources currently read by a worker thread */
+                std::list<HTTPChunkBufferedSource *> processing;
+                /* Started and not finished sources, holding a connection */
+                std::list<HTTPChunkBufferedSource *> active;
         };
 
     }
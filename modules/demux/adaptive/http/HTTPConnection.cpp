@@ -34,6 +34,8 @@ AbstractConnection::AbstractConnection(vlc_object_t *p_object_)
     available = true;
     bytesRead = 0;
     contentLength = 0;
+    releaseTime = mdate();
+    handshakeTime = 0;
 }
 
 AbstractConnection::~AbstractConnection()
@@ -55,6 +57,28 @@ size_t AbstractConnection::getContentLength() const
     return contentLength;
 }
 
+void AbstractConnection::setUsed( bool b )
+{
+    available = !b;
+    if(available)
+        releaseTime = mdate();
+}
+
+bool AbstractConnection::isAvailable() const
+{
+    return available;
+}
+
+mtime_t AbstractConnection::getIdleTime() const
+{
+    return (available) ? mdate() - releaseTime : 0;
+}
+
+mtime_t AbstractConnection::getHandshakeTime() const
+{
+    return handshakeTime;
+}
+
 HTTPConnection::HTTPConnection(vlc_object_t *p_object_, Socket *socket_, bool persistent)
     : AbstractConnection( p_object_ )
 {
@@ -73,10 +97,7 @@ HTTPConnection::~HTTPConnection()
 
 bool HTTPConnection::canReuse(const ConnectionParams &params_) const
 {
-    return ( available &&
-             params.getHostname() == params_.getHostname() &&
-             params.getScheme() == params_.getScheme() &&
-             params.getPort() == params_.getPort() );
+    return ( available && params.sameHost(params_) );
 }
 
 bool HTTPConnection::connect()
@@ -109,8 +130,14 @@ int HTTPConnection::request(const std::string &path, const BytesRange &range)
     msg_Dbg(p_object, "Retrieving %s @%zu", params.getUrl().c_str(),
                        range.isValid() ? range.getStartByte() : 0);
 
-    if(!connected() && ( params.getHostname().empty() || !connect() ))
-        return VLC_EGENERIC;
+    handshakeTime = 0;
+    if(!connected())
+    {
+        mtime_t time = mdate();
+        if( params.getHostname().empty() || !connect() )
+            return VLC_EGENERIC;
+        handshakeTime = mdate() - time;
+    }
 
     bytesRange = range;
     if(range.isValid() && range.getEndByte() > 0)
@@ -234,7 +261,7 @@ std::string HTTPConnection::readLine()
 
 void HTTPConnection::setUsed( bool b )
 {
-    available = !b;
+    AbstractConnection::setUsed(b);
     if(available)
     {
         if(!connectionClose && contentLength == bytesRead )
@@ -385,7 +412,7 @@ ssize_t StreamUrlConnection::read(void *p_buffer, size_t len)
 
 void StreamUrlConnection::setUsed( bool b )
 {
-    available = !b;
+    AbstractConnection::setUsed(b);
     if(available && contentLength == bytesRead)
        reset();
 }
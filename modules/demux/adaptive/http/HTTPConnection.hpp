@@ -53,7 +53,10 @@ namespace adaptive
                 virtual ssize_t read        (void *p_buffer, size_t len) = 0;
 
                 virtual size_t  getContentLength() const;
-                virtual void    setUsed( bool ) = 0;
+                virtual void    setUsed( bool );
+                bool            isAvailable () const;
+                mtime_t         getIdleTime () const;
+                mtime_t         getHandshakeTime() const;
 
             protected:
                 vlc_object_t      *p_object;
@@ -62,6 +65,8 @@ namespace adaptive
                 size_t             contentLength;
                 BytesRange         bytesRange;
                 size_t             bytesRead;
+                mtime_t            releaseTime;
+                mtime_t            handshakeTime; /* of last request, 0 if none */
         };
 
         class HTTPConnection : public AbstractConnection
@@ -30,17 +30,32 @@
 #include "ConnectionParams.hpp"
 #include "Sockets.hpp"
 #include "Downloader.hpp"
+#include "SegmentCache.hpp"
 #include <vlc_url.h>
+#include <vlc_configuration.h>
 
 using namespace adaptive::http;
 
+ConnectionStats::ConnectionStats()
+{
+    requests = reused = handshakes = responses = expired = 0;
+    handshakeTime = ttfbTime = 0;
+}
+
 HTTPConnectionManager::HTTPConnectionManager    (vlc_object_t *p_object_, ConnectionFactory *factory_) :
                        p_object                 (p_object_),
                        rateObserver             (NULL)
 {
+    cache = NULL;
     vlc_mutex_init(&lock);
-    downloader = new (std::nothrow) Downloader();
-    downloader->start();
+    downloader = new (std::nothrow) Downloader(
+                var_InheritInteger(p_object, "adaptive-maxdownloads"),
+                var_InheritInteger(p_object, "adaptive-maxconnections"));
+    if(downloader && !downloader->start())
+    {
+        delete downloader;
+        downloader = NULL;
+    }
     if(!factory_)
     {
         if(var_InheritBool(p_object, "adaptive-use-access"))
@@ -54,8 +69,16 @@ HTTPConnectionManager::HTTPConnectionManager    (vlc_object_t *p_object_, Connec
 HTTPConnectionManager::~HTTPConnectionManager   ()
 {
     delete downloader;
+    delete cache;
     delete factory;
     this->closeAllConnections();
+    if(stats.requests)
+        msg_Dbg(p_object, "connections: %u requests, %u%% reused, %u handshakes "
+                          "(avg %" PRId64 " ms), avg ttfb %" PRId64 " ms, %u expired",
+                stats.requests, stats.reused * 100 / stats.requests, stats.handshakes,
+                (stats.handshakes) ? stats.handshakeTime / stats.handshakes / 1000 : 0,
+                (stats.responses) ? stats.ttfbTime / stats.responses / 1000 : 0,
+                stats.expired);
     vlc_mutex_destroy(&lock);
 }
 
@@ -63,21 +86,47 @@ void HTTPConnectionManager::closeAllConnections      ()
 {
     vlc_mutex_lock(&lock);
     releaseAllConnections();
-    vlc_delete_all(this->connectionPool);
+    ConnectionPools::iterator it;
+    for(it = connectionPools.begin(); it != connectionPools.end(); ++it)
+        vlc_delete_all((*it).second);
+    connectionPools.clear();
     vlc_mutex_unlock(&lock);
 }
 
 void HTTPConnectionManager::releaseAllConnections()
 {
-    std::vector<AbstractConnection *>::iterator it;
-    for(it = connectionPool.begin(); it != connectionPool.end(); ++it)
-        (*it)->setUsed(false);
+    ConnectionPools::iterator it;
+    for(it = connectionPools.begin(); it != connectionPools.end(); ++it)
+    {
+        ConnectionPool::iterator it2;
+        for(it2 = (*it).second.begin(); it2 != (*it).second.end(); ++it2)
+            (*it2)->setUsed(false);
+    }
 }
 
-AbstractConnection * HTTPConnectionManager::reuseConnection(ConnectionParams &params)
+void HTTPConnectionManager::expireConnections(ConnectionPool &pool)
 {
-    std::vector<AbstractConnection *>::const_iterator it;
-    for(it = connectionPool.begin(); it != connectionPool.end(); ++it)
+    /* Servers will drop idle keep-alive connections anyway. Closing them
+     * first avoids failing a request on a half closed socket. */
+    ConnectionPool::iterator it = pool.begin();
+    while(it != pool.end())
+    {
+        AbstractConnection *conn = *it;
+        if(conn->isAvailable() && conn->getIdleTime() > IDLE_TIMEOUT)
+        {
+            delete conn;
+            it = pool.erase(it);
+            stats.expired++;
+        }
+        else ++it;
+    }
+}
+
+AbstractConnection * HTTPConnectionManager::reuseConnection(ConnectionPool &pool,
+                                                             ConnectionParams &params)
+{
+    ConnectionPool::const_iterator it;
+    for(it = pool.begin(); it != pool.end(); ++it)
     {
         AbstractConnection *conn = *it;
         if(conn->canReuse(params))
@@ -88,16 +137,23 @@ AbstractConnection * HTTPConnectionManager::reuseConnection(ConnectionParams &pa
 
 AbstractConnection * HTTPConnectionManager::getConnection(ConnectionParams &params)
 {
-    if(unlikely(!factory || !downloader))
+    if(unlikely(!factory))
         return NULL;
 
     vlc_mutex_lock(&lock);
-    AbstractConnection *conn = reuseConnection(params);
+    ConnectionPool &pool = connectionPools[params];
+    expireConnections(pool);
+    AbstractConnection *conn = reuseConnection(pool, params);
     if(!conn)
     {
         conn = factory->createConnection(p_object, params);
+        if(!conn)
+        {
+            vlc_mutex_unlock(&lock);
+            return NULL;
+        }
 
-        connectionPool.push_back(conn);
+        pool.push_back(conn);
 
         if (!conn->prepare(params))
         {
@@ -105,12 +161,24 @@ AbstractConnection * HTTPConnectionManager::getConnection(ConnectionParams &para
             return NULL;
         }
     }
+    else
+    {
+        stats.reused++;
+    }
 
+    stats.requests++;
     conn->setUsed(true);
     vlc_mutex_unlock(&lock);
     return conn;
 }
 
+void HTTPConnectionManager::releaseConnection(AbstractConnection *conn)
+{
+    vlc_mutex_lock(&lock);
+    conn->setUsed(false);
+    vlc_mutex_unlock(&lock);
+}
+
 void HTTPConnectionManager::updateDownloadRate(size_t size, mtime_t time)
 {
     if(rateObserver)
@@ -121,3 +189,47 @@ void HTTPConnectionManager::setDownloadRateObserver(IDownloadRateObserver *obs)
 {
     rateObserver = obs;
 }
+
+void HTTPConnectionManager::updateRequestStats(mtime_t handshake, mtime_t ttfb)
+{
+    vlc_mutex_lock(&lock);
+    if(handshake)
+    {
+        stats.handshakes++;
+        stats.handshakeTime += handshake;
+    }
+    stats.responses++;
+    stats.ttfbTime += ttfb;
+    vlc_mutex_unlock(&lock);
+}
+
+bool HTTPConnectionManager::enableCache()
+{
+    const uint64_t maxsize = (uint64_t) var_InheritInteger(p_object, "adaptive-cache-size") << 20;
+    if(cache || maxsize == 0)
+        return cache != NULL;
+
+    std::string dir;
+    char *psz_dir = var_InheritString(p_object, "adaptive-cache-dir");
+    if(psz_dir == NULL)
+    {
+        char *psz_cachedir = config_GetUserDir(VLC_CACHE_DIR);
+        if(psz_cachedir == NULL)
+            return false;
+        dir = std::string(psz_cachedir) + DIR_SEP + "adaptive";
+        free(psz_cachedir);
+    }
+    else
+    {
+        dir = psz_dir;
+        free(psz_dir);
+    }
+
+    cache = new (std::nothrow) SegmentCache(p_object, dir, maxsize);
+    if(cache && !cache->open())
+    {
+        delete cache;
+        cache = NULL;
+    }
+    return cache != NULL;
+}
@@ -30,19 +30,34 @@
 #endif
 
 #include "../logic/IDownloadRateObserver.h"
+#include "ConnectionParams.hpp"
 
 #include <vlc_common.h>
 #include <vector>
 #include <string>
+#include <map>
 
 namespace adaptive
 {
     namespace http
     {
-        class ConnectionParams;
         class ConnectionFactory;
         class AbstractConnection;
         class Downloader;
+        class SegmentCache;
+
+        class ConnectionStats
+        {
+            public:
+                ConnectionStats();
+                unsigned    requests;       /* connections handed out */
+                unsigned    reused;         /* handed out from the pool */
+                unsigned    handshakes;     /* requests needing to (re)connect */
+                mtime_t     handshakeTime;  /* cumulated connect/TLS time */
+                unsigned    responses;
+                mtime_t     ttfbTime;       /* cumulated request to headers time */
+                unsigned    expired;        /* idle connections closed */
+        };
 
         class HTTPConnectionManager : public IDownloadRateObserver
         {
@@ -52,19 +67,30 @@ namespace adaptive
 
                 void    closeAllConnections ();
                 AbstractConnection * getConnection(ConnectionParams &);
+                void    releaseConnection(AbstractConnection *);
 
                 virtual void updateDownloadRate(size_t, mtime_t); /* reimpl */
                 void setDownloadRateObserver(IDownloadRateObserver *);
+                void updateRequestStats(mtime_t, mtime_t);
+                bool    enableCache();
                 Downloader *downloader;
+                SegmentCache *cache;
+
+                static const mtime_t IDLE_TIMEOUT = CLOCK_FREQ * 5;
 
             private:
                 void    releaseAllConnections ();
+                typedef std::vector<AbstractConnection *> ConnectionPool;
+                typedef std::map<ConnectionParams, ConnectionPool,
+                                 ConnectionParams::HostLess> ConnectionPools;
                 vlc_mutex_t                                         lock;
-                std::vector<AbstractConnection *>                   connectionPool;
+                ConnectionPools                                     connectionPools;
+                ConnectionStats                                     stats;
                 vlc_object_t                                       *p_object;
                 IDownloadRateObserver                              *rateObserver;
                 ConnectionFactory                                  *factory;
-                AbstractConnection * reuseConnection(ConnectionParams &);
+                AbstractConnection * reuseConnection(ConnectionPool &, ConnectionParams &);
+                void    expireConnections(ConnectionPool &);
         };
     }
 }
@@ -0,0 +1,363 @@
+/*
+ * SegmentCache.cpp
+ *****************************************************************************
+ * Copyright (C) 2016 - VideoLAN and VLC Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "SegmentCache.hpp"
+
+#include <vlc_block.h>
+#include <vlc_fs.h>
+
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <sstream>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef HAVE_MMAP
+# include <sys/mman.h>
+#endif
+
+using namespace adaptive::http;
+
+static const char INDEX_MAGIC[8] = { 'V','L','C','S','E','G','C','H' };
+static const uint32_t INDEX_VERSION = 1;
+
+SegmentCache::SegmentCache(vlc_object_t *p_obj_, const std::string &dir_, uint64_t maxsize_)
+{
+    p_obj = p_obj_;
+    dir = dir_;
+    maxsize = maxsize_;
+    usedsize = 0;
+    indexfd = -1;
+    header = NULL;
+    entries = NULL;
+    vlc_mutex_init(&lock);
+}
+
+SegmentCache::~SegmentCache()
+{
+#ifdef HAVE_MMAP
+    if(header)
+        munmap(header, sizeof(IndexHeader) + sizeof(IndexEntry) * MAX_ENTRIES);
+#endif
+    if(indexfd != -1)
+        close(indexfd);
+    vlc_mutex_destroy(&lock);
+}
+
+bool SegmentCache::open()
+{
+#ifdef HAVE_MMAP
+    if(vlc_mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST)
+    {
+        msg_Warn(p_obj, "cannot create segment cache directory %s", dir.c_str());
+        return false;
+    }
+
+    const std::string indexpath = dir + DIR_SEP + "index";
+    indexfd = vlc_open(indexpath.c_str(), O_RDWR | O_CREAT, 0600);
+    if(indexfd == -1)
+        return false;
+
+    const size_t length = sizeof(IndexHeader) + sizeof(IndexEntry) * MAX_ENTRIES;
+    struct stat st;
+    if(fstat(indexfd, &st) != 0)
+        return false;
+    if((uint64_t) st.st_size != length &&
+       (ftruncate(indexfd, 0) != 0 || ftruncate(indexfd, length) != 0))
+        return false;
+
+    void *addr = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, indexfd, 0);
+    if(addr == MAP_FAILED)
+        return false;
+    header = static_cast<IndexHeader *>(addr);
+    entries = reinterpret_cast<IndexEntry *>(&header[1]);
+
+    if(memcmp(header->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) ||
+       header->version != INDEX_VERSION || header->entries != MAX_ENTRIES)
+    {
+        memset(addr, 0, length);
+        memcpy(header->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+        header->version = INDEX_VERSION;
+        header->entries = MAX_ENTRIES;
+    }
+
+    unsigned count = 0;
+    for(unsigned i=0; i<MAX_ENTRIES; i++)
+    {
+        if(entries[i].hash)
+        {
+            usedsize += entries[i].size;
+            count++;
+        }
+    }
+
+    /* Size limit might have been lowered since last run */
+    vlc_mutex_lock(&lock);
+    makeRoom(0);
+    vlc_mutex_unlock(&lock);
+
+    msg_Dbg(p_obj, "segment cache %s: %u entries, %" PRIu64 "/%" PRIu64 " KiB",
+            dir.c_str(), count, usedsize / 1024, maxsize / 1024);
+    return true;
+#else
+    msg_Dbg(p_obj, "segment cache unavailable on this platform");
+    return false;
+#endif
+}
+
+std::string SegmentCache::makeKey(const std::string &url, const BytesRange &range)
+{
+    std::stringstream ss;
+    ss << url;
+    if(range.isValid())
+        ss << " " << range.getStartByte() << "-" << range.getEndByte();
+    return ss.str();
+}
+
+uint64_t SegmentCache::hashKey(const std::string &key)
+{
+    /* FNV-1a */
+    uint64_t hash = UINT64_C(0xcbf29ce484222325);
+    for(std::string::const_iterator it = key.begin(); it != key.end(); ++it)
+    {
+        hash ^= (uint8_t) *it;
+        hash *= UINT64_C(0x100000001b3);
+    }
+    return hash ? hash : 1;
+}
+
+std::string SegmentCache::entryPath(uint64_t hash) const
+{
+    char psz_name[17];
+    snprintf(psz_name, sizeof(psz_name), "%016" PRIx64, hash);
+    return dir + DIR_SEP + psz_name;
+}
+
+SegmentCache::IndexEntry * SegmentCache::findEntry(uint64_t hash)
+{
+    for(unsigned i=0; i<MAX_ENTRIES; i++)
+        if(entries[i].hash == hash)
+            return &entries[i];
+    return NULL;
+}
+
+void SegmentCache::removeEntry(IndexEntry *entry)
+{
+    vlc_unlink(entryPath(entry->hash).c_str());
+    usedsize -= entry->size;
+    memset(entry, 0, sizeof(*entry));
+}
+
+/* Evicts least recently used entries until size fits.
+ * Returns a free slot, or NULL */
+SegmentCache::IndexEntry * SegmentCache::makeRoom(uint64_t size)
+{
+    for(;;)
+    {
+        IndexEntry *freeslot = NULL;
+        IndexEntry *lru = NULL;
+        for(unsigned i=0; i<MAX_ENTRIES; i++)
+        {
+            if(entries[i].hash == 0)
+            {
+                if(!freeslot)
+                    freeslot = &entries[i];
+            }
+            else if(!lru || entries[i].lastuse < lru->lastuse)
+            {
+                lru = &entries[i];
+            }
+        }
+
+        if(freeslot && usedsize + size <= maxsize)
+            return freeslot;
+        if(!lru)
+            return NULL;
+        removeEntry(lru);
+    }
+}
+
+block_t * SegmentCache::get(const std::string &url, const BytesRange &range)
+{
+    if(!header)
+        return NULL;
+
+    const std::string key = makeKey(url, range);
+    const uint64_t hash = hashKey(key);
+
+    vlc_mutex_lock(&lock);
+    IndexEntry *entry = findEntry(hash);
+    if(!entry)
+    {
+        vlc_mutex_unlock(&lock);
+        return NULL;
+    }
+    const uint64_t size = entry->size;
+    entry->lastuse = ++header->clock;
+    vlc_mutex_unlock(&lock);
+
+    int fd = vlc_open(entryPath(hash).c_str(), O_RDONLY);
+    if(fd == -1)
+        return NULL;
+    block_t *p_block = block_File(fd);
+    close(fd);
+    if(!p_block)
+        return NULL;
+
+    /* Entry starts with its key, to rule out hash collisions */
+    uint32_t keylen = 0;
+    if(p_block->i_buffer >= sizeof(keylen))
+        memcpy(&keylen, p_block->p_buffer, sizeof(keylen));
+    if(p_block->i_buffer < sizeof(keylen) ||
+       p_block->i_buffer - sizeof(keylen) < keylen ||
+       p_block->i_buffer - sizeof(keylen) - keylen != size ||
+       key.compare(0, std::string::npos, (const char *) &p_block->p_buffer[sizeof(keylen)], keylen))
+    {
+        block_Release(p_block);
+        return NULL;
+    }
+
+    p_block->p_buffer += sizeof(keylen) + keylen;
+    p_block->i_buffer = size;
+    return p_block;
+}
+
+SegmentCache::Writer * SegmentCache::store(const std::string &url, const BytesRange &range)
+{
+    if(!header)
+        return NULL;
+
+    const std::string key = makeKey(url, range);
+    const uint64_t hash = hashKey(key);
+    const std::string path = entryPath(hash) + ".part";
+
+    /* Fails if the same segment is already being stored */
+    int fd = vlc_open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0600);
+    if(fd == -1 && errno == EEXIST)
+    {
+        /* unless left over by an interrupted run */
+        struct stat st;
+        if(vlc_stat(path.c_str(), &st) == 0 && st.st_mtime + STALE_DELAY < time(NULL) &&
+           vlc_unlink(path.c_str()) == 0)
+            fd = vlc_open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0600);
+    }
+    if(fd == -1)
+        return NULL;
+
+    Writer *writer = new (std::nothrow) Writer(this, hash, path, fd);
+    if(!writer)
+    {
+        close(fd);
+        vlc_unlink(path.c_str());
+        return NULL;
+    }
+
+    const uint32_t keylen = key.length();
+    if(!writer->write((const uint8_t *) &keylen, sizeof(keylen)) ||
+       !writer->write((const uint8_t *) key.c_str(), keylen))
+    {
+        delete writer;
+        return NULL;
+    }
+    writer->size = 0;
+
+    return writer;
+}
+
+void SegmentCache::commit(Writer *writer)
+{
+    close(writer->fd);
+    writer->fd = -1;
+
+    const std::string path = entryPath(writer->hash);
+
+    vlc_mutex_lock(&lock);
+    IndexEntry *entry = findEntry(writer->hash);
+    if(entry)
+        removeEntry(entry);
+    if(writer->size == 0 || writer->size > maxsize ||
+       !(entry = makeRoom(writer->size)) ||
+       vlc_rename(writer->path.c_str(), path.c_str()) != 0)
+    {
+        vlc_mutex_unlock(&lock);
+        vlc_unlink(writer->path.c_str());
+        return;
+    }
+    entry->hash = writer->hash;
+    entry->size = writer->size;
+    entry->lastuse = ++header->clock;
+    usedsize += writer->size;
+    vlc_mutex_unlock(&lock);
+}
+
+SegmentCache::Writer::Writer(SegmentCache *cache_, uint64_t hash_,
+                             const std::string &path_, int fd_)
+{
+    cache = cache_;
+    hash = hash_;
+    path = path_;
+    fd = fd_;
+    size = 0;
+}
+
+SegmentCache::Writer::~Writer()
+{
+    /* Not committed */
+    if(fd != -1)
+    {
+        close(fd);
+        vlc_unlink(path.c_str());
+    }
+}
+
+bool SegmentCache::Writer::write(const uint8_t *p_data, size_t i_data)
+{
+    if(fd == -1)
+        return false;
+
+    while(i_data > 0)
+    {
+        ssize_t ret = ::write(fd, p_data, i_data);
+        if(ret < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            close(fd);
+            vlc_unlink(path.c_str());
+            fd = -1;
+            return false;
+        }
+        p_data += ret;
+        i_data -= ret;
+        size += ret;
+    }
+    return true;
+}
+
+void SegmentCache::Writer::commit()
+{
+    if(fd != -1)
+        cache->commit(this);
+}
@@ -0,0 +1,104 @@
+/*
+ * SegmentCache.hpp
+ *****************************************************************************
+ * Copyright (C) 2016 - VideoLAN and VLC Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef SEGMENTCACHE_HPP
+#define SEGMENTCACHE_HPP
+
+#include "BytesRange.hpp"
+
+#include <vlc_common.h>
+#include <string>
+#include <ctime>
+
+typedef struct block_t block_t;
+
+namespace adaptive
+{
+    namespace http
+    {
+        /* Disk backed LRU cache of downloaded segments, keyed by url and
+         * byte range. Entries are files named after the key hash, and
+         * tracked in a fixed size index file mapped in memory. */
+        class SegmentCache
+        {
+            public:
+                SegmentCache(vlc_object_t *, const std::string &, uint64_t);
+                ~SegmentCache();
+
+                bool        open();
+                block_t *   get(const std::string &, const BytesRange &);
+
+                class Writer
+                {
+                    friend class SegmentCache;
+
+                    public:
+                        ~Writer();
+                        bool write(const uint8_t *, size_t);
+                        void commit();
+
+                    private:
+                        Writer(SegmentCache *, uint64_t, const std::string &, int);
+                        SegmentCache *cache;
+                        uint64_t    hash;
+                        std::string path;
+                        int         fd;
+                        uint64_t    size;
+                };
+                Writer *    store(const std::string &, const BytesRange &);
+
+                static const unsigned MAX_ENTRIES = 4096;
+                static const time_t   STALE_DELAY = 60; /* seconds */
+
+            private:
+                struct IndexHeader
+                {
+                    char        magic[8];
+                    uint32_t    version;
+                    uint32_t    entries;
+                    uint64_t    clock; /* last use counter */
+                };
+                struct IndexEntry
+                {
+                    uint64_t    hash; /* 0 for free slots */
+                    uint64_t    size;
+                    uint64_t    lastuse;
+                };
+
+                static std::string makeKey(const std::string &, const BytesRange &);
+                static uint64_t hashKey(const std::string &);
+                std::string entryPath(uint64_t) const;
+                IndexEntry *findEntry(uint64_t);
+                void        removeEntry(IndexEntry *);
+                IndexEntry *makeRoom(uint64_t);
+                void        commit(Writer *);
+
+                vlc_object_t   *p_obj;
+                std::string     dir;
+                uint64_t        maxsize;
+                uint64_t        usedsize;
+                int             indexfd;
+                IndexHeader    *header;
+                IndexEntry     *entries;
+                vlc_mutex_t     lock;
+        };
+    }
+}
+
+#endif // SEGMENTCACHE_HPP
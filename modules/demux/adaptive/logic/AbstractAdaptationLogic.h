@@ -57,7 +57,8 @@ namespace adaptive
                     AlwaysBest,
                     AlwaysLowest,
                     RateBased,
-                    FixedRate
+                    FixedRate,
+                    Hybrid
                 };
         };
     }
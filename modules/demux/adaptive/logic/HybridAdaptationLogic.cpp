@@ -0,0 +1,168 @@
+/*
+ * HybridAdaptationLogic.cpp
+ *****************************************************************************
+ * Copyright (C) 2016 - VideoLAN and VLC authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "HybridAdaptationLogic.hpp"
+#include "Representationselectors.hpp"
+
+#include "../playlist/BaseRepresentation.h"
+#include "../playlist/BaseAdaptationSet.h"
+
+#include <cmath>
+
+using namespace adaptive::logic;
+using namespace adaptive;
+
+HybridAdaptationLogic::BufferingState::BufferingState()
+{
+    current = 0;
+    target = 0;
+}
+
+HybridAdaptationLogic::HybridAdaptationLogic(vlc_object_t *p_obj_, int w, int h) :
+    RateBasedAdaptationLogic(p_obj_, w, h)
+{
+    vlc_mutex_init(&statelock);
+}
+
+HybridAdaptationLogic::~HybridAdaptationLogic()
+{
+    vlc_mutex_destroy(&statelock);
+}
+
+BaseRepresentation *HybridAdaptationLogic::getNextRepresentation(BaseAdaptationSet *adaptSet,
+                                                                 BaseRepresentation *currep) const
+{
+    if(adaptSet == NULL)
+        return NULL;
+
+    BufferingState state;
+    vlc_mutex_lock(const_cast<vlc_mutex_t *>(&statelock));
+    std::map<BaseAdaptationSet *, BufferingState>::const_iterator it = states.find(adaptSet);
+    if(it != states.end())
+        state = (*it).second;
+    vlc_mutex_unlock(const_cast<vlc_mutex_t *>(&statelock));
+
+    /* Below the BOLA reservoir, or when we know nothing about the
+     * buffer, throughput is the only sensible indicator */
+    const mtime_t reservoir = state.target / 3;
+    if(state.target == 0 || state.current < reservoir)
+        return RateBasedAdaptationLogic::getNextRepresentation(adaptSet, currep);
+
+    BaseRepresentation *rep = getBolaRepresentation(adaptSet, state.current, state.target);
+    if(rep == NULL)
+        return RateBasedAdaptationLogic::getNextRepresentation(adaptSet, currep);
+
+    /* BOLA-O: don't switch up past what the link can sustain,
+     * as we would only have to come back down later */
+    if(currep && rep->getBandwidth() > currep->getBandwidth())
+    {
+        const size_t availBps = getAvailableBw(currep);
+        if(rep->getBandwidth() > availBps)
+        {
+            RepresentationSelector selector;
+            BaseRepresentation *sustainable = selector.select(adaptSet, availBps, width, height);
+            if(sustainable && sustainable->getBandwidth() > currep->getBandwidth() &&
+               sustainable->getBandwidth() <= availBps)
+                rep = sustainable;
+            else
+                rep = currep;
+        }
+    }
+
+    return rep;
+}
+
+BaseRepresentation *HybridAdaptationLogic::getBolaRepresentation(BaseAdaptationSet *adaptSet,
+                                                                 mtime_t current,
+                                                                 mtime_t target) const
+{
+    std::vector<BaseRepresentation *> reps = adaptSet->getRepresentations();
+    std::vector<BaseRepresentation *>::const_iterator it;
+
+    uint64_t minbw = 0, maxbw = 0;
+    for(it = reps.begin(); it != reps.end(); ++it)
+    {
+        const uint64_t bw = (*it)->getBandwidth();
+        if(bw == 0)
+            continue;
+        if(minbw == 0 || bw < minbw)
+            minbw = bw;
+        if(bw > maxbw)
+            maxbw = bw;
+    }
+
+    if(minbw == 0 || maxbw <= minbw)
+        return NULL;
+
+    /* Utilities are log(size), 1 for the lowest. Parameters are set so that
+     * the lowest is picked at the reservoir level and the highest when the
+     * buffer reaches target (see BOLA, Spiteri et al. 2016) */
+    const double umax = log((double) maxbw / minbw) + 1.0;
+    const double gp = (umax - 1.0) / 2.0; /* target / reservoir - 1 */
+    const double V = (double) (target / 3) / gp;
+    const double Q = (double) current;
+
+    BaseRepresentation *best = NULL;
+    double bestscore = 0.0;
+    for(it = reps.begin(); it != reps.end(); ++it)
+    {
+        const uint64_t bw = (*it)->getBandwidth();
+        if(bw == 0)
+            continue;
+        const double u = log((double) bw / minbw) + 1.0;
+        const double score = (V * (u + gp) - Q) / bw;
+        if(best == NULL || score > bestscore)
+        {
+            best = *it;
+            bestscore = score;
+        }
+    }
+
+    /* Apply the same resolution constraints as throughput selection */
+    if(best)
+    {
+        RepresentationSelector selector;
+        BaseRepresentation *rep = selector.select(adaptSet, best->getBandwidth() + 1,
+                                                  width, height);
+        if(rep)
+            best = rep;
+    }
+
+    return best;
+}
+
+void HybridAdaptationLogic::trackerEvent(const SegmentTrackerEvent &event)
+{
+    if(event.type == SegmentTrackerEvent::BUFFERING_STATE)
+    {
+        vlc_mutex_lock(&statelock);
+        BufferingState &state = states[event.u.buffering.set];
+        state.current = event.u.buffering.current;
+        state.target = event.u.buffering.target;
+        vlc_mutex_unlock(&statelock);
+    }
+    else
+    {
+        RateBasedAdaptationLogic::trackerEvent(event);
+    }
+}
@@ -0,0 +1,58 @@
+/*
+ * HybridAdaptationLogic.hpp
+ *****************************************************************************
+ * Copyright (C) 2016 - VideoLAN and VLC authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef HYBRIDADAPTATIONLOGIC_HPP
+#define HYBRIDADAPTATIONLOGIC_HPP
+
+#include "RateBasedAdaptationLogic.h"
+
+#include <map>
+
+namespace adaptive
+{
+    namespace logic
+    {
+        /* Throughput based while the buffer is low, then buffer based
+         * using BOLA utility scores, with upswitches capped by throughput */
+        class HybridAdaptationLogic : public RateBasedAdaptationLogic
+        {
+            public:
+                HybridAdaptationLogic            (vlc_object_t *, int, int);
+                virtual ~HybridAdaptationLogic   ();
+
+                BaseRepresentation *getNextRepresentation(BaseAdaptationSet *, BaseRepresentation *) const;
+                virtual void trackerEvent(const SegmentTrackerEvent &); /* reimpl */
+
+            private:
+                BaseRepresentation *getBolaRepresentation(BaseAdaptationSet *,
+                                                          mtime_t, mtime_t) const;
+                class BufferingState
+                {
+                    public:
+                        BufferingState();
+                        mtime_t current;
+                        mtime_t target;
+                };
+                std::map<BaseAdaptationSet *, BufferingState> states;
+                vlc_mutex_t             statelock;
+        };
+    }
+}
+
+#endif // HYBRIDADAPTATIONLOGIC_HPP
@@ -63,13 +63,7 @@ BaseRepresentation *RateBasedAdaptationLogic::getNextRepresentation(BaseAdaptati
     if(adaptSet == NULL)
         return NULL;
 
-    vlc_mutex_lock(const_cast<vlc_mutex_t *>(&lock));
-    size_t availBps = currentBps + ((currep) ? currep->getBandwidth() : 0);
-    vlc_mutex_unlock(const_cast<vlc_mutex_t *>(&lock));
-    if(availBps > usedBps)
-        availBps -= usedBps;
-    else
-        availBps = 0;
+    size_t availBps = getAvailableBw(currep);
 
     RepresentationSelector selector;
     BaseRepresentation *rep = selector.select(adaptSet, availBps, width, height);
@@ -83,16 +77,35 @@ BaseRepresentation *RateBasedAdaptationLogic::getNextRepresentation(BaseAdaptati
     return rep;
 }
 
+size_t RateBasedAdaptationLogic::getAvailableBw(const BaseRepresentation *currep) const
+{
+    vlc_mutex_lock(const_cast<vlc_mutex_t *>(&lock));
+    size_t availBps = currentBps + ((currep) ? currep->getBandwidth() : 0);
+    if(availBps > usedBps)
+        availBps -= usedBps;
+    else
+        availBps = 0;
+    vlc_mutex_unlock(const_cast<vlc_mutex_t *>(&lock));
+    return availBps;
+}
+
 void RateBasedAdaptationLogic::updateDownloadRate(size_t size, mtime_t time)
 {
     if(unlikely(time == 0))
         return;
+
+    /* Rates can be reported by several downloader threads */
+    vlc_mutex_lock(&lock);
+
     /* Accumulate up to observation window */
     dllength += time;
     dlsize += size;
 
     if(dllength < CLOCK_FREQ / 4)
+    {
+        vlc_mutex_unlock(&lock);
         return;
+    }
 
     const size_t bps = CLOCK_FREQ * dlsize * 8 / dllength;
 
@@ -129,7 +142,6 @@ void RateBasedAdaptationLogic::updateDownloadRate(size_t size, mtime_t time)
     const size_t deltamax = omax - omin;
     double alpha = (diffsum) ? 0.33 * ((double)deltamax / diffsum) : 0.5;
 
-    vlc_mutex_lock(&lock);
     bpsAvg = alpha * bpsAvg + (1.0 - alpha) * bps;
 
     BwDebug(msg_Dbg(p_obj, "alpha1 %lf alpha0 %lf dmax %ld ds %ld", alpha,
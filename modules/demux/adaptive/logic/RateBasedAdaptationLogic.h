@@ -42,9 +42,12 @@ namespace adaptive
                 virtual void updateDownloadRate(size_t, mtime_t); /* reimpl */
                 virtual void trackerEvent(const SegmentTrackerEvent &); /* reimpl */
 
-            private:
+            protected:
+                size_t getAvailableBw(const BaseRepresentation *) const;
                 int                     width;
                 int                     height;
+
+            private:
                 size_t                  bpsAvg;
                 size_t                  currentBps;
                 size_t                  usedBps;
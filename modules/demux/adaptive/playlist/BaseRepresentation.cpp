@@ -31,6 +31,7 @@
 #include "BaseAdaptationSet.h"
 #include "SegmentTemplate.h"
 #include "SegmentTimeline.h"
+#include "AbstractPlaylist.hpp"
 #include "ID.hpp"
 
 using namespace adaptive;
@@ -78,6 +79,11 @@ bool BaseRepresentation::needsUpdate() const
     return false;
 }
 
+bool BaseRepresentation::isLive() const
+{
+    return getPlaylist()->isLive();
+}
+
 bool BaseRepresentation::runLocalUpdates(mtime_t, uint64_t, bool)
 {
     return false;
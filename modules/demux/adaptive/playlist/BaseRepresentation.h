@@ -63,6 +63,7 @@ namespace adaptive
 
                 virtual mtime_t     getMinAheadTime         (uint64_t) const;
                 virtual bool        needsUpdate             () const;
+                virtual bool        isLive                  () const;
                 virtual bool        runLocalUpdates         (mtime_t, uint64_t, bool);
                 virtual void        scheduleNextUpdate      (uint64_t);
 
@@ -61,12 +61,17 @@ ISegment::~ISegment()
     assert(chunksuse.Get() == 0);
 }
 
-SegmentChunk * ISegment::getChunk(const std::string &url, HTTPConnectionManager *connManager)
+SegmentChunk * ISegment::getChunk(const std::string &url, HTTPConnectionManager *connManager,
+                                  bool cacheable)
 {
-    HTTPChunkBufferedSource *source = new HTTPChunkBufferedSource(url, connManager);
+    Downloader *downloader = connManager->downloader;
+    /* Without downloader threads, the chunk is read directly */
+    HTTPChunkSource *source = downloader ? new HTTPChunkBufferedSource(url, connManager, cacheable)
+                                         : new HTTPChunkSource(url, connManager);
     if(startByte != endByte)
         source->setBytesRange(BytesRange(startByte, endByte));
-    connManager->downloader->schedule(source);
+    if(downloader)
+        downloader->schedule(static_cast<HTTPChunkBufferedSource *>(source));
     return new (std::nothrow) SegmentChunk(this, source);
 }
 
@@ -80,7 +85,9 @@ SegmentChunk* ISegment::toChunk(size_t index, BaseRepresentation *ctxrep, HTTPCo
     SegmentChunk *chunk;
     try
     {
-        chunk = getChunk(getUrlSegment().toString(index, ctxrep), connManager);
+        /* Live segments are seldom played twice */
+        chunk = getChunk(getUrlSegment().toString(index, ctxrep), connManager,
+                         ctxrep && !ctxrep->isLive());
         if (!chunk)
             return NULL;
     }
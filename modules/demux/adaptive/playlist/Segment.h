@@ -89,7 +89,7 @@ namespace adaptive
                 static const int        SEQUENCE_INVALID;
                 static const int        SEQUENCE_FIRST;
 
-                virtual SegmentChunk * getChunk(const std::string &, HTTPConnectionManager *);
+                virtual SegmentChunk * getChunk(const std::string &, HTTPConnectionManager *, bool);
         };
 
         class Segment : public ISegment
@@ -454,6 +454,11 @@ void SegmentInformation::setSegmentList(SegmentList *list)
     }
 }
 
+SegmentList * SegmentInformation::getSegmentList() const
+{
+    return segmentList;
+}
+
 void SegmentInformation::setSegmentBase(SegmentBase *base)
 {
     if(segmentBase)
@@ -99,6 +99,7 @@ namespace adaptive
 
             public:
                 void setSegmentList(SegmentList *);
+                SegmentList * getSegmentList() const;
                 void setSegmentBase(SegmentBase *);
                 void setSegmentTemplate(MediaSegmentTemplate *);
                 void setSwitchPolicy(SwitchPolicy);
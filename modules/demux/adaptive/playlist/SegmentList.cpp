@@ -105,8 +105,10 @@ void SegmentList::pruneBySegmentNumber(uint64_t tobelownum)
             break;
 
         delete *it;
-        it = segments.erase(it);
+        ++it;
     }
+    /* single erase, as the window can be thousands of segments long */
+    segments.erase(segments.begin(), it);
 }
 
 bool SegmentList::getSegmentNumberByScaledTime(stime_t time, uint64_t *ret) const
@@ -40,42 +40,36 @@ SegmentTimeline::SegmentTimeline(uint64_t scale)
 
 SegmentTimeline::~SegmentTimeline()
 {
-    std::list<Element *>::iterator it;
-    for(it = elements.begin(); it != elements.end(); ++it)
-        delete *it;
 }
 
 void SegmentTimeline::addElement(uint64_t number, stime_t d, uint64_t r, stime_t t)
 {
-    Element *element = new (std::nothrow) Element(number, d, r, t);
-    if(element)
+    Element element(number, d, r, t);
+    if(!elements.empty() && !t)
     {
-        if(!elements.empty() && !t)
-        {
-            const Element *el = elements.back();
-            element->t = el->t + (el->d * (el->r + 1));
-        }
-        elements.push_back(element);
+        const Element &el = elements.back();
+        element.t = el.t + (el.d * (el.r + 1));
     }
+    elements.push_back(element);
 }
 
 mtime_t SegmentTimeline::getMinAheadScaledTime(uint64_t number) const
 {
     stime_t totalscaledtime = 0;
 
-    std::list<Element *>::const_reverse_iterator it;
+    std::deque<Element>::const_reverse_iterator it;
     for(it = elements.rbegin(); it != elements.rend(); ++it)
     {
-        const Element *el = *it;
+        const Element &el = *it;
 
-        if(number < el->number)
+        if(number < el.number)
         {
-            totalscaledtime += (el->d * (el->r + 1));
+            totalscaledtime += (el.d * (el.r + 1));
             break;
         }
-        else if(number <= el->number + el->r)
+        else if(number <= el.number + el.r)
         {
-            totalscaledtime += el->d * (el->number + el->r - number);
+            totalscaledtime += el.d * (el.number + el.r - number);
         }
         else break;
     }
@@ -85,58 +79,42 @@ mtime_t SegmentTimeline::getMinAheadScaledTime(uint64_t number) const
 
 uint64_t SegmentTimeline::getElementNumberByScaledPlaybackTime(stime_t scaled) const
 {
-    uint64_t prevnumber = 0;
-    std::list<Element *>::const_iterator it;
-    for(it = elements.begin(); it != elements.end(); ++it)
-    {
-        const Element *el = *it;
-        if(it == elements.begin())
-            scaled -= el->t;
-
-        for(uint64_t repeat = 1 + el->r; repeat; repeat--)
-        {
-            if(el->d >= scaled)
-                return prevnumber;
+    if(elements.empty())
+        return 0;
 
-            scaled -= el->d;
-            prevnumber++;
-        }
+    /* last element starting at or before that time */
+    std::deque<Element>::const_iterator it =
+            std::upper_bound(elements.begin(), elements.end(), scaled, Element::startsAfter);
+    if(it == elements.begin()) /* before the first one */
+        return it->number;
+    --it;
 
-        /* might have been discontinuity */
-        prevnumber = el->number;
-    }
+    const Element &el = *it;
+    if(el.d <= 0)
+        return el.number;
 
-    return prevnumber;
+    /* past last repeat when in a discontinuity gap */
+    uint64_t count = (scaled - el.t) / el.d;
+    return el.number + std::min(count, el.r);
 }
 
 stime_t SegmentTimeline::getScaledPlaybackTimeByElementNumber(uint64_t number) const
 {
-    stime_t totalscaledtime = 0;
-
-    std::list<Element *>::const_iterator it;
-    for(it = elements.begin(); it != elements.end(); ++it)
-    {
-        const Element *el = *it;
-
-        /* set start time, or from discontinuity */
-        if(it == elements.begin() || el->t)
-        {
-            totalscaledtime = el->t;
-        }
+    if(elements.empty())
+        return 0;
 
-        if(number <= el->number)
-            break;
+    /* last element numbered at or before that number */
+    std::deque<Element>::const_iterator it =
+            std::upper_bound(elements.begin(), elements.end(), number, Element::numberedAfter);
+    if(it == elements.begin())
+        return it->t;
+    --it;
 
-        if(number <= el->number + el->r)
-        {
-            totalscaledtime += el->d * (number - el->number);
-            break;
-        }
-
-        totalscaledtime += (el->d * (el->r + 1));
-    }
+    const Element &el = *it;
+    if(number <= el.number + el.r)
+        return el.t + el.d * (number - el.number);
 
-    return totalscaledtime;
+    return el.t + el.d * (el.r + 1);
 }
 
 uint64_t SegmentTimeline::maxElementNumber() const
@@ -144,15 +122,15 @@ uint64_t SegmentTimeline::maxElementNumber() const
     if(elements.empty())
         return 0;
 
-    const Element *e = elements.back();
-    return e->number + e->r;
+    const Element &e = elements.back();
+    return e.number + e.r;
 }
 
 uint64_t SegmentTimeline::minElementNumber() const
 {
     if(elements.empty())
         return 0;
-    return elements.front()->number;
+    return elements.front().number;
 }
 
 void SegmentTimeline::pruneByPlaybackTime(mtime_t time)
@@ -167,25 +145,24 @@ size_t SegmentTimeline::pruneBySequenceNumber(uint64_t number)
     size_t prunednow = 0;
     while(elements.size())
     {
-        Element *el = elements.front();
-        if(el->number >= number)
+        Element &el = elements.front();
+        if(el.number >= number)
         {
             break;
         }
-        else if(el->number + el->r >= number)
+        else if(el.number + el.r >= number)
         {
-            uint64_t count = number - el->number;
-            el->number += count;
-            el->t += count * el->d;
-            el->r -= count;
+            uint64_t count = number - el.number;
+            el.number += count;
+            el.t += count * el.d;
+            el.r -= count;
             prunednow += count;
             break;
         }
         else
         {
-            prunednow += el->r + 1;
+            prunednow += el.r + 1;
             elements.pop_front();
-            delete el;
         }
     }
 
@@ -196,52 +173,47 @@ void SegmentTimeline::mergeWith(SegmentTimeline &other)
 {
     if(elements.empty())
     {
-        while(other.elements.size())
-        {
-            elements.push_back(other.elements.front());
-            other.elements.pop_front();
-        }
+        elements.swap(other.elements);
         return;
     }
 
-    Element *last = elements.back();
-    while(other.elements.size())
+    std::deque<Element>::iterator it;
+    for(it = other.elements.begin(); it != other.elements.end(); ++it)
     {
-        Element *el = other.elements.front();
-        other.elements.pop_front();
+        Element &last = elements.back();
+        Element &el = *it;
 
-        if(last->contains(el->t)) /* Same element, but prev could have been middle of repeat */
+        if(last.contains(el.t)) /* Same element, but prev could have been middle of repeat */
         {
-            const uint64_t count = (el->t - last->t) / last->d;
-            last->r = std::max(last->r, el->r + count);
-            delete el;
+            const uint64_t count = (el.t - last.t) / last.d;
+            last.r = std::max(last.r, el.r + count);
         }
-        else if(el->t < last->t)
+        else if(el.t < last.t)
         {
-            delete el;
+            continue;
         }
         else /* Did not exist in previous list */
         {
+            el.number = last.number + last.r + 1;
             elements.push_back(el);
-            el->number = last->number + last->r + 1;
-            last = el;
         }
     }
+    other.elements.clear();
 }
 
 mtime_t SegmentTimeline::start() const
 {
     if(elements.empty())
         return 0;
-    return elements.front()->t * CLOCK_FREQ / inheritTimescale();
+    return elements.front().t * CLOCK_FREQ / inheritTimescale();
 }
 
 mtime_t SegmentTimeline::end() const
 {
     if(elements.empty())
         return 0;
-    const Element *last = elements.back();
-    stime_t scaled = last->t + last->d * (last->r + 1);
+    const Element &last = elements.back();
+    stime_t scaled = last.t + last.d * (last.r + 1);
     return scaled  * CLOCK_FREQ / inheritTimescale();
 }
 
@@ -251,9 +223,9 @@ void SegmentTimeline::debug(vlc_object_t *obj, int indent) const
     ss << std::string(indent, ' ') << "Timeline";
     msg_Dbg(obj, "%s", ss.str().c_str());
 
-    std::list<Element *>::const_iterator it;
+    std::deque<Element>::const_iterator it;
     for(it = elements.begin(); it != elements.end(); ++it)
-        (*it)->debug(obj, indent + 1);
+        (*it).debug(obj, indent + 1);
 }
 
 SegmentTimeline::Element::Element(uint64_t number_, stime_t d_, uint64_t r_, stime_t t_)
@@ -271,6 +243,16 @@ bool SegmentTimeline::Element::contains(stime_t time) const
     return false;
 }
 
+bool SegmentTimeline::Element::startsAfter(stime_t time, const Element &el)
+{
+    return time < el.t;
+}
+
+bool SegmentTimeline::Element::numberedAfter(uint64_t number, const Element &el)
+{
+    return number < el.number;
+}
+
 void SegmentTimeline::Element::debug(vlc_object_t *obj, int indent) const
 {
     std::stringstream ss;
@@ -30,7 +30,7 @@
 
 #include "SegmentInfoCommon.h"
 #include <vlc_common.h>
-#include <list>
+#include <deque>
 
 namespace adaptive
 {
@@ -58,19 +58,23 @@ namespace adaptive
                 void debug(vlc_object_t *, int = 0) const;
 
             private:
-                std::list<Element *> elements;
-
                 class Element
                 {
                     public:
                         Element(uint64_t, stime_t, uint64_t, stime_t);
                         void debug(vlc_object_t *, int = 0) const;
                         bool contains(stime_t) const;
+                        static bool startsAfter(stime_t, const Element &);
+                        static bool numberedAfter(uint64_t, const Element &);
                         stime_t  t;
                         stime_t  d;
                         uint64_t r;
                         uint64_t number;
                 };
+
+                /* Sorted by both start time and number, for lookups by
+                 * binary search. Pruned from front on live updates. */
+                std::deque<Element> elements;
         };
     }
 }
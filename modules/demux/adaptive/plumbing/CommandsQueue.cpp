@@ -156,8 +156,27 @@ void EsOutControlResetPCRCommand::Execute( es_out_t * )
  * Commands Default Factory
  */
 
+CommandsFactory::CommandsFactory()
+{
+}
+
+CommandsFactory::~CommandsFactory()
+{
+    std::vector<EsOutSendCommand *>::const_iterator it;
+    for( it = sendpool.begin(); it != sendpool.end(); ++it )
+        delete *it;
+}
+
 EsOutSendCommand * CommandsFactory::createEsOutSendCommand( FakeESOutID *id, block_t *p_block )
 {
+    if( !sendpool.empty() )
+    {
+        EsOutSendCommand *command = sendpool.back();
+        sendpool.pop_back();
+        command->p_fakeid = id;
+        command->p_block = p_block;
+        return command;
+    }
     return new (std::nothrow) EsOutSendCommand( id, p_block );
 }
 
@@ -186,11 +205,29 @@ EsOutControlResetPCRCommand * CommandsFactory::creatEsOutControlResetPCRCommand(
     return new (std::nothrow) EsOutControlResetPCRCommand();
 }
 
+void CommandsFactory::releaseCommand( AbstractCommand *command )
+{
+    if( command->getType() == ES_OUT_PRIVATE_COMMAND_SEND &&
+        sendpool.size() < MAX_POOLED_COMMANDS )
+    {
+        EsOutSendCommand *sendcommand = static_cast<EsOutSendCommand *>(command);
+        if( sendcommand->p_block )
+        {
+            block_Release( sendcommand->p_block );
+            sendcommand->p_block = NULL;
+        }
+        sendpool.push_back( sendcommand );
+    }
+    else delete command;
+}
+
 /*
  * Commands Queue management
  */
-CommandsQueue::CommandsQueue()
+CommandsQueue::CommandsQueue( CommandsFactory *factory_ )
 {
+    factory = factory_;
+    committed = 0;
     bufferinglevel = VLC_TS_INVALID;
     b_drop = false;
 }
@@ -200,27 +237,43 @@ CommandsQueue::~CommandsQueue()
     Abort( false );
 }
 
-static bool compareCommands( AbstractCommand *a, AbstractCommand *b )
-{
-    return (a->getTime() < b->getTime() && a->getTime() != VLC_TS_INVALID);
-}
-
 void CommandsQueue::Schedule( AbstractCommand *command )
 {
     if( b_drop )
     {
-        delete command;
+        factory->releaseCommand( command );
     }
     else if( command->getType() == ES_OUT_SET_GROUP_PCR )
     {
         bufferinglevel = command->getTime();
         Commit();
         commands.push_back( command );
+        committed = commands.size();
     }
     else
     {
-        incoming.push_back( command );
+        Insert( command );
+    }
+}
+
+/* Orders incoming commands by time. Untimed ones (ES creation or
+ * deletion, discontinuities) are never moved across. Blocks mostly
+ * come in order, so this rarely goes further than the last one. */
+void CommandsQueue::Insert( AbstractCommand *command )
+{
+    std::deque<AbstractCommand *>::iterator it = commands.end();
+    const mtime_t time = command->getTime();
+    if( time != VLC_TS_INVALID )
+    {
+        const std::deque<AbstractCommand *>::iterator first = commands.begin() + committed;
+        for( ; it != first; --it )
+        {
+            const mtime_t prevtime = (*(it - 1))->getTime();
+            if( prevtime == VLC_TS_INVALID || prevtime <= time )
+                break;
+        }
     }
+    commands.insert( it, command );
 }
 
 mtime_t CommandsQueue::Process( es_out_t *out, mtime_t barrier )
@@ -228,7 +281,7 @@ mtime_t CommandsQueue::Process( es_out_t *out, mtime_t barrier )
     mtime_t lastdts = barrier;
     bool b_datasent = false;
 
-    while( !commands.empty() && commands.front()->getTime() <= barrier )
+    while( committed && commands.front()->getTime() <= barrier )
     {
         AbstractCommand *command = commands.front();
         /* We need to have PCR set for stream before Deleting ES,
@@ -246,27 +299,27 @@ mtime_t CommandsQueue::Process( es_out_t *out, mtime_t barrier )
         }
 
         commands.pop_front();
+        committed--;
         command->Execute( out );
-        delete command;
+        factory->releaseCommand( command );
     }
     return lastdts;
 }
 
 void CommandsQueue::Commit()
 {
-    /* reorder all blocks by time between 2 PCR and merge with main list */
-    incoming.sort( compareCommands );
-    commands.splice( commands.end(), incoming );
+    /* incoming commands are already ordered, just merge with main list */
+    committed = commands.size();
 }
 
 void CommandsQueue::Abort( bool b_reset )
 {
-    commands.splice( commands.end(), incoming );
     while( !commands.empty() )
     {
-        delete commands.front();
+        factory->releaseCommand( commands.front() );
         commands.pop_front();
     }
+    committed = 0;
 
     if( b_reset )
         bufferinglevel = VLC_TS_INVALID;
@@ -274,7 +327,7 @@ void CommandsQueue::Abort( bool b_reset )
 
 bool CommandsQueue::isEmpty() const
 {
-    return commands.empty() && incoming.empty();
+    return commands.empty();
 }
 
 void CommandsQueue::setDrop( bool b )
@@ -290,12 +343,11 @@ mtime_t CommandsQueue::getBufferingLevel() const
 mtime_t CommandsQueue::getFirstDTS() const
 {
     mtime_t i_dts = VLC_TS_INVALID;
-    std::list<AbstractCommand *>::const_iterator it;
-    for( it = commands.begin(); it != commands.end(); ++it )
+    for( size_t i = 0; i < committed; i++ )
     {
-        if( (*it)->getTime() > VLC_TS_INVALID )
+        if( commands[i]->getTime() > VLC_TS_INVALID )
         {
-            i_dts = (*it)->getTime();
+            i_dts = commands[i]->getTime();
             break;
         }
     }
@@ -28,7 +28,8 @@
 #include <vlc_es.h>
 #include <vlc_atomic.h>
 
-#include <list>
+#include <deque>
+#include <vector>
 
 namespace adaptive
 {
@@ -127,20 +128,28 @@ namespace adaptive
     class CommandsFactory
     {
         public:
-            virtual ~CommandsFactory() {}
+            CommandsFactory();
+            virtual ~CommandsFactory();
             virtual EsOutSendCommand * createEsOutSendCommand( FakeESOutID *, block_t * );
             virtual EsOutDelCommand * createEsOutDelCommand( FakeESOutID * );
             virtual EsOutAddCommand * createEsOutAddCommand( FakeESOutID * );
             virtual EsOutControlPCRCommand * createEsOutControlPCRCommand( int, mtime_t );
             virtual EsOutControlResetPCRCommand * creatEsOutControlResetPCRCommand();
             virtual EsOutDestroyCommand * createEsOutDestroyCommand();
+            virtual void releaseCommand( AbstractCommand * );
+
+            static const size_t MAX_POOLED_COMMANDS = 4096;
+
+        private:
+            /* Send commands are one per block, recycle them */
+            std::vector<EsOutSendCommand *> sendpool;
     };
 
     /* Queuing for doing all the stuff in order */
     class CommandsQueue
     {
         public:
-            CommandsQueue();
+            CommandsQueue( CommandsFactory * );
             ~CommandsQueue();
             void Schedule( AbstractCommand * );
             mtime_t Process( es_out_t *out, mtime_t );
@@ -152,8 +161,12 @@ namespace adaptive
             mtime_t getFirstDTS() const;
 
         private:
-            std::list<AbstractCommand *> incoming;
-            std::list<AbstractCommand *> commands;
+            void Insert( AbstractCommand * );
+            CommandsFactory *factory;
+            /* Committed commands first, then incoming ones, which are
+             * kept ordered by time on insertion */
+            std::deque<AbstractCommand *> commands;
+            size_t committed;
             mtime_t bufferinglevel;
             bool b_drop;
     };
@@ -26,6 +26,7 @@
 using namespace adaptive;
 
 FakeESOut::FakeESOut( es_out_t *es, CommandsFactory *factory )
+    : commandsqueue( factory )
 {
     real_es_out = es;
     fakeesout = new es_out_t;
@@ -49,11 +50,11 @@ es_out_t * FakeESOut::getEsOut()
 
 FakeESOut::~FakeESOut()
 {
-    delete commandsFactory;
-
     recycleAll();
     gc();
 
+    delete commandsFactory;
+
     delete fakeesout;
 }
 
@@ -26,6 +26,7 @@
 
 #include "CommandsQueue.hpp"
 #include <vlc_atomic.h>
+#include <list>
 
 namespace adaptive
 {
@@ -0,0 +1,154 @@
+/*
+ * commandsqueue.cpp: es_out commands queue throughput benchmark
+ *****************************************************************************
+ * Copyright (C) 2016 VideoLAN and VLC authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Feeds small blocks through the fake es_out, as a TS demuxer would do,
+ * and measures Schedule/Commit/Process throughput.
+ *
+ * Usage: adaptive_commandsqueue [blocks] [even number of blocks per PCR]
+ *
+ * Blocks are sent with a B-frames like reordering of their DTS, which the
+ * queue must have undone when they reach the real es_out. */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_es_out.h>
+#include <vlc_block.h>
+
+#include "../plumbing/FakeESOut.hpp"
+#include "../plumbing/CommandsQueue.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+
+using namespace adaptive;
+
+struct es_out_sys_t
+{
+    unsigned blocks;
+    mtime_t lastdts;
+    bool b_disorder;
+};
+
+static es_out_id_t *EsOutAdd(es_out_t *, const es_format_t *)
+{
+    static char dummy;
+    return reinterpret_cast<es_out_id_t *>(&dummy);
+}
+
+static int EsOutSend(es_out_t *out, es_out_id_t *, block_t *p_block)
+{
+    es_out_sys_t *p_sys = out->p_sys;
+    if(p_block->i_dts < p_sys->lastdts)
+        p_sys->b_disorder = true;
+    p_sys->lastdts = p_block->i_dts;
+    p_sys->blocks++;
+    block_Release(p_block);
+    return VLC_SUCCESS;
+}
+
+static void EsOutDel(es_out_t *, es_out_id_t *)
+{
+}
+
+static int EsOutControl(es_out_t *, int, va_list)
+{
+    return VLC_EGENERIC;
+}
+
+static void EsOutDestroy(es_out_t *)
+{
+}
+
+int main(int argc, char *argv[])
+{
+    const unsigned i_blocks = argc > 1 ? strtoul(argv[1], NULL, 10) : 200000;
+    const unsigned i_group = argc > 2 ? strtoul(argv[2], NULL, 10) : 50;
+    if(i_blocks == 0 || i_group < 2 || i_group % 2)
+    {
+        fprintf(stderr, "usage: %s [blocks] [even number of blocks per PCR]\n", argv[0]);
+        return 1;
+    }
+
+    es_out_sys_t sys = { 0, VLC_TS_INVALID, false };
+    es_out_t realout;
+    realout.pf_add = EsOutAdd;
+    realout.pf_send = EsOutSend;
+    realout.pf_del = EsOutDel;
+    realout.pf_control = EsOutControl;
+    realout.pf_destroy = EsOutDestroy;
+    realout.p_sys = &sys;
+
+    FakeESOut *fakeesout = new FakeESOut(&realout, new CommandsFactory());
+    es_out_t *out = fakeesout->getEsOut();
+
+    es_format_t fmt;
+    es_format_Init(&fmt, VIDEO_ES, VLC_CODEC_H264);
+    es_out_id_t *id = es_out_Add(out, &fmt);
+    es_format_Clean(&fmt);
+    if(!id)
+    {
+        delete fakeesout;
+        return 1;
+    }
+
+    const mtime_t frameduration = CLOCK_FREQ / 1000;
+    unsigned i_sent = 0;
+    mtime_t start = mdate();
+    for(unsigned i=0; i<i_blocks; i++)
+    {
+        block_t *p_block = block_Alloc(188);
+        if(!p_block)
+            break;
+        /* swap every other pair: I P B P B ... */
+        unsigned order = (i % 2) ? i - 1 : i + 1;
+        p_block->i_dts = p_block->i_pts = VLC_TS_0 + order * frameduration;
+        es_out_Send(out, id, p_block);
+
+        if((i + 1) % i_group == 0)
+        {
+            mtime_t pcr = VLC_TS_0 + (i + 1) * frameduration;
+            es_out_Control(out, ES_OUT_SET_GROUP_PCR, 0, pcr);
+            /* keep a few groups buffered, as the demuxer does */
+            fakeesout->commandsqueue.Process(&realout, pcr - 4 * i_group * frameduration);
+        }
+        i_sent++;
+    }
+    fakeesout->commandsqueue.Commit();
+    fakeesout->commandsqueue.Process(&realout, INT64_MAX);
+    mtime_t elapsed = mdate() - start;
+
+    printf("%u blocks, %u per PCR: %.2f ms, %.0f commands/s\n",
+           sys.blocks, i_group, (double) elapsed / 1000,
+           elapsed > 0 ? (double) sys.blocks * CLOCK_FREQ / elapsed : 0.0);
+
+    es_out_Del(out, id);
+    fakeesout->commandsqueue.Process(&realout, INT64_MAX);
+    delete fakeesout;
+
+    if(sys.blocks != i_sent || sys.b_disorder)
+    {
+        fprintf(stderr, "blocks lost or not in DTS order\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,330 @@
+/*
+ * mpdbench.cpp: MPD parsing time and memory benchmark
+ *****************************************************************************
+ * Copyright (C) 2016 VideoLAN and VLC authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Compares the DOM and the streaming MPD parsers.
+ *
+ * Usage: adaptive_mpdbench [-n iterations] <mpd> [<mpd> ...]
+ *
+ * Each file is parsed in a separate process per parser, so that the
+ * reported peak resident size only accounts for that parser.
+ * Without arguments, checks both parsers build the same playlist from a
+ * generated MPD, and that timeline lookups are consistent. */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "../../../../lib/libvlc_internal.h"
+#include <vlc_stream.h>
+
+#include "../playlist/AbstractPlaylist.hpp"
+#include "../playlist/BasePeriod.h"
+#include "../playlist/BaseAdaptationSet.h"
+#include "../playlist/BaseRepresentation.h"
+#include "../xml/DOMParser.h"
+#include "../../dash/mpd/IsoffMainParser.h"
+#include "../../dash/mpd/MPD.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace adaptive;
+using namespace adaptive::playlist;
+
+static AbstractPlaylist *Parse(vlc_object_t *obj, uint8_t *p_data, size_t i_data,
+                               bool b_streaming)
+{
+    stream_t *s = stream_MemoryNew(obj, p_data, i_data, true);
+    if(!s)
+        return NULL;
+
+    const std::string url("http://localhost/");
+    AbstractPlaylist *playlist = NULL;
+    if(b_streaming)
+    {
+        dash::mpd::IsoffMainParser mpdparser(obj, s, url);
+        playlist = mpdparser.parse();
+    }
+    else
+    {
+        xml::DOMParser xmlParser(s);
+        if(xmlParser.parse(true))
+        {
+            dash::mpd::IsoffMainParser mpdparser(xmlParser.getRootNode(), obj, s, url);
+            playlist = mpdparser.parse();
+        }
+    }
+
+    stream_Delete(s);
+    return playlist;
+}
+
+/* Summary of the parsed hierarchy, used to compare parsers output */
+static std::string Describe(AbstractPlaylist *playlist)
+{
+    std::stringstream ss;
+    std::vector<BasePeriod *> periods = playlist->getPeriods();
+    for(size_t i=0; i<periods.size(); i++)
+    {
+        ss << "P" << periods[i]->getID().str() << "\n";
+        const std::vector<BaseAdaptationSet *> &sets = periods[i]->getAdaptationSets();
+        for(size_t j=0; j<sets.size(); j++)
+        {
+            ss << " A" << sets[j]->getID().str() << "\n";
+            const std::vector<BaseRepresentation *> &reps = sets[j]->getRepresentations();
+            for(size_t k=0; k<reps.size(); k++)
+            {
+                BaseRepresentation *rep = reps[k];
+                ss << "  R" << rep->getID().str() << " " << rep->getBandwidth();
+                uint64_t number = 0;
+                /* templates without timeline never end */
+                while(number < 1000000 &&
+                      rep->getSegment(SegmentInformation::INFOTYPE_MEDIA, number))
+                    number++;
+                ss << " " << number;
+                if(number)
+                    ss << " " << rep->getPlaybackTimeBySegmentNumber(number - 1);
+                ss << "\n";
+            }
+        }
+    }
+    return ss.str();
+}
+
+static void Bench(vlc_object_t *obj, const char *psz_name,
+                  uint8_t *p_data, size_t i_data, bool b_streaming, int i_iterations)
+{
+    fflush(stdout);
+    pid_t pid = fork();
+    if(pid == -1)
+    {
+        perror("fork");
+        return;
+    }
+    if(pid)
+    {
+        int status;
+        while(waitpid(pid, &status, 0) == -1);
+        return;
+    }
+
+    struct rusage before, after;
+    getrusage(RUSAGE_SELF, &before);
+
+    mtime_t start = mdate();
+    bool b_success = true;
+    for(int i=0; i<i_iterations && b_success; i++)
+    {
+        AbstractPlaylist *playlist = Parse(obj, p_data, i_data, b_streaming);
+        b_success = !!playlist;
+        delete playlist;
+    }
+    mtime_t elapsed = mdate() - start;
+
+    getrusage(RUSAGE_SELF, &after);
+
+    if(b_success)
+        printf("%-40s %-9s %10.2f ms %10ld KiB\n", psz_name,
+               b_streaming ? "streaming" : "dom",
+               (double) elapsed / i_iterations / 1000,
+               after.ru_maxrss - before.ru_maxrss);
+    else
+        printf("%-40s %-9s failed\n", psz_name, b_streaming ? "streaming" : "dom");
+    fflush(stdout);
+    _exit(0);
+}
+
+static uint8_t *ReadFile(const char *psz_path, size_t *pi_data)
+{
+    FILE *fp = fopen(psz_path, "rb");
+    if(!fp)
+        return NULL;
+
+    uint8_t *p_data = NULL;
+    size_t i_data = 0;
+    for(;;)
+    {
+        uint8_t *p_realloc = (uint8_t *) realloc(p_data, i_data + 65536);
+        if(!p_realloc)
+        {
+            free(p_data);
+            p_data = NULL;
+            break;
+        }
+        p_data = p_realloc;
+        size_t i_read = fread(&p_data[i_data], 1, 65536, fp);
+        i_data += i_read;
+        if(i_read < 65536)
+            break;
+    }
+    fclose(fp);
+    *pi_data = i_data;
+    return p_data;
+}
+
+static std::string GenerateMPD(unsigned i_timeline, unsigned i_list)
+{
+    std::stringstream ss;
+    ss << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+          "<MPD xmlns=\"urn:mpeg:dash:schema:mpd:2011\" type=\"static\""
+          " mediaPresentationDuration=\"PT10H\" minBufferTime=\"PT2S\""
+          " profiles=\"urn:mpeg:dash:profile:isoff-live:2011\">\n"
+          " <ProgramInformation><Title>bench</Title></ProgramInformation>\n"
+          " <BaseURL>http://example.com/</BaseURL>\n"
+          " <Period id=\"p0\" start=\"PT0S\">\n"
+          "  <AdaptationSet mimeType=\"video/mp4\" segmentAlignment=\"true\">\n"
+          "   <SegmentTemplate timescale=\"1000\" media=\"v$RepresentationID$_$Number$.m4s\""
+          " initialization=\"v$RepresentationID$.mp4\" startNumber=\"1\">\n"
+          "    <SegmentTimeline>\n";
+    for(unsigned i=0; i<i_timeline; i++)
+    {
+        ss << "     <S ";
+        if(i == 0)
+            ss << "t=\"0\" ";
+        ss << "d=\"" << (2000 + (i % 3) * 10) << "\"";
+        if(i % 5 == 0)
+            ss << " r=\"2\"";
+        ss << "/>\n";
+    }
+    ss << "    </SegmentTimeline>\n"
+          "   </SegmentTemplate>\n";
+    for(unsigned i=0; i<4; i++)
+        ss << "   <Representation id=\"" << i << "\" bandwidth=\"" << (i + 1) * 500000
+           << "\" width=\"1280\" height=\"720\" codecs=\"avc1.4d401f\"/>\n";
+    ss << "  </AdaptationSet>\n"
+          "  <AdaptationSet mimeType=\"audio/mp4\" lang=\"en\">\n"
+          "   <Role schemeIdUri=\"urn:mpeg:dash:role:2011\" value=\"main\"/>\n"
+          "   <Representation id=\"a\" bandwidth=\"128000\" codecs=\"mp4a.40.2\">\n"
+          "    <BaseURL>audio/</BaseURL>\n"
+          "    <SegmentList timescale=\"1000\" duration=\"2000\">\n"
+          "     <Initialization sourceURL=\"init.mp4\"/>\n";
+    for(unsigned i=0; i<i_list; i++)
+        ss << "     <SegmentURL media=\"a" << i << ".m4s\"/>\n";
+    ss << "    </SegmentList>\n"
+          "   </Representation>\n"
+          "  </AdaptationSet>\n"
+          " </Period>\n"
+          "</MPD>\n";
+    return ss.str();
+}
+
+static int SelfTest(vlc_object_t *obj)
+{
+    std::string mpd = GenerateMPD(20000, 5000);
+    uint8_t *p_data = (uint8_t *) mpd.c_str();
+
+    AbstractPlaylist *dom = Parse(obj, p_data, mpd.size(), false);
+    AbstractPlaylist *streamed = Parse(obj, p_data, mpd.size(), true);
+
+    int i_ret = 0;
+    if(!dom || !streamed)
+    {
+        fprintf(stderr, "parsing failed\n");
+        i_ret = 1;
+    }
+    else if(Describe(dom) != Describe(streamed))
+    {
+        fprintf(stderr, "parsers output mismatch:\n%s\n---\n%s",
+                Describe(dom).c_str(), Describe(streamed).c_str());
+        i_ret = 1;
+    }
+    else
+    {
+        /* timeline lookups must round trip */
+        BaseRepresentation *rep = streamed->getPeriods().front()->
+                                  getAdaptationSets().front()->getRepresentations().front();
+        for(uint64_t number = 0;
+            rep->getSegment(SegmentInformation::INFOTYPE_MEDIA, number); number++)
+        {
+            uint64_t found;
+            mtime_t time = rep->getPlaybackTimeBySegmentNumber(number);
+            if(!rep->getSegmentNumberByTime(time, &found) || found != number ||
+               !rep->getSegmentNumberByTime(time + CLOCK_FREQ, &found) || found != number)
+            {
+                fprintf(stderr, "timeline lookup mismatch at %" PRIu64 "\n", number);
+                i_ret = 1;
+                break;
+            }
+        }
+    }
+
+    delete dom;
+    delete streamed;
+    return i_ret;
+}
+
+int main(int argc, char *argv[])
+{
+    int i_iterations = 1;
+
+    int i = 1;
+    if(i + 1 < argc && !strcmp(argv[i], "-n"))
+    {
+        i_iterations = atoi(argv[i + 1]);
+        i += 2;
+    }
+
+    if(i_iterations < 1 || (argc > 1 && i == argc))
+    {
+        fprintf(stderr, "usage: %s [-n iterations] <mpd> [<mpd> ...]\n", argv[0]);
+        return 1;
+    }
+
+    const char *args[] = { "--ignore-config", "--quiet" };
+    libvlc_int_t *p_libvlc = libvlc_InternalCreate();
+    if(!p_libvlc)
+        return 1;
+    if(libvlc_InternalInit(p_libvlc, ARRAY_SIZE(args), args) != VLC_SUCCESS)
+    {
+        libvlc_InternalDestroy(p_libvlc);
+        return 1;
+    }
+
+    int i_ret = 0;
+    if(argc == 1)
+    {
+        i_ret = SelfTest(VLC_OBJECT(p_libvlc));
+    }
+    else for(; i < argc; i++)
+    {
+        size_t i_data;
+        uint8_t *p_data = ReadFile(argv[i], &i_data);
+        if(!p_data)
+        {
+            fprintf(stderr, "cannot read %s\n", argv[i]);
+            i_ret = 1;
+            continue;
+        }
+        Bench(VLC_OBJECT(p_libvlc), argv[i], p_data, i_data, false, i_iterations);
+        Bench(VLC_OBJECT(p_libvlc), argv[i], p_data, i_data, true, i_iterations);
+        free(p_data);
+    }
+
+    libvlc_InternalCleanup(p_libvlc);
+    libvlc_InternalDestroy(p_libvlc);
+    return i_ret;
+}
@@ -0,0 +1,479 @@
+/*
+ * simulator.cpp: replays bandwidth traces against adaptation logics
+ *****************************************************************************
+ * Copyright (C) 2016 VideoLAN and VLC authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Downloads are simulated from a piecewise constant bandwidth trace, the
+ * player drains the buffer in real time and stalls when it runs dry.
+ * No segment is ever fetched: only the playlist is parsed.
+ *
+ * Usage: adaptive_simulator [-l lowest|best|rate|hybrid] [-d segment secs]
+ *                           [-b max buffer secs] [-t duration secs]
+ *                           <playlist> <trace>
+ *
+ * Trace lines are "<start time secs> <kbps>", '#' starts a comment, and the
+ * trace loops when exhausted. Without arguments, runs built-in checks. */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "../../../../lib/libvlc_internal.h"
+#include <vlc_stream.h>
+
+#include "../playlist/AbstractPlaylist.hpp"
+#include "../playlist/BasePeriod.h"
+#include "../playlist/BaseAdaptationSet.h"
+#include "../playlist/BaseRepresentation.h"
+#include "../logic/AlwaysBestAdaptationLogic.h"
+#include "../logic/AlwaysLowestAdaptationLogic.hpp"
+#include "../logic/RateBasedAdaptationLogic.h"
+#include "../logic/HybridAdaptationLogic.hpp"
+#include "../SegmentTracker.hpp"
+#include "../../dash/mpd/IsoffMainParser.h"
+#include "../../dash/mpd/MPD.h"
+#include "../../hls/playlist/Parser.hpp"
+#include "../../hls/playlist/M3U8.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace adaptive;
+using namespace adaptive::logic;
+using namespace adaptive::playlist;
+
+struct TracePoint
+{
+    mtime_t start;
+    uint64_t bps;
+};
+
+class Trace
+{
+    public:
+        Trace() : length(0) {}
+
+        bool load(const char *psz_path)
+        {
+            FILE *fp = fopen(psz_path, "r");
+            if(!fp)
+                return false;
+            char line[256];
+            while(fgets(line, sizeof(line), fp))
+            {
+                double start, kbps;
+                char *comment = strchr(line, '#');
+                if(comment)
+                    *comment = '\0';
+                if(sscanf(line, "%lf %lf", &start, &kbps) == 2 && kbps > 0)
+                    add(start * CLOCK_FREQ, kbps * 1000);
+            }
+            fclose(fp);
+            return !points.empty();
+        }
+
+        void add(mtime_t start, uint64_t bps)
+        {
+            TracePoint point = { start, bps };
+            if(!points.empty() && start <= points.back().start)
+                return;
+            points.push_back(point);
+            length = start + CLOCK_FREQ; /* last point lasts one second */
+        }
+
+        /* Time needed to receive size bytes starting at time */
+        mtime_t transfer(mtime_t time, uint64_t size) const
+        {
+            double bits = size * 8.0;
+            mtime_t elapsed = 0;
+            while(bits > 0)
+            {
+                const mtime_t offset = (time + elapsed) % length;
+                size_t i = 0;
+                while(i + 1 < points.size() && points[i + 1].start <= offset)
+                    i++;
+                const mtime_t end = (i + 1 < points.size()) ? points[i + 1].start : length;
+                const double avail = (double)(end - offset) * points[i].bps / CLOCK_FREQ;
+                if(avail >= bits)
+                {
+                    elapsed += bits * CLOCK_FREQ / points[i].bps + 1;
+                    bits = 0;
+                }
+                else
+                {
+                    elapsed += end - offset;
+                    bits -= avail;
+                }
+            }
+            return elapsed;
+        }
+
+    private:
+        std::vector<TracePoint> points;
+        mtime_t length;
+};
+
+struct Results
+{
+    unsigned segments;
+    unsigned switches;
+    uint64_t bitrate; /* average, bps */
+    mtime_t startup;
+    mtime_t rebuffer;
+    BaseRepresentation *last;
+};
+
+static void Simulate(BaseAdaptationSet *adaptSet, AbstractAdaptationLogic *logic,
+                     const Trace &trace, mtime_t segmentduration,
+                     mtime_t maxbuffer, mtime_t duration, Results *res)
+{
+    memset(res, 0, sizeof(*res));
+
+    BaseRepresentation *rep = NULL;
+    mtime_t time = 0, buffer = 0;
+    uint64_t bitsum = 0;
+    bool b_playing = false;
+
+    for(mtime_t pos = 0; pos < duration; pos += segmentduration)
+    {
+        BaseRepresentation *next = logic->getNextRepresentation(adaptSet, rep);
+        if(next == NULL)
+            break;
+        if(next != rep)
+        {
+            if(rep)
+                res->switches++;
+            logic->trackerEvent(SegmentTrackerEvent(rep, next));
+            rep = next;
+        }
+
+        const uint64_t size = rep->getBandwidth() * segmentduration / CLOCK_FREQ / 8;
+        const mtime_t dltime = trace.transfer(time, size);
+        logic->updateDownloadRate(size, dltime);
+        time += dltime;
+
+        if(b_playing)
+        {
+            buffer -= dltime;
+            if(buffer < 0)
+            {
+                res->rebuffer -= buffer;
+                buffer = 0;
+            }
+        }
+        buffer += segmentduration;
+
+        if(!b_playing)
+        {
+            b_playing = true;
+            res->startup = time;
+        }
+
+        /* Player would not request anything beyond its buffer */
+        if(buffer > maxbuffer)
+        {
+            time += buffer - maxbuffer;
+            buffer = maxbuffer;
+        }
+
+        logic->trackerEvent(SegmentTrackerEvent(adaptSet, buffer, maxbuffer));
+
+        bitsum += rep->getBandwidth();
+        res->segments++;
+    }
+
+    if(res->segments)
+        res->bitrate = bitsum / res->segments;
+    res->last = rep;
+}
+
+static AbstractAdaptationLogic *CreateLogic(vlc_object_t *obj, const char *psz_name)
+{
+    if(!strcmp(psz_name, "lowest"))
+        return new AlwaysLowestAdaptationLogic();
+    else if(!strcmp(psz_name, "best"))
+        return new AlwaysBestAdaptationLogic();
+    else if(!strcmp(psz_name, "rate"))
+        return new RateBasedAdaptationLogic(obj, 0, 0);
+    else if(!strcmp(psz_name, "hybrid"))
+        return new HybridAdaptationLogic(obj, 0, 0);
+    return NULL;
+}
+
+static AbstractPlaylist *ParsePlaylist(vlc_object_t *obj, uint8_t *p_data, size_t i_data,
+                                       const std::string &url)
+{
+    stream_t *s = stream_MemoryNew(obj, p_data, i_data, true);
+    if(!s)
+        return NULL;
+
+    AbstractPlaylist *playlist = NULL;
+    if(i_data >= 7 && !memcmp(p_data, "#EXTM3U", 7))
+    {
+        hls::playlist::M3U8Parser parser;
+        playlist = parser.parse(obj, s, url);
+    }
+    else
+    {
+        dash::mpd::IsoffMainParser mpdparser(obj, s, url);
+        playlist = mpdparser.parse();
+    }
+
+    stream_Delete(s);
+    return playlist;
+}
+
+static BaseAdaptationSet *GetAdaptationSet(AbstractPlaylist *playlist)
+{
+    BasePeriod *period = playlist->getFirstPeriod();
+    if(!period || period->getAdaptationSets().empty())
+        return NULL;
+    /* Most representations is the one worth adapting */
+    BaseAdaptationSet *adaptSet = NULL;
+    std::vector<BaseAdaptationSet *>::const_iterator it;
+    for(it = period->getAdaptationSets().begin(); it != period->getAdaptationSets().end(); ++it)
+        if(!adaptSet || (*it)->getRepresentations().size() > adaptSet->getRepresentations().size())
+            adaptSet = *it;
+    return adaptSet;
+}
+
+static mtime_t GetSegmentDuration(BaseAdaptationSet *adaptSet)
+{
+    std::vector<BaseRepresentation *>::const_iterator it;
+    for(it = adaptSet->getRepresentations().begin(); it != adaptSet->getRepresentations().end(); ++it)
+    {
+        uint64_t number;
+        bool b_gap;
+        if(!(*it)->getNextSegment(SegmentInformation::INFOTYPE_MEDIA, 0, &number, &b_gap))
+            continue;
+        const mtime_t start = (*it)->getPlaybackTimeBySegmentNumber(number);
+        const mtime_t end = (*it)->getPlaybackTimeBySegmentNumber(number + 1);
+        if(end > start)
+            return end - start;
+    }
+    return 0;
+}
+
+static void Print(const char *psz_logic, const Results *res)
+{
+    printf("%-8s segments %u, average %" PRIu64 " kbps, switches %u, "
+           "startup %.2fs, rebuffering %.2fs\n", psz_logic,
+           res->segments, res->bitrate / 1000, res->switches,
+           (double) res->startup / CLOCK_FREQ, (double) res->rebuffer / CLOCK_FREQ);
+}
+
+static const char *ppsz_logics[] = { "lowest", "best", "rate", "hybrid" };
+
+#define CHECK(logic, cond) do { \
+    if(!(cond)) \
+    { \
+        fprintf(stderr, "%s: check failed at line %d: %s\n", \
+                logic, __LINE__, #cond); \
+        failures++; \
+    } \
+} while(0)
+
+static int SelfTest(vlc_object_t *obj)
+{
+    static const char psz_master[] =
+        "#EXTM3U\n"
+        "#EXT-X-STREAM-INF:PROGRAM-ID=1,BANDWIDTH=300000\n"
+        "low.m3u8\n"
+        "#EXT-X-STREAM-INF:PROGRAM-ID=1,BANDWIDTH=800000\n"
+        "mid.m3u8\n"
+        "#EXT-X-STREAM-INF:PROGRAM-ID=1,BANDWIDTH=1500000\n"
+        "high.m3u8\n"
+        "#EXT-X-STREAM-INF:PROGRAM-ID=1,BANDWIDTH=3000000\n"
+        "best.m3u8\n";
+
+    AbstractPlaylist *playlist = ParsePlaylist(obj, (uint8_t *) psz_master,
+                                               sizeof(psz_master) - 1,
+                                               "http://localhost/master.m3u8");
+    if(!playlist)
+    {
+        fprintf(stderr, "cannot parse the master playlist\n");
+        return 1;
+    }
+    BaseAdaptationSet *adaptSet = GetAdaptationSet(playlist);
+    if(!adaptSet || adaptSet->getRepresentations().size() != 4)
+    {
+        fprintf(stderr, "expected 4 representations in the master playlist\n");
+        delete playlist;
+        return 1;
+    }
+    unsigned failures = 0;
+    unsigned rate_switches = 0, hybrid_switches = 0;
+
+    Trace ample, unstable;
+    ample.add(0, 8000000);
+    for(unsigned i=0; i<16; i++)
+        unstable.add(CLOCK_FREQ * 5 * i, (i % 2) ? 2500000 : 700000);
+
+    for(size_t i=0; i<ARRAY_SIZE(ppsz_logics); i++)
+    {
+        Results res;
+        AbstractAdaptationLogic *logic = CreateLogic(obj, ppsz_logics[i]);
+        Simulate(adaptSet, logic, ample, CLOCK_FREQ * 4, CLOCK_FREQ * 30,
+                 CLOCK_FREQ * 300, &res);
+        delete logic;
+        Print(ppsz_logics[i], &res);
+
+        CHECK(ppsz_logics[i], res.segments == 75);
+        CHECK(ppsz_logics[i], res.bitrate >= 300000 && res.bitrate <= 3000000);
+        /* 8 Mbps sustains any representation */
+        CHECK(ppsz_logics[i], res.rebuffer == 0);
+        if(i == 0)
+            CHECK(ppsz_logics[i], res.bitrate == 300000 && res.switches == 0);
+        else
+            CHECK(ppsz_logics[i], res.last && res.last->getBandwidth() == 3000000);
+
+        logic = CreateLogic(obj, ppsz_logics[i]);
+        Simulate(adaptSet, logic, unstable, CLOCK_FREQ * 4, CLOCK_FREQ * 30,
+                 CLOCK_FREQ * 300, &res);
+        delete logic;
+        Print(ppsz_logics[i], &res);
+
+        CHECK(ppsz_logics[i], res.segments == 75);
+        CHECK(ppsz_logics[i], res.bitrate >= 300000 && res.bitrate <= 3000000);
+        if(i == 0)
+            CHECK(ppsz_logics[i], res.rebuffer == 0);
+        if(!strcmp(ppsz_logics[i], "rate"))
+            rate_switches = res.switches;
+        else if(!strcmp(ppsz_logics[i], "hybrid"))
+            hybrid_switches = res.switches;
+    }
+
+    /* The buffer absorbs the bandwidth swings the rate logic follows */
+    CHECK("hybrid", hybrid_switches < rate_switches);
+
+    delete playlist;
+    return failures ? 1 : 0;
+}
+
+static int Run(vlc_object_t *obj, const char *psz_logic,
+               const char *psz_playlist, const char *psz_trace,
+               mtime_t segmentduration, mtime_t maxbuffer, mtime_t duration)
+{
+    Trace trace;
+    if(!trace.load(psz_trace))
+    {
+        fprintf(stderr, "cannot load trace %s\n", psz_trace);
+        return 1;
+    }
+
+    FILE *fp = fopen(psz_playlist, "rb");
+    if(!fp)
+    {
+        fprintf(stderr, "cannot open playlist %s\n", psz_playlist);
+        return 1;
+    }
+    std::vector<uint8_t> data;
+    uint8_t buf[4096];
+    size_t i_read;
+    while((i_read = fread(buf, 1, sizeof(buf), fp)) > 0)
+        data.insert(data.end(), buf, buf + i_read);
+    fclose(fp);
+
+    AbstractPlaylist *playlist = data.empty() ? NULL :
+        ParsePlaylist(obj, &data[0], data.size(), std::string("file://") + psz_playlist);
+    BaseAdaptationSet *adaptSet = playlist ? GetAdaptationSet(playlist) : NULL;
+    if(!adaptSet)
+    {
+        fprintf(stderr, "cannot parse playlist %s\n", psz_playlist);
+        delete playlist;
+        return 1;
+    }
+
+    if(segmentduration == 0)
+        segmentduration = GetSegmentDuration(adaptSet);
+    if(segmentduration == 0)
+        segmentduration = CLOCK_FREQ * 4;
+    if(duration == 0)
+        duration = playlist->duration.Get();
+    if(duration == 0)
+        duration = CLOCK_FREQ * 600;
+
+    for(size_t i=0; i<ARRAY_SIZE(ppsz_logics); i++)
+    {
+        if(psz_logic && strcmp(psz_logic, ppsz_logics[i]))
+            continue;
+        Results res;
+        AbstractAdaptationLogic *logic = CreateLogic(obj, ppsz_logics[i]);
+        Simulate(adaptSet, logic, trace, segmentduration, maxbuffer, duration, &res);
+        delete logic;
+        Print(ppsz_logics[i], &res);
+    }
+
+    delete playlist;
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *psz_logic = NULL;
+    mtime_t segmentduration = 0, maxbuffer = CLOCK_FREQ * 30, duration = 0;
+
+    int i = 1;
+    for(; i + 1 < argc && argv[i][0] == '-'; i += 2)
+    {
+        if(!strcmp(argv[i], "-l"))
+            psz_logic = argv[i + 1];
+        else if(!strcmp(argv[i], "-d"))
+            segmentduration = atof(argv[i + 1]) * CLOCK_FREQ;
+        else if(!strcmp(argv[i], "-b"))
+            maxbuffer = atof(argv[i + 1]) * CLOCK_FREQ;
+        else if(!strcmp(argv[i], "-t"))
+            duration = atof(argv[i + 1]) * CLOCK_FREQ;
+        else
+            break;
+    }
+
+    if(i != argc && i + 2 != argc)
+    {
+        fprintf(stderr, "usage: %s [-l lowest|best|rate|hybrid] [-d segment secs] "
+                        "[-b max buffer secs] [-t duration secs] <playlist> <trace>\n",
+                argv[0]);
+        return 1;
+    }
+
+    if(maxbuffer <= 0)
+        maxbuffer = CLOCK_FREQ * 30;
+
+    const char *args[] = { "--ignore-config", "--quiet" };
+    libvlc_int_t *p_libvlc = libvlc_InternalCreate();
+    if(!p_libvlc)
+        return 1;
+    if(libvlc_InternalInit(p_libvlc, ARRAY_SIZE(args), args) != VLC_SUCCESS)
+    {
+        libvlc_InternalDestroy(p_libvlc);
+        return 1;
+    }
+
+    int i_ret;
+    if(i == argc)
+        i_ret = SelfTest(VLC_OBJECT(p_libvlc));
+    else
+        i_ret = Run(VLC_OBJECT(p_libvlc), psz_logic, argv[i], argv[i + 1],
+                    segmentduration, maxbuffer, duration);
+
+    libvlc_InternalCleanup(p_libvlc);
+    libvlc_InternalDestroy(p_libvlc);
+    return i_ret;
+}
@@ -53,10 +53,13 @@ DASHManager::DASHManager(demux_t *demux_, MPD *mpd,
                          AbstractAdaptationLogic::LogicType type) :
              PlaylistManager(demux_, mpd, factory, type)
 {
+    p_lastmpd = NULL;
 }
 
 DASHManager::~DASHManager   ()
 {
+    if(p_lastmpd)
+        block_Release(p_lastmpd);
 }
 
 void DASHManager::scheduleNextUpdate()
@@ -106,17 +109,20 @@ bool DASHManager::updatePlaylist()
         if(!p_block)
             return false;
 
-        stream_t *mpdstream = stream_MemoryNew(p_demux, p_block->p_buffer, p_block->i_buffer, true);
-        if(!mpdstream)
+        /* Most refreshes return the same MPD, nothing to parse nor merge */
+        if(p_lastmpd && p_lastmpd->i_buffer == p_block->i_buffer &&
+           !memcmp(p_lastmpd->p_buffer, p_block->p_buffer, p_block->i_buffer))
         {
             block_Release(p_block);
-            return false;
+            return true;
         }
+        if(p_lastmpd)
+            block_Release(p_lastmpd);
+        p_lastmpd = block_Duplicate(p_block);
 
-        xml::DOMParser parser(mpdstream);
-        if(!parser.parse(true))
+        stream_t *mpdstream = stream_MemoryNew(p_demux, p_block->p_buffer, p_block->i_buffer, true);
+        if(!mpdstream)
         {
-            stream_Delete(mpdstream);
             block_Release(p_block);
             return false;
         }
@@ -130,8 +136,8 @@ bool DASHManager::updatePlaylist()
                 minsegmentTime = segmentTime;
         }
 
-        IsoffMainParser mpdparser(parser.getRootNode(), VLC_OBJECT(p_demux),
-                                  mpdstream, Helper::getDirectoryPath(url).append("/"));
+        IsoffMainParser mpdparser(VLC_OBJECT(p_demux), mpdstream,
+                                  Helper::getDirectoryPath(url).append("/"));
         MPD *newmpd = mpdparser.parse();
         if(newmpd)
         {
@@ -40,16 +40,87 @@
 #include "ProgramInformation.h"
 #include "DASHSegment.h"
 #include "../adaptive/xml/DOMHelper.h"
+#include "../adaptive/xml/DOMParser.h"
 #include "../adaptive/tools/Helper.h"
 #include "../adaptive/tools/Debug.hpp"
 #include "../adaptive/tools/Conversions.hpp"
 #include <vlc_stream.h>
+#include <vlc_xml.h>
 #include <cstdio>
+#include <set>
+#include <stack>
 
 using namespace dash::mpd;
 using namespace adaptive::xml;
 using namespace adaptive::playlist;
 
+/* Element being built in streaming mode. Only currently open elements
+ * exist, the document tree is never built. */
+struct IsoffMainParser::StreamElement
+{
+    enum Type
+    {
+        IGNORED,
+        TEXT,
+        PLAYLIST,
+        PROGRAMINFO,
+        PERIOD,
+        ADAPTATIONSET,
+        REPRESENTATION,
+        SEGMENTBASE,
+        SEGMENTLIST,
+        SEGMENTTEMPLATE,
+        SEGMENTTIMELINE,
+    };
+
+    StreamElement(StreamElement *parent_)
+    {
+        parent = parent_;
+        type = IGNORED;
+        mpd = parent ? parent->mpd : NULL;
+        programInfo = NULL;
+        info = NULL;
+        adaptationSet = NULL;
+        segmentBase = NULL;
+        segmentList = NULL;
+        segmentTemplate = NULL;
+        timeline = NULL;
+        nextid = 0;
+        number = 0;
+        total = 0;
+    }
+
+    ~StreamElement()
+    {
+        /* only set while not yet attached */
+        delete segmentBase;
+        delete segmentList;
+        delete segmentTemplate;
+    }
+
+    /* Only first occurrence of most children is used */
+    bool firstChild(const std::string &name)
+    {
+        return seen.insert(name).second;
+    }
+
+    StreamElement          *parent;
+    Node                    node; /* name, attributes and text only */
+    Type                    type;
+    MPD                    *mpd;
+    ProgramInformation     *programInfo;
+    SegmentInformation     *info;
+    AdaptationSet          *adaptationSet;
+    SegmentBase            *segmentBase;
+    SegmentList            *segmentList;
+    MediaSegmentTemplate   *segmentTemplate;
+    SegmentTimeline        *timeline;
+    std::set<std::string>   seen;
+    uint64_t                nextid;
+    uint64_t                number;
+    size_t                  total;
+};
+
 IsoffMainParser::IsoffMainParser    (Node *root_, vlc_object_t *p_object_,
                                      stream_t *stream, const std::string & streambaseurl_)
 {
@@ -59,6 +130,15 @@ IsoffMainParser::IsoffMainParser    (Node *root_, vlc_object_t *p_object_,
     playlisturl = streambaseurl_;
 }
 
+IsoffMainParser::IsoffMainParser    (vlc_object_t *p_object_, stream_t *stream,
+                                     const std::string & streambaseurl_)
+{
+    root = NULL;
+    p_stream = stream;
+    p_object = p_object_;
+    playlisturl = streambaseurl_;
+}
+
 IsoffMainParser::~IsoffMainParser   ()
 {
 }
@@ -75,7 +155,10 @@ void IsoffMainParser::parseMPDBaseUrl(MPD *mpd, Node *root)
 
 MPD * IsoffMainParser::parse()
 {
-    MPD *mpd = new (std::nothrow) MPD(p_object, getProfile());
+    if(root == NULL)
+        return parseStream();
+
+    MPD *mpd = new (std::nothrow) MPD(p_object, getProfile(root));
     if(mpd)
     {
         parseMPDAttributes(mpd, root);
@@ -87,6 +170,327 @@ MPD * IsoffMainParser::parse()
     return mpd;
 }
 
+MPD * IsoffMainParser::parseStream()
+{
+    MPD *mpd = NULL;
+
+    xml_reader_t *reader = xml_ReaderCreate(p_object, p_stream);
+    if(reader)
+    {
+        mpd = processStream(reader);
+        xml_ReaderDelete(reader);
+    }
+
+    if(mpd)
+    {
+        mpd->debug();
+        return mpd;
+    }
+
+    /* Retry with the document parser */
+    msg_Dbg(p_object, "streaming MPD parsing failed, falling back to DOM");
+    if(stream_Seek(p_stream, 0) != VLC_SUCCESS)
+        return NULL;
+
+    DOMParser parser(p_stream);
+    if(!parser.parse(true))
+        return NULL;
+
+    root = parser.getRootNode();
+    mpd = parse();
+    root = NULL;
+    return mpd;
+}
+
+MPD * IsoffMainParser::processStream(xml_reader_t *reader)
+{
+    const char *data;
+    int type;
+    std::stack<StreamElement *> lifo;
+    MPD *mpd = NULL;
+    bool b_done = false;
+    bool b_error = false;
+
+    while( !b_done && !b_error && (type = xml_ReaderNextNode(reader, &data)) > 0 )
+    {
+        switch(type)
+        {
+            case XML_READER_STARTELEM:
+            {
+                bool empty = xml_ReaderIsEmptyElement(reader);
+                StreamElement *elem = new (std::nothrow) StreamElement(lifo.empty() ? NULL : lifo.top());
+                if(!elem)
+                {
+                    b_error = true;
+                    break;
+                }
+                lifo.push(elem);
+
+                elem->node.setName(std::string(data));
+                const char *attrName, *attrValue;
+                while((attrName = xml_ReaderNextAttr(reader, &attrValue)) != NULL)
+                    elem->node.addAttribute(std::string(attrName), std::string(attrValue));
+
+                if(!startElement(elem))
+                {
+                    b_error = true;
+                    break;
+                }
+                if(!elem->parent)
+                    mpd = elem->mpd;
+
+                if(empty)
+                {
+                    endElement(elem);
+                    lifo.pop();
+                    delete elem;
+                    b_done = lifo.empty();
+                }
+                break;
+            }
+
+            case XML_READER_TEXT:
+            {
+                if(!lifo.empty())
+                    lifo.top()->node.setText(std::string(data));
+                break;
+            }
+
+            case XML_READER_ENDELEM:
+            {
+                if(lifo.empty())
+                {
+                    b_error = true;
+                    break;
+                }
+
+                StreamElement *elem = lifo.top();
+                endElement(elem);
+                lifo.pop();
+                delete elem;
+                b_done = lifo.empty();
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+
+    while(!lifo.empty())
+    {
+        delete lifo.top();
+        lifo.pop();
+    }
+
+    if(!b_done)
+    {
+        delete mpd;
+        return NULL;
+    }
+
+    return mpd;
+}
+
+bool IsoffMainParser::startElement(StreamElement *elem)
+{
+    StreamElement *parent = elem->parent;
+    Node *node = &elem->node;
+    const std::string &name = node->getName();
+
+    if(parent == NULL)
+    {
+        if(name != "MPD" || !(elem->mpd = new (std::nothrow) MPD(p_object, getProfile(node))))
+            return false;
+        parseMPDAttributes(elem->mpd, node);
+        elem->mpd->setPlaylistUrl( Helper::getDirectoryPath(playlisturl).append("/") );
+        elem->type = StreamElement::PLAYLIST;
+        return true;
+    }
+
+    elem->info = parent->info;
+
+    switch(parent->type)
+    {
+        case StreamElement::PLAYLIST:
+            if(name == "Period")
+            {
+                Period *period = new (std::nothrow) Period(elem->mpd);
+                if(period)
+                {
+                    parseSegmentInformationAttributes(node, period, &parent->nextid);
+                    parsePeriodAttributes(node, period);
+                    elem->mpd->addPeriod(period);
+                    elem->info = period;
+                    elem->type = StreamElement::PERIOD;
+                }
+            }
+            else if(name == "ProgramInformation" && parent->firstChild(name))
+            {
+                parseProgramInformation(node, elem->mpd);
+                if((elem->programInfo = elem->mpd->programInfo.Get()))
+                    elem->type = StreamElement::PROGRAMINFO;
+            }
+            else if(name == "BaseURL")
+            {
+                elem->type = StreamElement::TEXT;
+            }
+            break;
+
+        case StreamElement::PROGRAMINFO:
+            if((name == "Title" || name == "Source" || name == "Copyright") &&
+               parent->firstChild(name))
+                elem->type = StreamElement::TEXT;
+            break;
+
+        case StreamElement::PERIOD:
+        case StreamElement::ADAPTATIONSET:
+        case StreamElement::REPRESENTATION:
+            if(name == "BaseURL")
+            {
+                if(parent->firstChild(name))
+                    elem->type = StreamElement::TEXT;
+            }
+            else if(name == "SegmentBase")
+            {
+                if(parent->firstChild(name) &&
+                   (elem->segmentBase = createSegmentBase(node, elem->info)))
+                    elem->type = StreamElement::SEGMENTBASE;
+            }
+            else if(name == "SegmentList")
+            {
+                if(parent->firstChild(name) &&
+                   (elem->segmentList = createSegmentList(node, elem->info)))
+                    elem->type = StreamElement::SEGMENTLIST;
+            }
+            else if(name == "SegmentTemplate")
+            {
+                if(parent->firstChild(name) &&
+                   (elem->segmentTemplate = createSegmentTemplate(node, elem->info)))
+                    elem->type = StreamElement::SEGMENTTEMPLATE;
+            }
+            else if(name == "AdaptationSet" && parent->type == StreamElement::PERIOD)
+            {
+                AdaptationSet *adaptationSet = new (std::nothrow) AdaptationSet(static_cast<Period *>(parent->info));
+                if(adaptationSet)
+                {
+                    parseAdaptationSetAttributes(node, adaptationSet);
+                    parseSegmentInformationAttributes(node, adaptationSet, &parent->nextid);
+                    static_cast<Period *>(parent->info)->addAdaptationSet(adaptationSet);
+                    elem->info = elem->adaptationSet = adaptationSet;
+                    elem->type = StreamElement::ADAPTATIONSET;
+                }
+            }
+            else if(name == "Role" && parent->type == StreamElement::ADAPTATIONSET)
+            {
+                if(parent->firstChild(name))
+                    parseRole(node, parent->adaptationSet);
+            }
+            else if(name == "Representation" && parent->type == StreamElement::ADAPTATIONSET)
+            {
+                Representation *rep = new (std::nothrow) Representation(parent->adaptationSet);
+                if(rep)
+                {
+                    parseRepresentationAttributes(node, rep);
+                    parseSegmentInformationAttributes(node, rep, &parent->nextid);
+                    parent->adaptationSet->addRepresentation(rep);
+                    elem->adaptationSet = parent->adaptationSet;
+                    elem->info = rep;
+                    elem->type = StreamElement::REPRESENTATION;
+                }
+            }
+            break;
+
+        case StreamElement::SEGMENTBASE:
+            if(name == "Initialization" && parent->firstChild(name))
+                parseInitSegment(node, parent->segmentBase, elem->info);
+            break;
+
+        case StreamElement::SEGMENTLIST:
+            if(name == "Initialization")
+            {
+                if(parent->firstChild(name))
+                    parseInitSegment(node, parent->segmentList, elem->info);
+            }
+            else if(name == "SegmentURL")
+            {
+                parseSegmentURL(node, parent->segmentList, elem->info,
+                                &parent->number, &parent->total);
+            }
+            break;
+
+        case StreamElement::SEGMENTTEMPLATE:
+            if(name == "SegmentTimeline" && parent->firstChild(name))
+            {
+                elem->timeline = createTimeline(node, parent->segmentTemplate, &elem->number);
+                if(elem->timeline)
+                    elem->type = StreamElement::SEGMENTTIMELINE;
+            }
+            break;
+
+        case StreamElement::SEGMENTTIMELINE:
+            if(name == "S")
+                parseTimelineElement(node, parent->timeline, &parent->number);
+            break;
+
+        default:
+            break;
+    }
+
+    return true;
+}
+
+void IsoffMainParser::endElement(StreamElement *elem)
+{
+    StreamElement *parent = elem->parent;
+    const Node *node = &elem->node;
+
+    switch(elem->type)
+    {
+        case StreamElement::TEXT:
+            if(parent->type == StreamElement::PLAYLIST)
+                elem->mpd->addBaseUrl(node->getText());
+            else if(parent->type == StreamElement::PROGRAMINFO)
+            {
+                if(node->getName() == "Title")
+                    parent->programInfo->setTitle(node->getText());
+                else if(node->getName() == "Source")
+                    parent->programInfo->setSource(node->getText());
+                else
+                    parent->programInfo->setCopyright(node->getText());
+            }
+            else
+                elem->info->baseUrl.Set(new Url(node->getText()));
+            break;
+
+        case StreamElement::REPRESENTATION:
+            parseEmptyRepresentation(static_cast<Representation *>(elem->info),
+                                     elem->adaptationSet, elem->total);
+            break;
+
+        case StreamElement::SEGMENTBASE:
+            setSegmentBase(elem->segmentBase, elem->info);
+            elem->segmentBase = NULL;
+            parent->total++;
+            break;
+
+        case StreamElement::SEGMENTLIST:
+            elem->info->setSegmentList(elem->segmentList);
+            elem->segmentList = NULL;
+            parent->total += elem->total;
+            break;
+
+        case StreamElement::SEGMENTTEMPLATE:
+            elem->info->setSegmentTemplate(elem->segmentTemplate);
+            elem->segmentTemplate = NULL;
+            parent->total++;
+            break;
+
+        default:
+            break;
+    }
+}
+
 void    IsoffMainParser::parseMPDAttributes   (MPD *mpd, xml::Node *node)
 {
     const std::map<std::string, std::string> attr = node->getAttributes();
@@ -126,6 +530,7 @@ void    IsoffMainParser::parseMPDAttributes   (MPD *mpd, xml::Node *node)
             mpd->timeShiftBufferDepth.Set(IsoTime(it->second) * CLOCK_FREQ);
 }
 
+
 void IsoffMainParser::parsePeriods(MPD *mpd, Node *root)
 {
     std::vector<Node *> periods = DOMHelper::getElementByTagName(root, "Period", false);
@@ -138,10 +543,7 @@ void IsoffMainParser::parsePeriods(MPD *mpd, Node *root)
         if (!period)
             continue;
         parseSegmentInformation(*it, period, &nextid);
-        if((*it)->hasAttribute("start"))
-            period->startTime.Set(IsoTime((*it)->getAttributeValue("start")) * CLOCK_FREQ);
-        if((*it)->hasAttribute("duration"))
-            period->duration.Set(IsoTime((*it)->getAttributeValue("duration")) * CLOCK_FREQ);
+        parsePeriodAttributes(*it, period);
         std::vector<Node *> baseUrls = DOMHelper::getChildElementByTagName(*it, "BaseURL");
         if(!baseUrls.empty())
             period->baseUrl.Set( new Url( baseUrls.front()->getText() ) );
@@ -151,16 +553,23 @@ void IsoffMainParser::parsePeriods(MPD *mpd, Node *root)
     }
 }
 
-size_t IsoffMainParser::parseSegmentTemplate(Node *templateNode, SegmentInformation *info)
+void IsoffMainParser::parsePeriodAttributes(Node *node, Period *period)
+{
+    if(node->hasAttribute("start"))
+        period->startTime.Set(IsoTime(node->getAttributeValue("start")) * CLOCK_FREQ);
+    if(node->hasAttribute("duration"))
+        period->duration.Set(IsoTime(node->getAttributeValue("duration")) * CLOCK_FREQ);
+}
+
+MediaSegmentTemplate * IsoffMainParser::createSegmentTemplate(Node *templateNode, SegmentInformation *info)
 {
-    size_t total = 0;
     if (templateNode == NULL || !templateNode->hasAttribute("media"))
-        return total;
+        return NULL;
 
     std::string mediaurl = templateNode->getAttributeValue("media");
     MediaSegmentTemplate *mediaTemplate = NULL;
     if(mediaurl.empty() || !(mediaTemplate = new (std::nothrow) MediaSegmentTemplate(info)) )
-        return total;
+        return NULL;
     mediaTemplate->setSourceUrl(mediaurl);
 
     if(templateNode->hasAttribute("startNumber"))
@@ -182,11 +591,20 @@ size_t IsoffMainParser::parseSegmentTemplate(Node *templateNode, SegmentInformat
     }
     mediaTemplate->initialisationSegment.Set(initTemplate);
 
+    return mediaTemplate;
+}
+
+size_t IsoffMainParser::parseSegmentTemplate(Node *templateNode, SegmentInformation *info)
+{
+    MediaSegmentTemplate *mediaTemplate = createSegmentTemplate(templateNode, info);
+    if(!mediaTemplate)
+        return 0;
+
     parseTimeline(DOMHelper::getFirstChildElementByName(templateNode, "SegmentTimeline"), mediaTemplate);
 
     info->setSegmentTemplate(mediaTemplate);
 
-    return ++total;
+    return 1;
 }
 
 size_t IsoffMainParser::parseSegmentInformation(Node *node, SegmentInformation *info, uint64_t *nextid)
@@ -195,6 +613,12 @@ size_t IsoffMainParser::parseSegmentInformation(Node *node, SegmentInformation *
     total += parseSegmentBase(DOMHelper::getFirstChildElementByName(node, "SegmentBase"), info);
     total += parseSegmentList(DOMHelper::getFirstChildElementByName(node, "SegmentList"), info);
     total += parseSegmentTemplate(DOMHelper::getFirstChildElementByName(node, "SegmentTemplate" ), info);
+    parseSegmentInformationAttributes(node, info, nextid);
+    return total;
+}
+
+void IsoffMainParser::parseSegmentInformationAttributes(Node *node, SegmentInformation *info, uint64_t *nextid)
+{
     if(node->hasAttribute("bitstreamSwitching") && node->getAttributeValue("bitstreamSwitching") == "true")
     {
         info->setSwitchPolicy(SegmentInformation::SWITCH_BITSWITCHEABLE);
@@ -213,8 +637,6 @@ size_t IsoffMainParser::parseSegmentInformation(Node *node, SegmentInformation *
         info->setID(node->getAttributeValue("id"));
     else
         info->setID(ID((*nextid)++));
-
-    return total;
 }
 
 void    IsoffMainParser::parseAdaptationSets  (Node *periodNode, Period *period)
@@ -228,34 +650,15 @@ void    IsoffMainParser::parseAdaptationSets  (Node *periodNode, Period *period)
         AdaptationSet *adaptationSet = new AdaptationSet(period);
         if(!adaptationSet)
             continue;
-        if((*it)->hasAttribute("mimeType"))
-            adaptationSet->setMimeType((*it)->getAttributeValue("mimeType"));
-
-        if((*it)->hasAttribute("lang"))
-        {
-            std::string lang = (*it)->getAttributeValue("lang");
-            std::size_t pos = lang.find_first_of('-');
-            if(pos != std::string::npos && pos > 0)
-                adaptationSet->addLang(lang.substr(0, pos));
-            else if (lang.size() < 4)
-                adaptationSet->addLang(lang);
-        }
+        parseAdaptationSetAttributes(*it, adaptationSet);
 
         Node *baseUrl = DOMHelper::getFirstChildElementByName((*it), "BaseURL");
         if(baseUrl)
             adaptationSet->baseUrl.Set(new Url(baseUrl->getText()));
 
         Node *role = DOMHelper::getFirstChildElementByName((*it), "Role");
-        if(role && role->hasAttribute("schemeIdUri") && role->hasAttribute("value"))
-        {
-            std::string uri = role->getAttributeValue("schemeIdUri");
-            if(uri == "urn:mpeg:dash:role:2011")
-                adaptationSet->description.Set(role->getAttributeValue("value"));
-        }
-#ifdef ADAPTATIVE_ADVANCED_DEBUG
-        if(adaptationSet->description.Get().empty())
-            adaptationSet->description.Set(adaptationSet->getMimeType());
-#endif
+        if(role)
+            parseRole(role, adaptationSet);
 
         parseSegmentInformation(*it, adaptationSet, &nextid);
 
@@ -263,6 +666,36 @@ void    IsoffMainParser::parseAdaptationSets  (Node *periodNode, Period *period)
         period->addAdaptationSet(adaptationSet);
     }
 }
+
+void    IsoffMainParser::parseAdaptationSetAttributes(Node *node, AdaptationSet *adaptationSet)
+{
+    if(node->hasAttribute("mimeType"))
+        adaptationSet->setMimeType(node->getAttributeValue("mimeType"));
+
+    if(node->hasAttribute("lang"))
+    {
+        std::string lang = node->getAttributeValue("lang");
+        std::size_t pos = lang.find_first_of('-');
+        if(pos != std::string::npos && pos > 0)
+            adaptationSet->addLang(lang.substr(0, pos));
+        else if (lang.size() < 4)
+            adaptationSet->addLang(lang);
+    }
+#ifdef ADAPTATIVE_ADVANCED_DEBUG
+    adaptationSet->description.Set(adaptationSet->getMimeType());
+#endif
+}
+
+void    IsoffMainParser::parseRole(Node *role, AdaptationSet *adaptationSet)
+{
+    if(role->hasAttribute("schemeIdUri") && role->hasAttribute("value"))
+    {
+        std::string uri = role->getAttributeValue("schemeIdUri");
+        if(uri == "urn:mpeg:dash:role:2011")
+            adaptationSet->description.Set(role->getAttributeValue("value"));
+    }
+}
+
 void    IsoffMainParser::parseRepresentations (Node *adaptationSetNode, AdaptationSet *adaptationSet)
 {
     std::vector<Node *> representations = DOMHelper::getElementByTagName(adaptationSetNode, "Representation", false);
@@ -277,55 +710,67 @@ void    IsoffMainParser::parseRepresentations (Node *adaptationSetNode, Adaptati
         if(!baseUrls.empty())
             currentRepresentation->baseUrl.Set(new Url(baseUrls.front()->getText()));
 
-        if(repNode->hasAttribute("id"))
-            currentRepresentation->setID(ID(repNode->getAttributeValue("id")));
+        parseRepresentationAttributes(repNode, currentRepresentation);
 
-        if(repNode->hasAttribute("width"))
-            currentRepresentation->setWidth(atoi(repNode->getAttributeValue("width").c_str()));
+        size_t i_total = parseSegmentInformation(repNode, currentRepresentation, &nextid);
+        parseEmptyRepresentation(currentRepresentation, adaptationSet, i_total);
 
-        if(repNode->hasAttribute("height"))
-            currentRepresentation->setHeight(atoi(repNode->getAttributeValue("height").c_str()));
+        adaptationSet->addRepresentation(currentRepresentation);
+    }
+}
 
-        if(repNode->hasAttribute("bandwidth"))
-            currentRepresentation->setBandwidth(atoi(repNode->getAttributeValue("bandwidth").c_str()));
+void    IsoffMainParser::parseRepresentationAttributes(Node *repNode, Representation *currentRepresentation)
+{
+    if(repNode->hasAttribute("id"))
+        currentRepresentation->setID(ID(repNode->getAttributeValue("id")));
 
-        if(repNode->hasAttribute("mimeType"))
-            currentRepresentation->setMimeType(repNode->getAttributeValue("mimeType"));
+    if(repNode->hasAttribute("width"))
+        currentRepresentation->setWidth(atoi(repNode->getAttributeValue("width").c_str()));
 
-        if(repNode->hasAttribute("codecs"))
-        {
-            std::list<std::string> list = Helper::tokenize(repNode->getAttributeValue("codecs"), ',');
-            std::list<std::string>::const_iterator it;
-            for(it=list.begin(); it!=list.end(); ++it)
-            {
-                std::size_t pos = (*it).find_first_of('.', 0);
-                if(pos != std::string::npos)
-                    currentRepresentation->addCodec((*it).substr(0, pos));
-                else
-                    currentRepresentation->addCodec(*it);
-            }
-        }
+    if(repNode->hasAttribute("height"))
+        currentRepresentation->setHeight(atoi(repNode->getAttributeValue("height").c_str()));
 
-        size_t i_total = parseSegmentInformation(repNode, currentRepresentation, &nextid);
-        /* Empty Representation with just baseurl (ex: subtitles) */
-        if(i_total == 0 &&
-           (currentRepresentation->baseUrl.Get() && !currentRepresentation->baseUrl.Get()->empty()) &&
-            adaptationSet->getSegment(SegmentInformation::INFOTYPE_MEDIA, 0) == NULL)
+    if(repNode->hasAttribute("bandwidth"))
+        currentRepresentation->setBandwidth(atoi(repNode->getAttributeValue("bandwidth").c_str()));
+
+    if(repNode->hasAttribute("mimeType"))
+        currentRepresentation->setMimeType(repNode->getAttributeValue("mimeType"));
+
+    if(repNode->hasAttribute("codecs"))
+    {
+        std::list<std::string> list = Helper::tokenize(repNode->getAttributeValue("codecs"), ',');
+        std::list<std::string>::const_iterator it;
+        for(it=list.begin(); it!=list.end(); ++it)
         {
-            SegmentBase *base = new (std::nothrow) SegmentBase(currentRepresentation);
-            if(base)
-                currentRepresentation->setSegmentBase(base);
+            std::size_t pos = (*it).find_first_of('.', 0);
+            if(pos != std::string::npos)
+                currentRepresentation->addCodec((*it).substr(0, pos));
+            else
+                currentRepresentation->addCodec(*it);
         }
+    }
+}
 
-        adaptationSet->addRepresentation(currentRepresentation);
+void    IsoffMainParser::parseEmptyRepresentation(Representation *currentRepresentation,
+                                                  AdaptationSet *adaptationSet, size_t i_total)
+{
+    /* Empty Representation with just baseurl (ex: subtitles) */
+    if(i_total == 0 &&
+       (currentRepresentation->baseUrl.Get() && !currentRepresentation->baseUrl.Get()->empty()) &&
+        adaptationSet->getSegment(SegmentInformation::INFOTYPE_MEDIA, 0) == NULL)
+    {
+        SegmentBase *base = new (std::nothrow) SegmentBase(currentRepresentation);
+        if(base)
+            currentRepresentation->setSegmentBase(base);
     }
 }
-size_t IsoffMainParser::parseSegmentBase(Node * segmentBaseNode, SegmentInformation *info)
+
+SegmentBase * IsoffMainParser::createSegmentBase(Node * segmentBaseNode, SegmentInformation *info)
 {
     SegmentBase *base;
 
     if(!segmentBaseNode || !(base = new (std::nothrow) SegmentBase(info)))
-        return 0;
+        return NULL;
 
     if(segmentBaseNode->hasAttribute("indexRange"))
     {
@@ -343,8 +788,11 @@ size_t IsoffMainParser::parseSegmentBase(Node * segmentBaseNode, SegmentInformat
         }
     }
 
-    parseInitSegment(DOMHelper::getFirstChildElementByName(segmentBaseNode, "Initialization"), base, info);
+    return base;
+}
 
+void IsoffMainParser::setSegmentBase(SegmentBase *base, SegmentInformation *info)
+{
     if(!base->initialisationSegment.Get() && base->indexSegment.Get() && base->indexSegment.Get()->getOffset())
     {
         Segment *initSeg = new InitSegment( info );
@@ -354,63 +802,83 @@ size_t IsoffMainParser::parseSegmentBase(Node * segmentBaseNode, SegmentInformat
     }
 
     info->setSegmentBase(base);
+}
+
+size_t IsoffMainParser::parseSegmentBase(Node * segmentBaseNode, SegmentInformation *info)
+{
+    SegmentBase *base = createSegmentBase(segmentBaseNode, info);
+    if(!base)
+        return 0;
+
+    parseInitSegment(DOMHelper::getFirstChildElementByName(segmentBaseNode, "Initialization"), base, info);
+
+    setSegmentBase(base, info);
 
     return 1;
 }
 
-size_t IsoffMainParser::parseSegmentList(Node * segListNode, SegmentInformation *info)
+SegmentList * IsoffMainParser::createSegmentList(Node * segListNode, SegmentInformation *info)
 {
-    size_t total = 0;
-    if(segListNode)
-    {
-        std::vector<Node *> segments = DOMHelper::getElementByTagName(segListNode, "SegmentURL", false);
-        SegmentList *list;
-        if((list = new (std::nothrow) SegmentList(info)))
-        {
-            parseInitSegment(DOMHelper::getFirstChildElementByName(segListNode, "Initialization"), list, info);
+    SegmentList *list;
+    if(!segListNode || !(list = new (std::nothrow) SegmentList(info)))
+        return NULL;
 
-            if(segListNode->hasAttribute("duration"))
-                list->duration.Set(Integer<stime_t>(segListNode->getAttributeValue("duration")));
+    if(segListNode->hasAttribute("duration"))
+        list->duration.Set(Integer<stime_t>(segListNode->getAttributeValue("duration")));
 
-            if(segListNode->hasAttribute("timescale"))
-                list->timescale.Set(Integer<uint64_t>(segListNode->getAttributeValue("timescale")));
+    if(segListNode->hasAttribute("timescale"))
+        list->timescale.Set(Integer<uint64_t>(segListNode->getAttributeValue("timescale")));
 
-            uint64_t nzStartTime = 0;
-            std::vector<Node *>::const_iterator it;
-            for(it = segments.begin(); it != segments.end(); ++it)
-            {
-                Node *segmentURL = *it;
+    return list;
+}
 
-                Segment *seg = new (std::nothrow) Segment(info);
-                if(!seg)
-                    continue;
+void IsoffMainParser::parseSegmentURL(Node *segmentURL, SegmentList *list, SegmentInformation *info,
+                                      uint64_t *nzStartTime, size_t *total)
+{
+    Segment *seg = new (std::nothrow) Segment(info);
+    if(!seg)
+        return;
 
-                std::string mediaUrl = segmentURL->getAttributeValue("media");
-                if(!mediaUrl.empty())
-                    seg->setSourceUrl(mediaUrl);
+    std::string mediaUrl = segmentURL->getAttributeValue("media");
+    if(!mediaUrl.empty())
+        seg->setSourceUrl(mediaUrl);
 
-                if(segmentURL->hasAttribute("mediaRange"))
-                {
-                    std::string range = segmentURL->getAttributeValue("mediaRange");
-                    size_t pos = range.find("-");
-                    seg->setByteRange(atoi(range.substr(0, pos).c_str()), atoi(range.substr(pos + 1, range.size()).c_str()));
-                }
+    if(segmentURL->hasAttribute("mediaRange"))
+    {
+        std::string range = segmentURL->getAttributeValue("mediaRange");
+        size_t pos = range.find("-");
+        seg->setByteRange(atoi(range.substr(0, pos).c_str()), atoi(range.substr(pos + 1, range.size()).c_str()));
+    }
 
-                if(list->duration.Get())
-                {
-                    seg->startTime.Set(nzStartTime);
-                    seg->duration.Set(list->duration.Get());
-                    nzStartTime += list->duration.Get();
-                }
+    if(list->duration.Get())
+    {
+        seg->startTime.Set(*nzStartTime);
+        seg->duration.Set(list->duration.Get());
+        *nzStartTime += list->duration.Get();
+    }
 
-                seg->setSequenceNumber(total);
+    seg->setSequenceNumber(*total);
 
-                list->addSegment(seg);
-                total++;
-            }
+    list->addSegment(seg);
+    (*total)++;
+}
 
-            info->setSegmentList(list);
-        }
+size_t IsoffMainParser::parseSegmentList(Node * segListNode, SegmentInformation *info)
+{
+    size_t total = 0;
+    SegmentList *list = createSegmentList(segListNode, info);
+    if(list)
+    {
+        std::vector<Node *> segments = DOMHelper::getElementByTagName(segListNode, "SegmentURL", false);
+
+        parseInitSegment(DOMHelper::getFirstChildElementByName(segListNode, "Initialization"), list, info);
+
+        uint64_t nzStartTime = 0;
+        std::vector<Node *>::const_iterator it;
+        for(it = segments.begin(); it != segments.end(); ++it)
+            parseSegmentURL(*it, list, info, &nzStartTime, &total);
+
+        info->setSegmentList(list);
     }
     return total;
 }
@@ -433,40 +901,51 @@ void IsoffMainParser::parseInitSegment(Node *initNode, Initializable<Segment> *i
     init->initialisationSegment.Set(seg);
 }
 
+SegmentTimeline * IsoffMainParser::createTimeline(Node *node, MediaSegmentTemplate *templ, uint64_t *number)
+{
+    SegmentTimeline *timeline = new (std::nothrow) SegmentTimeline(templ);
+    if(timeline)
+    {
+        *number = 0;
+        if(node->hasAttribute("startNumber"))
+            *number = Integer<uint64_t>(node->getAttributeValue("startNumber"));
+        templ->segmentTimeline.Set(timeline);
+    }
+    return timeline;
+}
+
+void IsoffMainParser::parseTimelineElement(Node *s, SegmentTimeline *timeline, uint64_t *number)
+{
+    if(!s->hasAttribute("d")) /* Mandatory */
+        return;
+    stime_t d = Integer<stime_t>(s->getAttributeValue("d"));
+    uint64_t r = 0; // never repeats by default
+    if(s->hasAttribute("r"))
+        r = Integer<uint64_t>(s->getAttributeValue("r"));
+
+    if(s->hasAttribute("t"))
+    {
+        stime_t t = Integer<stime_t>(s->getAttributeValue("t"));
+        timeline->addElement(*number, d, r, t);
+    }
+    else timeline->addElement(*number, d, r);
+
+    *number += (1 + r);
+}
+
 void IsoffMainParser::parseTimeline(Node *node, MediaSegmentTemplate *templ)
 {
     if(!node)
         return;
 
-    uint64_t number = 0;
-    if(node->hasAttribute("startNumber"))
-        number = Integer<uint64_t>(node->getAttributeValue("startNumber"));
-
-    SegmentTimeline *timeline = new (std::nothrow) SegmentTimeline(templ);
+    uint64_t number;
+    SegmentTimeline *timeline = createTimeline(node, templ, &number);
     if(timeline)
     {
         std::vector<Node *> elements = DOMHelper::getElementByTagName(node, "S", false);
         std::vector<Node *>::const_iterator it;
         for(it = elements.begin(); it != elements.end(); ++it)
-        {
-            const Node *s = *it;
-            if(!s->hasAttribute("d")) /* Mandatory */
-                continue;
-            stime_t d = Integer<stime_t>(s->getAttributeValue("d"));
-            uint64_t r = 0; // never repeats by default
-            if(s->hasAttribute("r"))
-                r = Integer<uint64_t>(s->getAttributeValue("r"));
-
-            if(s->hasAttribute("t"))
-            {
-                stime_t t = Integer<stime_t>(s->getAttributeValue("t"));
-                timeline->addElement(number, d, r, t);
-            }
-            else timeline->addElement(number, d, r);
-
-            number += (1 + r);
-        }
-        templ->segmentTimeline.Set(timeline);
+            parseTimelineElement(*it, timeline, &number);
     }
 }
 
@@ -497,10 +976,10 @@ void IsoffMainParser::parseProgramInformation(Node * node, MPD *mpd)
     }
 }
 
-Profile IsoffMainParser::getProfile() const
+Profile IsoffMainParser::getProfile(Node *root) const
 {
     Profile res(Profile::Unknown);
-    if(this->root == NULL)
+    if(root == NULL)
         return res;
 
     std::string urn = root->getAttributeValue("profiles");
@@ -42,6 +42,9 @@ namespace adaptive
     {
         class SegmentInformation;
         class MediaSegmentTemplate;
+        class SegmentTimeline;
+        class SegmentBase;
+        class SegmentList;
     }
     namespace xml
     {
@@ -55,6 +58,7 @@ namespace dash
     {
         class Period;
         class AdaptationSet;
+        class Representation;
         class MPD;
 
         using namespace adaptive::playlist;
@@ -65,22 +69,46 @@ namespace dash
             public:
                 IsoffMainParser             (xml::Node *root, vlc_object_t *p_object,
                                              stream_t *p_stream, const std::string &);
+                /* Streaming mode, builds the MPD from the xml reader events
+                 * without a document tree. Falls back to DOM on failure. */
+                IsoffMainParser             (vlc_object_t *p_object,
+                                             stream_t *p_stream, const std::string &);
                 virtual ~IsoffMainParser    ();
                 MPD *   parse();
 
             private:
-                mpd::Profile getProfile     () const;
+                struct StreamElement;
+                MPD *   parseStream         ();
+                MPD *   processStream       (xml_reader_t *);
+                bool    startElement        (StreamElement *);
+                void    endElement          (StreamElement *);
+
+                mpd::Profile getProfile     (xml::Node *) const;
                 void    parseMPDBaseUrl     (MPD *, xml::Node *);
                 void    parseMPDAttributes  (MPD *, xml::Node *);
+                void    parsePeriodAttributes(xml::Node *, Period *);
                 void    parseAdaptationSets (xml::Node *periodNode, Period *period);
+                void    parseAdaptationSetAttributes(xml::Node *, AdaptationSet *);
+                void    parseRole           (xml::Node *, AdaptationSet *);
                 void    parseRepresentations(xml::Node *adaptationSetNode, AdaptationSet *adaptationSet);
+                void    parseRepresentationAttributes(xml::Node *, Representation *);
+                void    parseEmptyRepresentation(Representation *, AdaptationSet *, size_t);
                 void    parseInitSegment    (xml::Node *, Initializable<Segment> *, SegmentInformation *);
                 void    parseTimeline       (xml::Node *, MediaSegmentTemplate *);
+                SegmentTimeline * createTimeline(xml::Node *, MediaSegmentTemplate *, uint64_t *);
+                void    parseTimelineElement(xml::Node *, SegmentTimeline *, uint64_t *);
                 void    parsePeriods        (MPD *, xml::Node *);
                 size_t  parseSegmentInformation(xml::Node *, SegmentInformation *, uint64_t *);
+                void    parseSegmentInformationAttributes(xml::Node *, SegmentInformation *, uint64_t *);
                 size_t  parseSegmentBase    (xml::Node *, SegmentInformation *);
+                SegmentBase * createSegmentBase(xml::Node *, SegmentInformation *);
+                void    setSegmentBase      (SegmentBase *, SegmentInformation *);
                 size_t  parseSegmentList    (xml::Node *, SegmentInformation *);
+                SegmentList * createSegmentList(xml::Node *, SegmentInformation *);
+                void    parseSegmentURL     (xml::Node *, SegmentList *, SegmentInformation *,
+                                             uint64_t *, size_t *);
                 size_t  parseSegmentTemplate(xml::Node *, SegmentInformation *);
+                MediaSegmentTemplate * createSegmentTemplate(xml::Node *, SegmentInformation *);
                 void    parseProgramInformation(xml::Node *, MPD *);
 
                 xml::Node       *root;
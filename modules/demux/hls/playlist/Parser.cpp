@@ -187,26 +187,61 @@ void M3U8Parser::createAndFillRepresentation(vlc_object_t *p_obj, BaseAdaptation
 
 bool M3U8Parser::appendSegmentsFromPlaylistURI(vlc_object_t *p_obj, Representation *rep)
 {
-    block_t *p_block = Retrieve::HTTP(p_obj, rep->getPlaylistUrl().toString());
-    if(p_block)
+    /* On refresh, only segments past the last known one get parsed */
+    const HLSSegment *last = NULL;
+    const SegmentList *segmentList = rep->getSegmentList();
+    if(rep->b_loaded && segmentList && !segmentList->getSegments().empty())
+        last = dynamic_cast<const HLSSegment *>(segmentList->getSegments().back());
+    uint64_t lastsequence = 0;
+    if(last)
+        lastsequence = last->getSequenceNumber() - ISegment::SEQUENCE_FIRST;
+
+    /* Delta updates are only valid if what we have is recent enough */
+    bool b_delta = last && rep->canSkipUntil &&
+                   mdate() - rep->lastUpdateTime < rep->canSkipUntil / 2;
+
+    for(;;)
     {
+        std::string url = rep->getPlaylistUrl().toString();
+        if(b_delta)
+            url.append((url.find('?') == std::string::npos) ? "?" : "&").append("_HLS_skip=YES");
+
+        block_t *p_block = Retrieve::HTTP(p_obj, url);
+        if(!p_block)
+            return false;
+
         stream_t *substream = stream_MemoryNew(p_obj, p_block->p_buffer, p_block->i_buffer, true);
-        if(substream)
+        if(!substream)
         {
-            std::list<Tag *> tagslist = parseEntries(substream);
-            stream_Delete(substream);
+            block_Release(p_block);
+            return false;
+        }
 
-            parseSegments(p_obj, rep, tagslist);
+        uint64_t firstsequence;
+        std::list<Tag *> tagslist = parseEntries(substream, last ? &lastsequence : NULL,
+                                                 &firstsequence);
+        stream_Delete(substream);
+        block_Release(p_block);
 
+        /* Skipped segments we never had: need the full playlist */
+        if(b_delta && firstsequence != UINT64_MAX && firstsequence > lastsequence + 1)
+        {
+            msg_Dbg(p_obj, "delta playlist does not overlap, reloading");
             releaseTagsList(tagslist);
-            return true;
+            b_delta = false;
+            continue;
         }
-        block_Release(p_block);
+
+        parseSegments(p_obj, rep, tagslist, last);
+        rep->lastUpdateTime = mdate();
+
+        releaseTagsList(tagslist);
+        return true;
     }
-    return false;
 }
 
-void M3U8Parser::parseSegments(vlc_object_t *p_obj, Representation *rep, const std::list<Tag *> &tagslist)
+void M3U8Parser::parseSegments(vlc_object_t *p_obj, Representation *rep, const std::list<Tag *> &tagslist,
+                               const HLSSegment *prev)
 {
     SegmentList *segmentList = new (std::nothrow) SegmentList(rep);
 
@@ -223,6 +258,18 @@ void M3U8Parser::parseSegments(vlc_object_t *p_obj, Representation *rep, const s
     SegmentEncryption encryption;
     const ValuesListTag *ctx_extinf = NULL;
 
+    /* Appending after known segments: carry on their context */
+    if(prev)
+    {
+        const mtime_t nzPrevDuration = prev->duration.Get() * CLOCK_FREQ / rep->timescale.Get();
+        nzStartTime = prev->startTime.Get() * CLOCK_FREQ / rep->timescale.Get() + nzPrevDuration;
+        totalduration = nzStartTime;
+        if(prev->utcTime > VLC_TS_INVALID)
+            absReferenceTime = prev->utcTime + nzPrevDuration;
+        prevbyterangeoffset = prev->endByte;
+        encryption = prev->encryption;
+    }
+
     std::list<Tag *>::const_iterator it;
     for(it = tagslist.begin(); it != tagslist.end(); ++it)
     {
@@ -370,6 +417,13 @@ void M3U8Parser::parseSegments(vlc_object_t *p_obj, Representation *rep, const s
             case Tag::EXTXENDLIST:
                 rep->b_live = false;
                 break;
+
+            case AttributesTag::EXTXSERVERCONTROL:
+            {
+                const Attribute *skipattr = static_cast<const AttributesTag *>(tag)->getAttributeByName("CAN-SKIP-UNTIL");
+                rep->canSkipUntil = (skipattr) ? CLOCK_FREQ * skipattr->floatingPoint() : 0;
+            }
+            break;
         }
     }
 
@@ -515,14 +569,42 @@ M3U8 * M3U8Parser::parse(vlc_object_t *p_object, stream_t *p_stream, const std::
     return playlist;
 }
 
-std::list<Tag *> M3U8Parser::parseEntries(stream_t *stream)
+/* Tags which are not attached to a particular segment */
+static bool isPlaylistTag(const std::string &key)
+{
+    const char *const ppsz_tags[] = {
+        "EXT-X-VERSION",
+        "EXT-X-TARGETDURATION",
+        "EXT-X-DISCONTINUITY-SEQUENCE",
+        "EXT-X-PLAYLIST-TYPE",
+        "EXT-X-ENDLIST",
+        "EXT-X-I-FRAMES-ONLY",
+        "EXT-X-SERVER-CONTROL",
+    };
+    for(size_t i=0; i<ARRAY_SIZE(ppsz_tags); i++)
+        if(key == ppsz_tags[i])
+            return true;
+    return false;
+}
+
+/* When lastsequence is set, lines of segments up to that media sequence
+ * number are skipped without being tokenized, and the media sequence of
+ * the first remaining segment is returned through firstsequence */
+std::list<Tag *> M3U8Parser::parseEntries(stream_t *stream, const uint64_t *lastsequence,
+                                          uint64_t *firstsequence)
 {
     std::list<Tag *> entrieslist;
     Tag *lastTag = NULL;
     char *psz_line;
+    uint64_t sequence = 0;
+
+    if(firstsequence)
+        *firstsequence = UINT64_MAX;
 
     while((psz_line = stream_ReadLine(stream)))
     {
+        const bool b_known = lastsequence && sequence <= *lastsequence;
+
         if(*psz_line == '#')
         {
             if(!strncmp(psz_line, "#EXT", 4)) //tag
@@ -540,6 +622,25 @@ std::list<Tag *> M3U8Parser::parseEntries(stream_t *stream)
                     key = std::string(psz_line + 1);
                 }
 
+                if(lastsequence && key == "EXT-X-MEDIA-SEQUENCE")
+                {
+                    /* replaced by the first new segment sequence */
+                    sequence = strtoull(attributes.c_str(), NULL, 10);
+                    key.clear();
+                }
+                else if(lastsequence && key == "EXT-X-SKIP")
+                {
+                    AttributesTag skiptag(AttributesTag::EXTXSKIP, attributes);
+                    if(skiptag.getAttributeByName("SKIPPED-SEGMENTS"))
+                        sequence += skiptag.getAttributeByName("SKIPPED-SEGMENTS")->decimal();
+                    key.clear();
+                }
+                else if(b_known && !isPlaylistTag(key))
+                {
+                    key.clear();
+                }
+
+                lastTag = NULL;
                 if(!key.empty())
                 {
                     Tag *tag = TagFactory::createTagByName(key, attributes);
@@ -560,11 +661,18 @@ std::list<Tag *> M3U8Parser::parseEntries(stream_t *stream)
                 if(uriAttr)
                     streaminftag->addAttribute(uriAttr);
             }
+            else if(b_known)
+            {
+                sequence++;
+            }
             else /* playlist tag, will take modifiers */
             {
                 Tag *tag = TagFactory::createTagByName("", std::string(psz_line));
                 if(tag)
                     entrieslist.push_back(tag);
+                if(firstsequence && *firstsequence == UINT64_MAX)
+                    *firstsequence = sequence;
+                sequence++;
             }
             lastTag = NULL;
         }
@@ -576,5 +684,15 @@ std::list<Tag *> M3U8Parser::parseEntries(stream_t *stream)
         free(psz_line);
     }
 
+    if(lastsequence)
+    {
+        std::stringstream ss;
+        ss.imbue(std::locale("C"));
+        ss << ((firstsequence && *firstsequence != UINT64_MAX) ? *firstsequence : sequence);
+        Tag *tag = TagFactory::createTagByName("EXT-X-MEDIA-SEQUENCE", ss.str());
+        if(tag)
+            entrieslist.push_front(tag);
+    }
+
     return entrieslist;
 }
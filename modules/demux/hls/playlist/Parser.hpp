@@ -52,6 +52,7 @@ namespace hls
         class AttributesTag;
         class Tag;
         class Representation;
+        class HLSSegment;
 
         class M3U8Parser
         {
@@ -66,10 +67,11 @@ namespace hls
                 Representation * createRepresentation(BaseAdaptationSet *, const AttributesTag *);
                 void createAndFillRepresentation(vlc_object_t *, BaseAdaptationSet *,
                                                  const AttributesTag *, const std::list<Tag *>&);
-                void parseSegments(vlc_object_t *, Representation *, const std::list<Tag *>&);
+                void parseSegments(vlc_object_t *, Representation *, const std::list<Tag *>&,
+                                   const HLSSegment * = NULL);
                 void setFormatFromCodecs(Representation *, const std::string);
                 void setFormatFromExtension(Representation *rep, const std::string &);
-                std::list<Tag *> parseEntries(stream_t *);
+                std::list<Tag *> parseEntries(stream_t *, const uint64_t * = NULL, uint64_t * = NULL);
         };
     }
 }
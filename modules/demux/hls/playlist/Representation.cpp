@@ -44,6 +44,8 @@ Representation::Representation  ( BaseAdaptationSet *set ) :
     switchpolicy = SegmentInformation::SWITCH_SEGMENT_ALIGNED; /* FIXME: based on streamformat */
     nextUpdateTime = 0;
     targetDuration = 0;
+    lastUpdateTime = 0;
+    canSkipUntil = 0;
     streamFormat = StreamFormat::UNKNOWN;
 }
 
@@ -45,7 +45,7 @@ namespace hls
 
                 void setPlaylistUrl(const std::string &);
                 Url getPlaylistUrl() const;
-                bool isLive() const;
+                virtual bool isLive() const; /* reimpl */
                 bool initialized() const;
                 virtual void scheduleNextUpdate(uint64_t); /* reimpl */
                 virtual bool needsUpdate() const;  /* reimpl */
@@ -59,6 +59,8 @@ namespace hls
                 bool b_loaded;
                 time_t nextUpdateTime;
                 time_t targetDuration;
+                mtime_t lastUpdateTime;
+                mtime_t canSkipUntil; /* delta updates skip boundary */
                 Url playlistUrl;
         };
     }
@@ -100,6 +100,8 @@ namespace hls
                     EXTXMAP,
                     EXTXMEDIA,
                     EXTXSTREAMINF,
+                    EXTXSERVERCONTROL,
+                    EXTXSKIP,
                 };
                 AttributesTag(int, const std::string &);
                 virtual ~AttributesTag();
@@ -0,0 +1,321 @@
+/*****************************************************************************
+ * index_cache.c: persistent seek index cache for demuxers
+ *****************************************************************************
+ * Copyright © 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#ifdef HAVE_MMAP
+# include <sys/mman.h>
+#endif
+
+#include <vlc_common.h>
+#include <vlc_demux.h>
+#include <vlc_configuration.h>
+#include <vlc_fs.h>
+#include <vlc_md5.h>
+
+#include "index_cache.h"
+
+#define INDEX_CACHE_MAGIC  "VLCINDEX"
+#define INDEX_CACHE_ENDIAN 0x01020304
+#define INDEX_CACHE_ALIGN  8
+
+typedef struct
+{
+    char     magic[8];
+    uint32_t i_endian;
+    uint32_t i_format;
+    uint32_t i_version;
+    uint32_t i_records;
+    uint64_t i_file_size;
+    int64_t  i_file_mtime;
+} index_cache_header_t;
+
+typedef struct
+{
+    uint32_t i_id;
+    uint32_t i_reserved;
+    uint64_t i_offset;
+    uint64_t i_size;
+} index_cache_entry_t;
+
+struct index_cache_t
+{
+    uint8_t *p_data;
+    size_t   i_data;
+    bool     b_mapped;
+};
+
+static char *GetCachePath( const char *psz_file, bool b_create_dir )
+{
+    char *psz_cachedir = config_GetUserDir( VLC_CACHE_DIR );
+    if( psz_cachedir == NULL )
+        return NULL;
+
+    struct md5_s md5;
+    InitMD5( &md5 );
+    AddMD5( &md5, psz_file, strlen( psz_file ) );
+    EndMD5( &md5 );
+    char *psz_hash = psz_md5_hash( &md5 );
+
+    char *psz_dir, *psz_path = NULL;
+    if( psz_hash != NULL &&
+        asprintf( &psz_dir, "%s" DIR_SEP "index", psz_cachedir ) != -1 )
+    {
+        if( b_create_dir )
+        {
+            vlc_mkdir( psz_cachedir, 0700 );
+            vlc_mkdir( psz_dir, 0700 );
+        }
+        if( asprintf( &psz_path, "%s" DIR_SEP "%s.idx", psz_dir, psz_hash ) == -1 )
+            psz_path = NULL;
+        free( psz_dir );
+    }
+
+    free( psz_hash );
+    free( psz_cachedir );
+    return psz_path;
+}
+
+/* Only plain local files can be keyed reliably */
+static int StatInput( demux_t *p_demux, struct stat *p_st )
+{
+    if( p_demux->psz_file == NULL || vlc_stat( p_demux->psz_file, p_st ) )
+        return VLC_EGENERIC;
+    return S_ISREG( p_st->st_mode ) ? VLC_SUCCESS : VLC_EGENERIC;
+}
+
+static bool CheckCache( const index_cache_t *p_cache, const struct stat *p_st,
+                        vlc_fourcc_t i_format, uint32_t i_version )
+{
+    const index_cache_header_t *p_header = (const void *) p_cache->p_data;
+
+    if( memcmp( p_header->magic, INDEX_CACHE_MAGIC, 8 ) ||
+        p_header->i_endian != INDEX_CACHE_ENDIAN ||
+        p_header->i_format != i_format ||
+        p_header->i_version != i_version ||
+        p_header->i_file_size != (uint64_t) p_st->st_size ||
+        p_header->i_file_mtime != (int64_t) p_st->st_mtime )
+        return false;
+
+    const size_t i_table = sizeof(*p_header) +
+                           sizeof(index_cache_entry_t) * p_header->i_records;
+    if( p_header->i_records > p_cache->i_data / sizeof(index_cache_entry_t) ||
+        i_table > p_cache->i_data )
+        return false;
+
+    const index_cache_entry_t *p_entries = (const void *) &p_header[1];
+    for( uint32_t i = 0; i < p_header->i_records; i++ )
+    {
+        if( p_entries[i].i_offset % INDEX_CACHE_ALIGN ||
+            p_entries[i].i_offset < i_table ||
+            p_entries[i].i_offset > p_cache->i_data ||
+            p_entries[i].i_size > p_cache->i_data - p_entries[i].i_offset )
+            return false;
+    }
+    return true;
+}
+
+index_cache_t *index_cache_Open( demux_t *p_demux, vlc_fourcc_t i_format, uint32_t i_version )
+{
+    struct stat st, cachest;
+    if( StatInput( p_demux, &st ) )
+        return NULL;
+
+    char *psz_path = GetCachePath( p_demux->psz_file, false );
+    if( psz_path == NULL )
+        return NULL;
+
+    int fd = vlc_open( psz_path, O_RDONLY );
+    if( fd == -1 )
+    {
+        free( psz_path );
+        return NULL;
+    }
+
+    index_cache_t *p_cache = NULL;
+    if( fstat( fd, &cachest ) ||
+        (uintmax_t) cachest.st_size < sizeof(index_cache_header_t) ||
+        (uintmax_t) cachest.st_size > SIZE_MAX )
+        goto end;
+
+    p_cache = malloc( sizeof(*p_cache) );
+    if( unlikely(p_cache == NULL) )
+        goto end;
+    p_cache->i_data = cachest.st_size;
+    p_cache->b_mapped = false;
+
+#ifdef HAVE_MMAP
+    p_cache->p_data = mmap( NULL, p_cache->i_data, PROT_READ, MAP_PRIVATE, fd, 0 );
+    if( p_cache->p_data != MAP_FAILED )
+        p_cache->b_mapped = true;
+    else
+#endif
+    {
+        /* malloc alignment is enough for the records */
+        p_cache->p_data = malloc( p_cache->i_data );
+        size_t i_read = 0;
+        while( p_cache->p_data && i_read < p_cache->i_data )
+        {
+            ssize_t i_ret = read( fd, p_cache->p_data + i_read,
+                                  p_cache->i_data - i_read );
+            if( i_ret <= 0 && errno != EINTR )
+                break;
+            if( i_ret > 0 )
+                i_read += i_ret;
+        }
+        if( i_read < p_cache->i_data )
+        {
+            free( p_cache->p_data );
+            free( p_cache );
+            p_cache = NULL;
+            goto end;
+        }
+    }
+
+    if( !CheckCache( p_cache, &st, i_format, i_version ) )
+    {
+        msg_Dbg( p_demux, "discarding stale index cache %s", psz_path );
+        index_cache_Close( p_cache );
+        p_cache = NULL;
+    }
+    else
+        msg_Dbg( p_demux, "using index cache %s", psz_path );
+
+end:
+    close( fd );
+    free( psz_path );
+    return p_cache;
+}
+
+const void *index_cache_Get( index_cache_t *p_cache, uint32_t i_id, size_t *pi_size )
+{
+    const index_cache_header_t *p_header = (const void *) p_cache->p_data;
+    const index_cache_entry_t *p_entries = (const void *) &p_header[1];
+
+    for( uint32_t i = 0; i < p_header->i_records; i++ )
+    {
+        if( p_entries[i].i_id == i_id )
+        {
+            *pi_size = p_entries[i].i_size;
+            return &p_cache->p_data[p_entries[i].i_offset];
+        }
+    }
+    return NULL;
+}
+
+void index_cache_Close( index_cache_t *p_cache )
+{
+#ifdef HAVE_MMAP
+    if( p_cache->b_mapped )
+        munmap( p_cache->p_data, p_cache->i_data );
+    else
+#endif
+        free( p_cache->p_data );
+    free( p_cache );
+}
+
+static bool WritePadded( FILE *p_file, const void *p_data, size_t i_size )
+{
+    static const uint8_t padding[INDEX_CACHE_ALIGN] = { 0 };
+    size_t i_padding = (INDEX_CACHE_ALIGN - i_size % INDEX_CACHE_ALIGN) % INDEX_CACHE_ALIGN;
+
+    return fwrite( p_data, 1, i_size, p_file ) == i_size &&
+           fwrite( padding, 1, i_padding, p_file ) == i_padding;
+}
+
+int index_cache_Write( demux_t *p_demux, vlc_fourcc_t i_format, uint32_t i_version,
+                       const index_cache_record_t *p_records, unsigned i_records )
+{
+    struct stat st;
+    if( StatInput( p_demux, &st ) )
+        return VLC_EGENERIC;
+
+    char *psz_path = GetCachePath( p_demux->psz_file, true );
+    if( psz_path == NULL )
+        return VLC_EGENERIC;
+
+    /* Unique, so that concurrent writers never rename each other's file */
+    char *psz_tmp;
+    if( asprintf( &psz_tmp, "%s.XXXXXX", psz_path ) == -1 )
+    {
+        free( psz_path );
+        return VLC_ENOMEM;
+    }
+
+    int i_ret = VLC_EGENERIC;
+    int fd = vlc_mkstemp( psz_tmp );
+    if( fd == -1 )
+        goto end;
+
+    FILE *p_file = fdopen( fd, "wb" );
+    if( p_file == NULL )
+    {
+        close( fd );
+        vlc_unlink( psz_tmp );
+        goto end;
+    }
+
+    index_cache_header_t header;
+    memcpy( header.magic, INDEX_CACHE_MAGIC, 8 );
+    header.i_endian = INDEX_CACHE_ENDIAN;
+    header.i_format = i_format;
+    header.i_version = i_version;
+    header.i_records = i_records;
+    header.i_file_size = st.st_size;
+    header.i_file_mtime = st.st_mtime;
+
+    bool b_ok = WritePadded( p_file, &header, sizeof(header) );
+
+    uint64_t i_offset = sizeof(header) + sizeof(index_cache_entry_t) * i_records;
+    for( unsigned i = 0; i < i_records && b_ok; i++ )
+    {
+        index_cache_entry_t entry;
+        entry.i_id = p_records[i].i_id;
+        entry.i_reserved = 0;
+        entry.i_offset = i_offset;
+        entry.i_size = p_records[i].i_size;
+        b_ok = WritePadded( p_file, &entry, sizeof(entry) );
+        i_offset += (p_records[i].i_size + INDEX_CACHE_ALIGN - 1) & ~(INDEX_CACHE_ALIGN - 1);
+    }
+
+    for( unsigned i = 0; i < i_records && b_ok; i++ )
+        b_ok = WritePadded( p_file, p_records[i].p_data, p_records[i].i_size );
+
+    if( fclose( p_file ) || !b_ok )
+        vlc_unlink( psz_tmp );
+    else if( vlc_rename( psz_tmp, psz_path ) == 0 )
+        i_ret = VLC_SUCCESS;
+
+end:
+    if( i_ret != VLC_SUCCESS )
+        msg_Warn( p_demux, "cannot write index cache %s", psz_path );
+    free( psz_tmp );
+    free( psz_path );
+    return i_ret;
+}
@@ -0,0 +1,64 @@
+/*****************************************************************************
+ * index_cache.h: persistent seek index cache for demuxers
+ *****************************************************************************
+ * Copyright © 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_DEMUX_INDEX_CACHE_H
+#define VLC_DEMUX_INDEX_CACHE_H
+
+#include <vlc_demux.h>
+
+# ifdef __cplusplus
+extern "C" {
+# endif
+
+/* Index computed by a demuxer for a local file, stored under the user
+ * cache directory and keyed by the file path, size and modification time.
+ *
+ * A cache file holds a set of records identified by the demuxer, each
+ * being a blob of native endian, fixed size structures. The file is
+ * mapped in memory when possible, records point directly into it. */
+
+typedef struct index_cache_t index_cache_t;
+
+typedef struct
+{
+    uint32_t    i_id;
+    const void *p_data;
+    size_t      i_size;
+} index_cache_record_t;
+
+/* Returns the cache of the demuxed file, NULL if there is none, it is
+ * stale, or it was written by another demuxer or version of it. */
+index_cache_t *index_cache_Open( demux_t *, vlc_fourcc_t i_format, uint32_t i_version );
+
+/* Returns the record data, NULL if missing. The data are aligned to 8 bytes
+ * and remain valid until the cache is closed. */
+const void *index_cache_Get( index_cache_t *, uint32_t i_id, size_t *pi_size );
+
+void index_cache_Close( index_cache_t * );
+
+/* Replaces the cache of the demuxed file */
+int index_cache_Write( demux_t *, vlc_fourcc_t i_format, uint32_t i_version,
+                       const index_cache_record_t *, unsigned i_records );
+
+# ifdef __cplusplus
+}
+# endif
+
+#endif
@@ -0,0 +1,159 @@
+/*****************************************************************************
+ * cues_index.cpp : matroska demuxer
+ *****************************************************************************
+ * Copyright (C) 2003-2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#include "cues_index.hpp"
+
+static bool PointStartsBefore( mtime_t i_mk_time, const mkv_index_t & point )
+{
+    return i_mk_time < point.i_mk_time;
+}
+
+static bool PointIsBefore( const mkv_index_t & point, int64_t i_position )
+{
+    return point.i_position < i_position;
+}
+
+cues_index_c::cues_index_c()
+    :i_count(0)
+    ,i_last_position(-1)
+{
+    vlc_mutex_init( &lock );
+}
+
+cues_index_c::~cues_index_c()
+{
+    vlc_mutex_destroy( &lock );
+}
+
+void cues_index_c::insert( const mkv_index_t & point )
+{
+    if( point.i_mk_time == -1 )
+        return;
+
+    vlc_mutex_locker l( &lock );
+
+    points_t & points = tracks[ point.i_track >= 0 ? point.i_track : ANY_TRACK ];
+
+    /* cues and clusters come in order, so this is mostly an append */
+    points_t::iterator it = points.end();
+    if( !points.empty() && points.back().i_mk_time > point.i_mk_time )
+        it = std::upper_bound( points.begin(), points.end(),
+                               point.i_mk_time, PointStartsBefore );
+
+    /* the same cluster may be found while playing and by the indexer */
+    for( points_t::iterator prev = it; prev != points.begin(); )
+    {
+        --prev;
+        if( prev->i_mk_time != point.i_mk_time )
+            break;
+        if( prev->i_position == point.i_position )
+            return;
+    }
+
+    points.insert( it, point );
+
+    i_count++;
+    if( point.i_position > i_last_position )
+        i_last_position = point.i_position;
+}
+
+void cues_index_c::clear()
+{
+    vlc_mutex_locker l( &lock );
+    tracks.clear();
+    i_count = 0;
+    i_last_position = -1;
+}
+
+bool cues_index_c::empty() const
+{
+    vlc_mutex_locker l( &lock );
+    return i_count == 0;
+}
+
+size_t cues_index_c::count() const
+{
+    vlc_mutex_locker l( &lock );
+    return i_count;
+}
+
+int64_t cues_index_c::lastPosition() const
+{
+    vlc_mutex_locker l( &lock );
+    return i_last_position;
+}
+
+void cues_index_c::copyTo( std::vector<mkv_index_t> & points ) const
+{
+    vlc_mutex_locker l( &lock );
+
+    points.clear();
+    points.reserve( i_count );
+    for( std::map<int, points_t>::const_iterator it = tracks.begin(); it != tracks.end(); ++it )
+        points.insert( points.end(), it->second.begin(), it->second.end() );
+}
+
+const cues_index_c::points_t * cues_index_c::getPoints( int i_track ) const
+{
+    std::map<int, points_t>::const_iterator it = tracks.find( i_track );
+    if( it == tracks.end() || it->second.empty() )
+        it = tracks.find( ANY_TRACK );
+    if( it == tracks.end() || it->second.empty() )
+    {
+        /* cues of another track still point to clusters starts */
+        for( it = tracks.begin(); it != tracks.end(); ++it )
+            if( !it->second.empty() )
+                break;
+    }
+    return it != tracks.end() ? &it->second : NULL;
+}
+
+bool cues_index_c::findByTime( int i_track, mtime_t i_mk_time, mkv_index_t *p_point ) const
+{
+    vlc_mutex_locker l( &lock );
+
+    const points_t *p_points = getPoints( i_track );
+    if( p_points == NULL )
+        return false;
+
+    points_t::const_iterator it = std::upper_bound( p_points->begin(), p_points->end(),
+                                                    i_mk_time, PointStartsBefore );
+    if( it == p_points->begin() )
+        return false;
+
+    *p_point = *--it;
+    return true;
+}
+
+bool cues_index_c::findByPosition( int i_track, int64_t i_position, mkv_index_t *p_point ) const
+{
+    vlc_mutex_locker l( &lock );
+
+    const points_t *p_points = getPoints( i_track );
+    if( p_points == NULL )
+        return false;
+
+    points_t::const_iterator it = std::lower_bound( p_points->begin(), p_points->end(),
+                                                    i_position, PointIsBefore );
+    if( it == p_points->end() )
+        return false;
+
+    *p_point = *it;
+    return true;
+}
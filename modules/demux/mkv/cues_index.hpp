@@ -0,0 +1,79 @@
+/*****************************************************************************
+ * cues_index.hpp : matroska demuxer
+ *****************************************************************************
+ * Copyright (C) 2003-2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_MKV_CUES_INDEX_HPP_
+#define VLC_MKV_CUES_INDEX_HPP_
+
+#include "mkv.hpp"
+
+#include <map>
+
+/* Seek points of a segment, kept per track and sorted by time.
+ *
+ * Points coming from the Cues are stored under their CueTrack, clusters
+ * found while playing or scanning the file are stored under the
+ * "any track" key (-1). Clusters are laid out in time order, so the
+ * points lists are sorted by position as well.
+ *
+ * The index is filled by the cluster indexer thread while playing, so
+ * lookups return copies of the points. */
+class cues_index_c
+{
+public:
+    enum { ANY_TRACK = -1 };
+
+    cues_index_c();
+    ~cues_index_c();
+
+    /* points without a time and already known clusters are dropped */
+    void insert( const mkv_index_t & );
+    void clear();
+    bool empty() const;
+    size_t count() const;
+
+    /* position of the last known point, -1 if empty */
+    int64_t lastPosition() const;
+
+    /* all the points, sorted by track and time */
+    void copyTo( std::vector<mkv_index_t> & ) const;
+
+    /* The lookups use the points of track i_track, falling back to the
+     * clusters and then to the cues of another track. */
+
+    /* last point starting at or before i_mk_time */
+    bool findByTime( int i_track, mtime_t i_mk_time, mkv_index_t *p_point ) const;
+    /* first point starting at or after i_position */
+    bool findByPosition( int i_track, int64_t i_position, mkv_index_t *p_point ) const;
+
+private:
+    typedef std::vector<mkv_index_t> points_t;
+
+    cues_index_c( const cues_index_c & );
+    cues_index_c & operator=( const cues_index_c & );
+
+    const points_t * getPoints( int i_track ) const;
+
+    mutable vlc_mutex_t     lock;
+    std::map<int, points_t> tracks;
+    size_t                  i_count;
+    int64_t                 i_last_position;
+};
+
+#endif
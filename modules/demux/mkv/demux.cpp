@@ -447,6 +447,7 @@ demux_sys_t::~demux_sys_t()
     { vlc_input_title_Delete( titles.back() ); titles.pop_back();}
 
     vlc_mutex_destroy( &lock_demuxer );
+    vlc_mutex_destroy( &lock_segments );
 }
 
 
@@ -541,7 +542,9 @@ matroska_stream_c *demux_sys_t::AnalyseAllSegmentsFound( demux_t *p_demux, EbmlS
                         if( MKV_IS_ID( l, KaxSegmentUID ) )
                         {
                             KaxSegmentUID *p_uid = static_cast<KaxSegmentUID*>(l);
+                            vlc_mutex_lock( &lock_segments );
                             b_keep_segment = (FindSegment( *p_uid ) == NULL);
+                            vlc_mutex_unlock( &lock_segments );
                             delete p_segment1->p_segment_uid;
                             p_segment1->p_segment_uid = new KaxSegmentUID(*p_uid);
                             if ( !b_keep_segment )
@@ -564,7 +567,14 @@ matroska_stream_c *demux_sys_t::AnalyseAllSegmentsFound( demux_t *p_demux, EbmlS
                         }
                     }
                     if( b_keep_segment || !p_segment1->p_segment_uid )
-                        opened_segments.push_back( p_segment1 );
+                    {
+                        vlc_mutex_locker locker( &lock_segments );
+                        /* files of the directory are analysed concurrently */
+                        if( p_segment1->p_segment_uid && FindSegment( *p_segment1->p_segment_uid ) )
+                            b_keep_segment = false;
+                        else
+                            opened_segments.push_back( p_segment1 );
+                    }
                     break;
                 }
             }
@@ -777,8 +787,8 @@ bool demux_sys_t::PreparePlayback( virtual_segment_c *p_new_segment )
     }
     if( !p_current_segment->CurrentSegment() )
         return false;
-    if( !p_current_segment->CurrentSegment()->b_cues )
-        msg_Warn( &p_current_segment->CurrentSegment()->sys.demuxer, "no cues/empty cues found->seek won't be precise" );
+    if( p_current_segment->CurrentSegment()->i_cues_position < 0 )
+        msg_Warn( &p_current_segment->CurrentSegment()->sys.demuxer, "no cues found->seek won't be precise" );
 
     f_duration = p_current_segment->Duration();
 
@@ -29,6 +29,7 @@
 
 #include "chapter_command.hpp"
 #include "virtual_segment.hpp"
+#include "../index_cache.h"
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #undef ATTRIBUTE_PACKED
@@ -342,8 +343,10 @@ public:
         ,f_duration(-1.0)
         ,p_input(NULL)
         ,p_ev(NULL)
+        ,p_index_cache(NULL)
     {
         vlc_mutex_init( &lock_demuxer );
+        vlc_mutex_init( &lock_segments );
     }
 
     virtual ~demux_sys_t();
@@ -364,6 +367,7 @@ public:
     std::vector<matroska_stream_c*>  streams;
     std::vector<attachment_c*>       stored_attachments;
     std::vector<matroska_segment_c*> opened_segments;
+    vlc_mutex_t                      lock_segments; /* opened_segments, while preloading */
     std::vector<virtual_segment_c*>  used_segments;
     virtual_segment_c                *p_current_segment;
 
@@ -398,6 +402,9 @@ public:
     /* event */
     event_thread_t *p_ev;
 
+    /* seek index cache of the opened file */
+    index_cache_t  *p_index_cache;
+
 protected:
     virtual_segment_c *VirtualFromSegments( std::vector<matroska_segment_c*> *p_segments ) const;
 };
@@ -0,0 +1,407 @@
+/*****************************************************************************
+ * local_dir.cpp : matroska demuxer
+ *****************************************************************************
+ * Copyright (C) 2003-2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#include "local_dir.hpp"
+#include "demux.hpp"
+#include "matroska_segment.hpp"
+#include "chapters.hpp"
+#include "stream_io_callback.hpp"
+
+#include <vlc_fs.h>
+#include <vlc_url.h>
+
+#include <sys/stat.h>
+#include <map>
+#include <set>
+
+/* files opened at the same time, mostly waiting for the storage */
+#define MKV_PRELOAD_THREADS 4
+/* directories remembered */
+#define MKV_LINKS_CACHE_DIRS 16
+
+struct segment_links_t
+{
+    std::string              uid;
+    std::string              prev_uid;
+    std::string              next_uid;
+    std::vector<std::string> families;
+};
+
+struct file_links_t
+{
+    uint64_t                     i_size;
+    int64_t                      i_mtime;
+    bool                         b_matroska;
+    std::vector<segment_links_t> segments;
+};
+
+typedef std::map<std::string, file_links_t> dir_links_t;
+
+static vlc_mutex_t links_lock = VLC_STATIC_MUTEX;
+static std::map<std::string, dir_links_t> links_cache;
+
+struct preload_file_t
+{
+    std::string        name;
+    std::string        path;
+    bool               b_stat;
+    uint64_t           i_size;
+    int64_t            i_mtime;
+
+    bool               b_known;   /* the links are from the cache */
+    bool               b_linked;
+    bool               b_done;
+    bool               b_opened;
+    file_links_t       links;
+
+    matroska_stream_c *p_stream;
+};
+
+struct preload_pool_t
+{
+    demux_sys_t                   *p_sys;
+    std::vector<preload_file_t *> *p_files;
+    vlc_mutex_t                   lock;
+    size_t                        i_next;
+};
+
+static std::string BinaryKey( const EbmlBinary *p_binary )
+{
+    if( p_binary == NULL || p_binary->GetBuffer() == NULL )
+        return std::string();
+    return std::string( reinterpret_cast<const char *>( p_binary->GetBuffer() ),
+                        p_binary->GetSize() );
+}
+
+static void GetLinks( const matroska_stream_c & stream, std::vector<segment_links_t> & links )
+{
+    for( size_t i = 0; i < stream.segments.size(); i++ )
+    {
+        const matroska_segment_c *p_segment = stream.segments[i];
+        segment_links_t segment;
+
+        segment.uid      = BinaryKey( p_segment->p_segment_uid );
+        segment.prev_uid = BinaryKey( p_segment->p_prev_segment_uid );
+        segment.next_uid = BinaryKey( p_segment->p_next_segment_uid );
+        for( size_t j = 0; j < p_segment->families.size(); j++ )
+            segment.families.push_back( BinaryKey( p_segment->families[j] ) );
+
+        links.push_back( segment );
+    }
+}
+
+/* Segments the opened stream may use: its own, the linked ones, the ones
+ * of its ordered chapters and the ones of its families */
+class wanted_links_c
+{
+public:
+    wanted_links_c( const matroska_stream_c & stream )
+    {
+        std::vector<segment_links_t> links;
+        GetLinks( stream, links );
+        for( size_t i = 0; i < links.size(); i++ )
+        {
+            add( links[i] );
+            families.insert( links[i].families.begin(), links[i].families.end() );
+        }
+
+        for( size_t i = 0; i < stream.segments.size(); i++ )
+        {
+            const std::vector<chapter_edition_c*> & editions = stream.segments[i]->stored_editions;
+            for( size_t j = 0; j < editions.size(); j++ )
+                addChapter( editions[j] );
+        }
+        uids.erase( std::string() );
+        families.erase( std::string() );
+    }
+
+    /* a file is linked when one of its segments is wanted, or links back
+     * to a wanted one; its own links are then wanted too */
+    bool match( const std::vector<segment_links_t> & links )
+    {
+        bool b_linked = false;
+        for( size_t i = 0; i < links.size() && !b_linked; i++ )
+        {
+            const segment_links_t & segment = links[i];
+            b_linked = uids.count( segment.uid ) || uids.count( segment.prev_uid ) ||
+                       uids.count( segment.next_uid );
+            for( size_t j = 0; j < segment.families.size() && !b_linked; j++ )
+                b_linked = families.count( segment.families[j] );
+        }
+
+        if( b_linked )
+        {
+            for( size_t i = 0; i < links.size(); i++ )
+                add( links[i] );
+            uids.erase( std::string() );
+        }
+        return b_linked;
+    }
+
+private:
+    void add( const segment_links_t & segment )
+    {
+        uids.insert( segment.uid );
+        uids.insert( segment.prev_uid );
+        uids.insert( segment.next_uid );
+    }
+
+    void addChapter( const chapter_item_c *p_chapter )
+    {
+        uids.insert( BinaryKey( p_chapter->p_segment_uid ) );
+        for( size_t i = 0; i < p_chapter->sub_chapters.size(); i++ )
+            addChapter( p_chapter->sub_chapters[i] );
+    }
+
+    std::set<std::string> uids;
+    std::set<std::string> families;
+};
+
+static void OpenFile( demux_sys_t & sys, preload_file_t & file )
+{
+    demux_t       *p_demux = &sys.demuxer;
+    const uint8_t *p_peek;
+    char          *psz_url = vlc_path2uri( file.path.c_str(), "file" );
+    stream_t      *p_file_stream = psz_url ? stream_UrlNew( p_demux, psz_url ) : NULL;
+
+    free( psz_url );
+
+    file.b_opened = p_file_stream != NULL;
+
+    /* peek the begining */
+    if( p_file_stream &&
+        stream_Peek( p_file_stream, &p_peek, 4 ) >= 4
+        && p_peek[0] == 0x1a && p_peek[1] == 0x45 &&
+        p_peek[2] == 0xdf && p_peek[3] == 0xa3 ) file.links.b_matroska = true;
+
+    if( !file.links.b_matroska )
+    {
+        if( p_file_stream )
+            stream_Delete( p_file_stream );
+        msg_Dbg( p_demux, "the file '%s' cannot be opened", file.path.c_str() );
+        return;
+    }
+
+    vlc_stream_io_callback *p_file_io = new vlc_stream_io_callback( p_file_stream, true );
+    EbmlStream *p_estream = new EbmlStream( *p_file_io );
+
+    file.p_stream = sys.AnalyseAllSegmentsFound( p_demux, p_estream );
+    if( file.p_stream == NULL )
+    {
+        msg_Dbg( p_demux, "the file '%s' will not be used", file.path.c_str() );
+        delete p_estream;
+        delete p_file_io;
+        return;
+    }
+
+    file.p_stream->p_io_callback = p_file_io;
+    file.p_stream->p_estream = p_estream;
+    /* The links may come from the cache of a previous opening */
+    file.links.segments.clear();
+    GetLinks( *file.p_stream, file.links.segments );
+}
+
+static void *PreloadThread( void *p_data )
+{
+    preload_pool_t *p_pool = static_cast<preload_pool_t *>( p_data );
+
+    for( ;; )
+    {
+        vlc_mutex_lock( &p_pool->lock );
+        size_t i_file = p_pool->i_next++;
+        vlc_mutex_unlock( &p_pool->lock );
+
+        if( i_file >= p_pool->p_files->size() )
+            break;
+        OpenFile( *p_pool->p_sys, *(*p_pool->p_files)[i_file] );
+    }
+    return NULL;
+}
+
+static void OpenFiles( demux_sys_t & sys, std::vector<preload_file_t *> & files )
+{
+    preload_pool_t pool;
+    pool.p_sys = &sys;
+    pool.p_files = &files;
+    pool.i_next = 0;
+    vlc_mutex_init( &pool.lock );
+
+    vlc_thread_t threads[MKV_PRELOAD_THREADS];
+    size_t i_threads = 0;
+    while( i_threads < __MIN( (size_t)MKV_PRELOAD_THREADS, files.size() ) &&
+           !vlc_clone( &threads[i_threads], PreloadThread, &pool, VLC_THREAD_PRIORITY_INPUT ) )
+        i_threads++;
+
+    if( i_threads == 0 )
+        PreloadThread( &pool );
+
+    for( size_t i = 0; i < i_threads; i++ )
+        vlc_join( threads[i], NULL );
+
+    vlc_mutex_destroy( &pool.lock );
+}
+
+void PreloadLocalDir( demux_sys_t & sys, const matroska_stream_c & stream )
+{
+    demux_t     *p_demux = &sys.demuxer;
+    std::string s_path, s_filename;
+
+    // assume it's a regular file
+    // get the directory path
+    s_path = p_demux->psz_file;
+    if (s_path.at(s_path.length() - 1) == DIR_SEP_CHAR)
+    {
+        s_path = s_path.substr(0,s_path.length()-1);
+    }
+    else
+    {
+        if (s_path.find_last_of(DIR_SEP_CHAR) > 0)
+        {
+            s_path = s_path.substr(0,s_path.find_last_of(DIR_SEP_CHAR));
+        }
+    }
+
+    DIR *p_src_dir = vlc_opendir(s_path.c_str());
+    if (p_src_dir == NULL)
+        return;
+
+    std::vector<preload_file_t> files;
+    const char *psz_file;
+    while ((psz_file = vlc_readdir(p_src_dir)) != NULL)
+    {
+        if (strlen(psz_file) <= 4)
+            continue;
+
+        s_filename = s_path + DIR_SEP_CHAR + psz_file;
+
+#if defined(_WIN32) || defined(__OS2__)
+        if (!strcasecmp(s_filename.c_str(), p_demux->psz_file))
+#else
+        if (!s_filename.compare(p_demux->psz_file))
+#endif
+        {
+            continue; // don't reuse the original opened file
+        }
+
+        if (s_filename.compare(s_filename.length() - 3, 3, "mkv") &&
+            s_filename.compare(s_filename.length() - 3, 3, "mka"))
+            continue;
+
+        preload_file_t file;
+        struct stat st;
+
+        file.name = psz_file;
+        file.path = s_filename;
+        file.b_stat = vlc_stat( s_filename.c_str(), &st ) == 0;
+        file.i_size = file.b_stat ? st.st_size : 0;
+        file.i_mtime = file.b_stat ? st.st_mtime : 0;
+        file.b_known = file.b_linked = file.b_done = file.b_opened = false;
+        file.links.b_matroska = false;
+        file.p_stream = NULL;
+        files.push_back( file );
+    }
+    closedir( p_src_dir );
+
+    /* what was found in this directory before */
+    vlc_mutex_lock( &links_lock );
+    std::map<std::string, dir_links_t>::const_iterator dir = links_cache.find( s_path );
+    if( dir != links_cache.end() )
+    {
+        for( size_t i = 0; i < files.size(); i++ )
+        {
+            dir_links_t::const_iterator it = dir->second.find( files[i].name );
+            if( files[i].b_stat && it != dir->second.end() &&
+                it->second.i_size == files[i].i_size &&
+                it->second.i_mtime == files[i].i_mtime )
+            {
+                files[i].links = it->second;
+                files[i].b_known = true;
+            }
+        }
+    }
+    vlc_mutex_unlock( &links_lock );
+
+    wanted_links_c wanted( stream );
+    size_t i_skipped = 0;
+
+    for( ;; )
+    {
+        /* known files only need to be opened if they are linked, which
+         * newly opened files can change */
+        bool b_changed;
+        do
+        {
+            b_changed = false;
+            for( size_t i = 0; i < files.size(); i++ )
+            {
+                if( files[i].b_known && !files[i].b_linked && files[i].links.b_matroska &&
+                    wanted.match( files[i].links.segments ) )
+                    b_changed = files[i].b_linked = true;
+            }
+        } while( b_changed );
+
+        std::vector<preload_file_t *> batch;
+        for( size_t i = 0; i < files.size(); i++ )
+        {
+            if( !files[i].b_done && ( !files[i].b_known || files[i].b_linked ) )
+            {
+                files[i].b_done = true;
+                batch.push_back( &files[i] );
+            }
+        }
+        if( batch.empty() )
+            break;
+
+        OpenFiles( sys, batch );
+
+        for( size_t i = 0; i < batch.size(); i++ )
+        {
+            if( !batch[i]->b_known && wanted.match( batch[i]->links.segments ) )
+                batch[i]->b_linked = true;
+            batch[i]->b_known = true;
+        }
+    }
+
+    /* keep the directory order */
+    dir_links_t links;
+    for( size_t i = 0; i < files.size(); i++ )
+    {
+        preload_file_t & file = files[i];
+
+        if( file.p_stream != NULL )
+            sys.streams.push_back( file.p_stream );
+
+        if( !file.b_done )
+            i_skipped++;
+        else if( !file.b_opened || !file.b_stat )
+            continue;
+
+        file.links.i_size = file.i_size;
+        file.links.i_mtime = file.i_mtime;
+        links[file.name] = file.links;
+    }
+
+    msg_Dbg( p_demux, "%zu files of the directory are not linked", i_skipped );
+
+    vlc_mutex_lock( &links_lock );
+    if( links_cache.size() >= MKV_LINKS_CACHE_DIRS && !links_cache.count( s_path ) )
+        links_cache.erase( links_cache.begin() );
+    links_cache[s_path] = links;
+    vlc_mutex_unlock( &links_lock );
+}
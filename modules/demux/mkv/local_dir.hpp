@@ -0,0 +1,34 @@
+/*****************************************************************************
+ * local_dir.hpp : matroska demuxer
+ *****************************************************************************
+ * Copyright (C) 2003-2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_MKV_LOCAL_DIR_HPP_
+#define VLC_MKV_LOCAL_DIR_HPP_
+
+#include "mkv.hpp"
+
+/* Opens the Matroska files of the directory of the demuxed file, several
+ * at a time, and adds the ones with segments to the streams of the demuxer.
+ *
+ * The segment links (UIDs, previous/next UIDs and families) of the files
+ * are remembered per directory. Unchanged files which are known not to
+ * be linked to the segments of the opened stream are not opened again. */
+void PreloadLocalDir( demux_sys_t & sys, const matroska_stream_c & stream );
+
+#endif
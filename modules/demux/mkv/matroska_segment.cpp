@@ -27,6 +27,7 @@
 #include "demux.hpp"
 #include "util.hpp"
 #include "Ebml_parser.hpp"
+#include "stream_io_callback.hpp"
 
 #include <new>
 
@@ -52,8 +53,9 @@ matroska_segment_c::matroska_segment_c( demux_sys_t & demuxer, EbmlStream & estr
     ,p_prev_segment_uid(NULL)
     ,p_next_segment_uid(NULL)
     ,b_cues(false)
-    ,i_index(0)
-    ,i_index_max(1024)
+    ,p_indexer_interrupt(NULL)
+    ,psz_indexer_url(NULL)
+    ,b_clusters_indexed(false)
     ,psz_muxing_application(NULL)
     ,psz_writing_application(NULL)
     ,psz_segment_filename(NULL)
@@ -65,14 +67,16 @@ matroska_segment_c::matroska_segment_c( demux_sys_t & demuxer, EbmlStream & estr
     ,b_preloaded(false)
     ,b_ref_external_segments(false)
 {
-    p_indexes = (mkv_index_t*)malloc( sizeof( mkv_index_t ) * i_index_max );
 }
 
 matroska_segment_c::~matroska_segment_c()
 {
+    StopIndexer();
+
     for( size_t i_track = 0; i_track < tracks.size(); i_track++ )
     {
         delete tracks[i_track]->p_compression_data;
+        TrackReleaseBuffers( tracks[i_track] );
         es_format_Clean( &tracks[i_track]->fmt );
         delete tracks[i_track]->p_sys;
         free( tracks[i_track]->p_extra_data );
@@ -85,7 +89,6 @@ matroska_segment_c::~matroska_segment_c()
     free( psz_segment_filename );
     free( psz_title );
     free( psz_date_utc );
-    free( p_indexes );
 
     delete ep;
     delete segment;
@@ -103,22 +106,39 @@ matroska_segment_c::~matroska_segment_c()
 /*****************************************************************************
  * Tools                                                                     *
  *****************************************************************************
- *  * LoadCues : load the cues element and update index
+ *  * LoadCues : load the cues element on first use
+ *  * ParseCues : parse the cues element and update index
  *  * LoadTags : load ... the tags element
  *  * InformationCreate : create all information, load tags if present
  *****************************************************************************/
-void matroska_segment_c::LoadCues( KaxCues *cues )
+bool matroska_segment_c::LoadCues()
+{
+    if( b_cues || i_cues_position < 0 )
+        return b_cues;
+
+    int64_t i_sav_position = (int64_t)es.I_O().getFilePointer();
+
+    es.I_O().setFilePointer( i_cues_position, seek_beginning );
+    EbmlElement *el = es.FindNextID( EBML_INFO(KaxCues), 0xFFFFFFFFL );
+    if( el != NULL && MKV_IS_ID( el, KaxCues ) )
+        ParseCues( static_cast<KaxCues*>( el ) );
+    else
+        msg_Err( &sys.demuxer, "cannot load cues (broken seekhead or file)" );
+    delete el;
+
+    es.I_O().setFilePointer( i_sav_position, seek_beginning );
+
+    /* don't try again on each seek */
+    b_cues = true;
+    return b_cues;
+}
+
+void matroska_segment_c::ParseCues( KaxCues *cues )
 {
     bool b_invalid_cue;
     EbmlParser  *ep;
     EbmlElement *el;
 
-    if( b_cues )
-    {
-        msg_Err( &sys.demuxer, "There can be only 1 Cues per section." );
-        return;
-    }
-
     ep = new EbmlParser( &es, cues, &sys.demuxer,
                          var_InheritBool( &sys.demuxer, "mkv-use-dummy" ) );
     while( ( el = ep->Get() ) != NULL )
@@ -126,7 +146,7 @@ void matroska_segment_c::LoadCues( KaxCues *cues )
         if( MKV_IS_ID( el, KaxCuePoint ) )
         {
             b_invalid_cue = false;
-#define idx p_indexes[i_index]
+            mkv_index_t idx;
 
             idx.i_track       = -1;
             idx.i_block_number= -1;
@@ -231,16 +251,7 @@ void matroska_segment_c::LoadCues( KaxCues *cues )
                      idx.i_track, idx.i_block_number );
 #endif
             if( likely( !b_invalid_cue ) )
-            {
-                i_index++;
-                if( i_index >= i_index_max )
-                {
-                    i_index_max += 1024;
-                    p_indexes = (mkv_index_t*)xrealloc( p_indexes,
-                                                        sizeof( mkv_index_t ) * i_index_max );
-                }
-            }
-#undef idx
+                index.insert( idx );
         }
         else
         {
@@ -248,8 +259,7 @@ void matroska_segment_c::LoadCues( KaxCues *cues )
         }
     }
     delete ep;
-    b_cues = true;
-    msg_Dbg( &sys.demuxer, "|   - loading cues done." );
+    msg_Dbg( &sys.demuxer, "|   - loading %zu cues done.", index.count() );
 }
 
 
@@ -596,21 +606,188 @@ void matroska_segment_c::InformationCreate( )
 
 void matroska_segment_c::IndexAppendCluster( KaxCluster *cluster )
 {
-#define idx p_indexes[i_index]
-    idx.i_track       = -1;
+    /* the cues already cover this cluster */
+    if( b_cues && index.lastPosition() >= (int64_t)cluster->GetElementPosition() )
+        return;
+
+    mkv_index_t idx;
+    idx.i_track       = cues_index_c::ANY_TRACK;
     idx.i_block_number= -1;
     idx.i_position    = cluster->GetElementPosition();
     idx.i_mk_time     = cluster->GlobalTimecode() / INT64_C(1000);
     idx.b_key         = true;
 
-    i_index++;
-    if( i_index >= i_index_max )
+    index.insert( idx );
+}
+
+/* Files without cues are indexed in the background, on a stream of their
+ * own, so that seeking does not have to parse all the clusters up to the
+ * requested position. Seeks use what was already indexed. */
+void matroska_segment_c::StartIndexer( const char *psz_url )
+{
+    if( p_indexer_interrupt != NULL || i_cues_position >= 0 || cluster == NULL ||
+        b_clusters_indexed )
+        return;
+
+    psz_indexer_url = strdup( psz_url );
+    if( unlikely( psz_indexer_url == NULL ) )
+        return;
+
+    p_indexer_interrupt = vlc_interrupt_create();
+    if( unlikely( p_indexer_interrupt == NULL ) ||
+        vlc_clone( &indexer_thread, IndexerThread, this, VLC_THREAD_PRIORITY_LOW ) )
+    {
+        msg_Warn( &sys.demuxer, "cannot start the cluster indexer" );
+        if( p_indexer_interrupt )
+            vlc_interrupt_destroy( p_indexer_interrupt );
+        p_indexer_interrupt = NULL;
+        free( psz_indexer_url );
+        psz_indexer_url = NULL;
+    }
+}
+
+void matroska_segment_c::StopIndexer()
+{
+    if( p_indexer_interrupt == NULL )
+        return;
+
+    vlc_interrupt_kill( p_indexer_interrupt );
+    vlc_join( indexer_thread, NULL );
+    vlc_interrupt_destroy( p_indexer_interrupt );
+    p_indexer_interrupt = NULL;
+    free( psz_indexer_url );
+    psz_indexer_url = NULL;
+}
+
+void *matroska_segment_c::IndexerThread( void *p_data )
+{
+    matroska_segment_c *p_segment = static_cast<matroska_segment_c *>( p_data );
+
+    vlc_interrupt_set( p_segment->p_indexer_interrupt );
+    p_segment->IndexClusters();
+    return NULL;
+}
+
+void matroska_segment_c::IndexClusters()
+{
+    stream_t *p_stream = stream_UrlNew( &sys.demuxer, psz_indexer_url );
+    if( p_stream == NULL )
+    {
+        msg_Warn( &sys.demuxer, "cannot open %s for indexing", psz_indexer_url );
+        return;
+    }
+
+    vlc_stream_io_callback io_callback( p_stream, true );
+    EbmlStream estream( io_callback );
+
+    /* start from what was already indexed while playing or seeking */
+    int64_t i_position = index.lastPosition();
+    io_callback.setFilePointer( i_position >= 0 ? i_position : i_start_pos,
+                                seek_beginning );
+
+    EbmlParser parser( &estream, segment, &sys.demuxer,
+                       var_InheritBool( &sys.demuxer, "mkv-use-dummy" ) );
+    EbmlElement *el;
+    size_t i_clusters = 0;
+    bool b_complete = false;
+
+    try
+    {
+        while( !vlc_killed() && ( el = parser.Get() ) != NULL )
+        {
+            if( MKV_IS_ID( el, KaxCluster ) )
+            {
+                KaxCluster *p_cluster = static_cast<KaxCluster *>( el );
+
+                ParseCluster( p_cluster, false, SCOPE_NO_DATA, &estream );
+                IndexAppendCluster( p_cluster );
+                i_clusters++;
+            }
+        }
+        b_complete = !vlc_killed();
+    }
+    catch(...)
+    {
+        msg_Err( &sys.demuxer, "Error while indexing clusters" );
+    }
+
+    msg_Dbg( &sys.demuxer, "indexed %zu clusters%s", i_clusters,
+             vlc_killed() ? " (interrupted)" : "" );
+
+    /* only read once the thread is joined */
+    b_clusters_indexed = b_complete;
+}
+
+/* Seek index cache record of a segment, see index_cache.h. The points are
+ * stored by track and time, as returned by cues_index_c::copyTo(). */
+#define MKV_INDEX_CACHE_CUES     0x01 /* the Cues were loaded */
+#define MKV_INDEX_CACHE_CLUSTERS 0x02 /* all the clusters were indexed */
+
+struct mkv_index_cache_t
+{
+    int64_t  i_segment_position;
+    uint32_t i_flags;
+    uint32_t i_points;
+};
+
+struct mkv_index_cache_point_t
+{
+    int64_t i_position;
+    int64_t i_mk_time;
+    int32_t i_track;
+    int32_t i_block_number;
+};
+
+bool matroska_segment_c::RestoreIndex( const void *p_data, size_t i_size )
+{
+    const mkv_index_cache_t *p_header = static_cast<const mkv_index_cache_t *>( p_data );
+
+    if( i_size < sizeof( *p_header ) ||
+        p_header->i_segment_position != (int64_t)segment->GetElementPosition() ||
+        p_header->i_points > ( i_size - sizeof( *p_header ) ) / sizeof( mkv_index_cache_point_t ) )
+        return false;
+
+    const mkv_index_cache_point_t *p_points =
+        reinterpret_cast<const mkv_index_cache_point_t *>( &p_header[1] );
+
+    for( uint32_t i = 0; i < p_header->i_points; i++ )
     {
-        i_index_max += 1024;
-        p_indexes = (mkv_index_t*)xrealloc( p_indexes,
-                                        sizeof( mkv_index_t ) * i_index_max );
+        mkv_index_t idx;
+        idx.i_track       = p_points[i].i_track;
+        idx.i_block_number= p_points[i].i_block_number;
+        idx.i_position    = p_points[i].i_position;
+        idx.i_mk_time     = p_points[i].i_mk_time;
+        idx.b_key         = true;
+
+        index.insert( idx );
+    }
+
+    b_cues = ( p_header->i_flags & MKV_INDEX_CACHE_CUES ) != 0;
+    b_clusters_indexed = ( p_header->i_flags & MKV_INDEX_CACHE_CLUSTERS ) != 0;
+    return true;
+}
+
+void matroska_segment_c::SaveIndex( std::vector<uint8_t> & data ) const
+{
+    std::vector<mkv_index_t> points;
+    index.copyTo( points );
+
+    data.resize( sizeof( mkv_index_cache_t ) + points.size() * sizeof( mkv_index_cache_point_t ) );
+
+    mkv_index_cache_t *p_header = reinterpret_cast<mkv_index_cache_t *>( &data[0] );
+    p_header->i_segment_position = segment->GetElementPosition();
+    p_header->i_flags = ( b_cues ? MKV_INDEX_CACHE_CUES : 0 ) |
+                        ( b_clusters_indexed ? MKV_INDEX_CACHE_CLUSTERS : 0 );
+    p_header->i_points = points.size();
+
+    mkv_index_cache_point_t *p_points = reinterpret_cast<mkv_index_cache_point_t *>( &p_header[1] );
+    for( size_t i = 0; i < points.size(); i++ )
+    {
+        p_points[i].i_position     = points[i].i_position;
+        p_points[i].i_mk_time      = points[i].i_mk_time;
+        p_points[i].i_track        = points[i].i_track;
+        p_points[i].i_block_number = points[i].i_block_number;
     }
-#undef idx
 }
 
 bool matroska_segment_c::PreloadFamily( const matroska_segment_c & of_segment )
@@ -707,11 +884,9 @@ bool matroska_segment_c::Preload( )
         else if( MKV_IS_ID( el, KaxCues ) )
         {
             msg_Dbg(  &sys.demuxer, "|   + Cues" );
+            /* loaded on the first seek */
             if( i_cues_position < 0 )
-            {
-                LoadCues( static_cast<KaxCues*>( el ) );
                 i_cues_position = el->GetElementPosition();
-            }
         }
         else if( MKV_IS_ID( el, KaxCluster ) )
         {
@@ -825,11 +1000,9 @@ bool matroska_segment_c::LoadSeekHeadItem( const EbmlCallbacks & ClassInfos, int
     else if( MKV_IS_ID( el, KaxCues ) )
     {
         msg_Dbg( &sys.demuxer, "|   + Cues" );
+        /* loaded on the first seek */
         if( i_cues_position < 0 )
-        {
-            LoadCues( static_cast<KaxCues*>( el ) );
             i_cues_position = i_element_position;
-        }
     }
     else if( MKV_IS_ID( el, KaxAttachments ) )
     {
@@ -903,11 +1076,10 @@ void matroska_segment_c::Seek( mtime_t i_mk_date, mtime_t i_mk_time_offset, int6
         EbmlElement *el = NULL;
 
         /* Start from the last known index instead of the beginning eachtime */
-        if( i_index == 0)
+        if( index.empty() )
             es.I_O().setFilePointer( i_start_pos, seek_beginning );
         else
-            es.I_O().setFilePointer( p_indexes[ i_index - 1 ].i_position,
-                                     seek_beginning );
+            es.I_O().setFilePointer( index.lastPosition(), seek_beginning );
         delete ep;
         ep = new EbmlParser( &es, segment, &sys.demuxer,
                              var_InheritBool( &sys.demuxer, "mkv-use-dummy" ) );
@@ -919,9 +1091,7 @@ void matroska_segment_c::Seek( mtime_t i_mk_date, mtime_t i_mk_time_offset, int6
             {
                 cluster = (KaxCluster *)el;
                 i_cluster_pos = cluster->GetElementPosition();
-                if( i_index == 0 ||
-                    ( i_index > 0 &&
-                      p_indexes[i_index - 1].i_position < (int64_t)cluster->GetElementPosition() ) )
+                if( index.lastPosition() < (int64_t)cluster->GetElementPosition() )
                 {
                     ParseCluster( cluster, false, SCOPE_NO_DATA );
                     IndexAppendCluster( cluster );
@@ -948,19 +1118,27 @@ void matroska_segment_c::Seek( mtime_t i_mk_date, mtime_t i_mk_time_offset, int6
         return;
     }
 
-    int i_idx = 0;
-    if ( i_index > 0 )
-    {
-
-        for( ; i_idx < i_index; i_idx++ )
-            if( p_indexes[i_idx].i_mk_time != -1 && p_indexes[i_idx].i_mk_time + i_mk_time_offset > i_mk_date )
-                break;
+    LoadCues();
 
-        if( i_idx > 0 )
-            i_idx--;
+    /* use the cues of the track we will look for a key frame in */
+    int i_seek_track = cues_index_c::ANY_TRACK;
+    for( size_t i = 0; i < tracks.size(); i++ )
+    {
+        if( tracks[i]->fmt.i_cat == VIDEO_ES )
+        {
+            i_seek_track = tracks[i]->i_number;
+            break;
+        }
+        if( tracks[i]->fmt.i_cat == AUDIO_ES && i_seek_track == cues_index_c::ANY_TRACK )
+            i_seek_track = tracks[i]->i_number;
+    }
 
-        i_seek_position = p_indexes[i_idx].i_position;
-        i_mk_seek_time = p_indexes[i_idx].i_mk_time;
+    mkv_index_t seekpoint;
+    bool b_seekpoint = index.findByTime( i_seek_track, i_mk_date - i_mk_time_offset, &seekpoint );
+    if ( b_seekpoint )
+    {
+        i_seek_position = seekpoint.i_position;
+        i_mk_seek_time = seekpoint.i_mk_time;
     }
 
     msg_Dbg( &sys.demuxer, "seek got %" PRId64 " - %" PRId64, i_mk_seek_time, i_seek_position );
@@ -1080,14 +1258,14 @@ void matroska_segment_c::Seek( mtime_t i_mk_date, mtime_t i_mk_time_offset, int6
 
             delete block;
         } while( i_mk_pts < i_mk_date );
-        if( b_has_key || !i_idx )
+        if( b_has_key || !b_seekpoint )
             break;
 
         /* No key picture was found in the cluster seek to previous seekpoint */
-        i_mk_date = i_mk_time_offset + p_indexes[i_idx].i_mk_time;
-        i_idx--;
+        i_mk_date = i_mk_time_offset + seekpoint.i_mk_time;
+        b_seekpoint = index.findByTime( i_seek_track, seekpoint.i_mk_time - 1, &seekpoint );
         i_mk_pts = 0;
-        es.I_O().setFilePointer( p_indexes[i_idx].i_position );
+        es.I_O().setFilePointer( b_seekpoint ? seekpoint.i_position : i_start_pos );
         delete ep;
         ep = new EbmlParser( &es, segment, &sys.demuxer,
                              var_InheritBool( &sys.demuxer, "mkv-use-dummy" ) );
@@ -1199,6 +1377,62 @@ void matroska_segment_c::ComputeTrackPriority()
     }
 }
 
+/* Look for the last Cluster ID near the end of the segment, which avoids
+ * walking all the clusters of files without cues. Returns 0 if not found. */
+uint64 matroska_segment_c::FindLastCluster()
+{
+    static const uint8_t cluster_id[4] = { 0x1F, 0x43, 0xB6, 0x75 };
+    static const uint8_t timecode_id = 0xE7;
+    const int64_t i_window = INT64_C(4) << 20;
+
+    int64_t i_end = segment->IsFiniteSize()
+                  ? (int64_t)segment->GetGlobalPosition( segment->GetSize() )
+                  : stream_Size( sys.demuxer.s );
+    int64_t i_begin = __MAX( i_start_pos, i_end - i_window );
+    if( i_end - i_begin < 4 )
+        return 0;
+
+    size_t i_data = i_end - i_begin;
+    uint8_t *p_data = (uint8_t *) malloc( i_data );
+    if( unlikely( p_data == NULL ) )
+        return 0;
+
+    es.I_O().setFilePointer( i_begin, seek_beginning );
+    i_data = es.I_O().read( p_data, i_data );
+
+    uint64 i_last_cluster_pos = 0;
+    for( size_t i = i_data; i >= 4 && !i_last_cluster_pos; i-- )
+    {
+        if( memcmp( &p_data[i - 4], cluster_id, 4 ) )
+            continue;
+
+        /* the ID may be found inside frames: check the Cluster size fits
+         * in the segment and the first child is the Cluster Timecode */
+        if( i >= i_data || p_data[i] == 0 )
+            continue;
+        unsigned i_len = 1;
+        while( !( p_data[i] & ( 0x80 >> ( i_len - 1 ) ) ) )
+            i_len++;
+        if( i + i_len >= i_data )
+            continue;
+
+        uint64 i_size = p_data[i] & ( 0xFF >> i_len );
+        for( unsigned j = 1; j < i_len; j++ )
+            i_size = ( i_size << 8 ) | p_data[i + j];
+        if( i_size == ( UINT64_C(1) << ( 7 * i_len ) ) - 1 ) /* unknown size */
+            continue;
+
+        uint64 i_pos = i_begin + i - 4;
+        if( i_size > (uint64)i_end - ( i_pos + 4 + i_len ) ||
+            p_data[i + i_len] != timecode_id )
+            continue;
+        i_last_cluster_pos = i_pos;
+    }
+    free( p_data );
+
+    return i_last_cluster_pos;
+}
+
 void matroska_segment_c::EnsureDuration()
 {
     if ( i_duration > 0 )
@@ -1218,10 +1452,16 @@ void matroska_segment_c::EnsureDuration()
     uint64 i_current_position = es.I_O().getFilePointer();
     uint64 i_last_cluster_pos = 0;
 
-    // find the last Cluster from the Cues
-    if ( b_cues && i_index > 0 && p_indexes != NULL)
+    // find the last Cluster from the Cues or a complete clusters index
+    if ( ( LoadCues() || b_clusters_indexed ) && !index.empty() )
+    {
+        i_last_cluster_pos = index.lastPosition();
+    }
+
+    // find the last Cluster from the end of the segment
+    if ( !i_last_cluster_pos && cluster != NULL )
     {
-        i_last_cluster_pos = p_indexes[i_index-1].i_position;
+        i_last_cluster_pos = FindLastCluster();
     }
 
     // find the last Cluster manually
@@ -1423,17 +1663,6 @@ int matroska_segment_c::BlockGet( KaxBlock * & pp_block, KaxSimpleBlock * & pp_s
                 }
             }
 
-            /* update the index */
-#define idx p_indexes[i_index - 1]
-            if( i_index > 0 && idx.i_mk_time == -1 )
-            {
-                if ( pp_simpleblock != NULL )
-                    idx.i_mk_time = pp_simpleblock->GlobalTimecode() / INT64_C(1000);
-                else
-                    idx.i_mk_time = (*pp_block).GlobalTimecode() / INT64_C(1000);
-                idx.b_key         = *pb_key_picture;
-            }
-#undef idx
             return VLC_SUCCESS;
         }
 
@@ -1509,10 +1738,7 @@ int matroska_segment_c::BlockGet( KaxBlock * & pp_block, KaxSimpleBlock * & pp_s
                         cluster->InitTimecode( uint64( ctc ), i_timescale );
 
                         /* add it to the index */
-                        if( i_index == 0 ||
-                            ( i_index > 0 &&
-                              p_indexes[i_index - 1].i_position < (int64_t)cluster->GetElementPosition() ) )
-                            IndexAppendCluster( cluster );
+                        IndexAppendCluster( cluster );
                     }
                     else if( MKV_IS_ID( el, KaxClusterSilentTracks ) )
                     {
@@ -26,6 +26,9 @@
 #define VLC_MKV_MATROSKA_SEGMENT_HPP_
 
 #include "mkv.hpp"
+#include "cues_index.hpp"
+
+#include <vlc_interrupt.h>
 
 class EbmlParser;
 
@@ -107,9 +110,13 @@ public:
     KaxNextUID              *p_next_segment_uid;
 
     bool                    b_cues;
-    int                     i_index;
-    int                     i_index_max;
-    mkv_index_t             *p_indexes;
+    cues_index_c            index;
+
+    /* background indexing of the clusters of files without cues */
+    vlc_thread_t            indexer_thread;
+    vlc_interrupt_t         *p_indexer_interrupt;
+    char                    *psz_indexer_url;
+    bool                    b_clusters_indexed;
 
     /* info */
     char                    *psz_muxing_application;
@@ -136,6 +143,11 @@ public:
     bool Preload();
     bool PreloadFamily( const matroska_segment_c & segment );
     void InformationCreate();
+    bool LoadCues();
+    void StartIndexer( const char *psz_url );
+    void StopIndexer();
+    bool RestoreIndex( const void *p_data, size_t i_size );
+    void SaveIndex( std::vector<uint8_t> & data ) const;
     void Seek( mtime_t i_mk_date, mtime_t i_mk_time_offset, int64_t i_global_position );
     int BlockGet( KaxBlock * &, KaxSimpleBlock * &, bool *, bool *, int64_t *);
 
@@ -148,7 +160,7 @@ public:
     static bool CompareSegmentUIDs( const matroska_segment_c * item_a, const matroska_segment_c * item_b );
 
 private:
-    void LoadCues( KaxCues *cues );
+    void ParseCues( KaxCues *cues );
     void LoadTags( KaxTags *tags );
     bool LoadSeekHeadItem( const EbmlCallbacks & ClassInfos, int64_t i_element_position );
     void ParseInfo( KaxInfo *info );
@@ -158,9 +170,13 @@ private:
     void ParseTracks( KaxTracks *tracks );
     void ParseChapterAtom( int i_level, KaxChapterAtom *ca, chapter_item_c & chapters );
     void ParseTrackEntry( KaxTrackEntry *m );
-    void ParseCluster( KaxCluster *cluster, bool b_update_start_time = true, ScopeMode read_fully = SCOPE_ALL_DATA );
+    void ParseCluster( KaxCluster *cluster, bool b_update_start_time = true, ScopeMode read_fully = SCOPE_ALL_DATA,
+                       EbmlStream *p_es = NULL );
     SimpleTag * ParseSimpleTags( KaxTagSimple *tag, int level = 50 );
     void IndexAppendCluster( KaxCluster *cluster );
+    static void *IndexerThread( void * );
+    void IndexClusters();
+    uint64 FindLastCluster();
     int32_t TrackInit( mkv_track_t * p_tk );
     void ComputeTrackPriority();
     void EnsureDuration();
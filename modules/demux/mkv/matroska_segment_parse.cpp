@@ -144,7 +144,9 @@ void matroska_segment_c::ParseSeekHead( KaxSeekHead *seekhead )
                 if( id == EBML_ID(KaxCues) )
                 {
                     msg_Dbg( &sys.demuxer, "|   - cues at %" PRId64, i_pos );
-                    LoadSeekHeadItem( EBML_INFO(KaxCues), i_pos );
+                    /* loaded on the first seek */
+                    if( i_cues_position < 0 )
+                        i_cues_position = i_pos;
                 }
                 else if( id == EBML_ID(KaxInfo) )
                 {
@@ -255,6 +257,11 @@ void matroska_segment_c::ParseTrackEntry( KaxTrackEntry *m )
     tk->i_compression_type     = MATROSKA_COMPRESSION_NONE;
     tk->i_encoding_scope       = MATROSKA_ENCODING_SCOPE_ALL_FRAMES;
     tk->p_compression_data     = NULL;
+#ifdef HAVE_ZLIB_H
+    tk->p_zstream              = NULL;
+    tk->i_inflated_size        = 0;
+#endif
+    tk->p_block_pool           = NULL;
 
     msg_Dbg( &sys.demuxer, "|   |   + Track Entry" );
 
@@ -1255,7 +1262,8 @@ void matroska_segment_c::ParseChapters( KaxChapters *chapters )
     }
 }
 
-void matroska_segment_c::ParseCluster( KaxCluster *cluster, bool b_update_start_time, ScopeMode read_fully )
+void matroska_segment_c::ParseCluster( KaxCluster *cluster, bool b_update_start_time, ScopeMode read_fully,
+                                       EbmlStream *p_es )
 {
     EbmlElement *el;
     EbmlMaster  *m;
@@ -1270,7 +1278,7 @@ void matroska_segment_c::ParseCluster( KaxCluster *cluster, bool b_update_start_
     }
     try
     {
-        m->Read( es, EBML_CONTEXT(cluster), i_upper_level, el, true, read_fully );
+        m->Read( p_es ? *p_es : es, EBML_CONTEXT(cluster), i_upper_level, el, true, read_fully );
     }
     catch(...)
     {
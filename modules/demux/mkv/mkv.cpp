@@ -32,6 +32,7 @@
 #include "Ebml_parser.hpp"
 
 #include "stream_io_callback.hpp"
+#include "local_dir.hpp"
 
 #include <new>
 
@@ -39,9 +40,6 @@ extern "C" {
 #include "../../modules/codec/dts_header.h"
 }
 
-#include <vlc_fs.h>
-#include <vlc_url.h>
-
 /*****************************************************************************
  * Module descriptor
  *****************************************************************************/
@@ -76,6 +74,14 @@ vlc_module_begin ()
             N_("Dummy Elements"),
             N_("Read and discard unknown EBML elements (not good for broken files)."), true );
 
+    add_bool( "mkv-index-clusters", true,
+            N_("Index files without cues"),
+            N_("Index the clusters of files without cues in the background, for faster seeking."), true );
+
+    add_bool( "mkv-index-cache", false,
+            N_("Cache the seek index"),
+            N_("Keep the seek index of local files in the cache directory, so that it does not have to be rebuilt when opening them again."), true );
+
     add_shortcut( "mka", "mkv" )
 vlc_module_end ()
 
@@ -85,6 +91,9 @@ static int  Demux  ( demux_t * );
 static int  Control( demux_t *, int, va_list );
 static void Seek   ( demux_t *, mtime_t i_mk_date, double f_percent, virtual_chapter_c *p_chapter );
 
+static void LoadIndexCache( demux_t *, matroska_stream_c * );
+static void SaveIndexCache( demux_t * );
+
 /*****************************************************************************
  * Open: initializes matroska demux structures
  *****************************************************************************/
@@ -95,7 +104,6 @@ static int Open( vlc_object_t * p_this )
     matroska_stream_c  *p_stream;
     matroska_segment_c *p_segment;
     const uint8_t      *p_peek;
-    std::string         s_path, s_filename;
     vlc_stream_io_callback *p_io_callback;
     EbmlStream         *p_io_stream;
     bool                b_need_preload = false;
@@ -134,6 +142,9 @@ static int Open( vlc_object_t * p_this )
     p_stream->p_io_callback = p_io_callback;
     p_stream->p_estream = p_io_stream;
 
+    if( var_InheritBool( p_demux, "mkv-index-cache" ) )
+        LoadIndexCache( p_demux, p_stream );
+
     for (size_t i=0; i<p_stream->segments.size(); i++)
     {
         p_stream->segments[i]->Preload();
@@ -147,97 +158,27 @@ static int Open( vlc_object_t * p_this )
         goto error;
     }
 
+    if( var_InheritBool( p_demux, "mkv-index-clusters" ) )
+    {
+        bool b_seekable;
+        char *psz_url;
+
+        if( stream_Control( p_demux->s, STREAM_CAN_SEEK, &b_seekable ) == VLC_SUCCESS &&
+            b_seekable &&
+            asprintf( &psz_url, "%s://%s", p_demux->psz_access, p_demux->psz_location ) != -1 )
+        {
+            for (size_t i=0; i<p_stream->segments.size(); i++)
+                p_stream->segments[i]->StartIndexer( psz_url );
+            free( psz_url );
+        }
+    }
+
     if (b_need_preload && var_InheritBool( p_demux, "mkv-preload-local-dir" ))
     {
         msg_Dbg( p_demux, "Preloading local dir" );
         /* get the files from the same dir from the same family (based on p_demux->psz_path) */
         if ( p_demux->psz_file && !strcmp( p_demux->psz_access, "file" ) )
-        {
-            // assume it's a regular file
-            // get the directory path
-            s_path = p_demux->psz_file;
-            if (s_path.at(s_path.length() - 1) == DIR_SEP_CHAR)
-            {
-                s_path = s_path.substr(0,s_path.length()-1);
-            }
-            else
-            {
-                if (s_path.find_last_of(DIR_SEP_CHAR) > 0)
-                {
-                    s_path = s_path.substr(0,s_path.find_last_of(DIR_SEP_CHAR));
-                }
-            }
-
-            DIR *p_src_dir = vlc_opendir(s_path.c_str());
-
-            if (p_src_dir != NULL)
-            {
-                const char *psz_file;
-                while ((psz_file = vlc_readdir(p_src_dir)) != NULL)
-                {
-                    if (strlen(psz_file) > 4)
-                    {
-                        s_filename = s_path + DIR_SEP_CHAR + psz_file;
-
-#if defined(_WIN32) || defined(__OS2__)
-                        if (!strcasecmp(s_filename.c_str(), p_demux->psz_file))
-#else
-                        if (!s_filename.compare(p_demux->psz_file))
-#endif
-                        {
-                            continue; // don't reuse the original opened file
-                        }
-
-                        if (!s_filename.compare(s_filename.length() - 3, 3, "mkv") ||
-                            !s_filename.compare(s_filename.length() - 3, 3, "mka"))
-                        {
-                            // test whether this file belongs to our family
-                            const uint8_t *p_peek;
-                            bool          file_ok = false;
-                            char          *psz_url = vlc_path2uri( s_filename.c_str(), "file" );
-                            stream_t      *p_file_stream = stream_UrlNew(
-                                                            p_demux,
-                                                            psz_url );
-                            /* peek the begining */
-                            if( p_file_stream &&
-                                stream_Peek( p_file_stream, &p_peek, 4 ) >= 4
-                                && p_peek[0] == 0x1a && p_peek[1] == 0x45 &&
-                                p_peek[2] == 0xdf && p_peek[3] == 0xa3 ) file_ok = true;
-
-                            if ( file_ok )
-                            {
-                                vlc_stream_io_callback *p_file_io = new vlc_stream_io_callback( p_file_stream, true );
-                                EbmlStream *p_estream = new EbmlStream(*p_file_io);
-
-                                p_stream = p_sys->AnalyseAllSegmentsFound( p_demux, p_estream );
-
-                                if ( p_stream == NULL )
-                                {
-                                    msg_Dbg( p_demux, "the file '%s' will not be used", s_filename.c_str() );
-                                    delete p_estream;
-                                    delete p_file_io;
-                                }
-                                else
-                                {
-                                    p_stream->p_io_callback = p_file_io;
-                                    p_stream->p_estream = p_estream;
-                                    p_sys->streams.push_back( p_stream );
-                                }
-                            }
-                            else
-                            {
-                                if( p_file_stream ) {
-                                    stream_Delete( p_file_stream );
-                                }
-                                msg_Dbg( p_demux, "the file '%s' cannot be opened", s_filename.c_str() );
-                            }
-                            free( psz_url );
-                        }
-                    }
-                }
-                closedir( p_src_dir );
-            }
-        }
+            PreloadLocalDir( *p_sys, *p_stream );
 
         p_sys->PreloadFamily( *p_segment );
     }
@@ -258,6 +199,8 @@ static int Open( vlc_object_t * p_this )
     return VLC_SUCCESS;
 
 error:
+    if( p_sys->p_index_cache )
+        index_cache_Close( p_sys->p_index_cache );
     delete p_sys;
     return VLC_EGENERIC;
 }
@@ -277,9 +220,73 @@ static void Close( vlc_object_t *p_this )
             p_segment->UnSelect();
     }
 
+    if( var_InheritBool( p_demux, "mkv-index-cache" ) )
+        SaveIndexCache( p_demux );
+    if( p_sys->p_index_cache )
+        index_cache_Close( p_sys->p_index_cache );
+
     delete p_sys;
 }
 
+/*****************************************************************************
+ * Seek index cache: one record per segment of the opened file
+ *****************************************************************************/
+#define MKV_INDEX_CACHE_FORMAT  VLC_FOURCC('m','k','v',' ')
+#define MKV_INDEX_CACHE_VERSION 1
+
+static void LoadIndexCache( demux_t *p_demux, matroska_stream_c *p_stream )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    p_sys->p_index_cache = index_cache_Open( p_demux, MKV_INDEX_CACHE_FORMAT,
+                                             MKV_INDEX_CACHE_VERSION );
+    if( p_sys->p_index_cache == NULL )
+        return;
+
+    for( size_t i = 0; i < p_stream->segments.size(); i++ )
+    {
+        size_t i_size;
+        const void *p_data = index_cache_Get( p_sys->p_index_cache, i, &i_size );
+        if( p_data == NULL || !p_stream->segments[i]->RestoreIndex( p_data, i_size ) )
+            msg_Dbg( p_demux, "no cached index for segment %zu", i );
+    }
+}
+
+static void SaveIndexCache( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    if( p_sys->streams.empty() || p_sys->streams[0] == NULL )
+        return;
+
+    std::vector<matroska_segment_c*> & segments = p_sys->streams[0]->segments;
+    std::vector< std::vector<uint8_t> > data( segments.size() );
+    std::vector<index_cache_record_t> records;
+    bool b_changed = false, b_empty = true;
+
+    for( size_t i = 0; i < segments.size(); i++ )
+    {
+        segments[i]->StopIndexer();
+        segments[i]->SaveIndex( data[i] );
+
+        index_cache_record_t record = { (uint32_t) i, &data[i][0], data[i].size() };
+        records.push_back( record );
+
+        b_empty &= segments[i]->index.empty();
+
+        /* don't rewrite an up to date cache */
+        size_t i_size;
+        const void *p_cached = p_sys->p_index_cache ?
+            index_cache_Get( p_sys->p_index_cache, i, &i_size ) : NULL;
+        if( p_cached == NULL || i_size != data[i].size() ||
+            memcmp( p_cached, &data[i][0], i_size ) )
+            b_changed = true;
+    }
+
+    if( b_changed && !b_empty )
+        index_cache_Write( p_demux, MKV_INDEX_CACHE_FORMAT, MKV_INDEX_CACHE_VERSION,
+                           &records[0], records.size() );
+}
+
 /*****************************************************************************
  * Control:
  *****************************************************************************/
@@ -441,8 +448,6 @@ static void Seek( demux_t *p_demux, mtime_t i_mk_date, double f_percent, virtual
     matroska_segment_c *p_segment = p_vsegment->CurrentSegment();
     int64_t            i_global_position = -1;
 
-    int         i_index;
-
     msg_Dbg( p_demux, "seek request to %" PRId64 " (%f%%)", i_mk_date, f_percent );
     if( i_mk_date < 0 && f_percent < 0 )
     {
@@ -466,24 +471,16 @@ static void Seek( demux_t *p_demux, mtime_t i_mk_date, double f_percent, virtual
     }
 
     /* seek without index or without date */
-    if( f_percent >= 0 && (var_InheritBool( p_demux, "mkv-seek-percent" ) || !p_segment->b_cues || i_mk_date < 0 ))
+    if( f_percent >= 0 && (var_InheritBool( p_demux, "mkv-seek-percent" ) || !p_segment->LoadCues() || i_mk_date < 0 ))
     {
         i_mk_date = int64_t( f_percent * p_sys->f_duration * 1000.0 );
-        if( !p_segment->b_cues )
+        if( !p_segment->LoadCues() )
         {
             int64_t i_pos = int64_t( f_percent * stream_Size( p_demux->s ) );
 
             msg_Dbg( p_demux, "lengthy way of seeking for pos:%" PRId64, i_pos );
-            for( i_index = 0; i_index < p_segment->i_index; i_index++ )
-            {
-                if( p_segment->p_indexes[i_index].i_position >= i_pos &&
-                    p_segment->p_indexes[i_index].i_mk_time != -1 )
-                    break;
-            }
-            if( i_index == p_segment->i_index )
-                i_index--;
-
-            if( p_segment->p_indexes[i_index].i_position < i_pos )
+            mkv_index_t point;
+            if( !p_segment->index.findByPosition( cues_index_c::ANY_TRACK, i_pos, &point ) )
             {
                 msg_Dbg( p_demux, "no cues, seek request to global pos: %" PRId64, i_pos );
                 i_global_position = i_pos;
@@ -576,36 +573,48 @@ void BlockDecode( demux_t *p_demux, KaxBlock *block, KaxSimpleBlock *simpleblock
             break;
         }
 
+        /* each frame of a lace gets its own block from the pool of the
+         * track, the frames are copied (or inflated) only once */
         if( tk->i_compression_type == MATROSKA_COMPRESSION_HEADER &&
             tk->p_compression_data != NULL &&
             tk->i_encoding_scope & MATROSKA_ENCODING_SCOPE_ALL_FRAMES )
-            p_block = MemToBlock( data->Buffer(), data->Size(), tk->p_compression_data->GetSize() );
+        {
+            p_block = MemToBlock( data->Buffer(), data->Size(), tk->p_compression_data->GetSize(), tk );
+            if( p_block != NULL )
+                memcpy( p_block->p_buffer, tk->p_compression_data->GetBuffer(), tk->p_compression_data->GetSize() );
+        }
         else if( unlikely( tk->fmt.i_codec == VLC_CODEC_WAVPACK ) )
+        {
+#if defined(HAVE_ZLIB_H)
+            /* the frame is inflated before the WavPack header is added */
+            if( tk->i_compression_type == MATROSKA_COMPRESSION_ZLIB &&
+                tk->i_encoding_scope & MATROSKA_ENCODING_SCOPE_ALL_FRAMES )
+            {
+                block_t *p_inflated = block_zlib_decompress( VLC_OBJECT(p_demux), tk, data->Buffer(), data->Size() );
+                p_block = NULL;
+                if( p_inflated != NULL )
+                {
+                    p_block = packetize_wavpack( tk, p_inflated->p_buffer, p_inflated->i_buffer );
+                    block_Release( p_inflated );
+                }
+            }
+            else
+#endif
             p_block = packetize_wavpack(tk, data->Buffer(), data->Size());
+        }
+#if defined(HAVE_ZLIB_H)
+        else if( tk->i_compression_type == MATROSKA_COMPRESSION_ZLIB &&
+                 tk->i_encoding_scope & MATROSKA_ENCODING_SCOPE_ALL_FRAMES )
+            p_block = block_zlib_decompress( VLC_OBJECT(p_demux), tk, data->Buffer(), data->Size() );
+#endif
         else
-            p_block = MemToBlock( data->Buffer(), data->Size(), 0 );
+            p_block = MemToBlock( data->Buffer(), data->Size(), 0, tk );
 
         if( p_block == NULL )
         {
             break;
         }
 
-#if defined(HAVE_ZLIB_H)
-        if( tk->i_compression_type == MATROSKA_COMPRESSION_ZLIB &&
-            tk->i_encoding_scope & MATROSKA_ENCODING_SCOPE_ALL_FRAMES )
-        {
-            p_block = block_zlib_decompress( VLC_OBJECT(p_demux), p_block );
-            if( p_block == NULL )
-                break;
-        }
-        else
-#endif
-        if( tk->i_compression_type == MATROSKA_COMPRESSION_HEADER &&
-            tk->i_encoding_scope & MATROSKA_ENCODING_SCOPE_ALL_FRAMES )
-        {
-            memcpy( p_block->p_buffer, tk->p_compression_data->GetBuffer(), tk->p_compression_data->GetSize() );
-        }
-
         if ( b_key_picture )
             p_block->i_flags |= BLOCK_FLAG_TYPE_I;
 
@@ -177,6 +177,8 @@ public:
     virtual int32_t Init() { return 0; }
 };
 
+class block_pool_c;
+
 struct mkv_track_t
 {
     bool         b_default;
@@ -229,6 +231,13 @@ struct mkv_track_t
     int                    i_compression_type;
     uint32_t               i_encoding_scope;
     KaxContentCompSettings *p_compression_data;
+#ifdef HAVE_ZLIB_H
+    z_stream               *p_zstream;
+    size_t                 i_inflated_size;
+#endif
+
+    /* frames buffers, created on the first block */
+    block_pool_c           *p_block_pool;
 
     /* Matroska 4 new elements used by Opus */
     mtime_t i_seek_preroll;
@@ -26,6 +26,7 @@
 #include "demux.hpp"
 
 #include <stdint.h>
+#include <new>
 /*****************************************************************************
  * Local prototypes
  *****************************************************************************/
@@ -105,64 +106,207 @@ int32_t zlib_decompress_extra( demux_t * p_demux, mkv_track_t * tk )
     return 0;
 }
 
-block_t *block_zlib_decompress( vlc_object_t *p_this, block_t *p_in_block ) {
-    int result, dstsize, n;
-    unsigned char *dst;
-    block_t *p_block;
-    z_stream d_stream;
+/* Inflates a frame straight from the block data. The z_stream of the track
+ * is kept between frames, and the output starts at the size of the last
+ * inflated frame. */
+block_t *block_zlib_decompress( vlc_object_t *p_this, mkv_track_t *tk, const uint8_t *p_in, size_t i_in )
+{
+    z_stream *p_stream = tk->p_zstream;
+    int result;
 
-    d_stream.zalloc = (alloc_func)0;
-    d_stream.zfree = (free_func)0;
-    d_stream.opaque = (voidpf)0;
-    result = inflateInit(&d_stream);
-    if( result != Z_OK )
+    if( p_stream == NULL )
     {
-        msg_Dbg( p_this, "inflateInit() failed. Result: %d", result );
-        return NULL;
+        p_stream = new (std::nothrow) z_stream;
+        if( unlikely( p_stream == NULL ) )
+            return NULL;
+        p_stream->zalloc = (alloc_func)0;
+        p_stream->zfree = (free_func)0;
+        p_stream->opaque = (voidpf)0;
+        result = inflateInit( p_stream );
+        if( result != Z_OK )
+        {
+            msg_Dbg( p_this, "inflateInit() failed. Result: %d", result );
+            delete p_stream;
+            return NULL;
+        }
+        tk->p_zstream = p_stream;
     }
+    else
+        inflateReset( p_stream );
 
-    d_stream.next_in = (Bytef *)p_in_block->p_buffer;
-    d_stream.avail_in = p_in_block->i_buffer;
-    n = 0;
-    p_block = block_Alloc( 0 );
-    dst = NULL;
-    do
+    block_t *p_block = TrackBlockAlloc( tk, __MAX( tk->i_inflated_size, 2 * i_in ) );
+    if( unlikely( p_block == NULL ) )
+        return NULL;
+
+    p_stream->next_in = (Bytef *)p_in;
+    p_stream->avail_in = i_in;
+
+    size_t i_out = 0;
+    for( ;; )
     {
-        n++;
-        p_block = block_Realloc( p_block, 0, n * 1000 );
-        dst = (unsigned char *)p_block->p_buffer;
-        d_stream.next_out = (Bytef *)&dst[(n - 1) * 1000];
-        d_stream.avail_out = 1000;
-        result = inflate(&d_stream, Z_NO_FLUSH);
-        if( ( result != Z_OK ) && ( result != Z_STREAM_END ) )
+        p_stream->next_out = (Bytef *)&p_block->p_buffer[i_out];
+        p_stream->avail_out = p_block->i_buffer - i_out;
+        result = inflate( p_stream, Z_NO_FLUSH );
+        i_out = p_block->i_buffer - p_stream->avail_out;
+
+        if( result == Z_STREAM_END || ( result == Z_OK && p_stream->avail_out ) )
+            break;
+        if( result != Z_OK )
         {
             msg_Err( p_this, "Zlib decompression failed. Result: %d", result );
-            inflateEnd( &d_stream );
             block_Release( p_block );
-            return p_in_block;
+            /* pass the frame as is */
+            return MemToBlock( p_in, i_in, 0, tk );
         }
-    }
-    while( ( d_stream.avail_out == 0 ) && ( d_stream.avail_in != 0 ) &&
-           ( result != Z_STREAM_END ) );
 
-    dstsize = d_stream.total_out;
-    inflateEnd( &d_stream );
-
-    p_block = block_Realloc( p_block, 0, dstsize );
-    p_block->i_buffer = dstsize;
-    block_Release( p_in_block );
+        /* output full */
+        p_block = block_Realloc( p_block, 0, 2 * p_block->i_buffer );
+        if( unlikely( p_block == NULL ) )
+            return NULL;
+    }
 
+    p_block->i_buffer = i_out;
+    tk->i_inflated_size = i_out;
     return p_block;
 }
 #endif
 
+/* Pooled blocks have the same layout as the ones of block_Alloc() */
+#define POOL_BLOCK_ALIGN    32
+#define POOL_BLOCK_PADDING  32
+#define POOL_MAX_FREE_BLOCKS 16
+
+struct block_pool_c::pool_block_t
+{
+    block_t       self;
+    block_pool_c *p_pool;
+    size_t        i_capacity;
+};
+
+block_pool_c::block_pool_c()
+    :i_refs(1)
+    ,i_frame_size(0)
+{
+    vlc_mutex_init( &lock );
+}
+
+block_pool_c::~block_pool_c()
+{
+    for( size_t i = 0; i < free_blocks.size(); i++ )
+        free( free_blocks[i] );
+    vlc_mutex_destroy( &lock );
+}
+
+block_t *block_pool_c::Alloc( size_t i_size )
+{
+    pool_block_t *p_block = NULL;
+    size_t i_capacity;
+
+    vlc_mutex_lock( &lock );
+    /* follow the frame sizes, slowly forgetting the large ones */
+    i_frame_size = __MAX( i_size, i_frame_size - i_frame_size / 16 );
+    i_capacity = i_frame_size;
+
+    for( size_t i = free_blocks.size(); i > 0; i-- )
+    {
+        if( free_blocks[i - 1]->i_capacity >= i_size )
+        {
+            p_block = free_blocks[i - 1];
+            free_blocks.erase( free_blocks.begin() + i - 1 );
+            break;
+        }
+    }
+    i_refs++;
+    vlc_mutex_unlock( &lock );
+
+    if( p_block == NULL )
+    {
+        const size_t i_alloc = sizeof( *p_block ) + POOL_BLOCK_ALIGN +
+                               2 * POOL_BLOCK_PADDING + i_capacity;
+        if( likely( i_alloc > i_capacity ) )
+            p_block = static_cast<pool_block_t *>( malloc( i_alloc ) );
+        if( unlikely( p_block == NULL ) )
+        {
+            Release();
+            return NULL;
+        }
+        p_block->p_pool = this;
+        p_block->i_capacity = i_capacity;
+    }
+
+    block_t *b = &p_block->self;
+    const size_t i_start = sizeof( *p_block );
+    block_Init( b, reinterpret_cast<uint8_t *>( p_block ) + i_start,
+                POOL_BLOCK_ALIGN + 2 * POOL_BLOCK_PADDING + p_block->i_capacity );
+    b->p_buffer += POOL_BLOCK_PADDING + POOL_BLOCK_ALIGN - 1;
+    b->p_buffer = (uint8_t *)( ( (uintptr_t)b->p_buffer ) & ~(uintptr_t)( POOL_BLOCK_ALIGN - 1 ) );
+    b->i_buffer = i_size;
+    b->pf_release = BlockRelease;
+    return b;
+}
+
+void block_pool_c::BlockRelease( block_t *b )
+{
+    pool_block_t *p_block = reinterpret_cast<pool_block_t *>( b );
+    block_pool_c *p_pool = p_block->p_pool;
+
+    vlc_mutex_lock( &p_pool->lock );
+    /* don't keep the buffers of a much larger frame */
+    if( p_pool->i_refs > 1 && p_pool->free_blocks.size() < POOL_MAX_FREE_BLOCKS &&
+        p_block->i_capacity <= 2 * p_pool->i_frame_size )
+    {
+        p_pool->free_blocks.push_back( p_block );
+        p_block = NULL;
+    }
+    vlc_mutex_unlock( &p_pool->lock );
+
+    free( p_block );
+    p_pool->Release();
+}
+
+void block_pool_c::Release()
+{
+    vlc_mutex_lock( &lock );
+    bool b_last = --i_refs == 0;
+    vlc_mutex_unlock( &lock );
+
+    if( b_last )
+        delete this;
+}
+
 /* Utility function for BlockDecode */
-block_t *MemToBlock( uint8_t *p_mem, size_t i_mem, size_t offset)
+block_t *TrackBlockAlloc( mkv_track_t *tk, size_t i_size )
+{
+    if( tk->p_block_pool == NULL )
+        tk->p_block_pool = new (std::nothrow) block_pool_c();
+    if( unlikely( tk->p_block_pool == NULL ) )
+        return block_Alloc( i_size );
+    return tk->p_block_pool->Alloc( i_size );
+}
+
+void TrackReleaseBuffers( mkv_track_t *tk )
+{
+#ifdef HAVE_ZLIB_H
+    if( tk->p_zstream )
+    {
+        inflateEnd( tk->p_zstream );
+        delete tk->p_zstream;
+        tk->p_zstream = NULL;
+    }
+#endif
+    if( tk->p_block_pool )
+    {
+        tk->p_block_pool->Release();
+        tk->p_block_pool = NULL;
+    }
+}
+
+block_t *MemToBlock( const uint8_t *p_mem, size_t i_mem, size_t offset, mkv_track_t *tk )
 {
     if( unlikely( i_mem > SIZE_MAX - offset ) )
         return NULL;
 
-    block_t *p_block = block_Alloc( i_mem + offset );
+    block_t *p_block = tk ? TrackBlockAlloc( tk, i_mem + offset ) : block_Alloc( i_mem + offset );
     if( likely(p_block != NULL) )
     {
         memcpy( p_block->p_buffer + offset, p_mem, i_mem );
@@ -27,10 +27,42 @@
 
 #ifdef HAVE_ZLIB_H
 int32_t zlib_decompress_extra( demux_t * p_demux, mkv_track_t * tk );
-block_t *block_zlib_decompress( vlc_object_t *p_this, block_t *p_in_block );
+block_t *block_zlib_decompress( vlc_object_t *p_this, mkv_track_t *tk, const uint8_t *p_in, size_t i_in );
 #endif
 
-block_t *MemToBlock( uint8_t *p_mem, size_t i_mem, size_t offset);
+/* Recycles the frames blocks of a track once they are released.
+ *
+ * Blocks are allocated to the largest recent frame size, so that the
+ * frames of high bitrate video, which have similar sizes, keep using the
+ * same buffers instead of going through malloc and the page faults of
+ * fresh memory. The pool lives until its last block is released. */
+class block_pool_c
+{
+public:
+    block_pool_c();
+
+    block_t *Alloc( size_t i_size );
+    void Release();
+
+private:
+    struct pool_block_t;
+
+    ~block_pool_c();
+    block_pool_c( const block_pool_c & );
+    block_pool_c & operator=( const block_pool_c & );
+
+    static void BlockRelease( block_t * );
+
+    vlc_mutex_t                 lock;
+    std::vector<pool_block_t *> free_blocks;
+    unsigned                    i_refs;
+    size_t                      i_frame_size;
+};
+
+block_t *TrackBlockAlloc( mkv_track_t *tk, size_t i_size );
+void TrackReleaseBuffers( mkv_track_t *tk );
+
+block_t *MemToBlock( const uint8_t *p_mem, size_t i_mem, size_t offset, mkv_track_t *tk = NULL );
 void handle_real_audio(demux_t * p_demux, mkv_track_t * p_tk, block_t * p_blk, mtime_t i_pts);
 void send_Block( demux_t * p_demux, mkv_track_t * p_tk, block_t * p_block, unsigned int i_number_frames, mtime_t i_duration );
 
@@ -51,160 +51,315 @@ void MP4_Fragments_Clean( mp4_fragments_t *p_frags )
         p_frags->moov.p_next = p_fragment;
     }
     MP4_Fragment_Clean( &p_frags->moov );
+
+    free( p_frags->index.pp_fragments );
+    free( p_frags->index.pi_track_IDs );
+    free( p_frags->index.pi_times );
 }
 
-void MP4_Fragments_Insert( mp4_fragments_t *p_frags, mp4_fragment_t *p_new )
+static stime_t GetTrackDurationInFragment( const mp4_fragment_t *p_fragment,
+                                           unsigned int i_track_ID )
 {
-    mp4_fragment_t *p_fragment = p_frags->p_last;
-    /* tail append lookup */
-    if( p_fragment && p_fragment->p_moox->i_pos < p_new->p_moox->i_pos )
+    for( unsigned int i=0; i<p_fragment->i_durations; i++ )
     {
-        p_new ->p_next = p_fragment->p_next;
-        p_fragment->p_next = p_new;
-        p_frags->p_last = p_new;
-        return;
+        if( i_track_ID == p_fragment->p_durations[i].i_track_ID )
+            return p_fragment->p_durations[i].i_duration;
     }
+    return 0;
+}
 
-    /* start from head */
-    p_fragment = MP4_Fragment_Moov( p_frags )->p_next;
-    while ( p_fragment && p_fragment->p_moox->i_pos < p_new->p_moox->i_pos )
+/* Returns the index of the first moof at or after i_pos */
+static unsigned int IndexFindAtomPos( const mp4_fragments_t *p_frags, uint64_t i_pos )
+{
+    unsigned int i_low = 0, i_high = p_frags->index.i_count;
+    while( i_low < i_high )
     {
-        p_fragment = p_fragment->p_next;
+        unsigned int i_mid = i_low + ( i_high - i_low ) / 2;
+        if( p_frags->index.pp_fragments[i_mid]->p_moox->i_pos < i_pos )
+            i_low = i_mid + 1;
+        else
+            i_high = i_mid;
     }
+    return i_low;
+}
 
-    if( p_fragment )
+static int IndexGetTrack( const mp4_fragments_t *p_frags, unsigned int i_track_ID )
+{
+    for( unsigned int i=0; i<p_frags->index.i_tracks; i++ )
+    {
+        if( p_frags->index.pi_track_IDs[i] == i_track_ID )
+            return i;
+    }
+    return -1;
+}
+
+/* Makes room for the times of the tracks of a new fragment. Adding
+ * a track changes the layout, all times will be computed again. */
+static bool IndexAddTracks( mp4_fragments_t *p_frags, const mp4_fragment_t *p_new )
+{
+    for( unsigned int i=0; i<p_new->i_durations; i++ )
     {
-        p_new->p_next = p_fragment->p_next;
-        p_fragment->p_next = p_new;
+        if( IndexGetTrack( p_frags, p_new->p_durations[i].i_track_ID ) >= 0 )
+            continue;
 
-        if( p_fragment == p_frags->p_last )
-            p_frags->p_last = p_new;
+        const unsigned int i_tracks = p_frags->index.i_tracks + 1;
+        unsigned int *pi_track_IDs = realloc( p_frags->index.pi_track_IDs,
+                                              i_tracks * sizeof(*pi_track_IDs) );
+        if( !pi_track_IDs )
+            return false;
+        p_frags->index.pi_track_IDs = pi_track_IDs;
+
+        stime_t *pi_times = realloc( p_frags->index.pi_times, (size_t)
+                                     p_frags->index.i_alloc * i_tracks * sizeof(*pi_times) );
+        if( !pi_times && p_frags->index.i_alloc )
+            return false;
+        p_frags->index.pi_times = pi_times;
+
+        pi_track_IDs[p_frags->index.i_tracks] = p_new->p_durations[i].i_track_ID;
+        p_frags->index.i_tracks = i_tracks;
+        p_frags->index.i_timed = 0;
     }
-    else
+    return true;
+}
+
+bool MP4_Fragments_Insert( mp4_fragments_t *p_frags, mp4_fragment_t *p_new )
+{
+    if( p_frags->index.i_count == p_frags->index.i_alloc )
     {
-        MP4_Fragment_Moov( p_frags )->p_next = p_new;
-        p_frags->p_last = p_new;
+        const unsigned int i_alloc = __MAX( 64, p_frags->index.i_alloc * 2 );
+        mp4_fragment_t **pp_fragments = realloc( p_frags->index.pp_fragments,
+                                                 i_alloc * sizeof(*pp_fragments) );
+        if( !pp_fragments )
+            return false;
+        p_frags->index.pp_fragments = pp_fragments;
+
+        stime_t *pi_times = realloc( p_frags->index.pi_times, (size_t)
+                                     i_alloc * p_frags->index.i_tracks * sizeof(*pi_times) );
+        if( !pi_times && p_frags->index.i_tracks )
+            return false;
+        p_frags->index.pi_times = pi_times;
+        p_frags->index.i_alloc = i_alloc;
     }
+
+    if( !IndexAddTracks( p_frags, p_new ) )
+        return false;
+
+    /* fragments are mostly found in order */
+    unsigned int i_insert = p_frags->index.i_count;
+    if( i_insert && p_frags->index.pp_fragments[i_insert - 1]->p_moox->i_pos > p_new->p_moox->i_pos )
+        i_insert = IndexFindAtomPos( p_frags, p_new->p_moox->i_pos );
+
+    mp4_fragment_t **pp_fragments = p_frags->index.pp_fragments;
+    memmove( &pp_fragments[i_insert + 1], &pp_fragments[i_insert],
+             ( p_frags->index.i_count - i_insert ) * sizeof(*pp_fragments) );
+    pp_fragments[i_insert] = p_new;
+    p_frags->index.i_count++;
+    p_frags->index.i_timed = __MIN( p_frags->index.i_timed, i_insert );
+
+    /* data ranges usually follow the moofs, which allows searching them */
+    mp4_fragment_t *p_prev = i_insert ? pp_fragments[i_insert - 1] : NULL;
+    const mp4_fragment_t *p_next = i_insert + 1 < p_frags->index.i_count
+                                 ? pp_fragments[i_insert + 1] : NULL;
+    if( p_new->i_chunk_range_min_offset > p_new->i_chunk_range_max_offset ||
+        ( p_prev && p_prev->i_chunk_range_max_offset > p_new->i_chunk_range_min_offset ) ||
+        ( p_next && p_new->i_chunk_range_max_offset > p_next->i_chunk_range_min_offset ) )
+        p_frags->index.b_unsorted_ranges = true;
+
+    /* and chain it */
+    mp4_fragment_t *p_fragment = p_prev ? p_prev : MP4_Fragment_Moov( p_frags );
+    p_new->p_next = p_fragment->p_next;
+    p_fragment->p_next = p_new;
+    if( !p_new->p_next )
+        p_frags->p_last = p_new;
+
+    return true;
 }
 
 bool MP4_Fragments_Init( mp4_fragments_t *p_frags )
 {
-    memset( &p_frags->moov, 0, sizeof(mp4_fragment_t) );
+    memset( p_frags, 0, sizeof(*p_frags) );
     return true;
 }
 
-static stime_t GetTrackDurationInFragment( const mp4_fragment_t *p_fragment,
-                                           unsigned int i_track_ID )
+/* Computes the missing start times, each being the sum of the durations
+ * of the track in the previous moofs */
+static void IndexUpdateTimes( mp4_fragments_t *p_frags )
 {
-    for( unsigned int i=0; i<p_fragment->i_durations; i++ )
+    const unsigned int i_tracks = p_frags->index.i_tracks;
+    stime_t *pi_times = p_frags->index.pi_times;
+
+    if( p_frags->index.i_timed == 0 && p_frags->index.i_count )
     {
-        if( i_track_ID == p_fragment->p_durations[i].i_track_ID )
-            return p_fragment->p_durations[i].i_duration;
+        for( unsigned int i=0; i<i_tracks; i++ )
+            pi_times[i] = 0;
+        p_frags->index.i_timed = 1;
     }
-    return 0;
+
+    for( unsigned int k = p_frags->index.i_timed; k < p_frags->index.i_count; k++ )
+    {
+        const mp4_fragment_t *p_prev = p_frags->index.pp_fragments[k - 1];
+        for( unsigned int i=0; i<i_tracks; i++ )
+            pi_times[k * i_tracks + i] = pi_times[(k - 1) * i_tracks + i] +
+                GetTrackDurationInFragment( p_prev, p_frags->index.pi_track_IDs[i] );
+    }
+    p_frags->index.i_timed = p_frags->index.i_count;
+}
+
+/* Start time of the track in the k-th moof, the end of the last one
+ * for k == count, without the moov part */
+static stime_t IndexGetTime( const mp4_fragments_t *p_frags, unsigned int k,
+                             unsigned int i_track_ID )
+{
+    const int i_track = IndexGetTrack( p_frags, i_track_ID );
+    if( i_track < 0 || p_frags->index.i_count == 0 )
+        return 0;
+
+    const unsigned int i_tracks = p_frags->index.i_tracks;
+    if( k < p_frags->index.i_count )
+        return p_frags->index.pi_times[k * i_tracks + i_track];
+
+    k = p_frags->index.i_count - 1;
+    return p_frags->index.pi_times[k * i_tracks + i_track] +
+           GetTrackDurationInFragment( p_frags->index.pp_fragments[k], i_track_ID );
 }
 
 stime_t GetTrackTotalDuration( mp4_fragments_t *p_frags, unsigned int i_track_ID )
 {
-    stime_t i_duration = 0;
-    const mp4_fragment_t *p_fragment = MP4_Fragment_Moov( p_frags );
-    while ( p_fragment && p_fragment->p_durations )
-    {
-        i_duration += GetTrackDurationInFragment( p_fragment, i_track_ID );
-        p_fragment = p_fragment->p_next;
-    }
-    return i_duration;
+    const mp4_fragment_t *p_moov = MP4_Fragment_Moov( p_frags );
+    if ( !p_moov->p_durations )
+        return 0;
+
+    IndexUpdateTimes( p_frags );
+    return GetTrackDurationInFragment( p_moov, i_track_ID ) +
+           IndexGetTime( p_frags, p_frags->index.i_count, i_track_ID );
 }
 
 mp4_fragment_t * GetFragmentByAtomPos( mp4_fragments_t *p_frags, uint64_t i_pos )
 {
-    mp4_fragment_t *p_fragment = MP4_Fragment_Moov( p_frags );
-    do
-    {
-        if( p_fragment && p_fragment->p_moox && p_fragment->p_moox->i_pos >= i_pos )
-        {
-            if( p_fragment->p_moox->i_pos != i_pos )
-                p_fragment = NULL;
-            break;
-        }
-        p_fragment = p_fragment->p_next;
-    } while( p_fragment );
-    return p_fragment;
+    mp4_fragment_t *p_moov = MP4_Fragment_Moov( p_frags );
+    if( p_moov->p_moox && p_moov->p_moox->i_pos >= i_pos )
+        return p_moov->p_moox->i_pos == i_pos ? p_moov : NULL;
+
+    unsigned int k = IndexFindAtomPos( p_frags, i_pos );
+    if( k < p_frags->index.i_count &&
+        p_frags->index.pp_fragments[k]->p_moox->i_pos == i_pos )
+        return p_frags->index.pp_fragments[k];
+    return NULL;
 }
 
 mp4_fragment_t * GetFragmentByPos( mp4_fragments_t *p_frags, uint64_t i_pos, bool b_exact )
 {
     mp4_fragment_t *p_fragment = MP4_Fragment_Moov( p_frags );
-    while ( p_fragment )
+    if ( i_pos <= p_fragment->i_chunk_range_max_offset &&
+         ( !b_exact || i_pos >= p_fragment->i_chunk_range_min_offset ) )
+        return p_fragment;
+
+    mp4_fragment_t **pp_fragments = p_frags->index.pp_fragments;
+    unsigned int k = 0;
+    if( !p_frags->index.b_unsorted_ranges )
+    {
+        /* first one ending after i_pos */
+        unsigned int i_high = p_frags->index.i_count;
+        while( k < i_high )
+        {
+            unsigned int i_mid = k + ( i_high - k ) / 2;
+            if( pp_fragments[i_mid]->i_chunk_range_max_offset < i_pos )
+                k = i_mid + 1;
+            else
+                i_high = i_mid;
+        }
+    }
+
+    for( ; k < p_frags->index.i_count; k++ )
     {
+        p_fragment = pp_fragments[k];
         if ( i_pos <= p_fragment->i_chunk_range_max_offset &&
              ( !b_exact || i_pos >= p_fragment->i_chunk_range_min_offset ) )
-        {
             return p_fragment;
-        }
-        else
-        {
-            p_fragment = p_fragment->p_next;
-        }
+        if( !p_frags->index.b_unsorted_ranges )
+            break;
     }
     return NULL;
 }
 
+/* Start (k) or end (k + 1) of the k-th moof, as the latest of the tracks */
+static stime_t IndexGetSegmentTime( const mp4_fragments_t *p_frags, unsigned int k,
+                                    unsigned i_tracks_id, const unsigned *pi_tracks_id,
+                                    const stime_t *pi_base )
+{
+    stime_t i_time = 0;
+    for( unsigned int i=0; i<i_tracks_id; i++ )
+        i_time = __MAX( i_time, pi_base[i] + IndexGetTime( p_frags, k, pi_tracks_id[i] ) );
+    return i_time;
+}
+
 /* Get a matching fragment data start by clock time */
 mp4_fragment_t * GetFragmentByTime( mp4_fragments_t *p_frags, const mtime_t i_time,
                                     unsigned i_tracks_id, unsigned *pi_tracks_id,
                                     uint32_t i_movie_timescale )
 {
     const stime_t i_scaled_time = i_time * i_movie_timescale / CLOCK_FREQ;
-    mp4_fragment_t *p_fragment = MP4_Fragment_Moov( p_frags );
-    stime_t *pi_tracks_fragduration_total = calloc( i_tracks_id, sizeof(stime_t) );
-    mtime_t i_segment_start = 0;
+    mp4_fragment_t *p_moov = MP4_Fragment_Moov( p_frags );
+    mp4_fragment_t *p_fragment = NULL;
+    stime_t *pi_base = calloc( i_tracks_id, sizeof(stime_t) );
+    if( !pi_base && i_tracks_id )
+        return NULL;
 
-    if( p_fragment->i_chunk_range_max_offset == 0 )
-        p_fragment = p_fragment->p_next;
-
-    while ( p_fragment && pi_tracks_fragduration_total )
+    /* the moov is a fragment when it has samples */
+    if( p_moov->i_chunk_range_max_offset )
     {
-        mtime_t i_segment_end = 0;
+        stime_t i_segment_end = 0;
         for( unsigned int i=0; i<i_tracks_id; i++ )
         {
-            pi_tracks_fragduration_total[i] += GetTrackDurationInFragment( p_fragment, pi_tracks_id[i] );
-            i_segment_end = __MAX(i_segment_end, pi_tracks_fragduration_total[i]);
+            pi_base[i] = GetTrackDurationInFragment( p_moov, pi_tracks_id[i] );
+            i_segment_end = __MAX( i_segment_end, pi_base[i] );
         }
-
-        if ( i_scaled_time >= i_segment_start &&
-             i_scaled_time <= i_segment_end )
+        if( i_scaled_time >= 0 && i_scaled_time <= i_segment_end )
         {
-            free( pi_tracks_fragduration_total );
-            return p_fragment;
+            free( pi_base );
+            return p_moov;
         }
+    }
+
+    IndexUpdateTimes( p_frags );
+
+    /* first moof ending after the time */
+    unsigned int k = 0, i_high = p_frags->index.i_count;
+    while( k < i_high )
+    {
+        unsigned int i_mid = k + ( i_high - k ) / 2;
+        if( IndexGetSegmentTime( p_frags, i_mid + 1, i_tracks_id,
+                                 pi_tracks_id, pi_base ) < i_scaled_time )
+            k = i_mid + 1;
         else
-        {
-            i_segment_start = i_segment_end; /* end = next segment start */
-            p_fragment = p_fragment->p_next;
-        }
+            i_high = i_mid;
     }
 
-    free( pi_tracks_fragduration_total );
-    return NULL;
+    if( k < p_frags->index.i_count &&
+        IndexGetSegmentTime( p_frags, k, i_tracks_id,
+                             pi_tracks_id, pi_base ) <= i_scaled_time )
+        p_fragment = p_frags->index.pp_fragments[k];
+
+    free( pi_base );
+    return p_fragment;
 }
 
 /* Returns fragment scaled time offset */
 stime_t GetTrackFragmentTimeOffset( mp4_fragments_t *p_frags, mp4_fragment_t *p_fragment,
                                      unsigned int i_track_ID )
 {
+    const mp4_fragment_t *p_moov = MP4_Fragment_Moov( p_frags );
+    if ( p_fragment == p_moov )
+        return 0;
+
     stime_t i_base_scaledtime = 0;
-    mp4_fragment_t *p_current = MP4_Fragment_Moov( p_frags );
-    while ( p_current != p_fragment )
-    {
-        if ( p_current != MP4_Fragment_Moov( p_frags ) ||
-             p_current->i_chunk_range_max_offset )
-        {
-            i_base_scaledtime += GetTrackDurationInFragment( p_current, i_track_ID );
-        }
-        p_current = p_current->p_next;
-    }
-    return i_base_scaledtime;
+    if ( p_moov->i_chunk_range_max_offset )
+        i_base_scaledtime = GetTrackDurationInFragment( p_moov, i_track_ID );
+
+    IndexUpdateTimes( p_frags );
+    return i_base_scaledtime +
+           IndexGetTime( p_frags, IndexFindAtomPos( p_frags, p_fragment->p_moox->i_pos ),
+                         i_track_ID );
 }
 
 void DumpFragments( vlc_object_t *p_obj, mp4_fragments_t *p_frags, uint32_t i_movie_timescale )
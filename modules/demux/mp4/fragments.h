@@ -50,6 +50,20 @@ typedef struct
 {
     mp4_fragment_t moov; /* known fragments (moof following moov) */
     mp4_fragment_t *p_last;
+
+    /* moof fragments sorted by position, with the start time of each
+       track in each of them, for the position and time lookups */
+    struct
+    {
+        mp4_fragment_t **pp_fragments;
+        unsigned int     i_count;
+        unsigned int     i_alloc;
+        unsigned int    *pi_track_IDs;
+        unsigned int     i_tracks;
+        stime_t         *pi_times;  /* i_tracks per fragment, movie scaled */
+        unsigned int     i_timed;   /* fragments with up to date times */
+        bool             b_unsorted_ranges;
+    } index;
 } mp4_fragments_t;
 
 static inline mp4_fragment_t * MP4_Fragment_Moov(mp4_fragments_t *p_fragments)
@@ -68,7 +82,7 @@ static inline void MP4_Fragment_Delete( mp4_fragment_t *p_fragment )
 
 bool MP4_Fragments_Init(mp4_fragments_t *);
 void MP4_Fragments_Clean(mp4_fragments_t *);
-void MP4_Fragments_Insert(mp4_fragments_t *, mp4_fragment_t *);
+bool MP4_Fragments_Insert(mp4_fragments_t *, mp4_fragment_t *);
 
 stime_t GetTrackTotalDuration( mp4_fragments_t *p_frags, unsigned int i_track_ID );
 mp4_fragment_t * GetFragmentByAtomPos( mp4_fragments_t *p_frags, uint64_t i_pos );
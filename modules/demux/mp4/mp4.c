@@ -35,6 +35,7 @@
 #include <assert.h>
 #include <limits.h>
 #include "../codec/cc.h"
+#include "../index_cache.h"
 
 /*****************************************************************************
  * Module descriptor
@@ -49,6 +50,18 @@ vlc_module_begin ()
     set_shortname( N_("MP4") )
     set_capability( "demux", 240 )
     set_callbacks( Open, Close )
+
+    add_bool( "mp4-index-cache", false,
+              N_("Cache the fragments index"),
+              N_("Keep the fragments index of local fragmented files in the cache "
+                 "directory, so that they do not have to be read entirely when "
+                 "opening them again."), true )
+    add_integer( "mp4-tables-cache", 0,
+                 N_("Sample tables memory (kB)"),
+                 N_("Memory used by the timing tables of the samples, which are "
+                    "then only built around the playback position. 0 builds them "
+                    "for the whole file when opening it."), true )
+        change_integer_range( 0, 1 << 20 )
 vlc_module_end ()
 
 /*****************************************************************************
@@ -61,6 +74,26 @@ static int   DemuxAsLeaf( demux_t * );
 static int   Seek    ( demux_t *, mtime_t );
 static int   Control ( demux_t *, int, va_list );
 
+/* Fragments index cache, see index_cache.h */
+#define MP4_INDEX_CACHE_FORMAT  VLC_FOURCC('m','p','4',' ')
+#define MP4_INDEX_CACHE_VERSION 1
+#define MP4_INDEX_CACHE_INFO    0
+#define MP4_INDEX_CACHE_MOOFS   1
+
+typedef struct
+{
+    uint64_t i_overall_duration;
+    uint32_t i_timescale;
+    uint32_t i_reserved;
+} mp4_index_cache_info_t;
+
+/* moof by time, also the cache record */
+typedef struct
+{
+    uint64_t i_pos;  /* moof position */
+    int64_t  i_time; /* movie timescale */
+} mp4_moof_index_t;
+
 struct demux_sys_t
 {
     MP4_Box_t    *p_root;      /* container for the whole file */
@@ -85,6 +118,19 @@ struct demux_sys_t
 
     mp4_fragments_t fragments;
 
+    uint64_t        i_tables_max;   /* per track, 0 for no limit */
+
+    /* fragments index from the cache, replaces the full probing */
+    index_cache_t                *p_index_cache;
+    const mp4_index_cache_info_t *p_cached_info;
+
+    /* moofs by time, to seek into the fragments not read yet: from the
+       cache, the mfra/tfra or sidx boxes, and the moofs read so far */
+    mp4_moof_index_t *p_moofs;
+    size_t            i_moofs;
+    size_t            i_moofs_alloc;
+    bool              b_moofs_indexed;
+
     struct
     {
         mp4_fragment_t *p_fragment;
@@ -111,6 +157,9 @@ struct demux_sys_t
 static void MP4_TrackCreate ( demux_t *, mp4_track_t *, MP4_Box_t  *, bool, bool );
 static void MP4_TrackDestroy( demux_t *, mp4_track_t * );
 
+static int  TrackLoadTables( demux_t *, mp4_track_t *, uint32_t );
+static void TrackReleaseTables( mp4_track_t * );
+
 static block_t * MP4_Block_Read( demux_t *, const mp4_track_t *, int );
 static void MP4_Block_Send( demux_t *, mp4_track_t *, block_t * );
 
@@ -136,7 +185,10 @@ static void MP4_GetDefaultSizeAndDuration( demux_t *p_demux,
 static bool AddFragment( demux_t *p_demux, MP4_Box_t *p_moox );
 static int  ProbeFragments( demux_t *p_demux, bool b_force );
 static int  ProbeIndex( demux_t *p_demux );
+static void LoadFragmentsCache( demux_t *p_demux );
+static void SaveFragmentsCache( demux_t *p_demux );
 
+static void LeafIndexAddMoof( demux_t *p_demux, uint64_t i_pos, stime_t i_time );
 static int LeafIndexGetMoofPosByTime( demux_t *p_demux, const mtime_t i_target_time,
                                       uint64_t *pi_pos, mtime_t *pi_mooftime );
 static int LeafGetTrackAndChunkByMOOVPos( demux_t *p_demux, uint64_t *pi_pos,
@@ -197,6 +249,17 @@ static MP4_Box_t * MP4_GetTrakByTrackID( MP4_Box_t *p_moov, const uint32_t i_id
     return p_trak;
 }
 
+/* Makes sure the dts/pts tables of a chunk are built */
+static inline int TrackEnsureTables( demux_t *p_demux, mp4_track_t *p_track,
+                                     uint32_t i_chunk )
+{
+    if( i_chunk >= p_track->i_tables_first && i_chunk < p_track->i_tables_end )
+        return VLC_SUCCESS;
+    if( i_chunk >= p_track->i_chunk_count )
+        return VLC_EGENERIC;
+    return TrackLoadTables( p_demux, p_track, i_chunk );
+}
+
 /* Return time in microsecond of a track */
 static inline int64_t MP4_TrackGetDTS( demux_t *p_demux, mp4_track_t *p_track )
 {
@@ -205,7 +268,10 @@ static inline int64_t MP4_TrackGetDTS( demux_t *p_demux, mp4_track_t *p_track )
     if( p_sys->b_fragmented )
         p_chunk = p_track->cchunk;
     else
+    {
+        TrackEnsureTables( p_demux, p_track, p_track->i_chunk );
         p_chunk = &p_track->chunk[p_track->i_chunk];
+    }
 
     unsigned int i_index = 0;
     unsigned int i_sample = p_track->i_sample - p_chunk->i_sample_first;
@@ -259,7 +325,10 @@ static inline bool MP4_TrackGetPTSDelta( demux_t *p_demux, mp4_track_t *p_track,
     if( p_sys->b_fragmented )
         ck = p_track->cchunk;
     else
+    {
+        TrackEnsureTables( p_demux, p_track, p_track->i_chunk );
         ck = &p_track->chunk[p_track->i_chunk];
+    }
 
     unsigned int i_index = 0;
     unsigned int i_sample = p_track->i_sample - ck->i_sample_first;
@@ -313,6 +382,8 @@ static int AllocateTracks( demux_t *p_demux, unsigned i_tracks )
     if( p_sys->track == NULL )
         return VLC_ENOMEM;
     p_sys->i_tracks = i_tracks;
+    p_sys->i_tables_max = (uint64_t) var_InheritInteger( p_demux, "mp4-tables-cache" )
+                          * 1024 / i_tracks;
 
     if( p_sys->b_fragmented )
     {
@@ -571,13 +642,21 @@ static int Open( vlc_object_t * p_this )
     {
         if ( p_sys->b_seekable )
         {
+            if ( var_InheritBool( p_demux, "mp4-index-cache" ) )
+                LoadFragmentsCache( p_demux );
+
             /* Probe remaining to check if there's really fragments
                or if that file is just ready to append fragments */
             ProbeFragments( p_demux, false );
             p_sys->b_fragmented = !!MP4_BoxCount( p_sys->p_root, "/moof" );
 
             if ( p_sys->b_fragmented && !p_sys->i_overall_duration )
-                ProbeFragments( p_demux, true );
+            {
+                if ( p_sys->p_cached_info )
+                    p_sys->i_overall_duration = p_sys->p_cached_info->i_overall_duration;
+                else
+                    ProbeFragments( p_demux, true );
+            }
 
             MP4_Box_t *p_mdat = MP4_BoxGet( p_sys->p_root, "mdat" );
             if ( p_mdat )
@@ -858,6 +937,8 @@ error:
     {
         MP4_BoxFree( p_sys->p_root );
     }
+    if( p_sys->p_index_cache )
+        index_cache_Close( p_sys->p_index_cache );
     free( p_sys );
     return VLC_EGENERIC;
 }
@@ -1631,6 +1712,12 @@ static void Close ( vlc_object_t * p_this )
 
     msg_Dbg( p_demux, "freeing all memory" );
 
+    if( p_sys->b_fragmented && p_sys->b_fragments_probed && !p_sys->p_index_cache &&
+        var_InheritBool( p_demux, "mp4-index-cache" ) )
+        SaveFragmentsCache( p_demux );
+    if( p_sys->p_index_cache )
+        index_cache_Close( p_sys->p_index_cache );
+
     MP4_BoxFree( p_sys->p_root );
     for( i_track = 0; i_track < p_sys->i_tracks; i_track++ )
     {
@@ -1642,6 +1729,7 @@ static void Close ( vlc_object_t * p_this )
         vlc_input_title_Delete( p_sys->p_title );
 
     MP4_Fragments_Clean( &p_sys->fragments );
+    free( p_sys->p_moofs );
 
     free( p_sys );
 }
@@ -1859,52 +1947,52 @@ static int TrackCreateChunksIndex( demux_t *p_demux,
     return VLC_SUCCESS;
 }
 
-static int xTTS_CountEntries( demux_t *p_demux, uint32_t *pi_entry /* out */,
-                              const uint32_t i_index,
-                              uint32_t i_index_samples_left,
-                              uint32_t i_sample_count,
-                              const uint32_t *pi_index_sample_count,
-                              const uint32_t i_table_count )
+/* Walks the runs of a stts or ctts table covering i_sample_count samples,
+ * starting at entry *pi_index with *pi_left samples left in it (0 for all).
+ * The runs are stored when p_counts is set, the time covered by them is
+ * added to *pi_dts when it is set. Returns the number of runs. */
+static uint32_t xTTS_Walk( const uint32_t *pi_table_count,
+                           const uint32_t *pi_table_value,
+                           uint32_t i_table_count,
+                           uint32_t *pi_index, uint32_t *pi_left,
+                           uint32_t i_sample_count,
+                           uint32_t *p_counts, uint32_t *p_values,
+                           uint64_t *pi_dts, uint64_t *pi_last_dts )
 {
-    uint32_t i_array_offset;
-    while( i_sample_count > 0 )
+    uint32_t i_runs = 0;
+
+    while( i_sample_count > 0 && *pi_index < i_table_count )
     {
-        if ( likely((UINT32_MAX - i_index) >= *pi_entry) )
-            i_array_offset = i_index + *pi_entry;
-        else
-            return VLC_EGENERIC;
+        const uint32_t i_avail = *pi_left ? *pi_left
+                                          : pi_table_count[*pi_index];
+        const uint32_t i_run = __MIN( i_avail, i_sample_count );
 
-        if ( i_array_offset >= i_table_count )
+        if( p_counts )
         {
-            msg_Err( p_demux, "invalid index counting total samples %u %u", i_array_offset,  i_table_count );
-            return VLC_ENOVAR;
+            p_counts[i_runs] = i_run;
+            p_values[i_runs] = pi_table_value[*pi_index];
         }
+        if( pi_dts )
+        {
+            if( i_run )
+                *pi_last_dts = *pi_dts;
+            *pi_dts += (uint64_t) i_run * pi_table_value[*pi_index];
+        }
+        i_runs++;
 
-        if ( i_index_samples_left )
+        i_sample_count -= i_run;
+        if( i_avail > i_run )
         {
-            if ( i_index_samples_left > i_sample_count )
-            {
-                i_index_samples_left -= i_sample_count;
-                i_sample_count = 0;
-                *pi_entry +=1; /* No samples left, go copy */
-                break;
-            }
-            else
-            {
-                i_sample_count -= i_index_samples_left;
-                i_index_samples_left = 0;
-                *pi_entry += 1;
-                continue;
-            }
+            *pi_left = i_avail - i_run;
         }
         else
         {
-            i_sample_count -= __MIN( i_sample_count, pi_index_sample_count[i_array_offset] );
-            *pi_entry += 1;
+            *pi_left = 0;
+            (*pi_index)++;
         }
     }
 
-    return VLC_SUCCESS;
+    return i_runs;
 }
 
 static int TrackCreateSamplesIndex( demux_t *p_demux,
@@ -1929,7 +2017,7 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
     }
     stsz = p_box->data.p_stsz;
 
-    /* Use stsz table to create a sample number -> sample size table */
+    /* Use stsz table as the sample number -> sample size table */
     p_demux_track->i_sample_count = stsz->i_sample_count;
     if( stsz->i_sample_size )
     {
@@ -1941,16 +2029,7 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
     {
         /* 2: each sample can have a different size */
         p_demux_track->i_sample_size = 0;
-        p_demux_track->p_sample_size =
-            calloc( p_demux_track->i_sample_count, sizeof( uint32_t ) );
-        if( p_demux_track->p_sample_size == NULL )
-            return VLC_ENOMEM;
-
-        for( uint32_t i_sample = 0; i_sample < p_demux_track->i_sample_count; i_sample++ )
-        {
-            p_demux_track->p_sample_size[i_sample] =
-                    stsz->i_entry_size[i_sample];
-        }
+        p_demux_track->p_sample_size = stsz->i_entry_size;
     }
 
     if ( p_demux_track->i_chunk_count )
@@ -1987,15 +2066,12 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
      *  for fast research (problem with raw stream where a sample is sometime
      *  just channels*bits_per_sample/8 */
 
-     /* FIXME: refactor STTS & CTTS, STTS having now only few extra lines and
-      *        differing in 2/2 fields and 1 signedness */
-
-    mtime_t i_next_dts = 0;
+    uint64_t i_next_dts = 0;
     /* Find stts
      *  Gives mapping between sample and decoding time
      */
     p_box = MP4_BoxGet( p_demux_track->p_stbl, "stts" );
-    if( !p_box )
+    if( !p_box || !p_box->data.p_stts )
     {
         msg_Warn( p_demux, "cannot find STTS box" );
         return VLC_EGENERIC;
@@ -2006,101 +2082,25 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
 
         msg_Warn( p_demux, "STTS table of %"PRIu32" entries", stts->i_entry_count );
 
-        /* Create sample -> dts table per chunk */
+        /* Save where each chunk starts in the table, and its dts range */
         uint32_t i_index = 0;
         uint32_t i_current_index_samples_left = 0;
 
         for( uint32_t i_chunk = 0; i_chunk < p_demux_track->i_chunk_count; i_chunk++ )
         {
             mp4_chunk_t *ck = &p_demux_track->chunk[i_chunk];
-            uint32_t i_sample_count;
-
-            /* save first dts */
-            ck->i_first_dts = i_next_dts;
-            ck->i_last_dts  = i_next_dts;
-
-            /* count how many entries are needed for this chunk
-             * for p_sample_delta_dts and p_sample_count_dts */
-            ck->i_entries_dts = 0;
-
-            int i_ret = xTTS_CountEntries( p_demux, &ck->i_entries_dts, i_index,
-                                           i_current_index_samples_left,
-                                           ck->i_sample_count,
-                                           stts->pi_sample_count,
-                                           stts->i_entry_count );
-            if ( i_ret == VLC_EGENERIC )
-                return i_ret;
-
-            /* allocate them */
-            ck->p_sample_count_dts = calloc( ck->i_entries_dts, sizeof( uint32_t ) );
-            ck->p_sample_delta_dts = calloc( ck->i_entries_dts, sizeof( uint32_t ) );
-            if( !ck->p_sample_count_dts || !ck->p_sample_delta_dts )
-            {
-                free( ck->p_sample_count_dts );
-                free( ck->p_sample_delta_dts );
-                msg_Err( p_demux, "can't allocate memory for i_entry=%"PRIu32, ck->i_entries_dts );
-                ck->i_entries_dts = 0;
-                return VLC_ENOMEM;
-            }
 
-            /* now copy */
-            i_sample_count = ck->i_sample_count;
-
-            for( uint32_t i = 0; i < ck->i_entries_dts; i++ )
-            {
-                if ( i_current_index_samples_left )
-                {
-                    if ( i_current_index_samples_left > i_sample_count )
-                    {
-                        if ( i_sample_count ) ck->i_last_dts = i_next_dts;
-                        ck->p_sample_count_dts[i] = i_sample_count;
-                        ck->p_sample_delta_dts[i] = stts->pi_sample_delta[i_index];
-                        i_next_dts += ck->p_sample_count_dts[i] * stts->pi_sample_delta[i_index];
-                        i_current_index_samples_left -= i_sample_count;
-                        i_sample_count = 0;
-                        assert( i == ck->i_entries_dts - 1 );
-                        break;
-                    }
-                    else
-                    {
-                        if ( i_current_index_samples_left ) ck->i_last_dts = i_next_dts;
-                        ck->p_sample_count_dts[i] = i_current_index_samples_left;
-                        ck->p_sample_delta_dts[i] = stts->pi_sample_delta[i_index];
-                        i_next_dts += ck->p_sample_count_dts[i] * stts->pi_sample_delta[i_index];
-                        i_sample_count -= i_current_index_samples_left;
-                        i_current_index_samples_left = 0;
-                        i_index++;
-                    }
-                }
-                else
-                {
-                    if ( stts->pi_sample_count[i_index] > i_sample_count )
-                    {
-                        if ( i_sample_count ) ck->i_last_dts = i_next_dts;
-                        ck->p_sample_count_dts[i] = i_sample_count;
-                        ck->p_sample_delta_dts[i] = stts->pi_sample_delta[i_index];
-                        i_next_dts += ck->p_sample_count_dts[i] * stts->pi_sample_delta[i_index];
-                        i_current_index_samples_left = stts->pi_sample_count[i_index] - i_sample_count;
-                        i_sample_count = 0;
-                        assert( i == ck->i_entries_dts - 1 );
-                        // keep building from same index
-                    }
-                    else
-                    {
-                        if ( stts->pi_sample_count[i_index] ) ck->i_last_dts = i_next_dts;
-                        ck->p_sample_count_dts[i] = stts->pi_sample_count[i_index];
-                        ck->p_sample_delta_dts[i] = stts->pi_sample_delta[i_index];
-                        i_next_dts += ck->p_sample_count_dts[i] * stts->pi_sample_delta[i_index];
-                        i_sample_count -= stts->pi_sample_count[i_index];
-                        i_index++;
-                    }
-                }
+            ck->i_stts_index = i_index;
+            ck->i_stts_left  = i_current_index_samples_left;
+            ck->i_first_dts  = i_next_dts;
+            ck->i_last_dts   = i_next_dts;
 
-            }
+            xTTS_Walk( stts->pi_sample_count, (const uint32_t *) stts->pi_sample_delta,
+                       stts->i_entry_count, &i_index, &i_current_index_samples_left,
+                       ck->i_sample_count, NULL, NULL, &i_next_dts, &ck->i_last_dts );
         }
     }
 
-
     /* Find ctts
      *  Gives the delta between decoding time (dts) and composition table (pts)
      */
@@ -2111,95 +2111,151 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
 
         msg_Warn( p_demux, "CTTS table of %"PRIu32" entries", ctts->i_entry_count );
 
-        /* Create pts-dts table per chunk */
         uint32_t i_index = 0;
         uint32_t i_current_index_samples_left = 0;
 
         for( uint32_t i_chunk = 0; i_chunk < p_demux_track->i_chunk_count; i_chunk++ )
         {
             mp4_chunk_t *ck = &p_demux_track->chunk[i_chunk];
-            uint32_t i_sample_count;
-
-            /* count how many entries are needed for this chunk
-             * for p_sample_offset_pts and p_sample_count_pts */
-            ck->i_entries_pts = 0;
-            int i_ret = xTTS_CountEntries( p_demux, &ck->i_entries_pts, i_index,
-                                           i_current_index_samples_left,
-                                           ck->i_sample_count,
-                                           ctts->pi_sample_count,
-                                           ctts->i_entry_count );
-            if ( i_ret == VLC_EGENERIC )
-                return i_ret;
-
-            /* allocate them */
-            ck->p_sample_count_pts = calloc( ck->i_entries_pts, sizeof( uint32_t ) );
-            ck->p_sample_offset_pts = calloc( ck->i_entries_pts, sizeof( int32_t ) );
-            if( !ck->p_sample_count_pts || !ck->p_sample_offset_pts )
-            {
-                free( ck->p_sample_count_pts );
-                free( ck->p_sample_offset_pts );
-                msg_Err( p_demux, "can't allocate memory for i_entry=%"PRIu32, ck->i_entries_pts );
-                ck->i_entries_pts = 0;
-                return VLC_ENOMEM;
-            }
 
-            /* now copy */
-            i_sample_count = ck->i_sample_count;
+            ck->i_ctts_index = i_index;
+            ck->i_ctts_left  = i_current_index_samples_left;
 
-            for( uint32_t i = 0; i < ck->i_entries_pts; i++ )
-            {
-                if ( i_current_index_samples_left )
-                {
-                    if ( i_current_index_samples_left > i_sample_count )
-                    {
-                        ck->p_sample_count_pts[i] = i_sample_count;
-                        ck->p_sample_offset_pts[i] = ctts->pi_sample_offset[i_index];
-                        i_current_index_samples_left -= i_sample_count;
-                        i_sample_count = 0;
-                        assert( i == ck->i_entries_pts - 1 );
-                        break;
-                    }
-                    else
-                    {
-                        ck->p_sample_count_pts[i] = i_current_index_samples_left;
-                        ck->p_sample_offset_pts[i] = ctts->pi_sample_offset[i_index];
-                        i_sample_count -= i_current_index_samples_left;
-                        i_current_index_samples_left = 0;
-                        i_index++;
-                    }
-                }
-                else
-                {
-                    if ( ctts->pi_sample_count[i_index] > i_sample_count )
-                    {
-                        ck->p_sample_count_pts[i] = i_sample_count;
-                        ck->p_sample_offset_pts[i] = ctts->pi_sample_offset[i_index];
-                        i_current_index_samples_left = ctts->pi_sample_count[i_index] - i_sample_count;
-                        i_sample_count = 0;
-                        assert( i == ck->i_entries_pts - 1 );
-                        // keep building from same index
-                    }
-                    else
-                    {
-                        ck->p_sample_count_pts[i] = ctts->pi_sample_count[i_index];
-                        ck->p_sample_offset_pts[i] = ctts->pi_sample_offset[i_index];
-                        i_sample_count -= ctts->pi_sample_count[i_index];
-                        i_index++;
-                    }
-                }
-
-
-            }
+            xTTS_Walk( ctts->pi_sample_count, (const uint32_t *) ctts->pi_sample_offset,
+                       ctts->i_entry_count, &i_index, &i_current_index_samples_left,
+                       ck->i_sample_count, NULL, NULL, NULL, NULL );
         }
     }
 
-    msg_Dbg( p_demux, "track[Id 0x%x] read %"PRIu32" samples length:%"PRId64"s",
+    /* Build the tables of the first chunks */
+    if( p_demux_track->i_chunk_count &&
+        TrackLoadTables( p_demux, p_demux_track, 0 ) )
+        return VLC_ENOMEM;
+
+    msg_Dbg( p_demux, "track[Id 0x%x] read %"PRIu32" samples length:%"PRIu64"s",
              p_demux_track->i_track_ID, p_demux_track->i_sample_count,
              i_next_dts / p_demux_track->i_timescale );
 
     return VLC_SUCCESS;
 }
 
+static void TrackReleaseTables( mp4_track_t *p_track )
+{
+    for( uint32_t i_chunk = p_track->i_tables_first;
+         i_chunk < p_track->i_tables_end; i_chunk++ )
+    {
+        mp4_chunk_t *ck = &p_track->chunk[i_chunk];
+
+        ck->i_entries_dts = 0;
+        ck->p_sample_count_dts = NULL;
+        ck->p_sample_delta_dts = NULL;
+        ck->i_entries_pts = 0;
+        ck->p_sample_count_pts = NULL;
+        ck->p_sample_offset_pts = NULL;
+    }
+    free( p_track->p_tables );
+    p_track->p_tables = NULL;
+    p_track->i_tables_first = 0;
+    p_track->i_tables_end = 0;
+}
+
+/* Builds the dts/pts tables of the chunks from i_chunk on, as long as they
+ * fit in the tables memory limit, replacing the previous ones.
+ * The first chunk always gets its tables. */
+static int TrackLoadTables( demux_t *p_demux, mp4_track_t *p_track,
+                            uint32_t i_chunk )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    const MP4_Box_t *p_box = MP4_BoxGet( p_track->p_stbl, "stts" );
+    const MP4_Box_data_stts_t *stts = p_box ? p_box->data.p_stts : NULL;
+    p_box = MP4_BoxGet( p_track->p_stbl, "ctts" );
+    const MP4_Box_data_ctts_t *ctts = p_box ? p_box->data.p_ctts : NULL;
+
+    if( stts == NULL )
+        return VLC_EGENERIC;
+
+    TrackReleaseTables( p_track );
+
+    /* count the runs of the chunks to load */
+    uint64_t i_runs = 0;
+    uint32_t i_end;
+    for( i_end = i_chunk; i_end < p_track->i_chunk_count; i_end++ )
+    {
+        const mp4_chunk_t *ck = &p_track->chunk[i_end];
+        uint32_t i_index = ck->i_stts_index;
+        uint32_t i_left = ck->i_stts_left;
+        uint64_t i_chunk_runs =
+            xTTS_Walk( stts->pi_sample_count, (const uint32_t *) stts->pi_sample_delta,
+                       stts->i_entry_count, &i_index, &i_left,
+                       ck->i_sample_count, NULL, NULL, NULL, NULL );
+        if( ctts )
+        {
+            i_index = ck->i_ctts_index;
+            i_left = ck->i_ctts_left;
+            i_chunk_runs +=
+                xTTS_Walk( ctts->pi_sample_count, (const uint32_t *) ctts->pi_sample_offset,
+                           ctts->i_entry_count, &i_index, &i_left,
+                           ck->i_sample_count, NULL, NULL, NULL, NULL );
+        }
+
+        if( i_end > i_chunk && p_sys->i_tables_max &&
+            ( i_runs + i_chunk_runs ) * 2 * sizeof(uint32_t) > p_sys->i_tables_max )
+            break;
+        i_runs += i_chunk_runs;
+    }
+
+    /* counts first, then deltas and offsets */
+    uint32_t *p_tables = NULL;
+    if( i_runs > 0 )
+    {
+        if( i_runs <= SIZE_MAX / ( 2 * sizeof(uint32_t) ) )
+            p_tables = malloc( i_runs * 2 * sizeof(uint32_t) );
+        if( unlikely( p_tables == NULL ) )
+        {
+            msg_Err( p_demux, "can't allocate memory for %"PRIu64" sample runs", i_runs );
+            return VLC_ENOMEM;
+        }
+    }
+
+    size_t i_offset = 0;
+    for( uint32_t i = i_chunk; i < i_end && p_tables; i++ )
+    {
+        mp4_chunk_t *ck = &p_track->chunk[i];
+        uint32_t i_index = ck->i_stts_index;
+        uint32_t i_left = ck->i_stts_left;
+
+        ck->p_sample_count_dts = &p_tables[i_offset];
+        ck->p_sample_delta_dts = &p_tables[i_runs + i_offset];
+        ck->i_entries_dts =
+            xTTS_Walk( stts->pi_sample_count, (const uint32_t *) stts->pi_sample_delta,
+                       stts->i_entry_count, &i_index, &i_left, ck->i_sample_count,
+                       ck->p_sample_count_dts, ck->p_sample_delta_dts, NULL, NULL );
+        i_offset += ck->i_entries_dts;
+
+        if( ctts )
+        {
+            i_index = ck->i_ctts_index;
+            i_left = ck->i_ctts_left;
+
+            ck->p_sample_count_pts = &p_tables[i_offset];
+            ck->p_sample_offset_pts = (int32_t *) &p_tables[i_runs + i_offset];
+            ck->i_entries_pts =
+                xTTS_Walk( ctts->pi_sample_count, (const uint32_t *) ctts->pi_sample_offset,
+                           ctts->i_entry_count, &i_index, &i_left, ck->i_sample_count,
+                           ck->p_sample_count_pts, (uint32_t *) ck->p_sample_offset_pts,
+                           NULL, NULL );
+            i_offset += ck->i_entries_pts;
+        }
+    }
+
+    p_track->p_tables = p_tables;
+    p_track->i_tables_first = i_chunk;
+    p_track->i_tables_end = i_end;
+
+    return VLC_SUCCESS;
+}
+
 
 /**
  * It computes the sample rate for a video track using the given sample
@@ -2404,29 +2460,28 @@ static int TrackTimeToSampleChunk( demux_t *p_demux, mp4_track_t *p_track,
         i_start = i_start * p_track->i_timescale / CLOCK_FREQ;
     }
 
-    /* we start from sample 0/chunk 0, hope it won't take too much time */
     /* *** find good chunk *** */
-    for( i_chunk = 0; ; i_chunk++ )
-    {
-        if( i_chunk + 1 >= p_track->i_chunk_count )
-        {
-            /* at the end and can't check if i_start in this chunk,
-               it will be check while searching i_sample */
-            i_chunk = p_track->i_chunk_count - 1;
-            break;
-        }
-
-        if( (uint64_t)i_start >= p_track->chunk[i_chunk].i_first_dts &&
-            (uint64_t)i_start <  p_track->chunk[i_chunk + 1].i_first_dts )
-        {
-            break;
-        }
+    /* the chunks dts are increasing, look for the last one starting
+       before i_start, the sample search will check the last chunk */
+    uint32_t i_lo = 0, i_hi = p_track->i_chunk_count;
+    while( i_hi - i_lo > 1 )
+    {
+        const uint32_t i_mid = i_lo + ( i_hi - i_lo ) / 2;
+        if( (uint64_t)i_start >= p_track->chunk[i_mid].i_first_dts )
+            i_lo = i_mid;
+        else
+            i_hi = i_mid;
     }
+    i_chunk = i_lo;
+
+    if( TrackEnsureTables( p_demux, p_track, i_chunk ) )
+        return VLC_EGENERIC;
 
     /* *** find sample in the chunk *** */
     i_sample = p_track->chunk[i_chunk].i_sample_first;
     i_dts    = p_track->chunk[i_chunk].i_first_dts;
-    for( i_index = 0; i_sample < p_track->chunk[i_chunk].i_sample_count; )
+    for( i_index = 0; i_sample < p_track->chunk[i_chunk].i_sample_count &&
+                      (uint32_t)i_index < p_track->chunk[i_chunk].i_entries_dts; )
     {
         if( i_dts +
             p_track->chunk[i_chunk].p_sample_count_dts[i_index] *
@@ -2887,6 +2942,7 @@ static void MP4_TrackDestroy( demux_t *p_demux, mp4_track_t *p_track )
 
     if( p_track->chunk )
     {
+        TrackReleaseTables( p_track );
         for( unsigned int i_chunk = 0; i_chunk < p_track->i_chunk_count; i_chunk++ )
             DestroyChunk( &p_track->chunk[i_chunk] );
     }
@@ -2899,9 +2955,6 @@ static void MP4_TrackDestroy( demux_t *p_demux, mp4_track_t *p_track )
         free( p_track->cchunk );
     }
 
-    if( !p_track->i_sample_size )
-        free( p_track->p_sample_size );
-
     if ( p_track->asfinfo.p_frame )
         block_ChainRelease( p_track->asfinfo.p_frame );
 }
@@ -4009,7 +4062,11 @@ static bool AddFragment( demux_t *p_demux, MP4_Box_t *p_moox )
     p_new->i_chunk_range_min_offset = i_traf_min_offset;
     p_new->i_chunk_range_max_offset = i_traf_min_offset + i_trafs_total_size;
 
-    MP4_Fragments_Insert( &p_sys->fragments, p_new );
+    if ( !MP4_Fragments_Insert( &p_sys->fragments, p_new ) )
+    {
+        MP4_Fragment_Delete( p_new );
+        return false;
+    }
     msg_Dbg( p_demux, "added fragment %4.4s", (char*) &p_moox->i_type );
 
 
@@ -4077,7 +4134,8 @@ static int ProbeFragments( demux_t *p_demux, bool b_force )
 
     assert( p_sys->p_root );
 
-    if ( p_sys->b_fastseekable || b_force )
+    /* a cached index spares reading all the fragments */
+    if ( ( p_sys->b_fastseekable && !p_sys->p_cached_info ) || b_force )
     {
         MP4_ReadBoxContainerChildren( p_demux->s, p_sys->p_root, NULL ); /* Get the rest of the file */
         p_sys->b_fragments_probed = true;
@@ -4301,7 +4359,7 @@ static inline mtime_t LeafGetMOOVTimeInChunk( const mp4_chunk_t *p_chunk, uint32
     mtime_t i_time = 0;
     uint32_t i_index = 0;
 
-    while( i_sample > 0 )
+    while( i_sample > 0 && i_index < p_chunk->i_entries_dts )
     {
         if( i_sample > p_chunk->p_sample_count_dts[i_index] )
         {
@@ -4370,6 +4428,8 @@ static int LeafParseMDATwithMOOV( demux_t *p_demux )
         }
         /**/
 
+        if( TrackEnsureTables( p_demux, p_track, i_chunk ) )
+            goto error;
         mp4_chunk_t *p_chunk = &p_track->chunk[i_chunk];
 
         uint32_t i_nb_samples_at_chunk_start = p_chunk->i_sample_first;
@@ -4554,57 +4614,277 @@ static int LeafMapTrafTrunContextes( demux_t *p_demux, MP4_Box_t *p_moof )
     return VLC_SUCCESS;
 }
 
-static int LeafIndexGetMoofPosByTime( demux_t *p_demux, const mtime_t i_target_time,
-                                      uint64_t *pi_pos, mtime_t *pi_mooftime )
+static void LoadFragmentsCache( demux_t *p_demux )
 {
-    MP4_Box_t *p_tfra = MP4_BoxGet( p_demux->p_sys->p_root, "mfra/tfra" );
-    while ( p_tfra )
+    demux_sys_t *p_sys = p_demux->p_sys;
+    size_t i_info, i_moofs;
+
+    MP4_Box_t *p_mvhd = MP4_BoxGet( p_sys->p_root, "/moov/mvhd" );
+    if( !p_mvhd || !BOXDATA(p_mvhd) )
+        return;
+
+    p_sys->p_index_cache = index_cache_Open( p_demux, MP4_INDEX_CACHE_FORMAT,
+                                             MP4_INDEX_CACHE_VERSION );
+    if( !p_sys->p_index_cache )
+        return;
+
+    const mp4_index_cache_info_t *p_info =
+            index_cache_Get( p_sys->p_index_cache, MP4_INDEX_CACHE_INFO, &i_info );
+    const mp4_moof_index_t *p_moofs =
+            index_cache_Get( p_sys->p_index_cache, MP4_INDEX_CACHE_MOOFS, &i_moofs );
+
+    if( !p_info || i_info != sizeof(*p_info) || !p_moofs ||
+        p_info->i_timescale != BOXDATA(p_mvhd)->i_timescale )
+    {
+        index_cache_Close( p_sys->p_index_cache );
+        p_sys->p_index_cache = NULL;
+        return;
+    }
+
+    p_sys->p_cached_info = p_info;
+    for( size_t i = 0; i < i_moofs / sizeof(*p_moofs); i++ )
+        LeafIndexAddMoof( p_demux, p_moofs[i].i_pos, p_moofs[i].i_time );
+    p_sys->b_moofs_indexed = true;
+    msg_Dbg( p_demux, "using %zu cached fragments", p_sys->i_moofs );
+}
+
+static void SaveFragmentsCache( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    mp4_fragment_t *p_moov = MP4_Fragment_Moov( &p_sys->fragments );
+
+    size_t i_moofs = 0;
+    for( mp4_fragment_t *p_fragment = p_moov->p_next; p_fragment; p_fragment = p_fragment->p_next )
+        i_moofs++;
+    if( !i_moofs || !p_sys->i_tracks )
+        return;
+
+    mp4_moof_index_t *p_moofs = malloc( i_moofs * sizeof(*p_moofs) );
+    stime_t *pi_times = calloc( p_sys->i_tracks, sizeof(*pi_times) );
+    if( !p_moofs || !pi_times )
+    {
+        free( p_moofs );
+        free( pi_times );
+        return;
+    }
+
+    /* Same as GetTrackFragmentTimeOffset(), without walking the list for
+     * each fragment. Fragments are indexed by their earliest track. */
+    i_moofs = 0;
+    for( mp4_fragment_t *p_fragment = p_moov; p_fragment; p_fragment = p_fragment->p_next )
     {
-        if ( p_tfra->i_type == ATOM_tfra )
+        if( p_fragment != p_moov )
         {
-            int64_t i_pos = -1;
-            const MP4_Box_data_tfra_t *p_data = BOXDATA(p_tfra);
-            mp4_track_t *p_track = MP4_frg_GetTrackByID( p_demux, p_data->i_track_ID );
-            if ( p_track && (p_track->fmt.i_cat == AUDIO_ES || p_track->fmt.i_cat == VIDEO_ES) )
+            stime_t i_time = pi_times[0];
+            for( unsigned i = 1; i < p_sys->i_tracks; i++ )
+                i_time = __MIN( i_time, pi_times[i] );
+            p_moofs[i_moofs].i_pos = p_fragment->p_moox->i_pos;
+            p_moofs[i_moofs++].i_time = i_time;
+        }
+        else if( !p_fragment->i_chunk_range_max_offset )
+            continue;
+
+        for( unsigned i = 0; i < p_sys->i_tracks; i++ )
+        {
+            for( unsigned j = 0; j < p_fragment->i_durations; j++ )
             {
-                for ( uint32_t i = 0; i<p_data->i_number_of_entries; i += ( p_data->i_version == 1 ) ? 2 : 1 )
+                if( p_fragment->p_durations[j].i_track_ID == p_sys->track[i].i_track_ID )
                 {
-                    mtime_t i_time;
-                    uint64_t i_offset;
-                    if ( p_data->i_version == 1 )
-                    {
-                        i_time = *((uint64_t *)(p_data->p_time + i));
-                        i_offset = *((uint64_t *)(p_data->p_moof_offset + i));
-                    }
-                    else
-                    {
-                        i_time = p_data->p_time[i];
-                        i_offset = p_data->p_moof_offset[i];
-                    }
-
-                    if ( CLOCK_FREQ * i_time / p_track->i_timescale >= i_target_time )
-                    {
-                        if ( i_pos == -1 ) /* Not in this traf */
-                            break;
-
-                        *pi_pos = (uint64_t) i_pos;
-                        *pi_mooftime = CLOCK_FREQ * i_time / p_track->i_timescale;
-                        if ( p_track->fmt.i_cat == AUDIO_ES )
-                            *pi_mooftime -= CLOCK_FREQ / p_track->fmt.audio.i_rate * p_data->p_sample_number[i];
-                        else
-                            *pi_mooftime -= CLOCK_FREQ / p_demux->p_sys->f_fps * p_data->p_sample_number[i];
-                        return VLC_SUCCESS;
-                    }
-                    else
-                        i_pos = i_offset;
+                    pi_times[i] += p_fragment->p_durations[j].i_duration;
+                    break;
                 }
             }
         }
-        p_tfra = p_tfra->p_next;
+    }
+
+    const mp4_index_cache_info_t info = {
+        .i_overall_duration = p_sys->i_overall_duration,
+        .i_timescale = p_sys->i_timescale,
+    };
+    const index_cache_record_t records[] = {
+        { MP4_INDEX_CACHE_INFO, &info, sizeof(info) },
+        { MP4_INDEX_CACHE_MOOFS, p_moofs, i_moofs * sizeof(*p_moofs) },
+    };
+    index_cache_Write( p_demux, MP4_INDEX_CACHE_FORMAT, MP4_INDEX_CACHE_VERSION,
+                       records, ARRAY_SIZE(records) );
+
+    free( pi_times );
+    free( p_moofs );
+}
+
+/* Adds a moof to the seek index, which is sorted by time */
+static void LeafIndexAddMoof( demux_t *p_demux, uint64_t i_pos, stime_t i_time )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    /* moofs are mostly added in order */
+    size_t i_insert = p_sys->i_moofs;
+    if( i_insert && p_sys->p_moofs[i_insert - 1].i_time > i_time )
+    {
+        size_t i_low = 0;
+        while( i_low < i_insert )
+        {
+            size_t i_mid = i_low + ( i_insert - i_low ) / 2;
+            if( p_sys->p_moofs[i_mid].i_time <= i_time )
+                i_low = i_mid + 1;
+            else
+                i_insert = i_mid;
+        }
+    }
+
+    if( ( i_insert > 0 && p_sys->p_moofs[i_insert - 1].i_pos == i_pos ) ||
+        ( i_insert < p_sys->i_moofs && p_sys->p_moofs[i_insert].i_pos == i_pos ) )
+        return;
+
+    if( p_sys->i_moofs == p_sys->i_moofs_alloc )
+    {
+        size_t i_alloc = __MAX( 64, p_sys->i_moofs_alloc * 2 );
+        mp4_moof_index_t *p_moofs = realloc( p_sys->p_moofs, i_alloc * sizeof(*p_moofs) );
+        if( unlikely( !p_moofs ) )
+            return;
+        p_sys->p_moofs = p_moofs;
+        p_sys->i_moofs_alloc = i_alloc;
+    }
+
+    memmove( &p_sys->p_moofs[i_insert + 1], &p_sys->p_moofs[i_insert],
+             ( p_sys->i_moofs - i_insert ) * sizeof(*p_sys->p_moofs) );
+    p_sys->p_moofs[i_insert].i_pos = i_pos;
+    p_sys->p_moofs[i_insert].i_time = i_time;
+    p_sys->i_moofs++;
+}
+
+static uint32_t TfraGetNumber( const uint8_t *p_array, uint8_t i_length_size, uint32_t i )
+{
+    switch( i_length_size )
+    {
+        case 0:
+            return p_array[i];
+        case 1:
+            return ((const uint16_t *) p_array)[i];
+        default:
+            return ((const uint32_t *) p_array)[i];
+    }
+}
+
+/* Indexes the moofs listed by the tfra of the first audio or video track */
+static int LeafIndexMoofsFromTfra( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    for ( MP4_Box_t *p_tfra = MP4_BoxGet( p_sys->p_root, "mfra/tfra" );
+          p_tfra; p_tfra = p_tfra->p_next )
+    {
+        if ( p_tfra->i_type != ATOM_tfra || !BOXDATA(p_tfra) )
+            continue;
+
+        const MP4_Box_data_tfra_t *p_data = BOXDATA(p_tfra);
+        mp4_track_t *p_track = MP4_frg_GetTrackByID( p_demux, p_data->i_track_ID );
+        if ( !p_track || !p_track->i_timescale || !p_data->i_number_of_entries ||
+             (p_track->fmt.i_cat != AUDIO_ES && p_track->fmt.i_cat != VIDEO_ES) )
+            continue;
+
+        uint32_t i_sample_duration = 0;
+        MP4_Box_t *p_trex = MP4_GetTrexByTrackID( MP4_BoxGet( p_sys->p_root, "moov" ),
+                                                  p_data->i_track_ID );
+        if ( p_trex && BOXDATA(p_trex) )
+            i_sample_duration = BOXDATA(p_trex)->i_default_sample_duration;
+
+        for ( uint32_t i = 0; i < p_data->i_number_of_entries; i++ )
+        {
+            uint64_t i_time, i_offset;
+            if ( p_data->i_version == 1 )
+            {
+                i_time = *((uint64_t *)(p_data->p_time + i * 2));
+                i_offset = *((uint64_t *)(p_data->p_moof_offset + i * 2));
+            }
+            else
+            {
+                i_time = p_data->p_time[i];
+                i_offset = p_data->p_moof_offset[i];
+            }
+
+            /* entries give the time of a sync sample, back to the moof start */
+            uint32_t i_sample = TfraGetNumber( p_data->p_sample_number,
+                                               p_data->i_length_size_of_sample_num, i );
+            if ( i_sample > 1 )
+                i_time -= __MIN( i_time, (uint64_t) (i_sample - 1) * i_sample_duration );
+
+            LeafIndexAddMoof( p_demux, i_offset,
+                              i_time * p_sys->i_timescale / p_track->i_timescale );
+        }
+
+        msg_Dbg( p_demux, "indexed %"PRIu32" fragments from tfra of track[Id 0x%x]",
+                 p_data->i_number_of_entries, p_track->i_track_ID );
+        return VLC_SUCCESS;
+    }
+    return VLC_EGENERIC;
+}
+
+/* Indexes the subsegments of the first top level sidx */
+static int LeafIndexMoofsFromSidx( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    for ( MP4_Box_t *p_sidx = MP4_BoxGet( p_sys->p_root, "sidx" );
+          p_sidx; p_sidx = p_sidx->p_next )
+    {
+        if ( p_sidx->i_type != ATOM_sidx || !BOXDATA(p_sidx) ||
+             !BOXDATA(p_sidx)->i_timescale )
+            continue;
+
+        const MP4_Box_data_sidx_t *p_data = BOXDATA(p_sidx);
+        uint64_t i_offset = p_sidx->i_pos + p_sidx->i_size + p_data->i_first_offset;
+        uint64_t i_time = p_data->i_earliest_presentation_time;
+
+        for ( uint16_t i = 0; i < p_data->i_reference_count; i++ )
+        {
+            /* references to other sidx only tell their size */
+            if ( !p_data->p_items[i].b_reference_type )
+                LeafIndexAddMoof( p_demux, i_offset,
+                                  i_time * p_sys->i_timescale / p_data->i_timescale );
+            i_offset += p_data->p_items[i].i_referenced_size;
+            i_time += p_data->p_items[i].i_subsegment_duration;
+        }
+
+        msg_Dbg( p_demux, "indexed %"PRIu16" fragments from sidx",
+                 p_data->i_reference_count );
+        return VLC_SUCCESS;
     }
     return VLC_EGENERIC;
 }
 
+/* Finds the last indexed moof starting before the target time */
+static int LeafIndexGetMoofPosByTime( demux_t *p_demux, const mtime_t i_target_time,
+                                      uint64_t *pi_pos, mtime_t *pi_mooftime )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    if( !p_sys->b_moofs_indexed )
+    {
+        if( LeafIndexMoofsFromTfra( p_demux ) != VLC_SUCCESS )
+            LeafIndexMoofsFromSidx( p_demux );
+        p_sys->b_moofs_indexed = true;
+    }
+
+    const stime_t i_target = i_target_time * p_sys->i_timescale / CLOCK_FREQ;
+    size_t i_low = 0, i_high = p_sys->i_moofs;
+    while( i_low < i_high )
+    {
+        size_t i_mid = i_low + ( i_high - i_low ) / 2;
+        if( p_sys->p_moofs[i_mid].i_time <= i_target )
+            i_low = i_mid + 1;
+        else
+            i_high = i_mid;
+    }
+    if( i_low == 0 )
+        return VLC_EGENERIC;
+
+    const mp4_moof_index_t *p_moof = &p_sys->p_moofs[i_low - 1];
+    *pi_pos = p_moof->i_pos;
+    *pi_mooftime = CLOCK_FREQ * p_moof->i_time / p_sys->i_timescale;
+    return VLC_SUCCESS;
+}
+
 static void MP4_GetDefaultSizeAndDuration( demux_t *p_demux,
                                            const MP4_Box_data_tfhd_t *p_tfhd_data,
                                            uint32_t *pi_default_size,
@@ -4765,7 +5045,16 @@ static int DemuxAsLeaf( demux_t *p_demux )
         if ( p_sys->context.i_current_box_type != ATOM_mdat )
         {
             const int i_tell = stream_Tell( p_demux->s );
-            if ( i_tell >= 0 && ! BoxExistsInRootTree( p_sys->p_root, p_sys->context.i_current_box_type, (uint64_t)i_tell ) )
+            bool b_known = false;
+            if ( i_tell >= 0 )
+            {
+                /* moofs are looked up in the fragments index */
+                if ( p_sys->context.i_current_box_type == ATOM_moof )
+                    b_known = GetFragmentByAtomPos( &p_sys->fragments, i_tell ) != NULL;
+                else
+                    b_known = BoxExistsInRootTree( p_sys->p_root, p_sys->context.i_current_box_type, (uint64_t)i_tell );
+            }
+            if ( i_tell >= 0 && !b_known )
             {// only if !b_probed ??
                 MP4_Box_t *p_vroot = MP4_BoxGetNextChunk( p_demux->s );
                 if(!p_vroot)
@@ -4830,7 +5119,8 @@ static int DemuxAsLeaf( demux_t *p_demux )
                 p_fragbox->p_next = NULL;
 
                 /* create fragment */
-                AddFragment( p_demux, p_fragbox );
+                if( AddFragment( p_demux, p_fragbox ) && p_fragbox->i_type == ATOM_moof )
+                    LeafIndexAddMoof( p_demux, p_fragbox->i_pos, p_sys->i_time );
 
                 /* Append to root */
                 p_sys->p_root->p_last->p_next = p_fragbox;
@@ -58,6 +58,13 @@ typedef struct
     uint32_t     *p_sample_count_pts;
     int32_t      *p_sample_offset_pts;  /* pts-dts */
 
+    /* stts and ctts entries of the first sample, and samples left in them
+       (0 for all), the tables above are built from there when needed */
+    uint32_t     i_stts_index;
+    uint32_t     i_stts_left;
+    uint32_t     i_ctts_index;
+    uint32_t     i_ctts_left;
+
     uint8_t      **p_sample_data;     /* set when b_fragmented is true */
     uint32_t     *p_sample_size;
     /* TODO if needed add pts
@@ -108,11 +115,16 @@ typedef struct
     mp4_chunk_t    *chunk; /* always defined  for each chunk */
     mp4_chunk_t    *cchunk; /* current chunk if b_fragmented is true */
 
+    /* the dts/pts tables are only built for the chunks
+       [i_tables_first, i_tables_end[, in a single p_tables allocation */
+    uint32_t         i_tables_first;
+    uint32_t         i_tables_end;
+    uint32_t        *p_tables;
+
     /* sample size, p_sample_size defined only if i_sample_size == 0
         else i_sample_size is size for all sample */
     uint32_t         i_sample_size;
-    uint32_t         *p_sample_size; /* XXX perhaps add file offset if take
-                                    too much time to do sumations each time*/
+    const uint32_t   *p_sample_size; /* points to the stsz entries */
 
     uint32_t     i_sample_first; /* i_sample_first value
                                                    of the next chunk */
@@ -51,6 +51,8 @@
 
 #include "ts_hotfixes.h"
 #include "ts_sl.h"
+#include "ts_workers.h"
+#include "ts_index.h"
 #include "sections.h"
 #include "pes.h"
 #include "timestamps.h"
@@ -131,6 +133,28 @@ static const char *const arib_mode_list_text[] =
 
 #define ATSC_MODE_TEXT N_("ATSC")
 
+#define PROGRAM_THREADS_TEXT N_("Program threads")
+#define PROGRAM_THREADS_LONGTEXT N_( \
+    "Number of threads gathering the PES of the programs, each program " \
+    "being handled by one of them. This helps demuxing several programs " \
+    "of high bitrate multiplexes. 0 demuxes everything on the input thread." )
+
+#define INDEX_PRESCAN_TEXT N_("Index the PCR in the background")
+#define INDEX_PRESCAN_LONGTEXT N_( \
+    "Read the whole file in the background to find the positions of the " \
+    "program clocks, so that seeking does not need to search for them." )
+
+#define INDEX_CACHE_TEXT N_("Cache the seek index")
+#define INDEX_CACHE_LONGTEXT N_( \
+    "Keep the positions of the program clocks of local files in the " \
+    "cache directory, so that seeking in them is fast when opening them again." )
+
+#define READ_BATCH_TEXT N_("Packets read at once")
+#define READ_BATCH_LONGTEXT N_( \
+    "Number of TS packets read at once from the input. Larger values " \
+    "lower the cost of demuxing high bitrate streams, at the expense " \
+    "of latency on low bitrate live streams." )
+
 vlc_module_begin ()
     set_description( N_("MPEG Transport Stream demuxer") )
     set_shortname ( "MPEG-TS" )
@@ -159,6 +183,14 @@ vlc_module_begin ()
 
     add_bool( "ts-atsc", false, ATSC_MODE_TEXT, NULL, false )
 
+    add_integer_with_range( "ts-read-batch", 32, 4, 1024,
+                            READ_BATCH_TEXT, READ_BATCH_LONGTEXT, true )
+    add_integer_with_range( "ts-program-threads", 0, 0, 32,
+                            PROGRAM_THREADS_TEXT, PROGRAM_THREADS_LONGTEXT, true )
+
+    add_bool( "ts-index-prescan", false, INDEX_PRESCAN_TEXT, INDEX_PRESCAN_LONGTEXT, true )
+    add_bool( "ts-index-cache", false, INDEX_CACHE_TEXT, INDEX_CACHE_LONGTEXT, true )
+
     add_obsolete_bool( "ts-silent" );
 
     set_capability( "demux", 10 )
@@ -179,9 +211,9 @@ static bool PIDReferencedByProgram( const ts_pmt_t *, uint16_t );
 void UpdatePESFilters( demux_t *p_demux, bool b_all );
 static inline void FlushESBuffer( ts_pes_t *p_pes );
 static void UpdatePIDScrambledState( demux_t *p_demux, ts_pid_t *p_pid, bool );
-static inline int PIDGet( block_t *p )
+static inline int PIDGet( const uint8_t *p )
 {
-    return ( (p->p_buffer[1]&0x1f)<<8 )|p->p_buffer[2];
+    return ( (p[1]&0x1f)<<8 )|p[2];
 }
 
 static bool ProcessTSPacket( demux_t *p_demux, ts_pid_t *pid, block_t *p_pkt );
@@ -189,11 +221,27 @@ static bool GatherPESData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk, size_
 static void ProgramSetPCR( demux_t *p_demux, ts_pmt_t *p_prg, mtime_t i_pcr );
 
 static block_t* ReadTSPacket( demux_t *p_demux );
+static uint8_t *ReadBatchedTSPacket( demux_t *p_demux );
+static void ResetTSBatch( demux_sys_t *p_sys );
 static int SeekToTime( demux_t *p_demux, const ts_pmt_t *, int64_t time );
 static void ReadyQueuesPostSeek( demux_t *p_demux );
-static void PCRHandle( demux_t *p_demux, ts_pid_t *, block_t * );
+static void PCRHandle( demux_t *p_demux, ts_pid_t *, const uint8_t * );
 static void PCRFixHandle( demux_t *, ts_pmt_t *, block_t * );
 
+static mtime_t GetPCR( const uint8_t * );
+static block_t *CopyTSPacket( const uint8_t *, size_t );
+static bool ProcessProgramPacket( demux_t *, ts_pid_t *, block_t *, bool );
+static bool DispatchTSPacket( demux_t *, ts_pid_t *, block_t *, bool );
+
+static void IndexPCR( demux_t *, const ts_pid_t *, const uint8_t * );
+static void StartIndexScan( demux_t * );
+
+void DrainWorkers( demux_sys_t *p_sys )
+{
+    if( p_sys->p_workers )
+        ts_workers_Drain( p_sys->p_workers );
+}
+
 #define TS_PACKET_SIZE_188 188
 #define TS_PACKET_SIZE_192 192
 #define TS_PACKET_SIZE_204 204
@@ -401,6 +449,13 @@ static int Open( vlc_object_t *p_this )
     p_sys->i_packet_size = i_packet_size;
     p_sys->i_packet_header_size = i_packet_header_size;
     p_sys->i_ts_read = 50;
+    p_sys->batch.i_packets = VLC_CLIP( var_InheritInteger( p_demux, "ts-read-batch" ), 4, 1024 );
+    p_sys->batch.p_buffer = NULL;
+    p_sys->batch.i_size = p_sys->batch.i_synced = p_sys->batch.i_offset = 0;
+    p_sys->batch.b_lost = false;
+    p_sys->p_workers = NULL;
+    p_sys->i_next_worker = 0;
+    p_sys->p_index = NULL;
     p_sys->csa = NULL;
     p_sys->b_start_record = false;
 
@@ -531,6 +586,13 @@ static int Open( vlc_object_t *p_this )
     stream_Control( p_sys->stream, STREAM_CAN_SEEK, &p_sys->b_canseek );
     stream_Control( p_sys->stream, STREAM_CAN_FASTSEEK, &p_sys->b_canfastseek );
 
+    if( p_sys->b_canseek )
+    {
+        p_sys->p_index = ts_index_New();
+        if( p_sys->p_index && var_InheritBool( p_demux, "ts-index-cache" ) )
+            ts_index_Load( p_sys->p_index, p_demux );
+    }
+
     /* Preparse time */
     if( p_sys->b_canseek )
     {
@@ -543,6 +605,14 @@ static int Open( vlc_object_t *p_this )
     else
         p_sys->es_creation = ( p_sys->b_access_control ? CREATE_ES : DELAY_ES );
 
+    if( p_sys->p_index && var_InheritBool( p_demux, "ts-index-prescan" ) )
+        StartIndexScan( p_demux );
+
+    unsigned i_threads = var_InheritInteger( p_demux, "ts-program-threads" );
+    if( i_threads > 0 )
+        p_sys->p_workers = ts_workers_New( p_demux, __MIN(i_threads, 32),
+                                           ProcessProgramPacket );
+
     return VLC_SUCCESS;
 }
 
@@ -554,6 +624,17 @@ static void Close( vlc_object_t *p_this )
     demux_t     *p_demux = (demux_t*)p_this;
     demux_sys_t *p_sys = p_demux->p_sys;
 
+    if( p_sys->p_workers )
+        ts_workers_Delete( p_sys->p_workers );
+
+    if( p_sys->p_index )
+    {
+        ts_index_StopScan( p_sys->p_index );
+        if( var_InheritBool( p_demux, "ts-index-cache" ) )
+            ts_index_Save( p_sys->p_index, p_demux );
+        ts_index_Delete( p_sys->p_index );
+    }
+
     PIDRelease( p_demux, GetPID(p_sys, 0) );
 
     if( p_sys->b_dvb_meta )
@@ -590,6 +671,7 @@ static void Close( vlc_object_t *p_this )
     /* Release all non default pids */
     ts_pid_list_Release( p_demux, &p_sys->pids );
 
+    free( p_sys->batch.p_buffer );
     free( p_sys );
 }
 
@@ -630,13 +712,16 @@ static int Demux( demux_t *p_demux )
         p_sys->patfix.status = PAT_FIXTRIED;
     }
 
+    const size_t i_pkt_size = p_sys->i_packet_size - p_sys->i_packet_header_size;
+
     /* We read at most 100 TS packet or until a frame is completed */
     for( unsigned i_pkt = 0; i_pkt < p_sys->i_ts_read; i_pkt++ )
     {
         bool         b_frame = false;
-        block_t     *p_pkt;
-        if( !(p_pkt = ReadTSPacket( p_demux )) )
+        uint8_t     *p_pkt;
+        if( !(p_pkt = ReadBatchedTSPacket( p_demux )) )
         {
+            DrainWorkers( p_sys );
             return VLC_DEMUXER_EOF;
         }
 
@@ -650,10 +735,11 @@ static int Demux( demux_t *p_demux )
         /* Parse the TS packet */
         ts_pid_t *p_pid = GetPID( p_sys, PIDGet( p_pkt ) );
 
-        if( (p_pkt->p_buffer[1] & 0x40) && (p_pkt->p_buffer[3] & 0x10) &&
-            !SCRAMBLED(*p_pid) != !(p_pkt->p_buffer[3] & 0x80) )
+        if( (p_pkt[1] & 0x40) && (p_pkt[3] & 0x10) &&
+            !SCRAMBLED(*p_pid) != !(p_pkt[3] & 0x80) )
         {
-            UpdatePIDScrambledState( p_demux, p_pid, p_pkt->p_buffer[3] & 0x80 );
+            DrainWorkers( p_sys );
+            UpdatePIDScrambledState( p_demux, p_pid, p_pkt[3] & 0x80 );
         }
 
         if( !SEEN(p_pid) )
@@ -663,33 +749,36 @@ static int Demux( demux_t *p_demux )
             p_pid->i_flags |= FLAG_SEEN;
         }
 
+        if( p_sys->p_index )
+            IndexPCR( p_demux, p_pid, p_pkt );
+
         if ( SCRAMBLED(*p_pid) && !p_demux->p_sys->csa )
         {
-            PCRHandle( p_demux, p_pid, p_pkt );
-            block_Release( p_pkt );
+            if( !p_sys->p_workers )
+                PCRHandle( p_demux, p_pid, p_pkt );
+            else if( GetPCR( p_pkt ) >= 0 )
+                DispatchTSPacket( p_demux, p_pid, CopyTSPacket( p_pkt, i_pkt_size ), true );
             continue;
         }
 
         /* Probe streams to build PAT/PMT after MIN_PAT_INTERVAL in case we don't see any PAT */
         if( !SEEN( GetPID( p_sys, 0 ) ) &&
             (p_pid->probed.i_type == 0 || p_pid->i_pid == p_sys->patfix.i_timesourcepid) &&
-            (p_pkt->p_buffer[1] & 0xC0) == 0x40 && /* Payload start but not corrupt */
-            (p_pkt->p_buffer[3] & 0xD0) == 0x10 )  /* Has payload but is not encrypted */
+            (p_pkt[1] & 0xC0) == 0x40 && /* Payload start but not corrupt */
+            (p_pkt[3] & 0xD0) == 0x10 )  /* Has payload but is not encrypted */
         {
-            ProbePES( p_demux, p_pid, p_pkt->p_buffer + TS_HEADER_SIZE,
-                      p_pkt->i_buffer - TS_HEADER_SIZE, p_pkt->p_buffer[3] & 0x20 /* Adaptation field */);
+            ProbePES( p_demux, p_pid, p_pkt + TS_HEADER_SIZE,
+                      i_pkt_size - TS_HEADER_SIZE, p_pkt[3] & 0x20 /* Adaptation field */);
         }
 
         switch( p_pid->type )
         {
         case TYPE_PAT:
-            dvbpsi_packet_push( p_pid->u.p_pat->handle, p_pkt->p_buffer );
-            block_Release( p_pkt );
+            dvbpsi_packet_push( p_pid->u.p_pat->handle, p_pkt );
             break;
 
         case TYPE_PMT:
-            dvbpsi_packet_push( p_pid->u.p_pmt->handle, p_pkt->p_buffer );
-            block_Release( p_pkt );
+            dvbpsi_packet_push( p_pid->u.p_pmt->handle, p_pkt );
             break;
 
         case TYPE_PES:
@@ -697,6 +786,7 @@ static int Demux( demux_t *p_demux )
 
             if( p_sys->es_creation == DELAY_ES ) /* No longer delay ES since that pid's program sends data */
             {
+                DrainWorkers( p_sys );
                 msg_Dbg( p_demux, "Creating delayed ES" );
                 AddAndCreateES( p_demux, p_pid, true );
             }
@@ -705,31 +795,37 @@ static int Demux( demux_t *p_demux )
             if( !p_sys->b_access_control && !(p_pid->i_flags & FLAG_FILTERED) )
             {
                 /* That packet is for an unselected ES, don't waste time/memory gathering its data */
-                block_Release( p_pkt );
                 continue;
             }
 
-            b_frame = ProcessTSPacket( p_demux, p_pid, p_pkt );
+            /* Only the packets gathered into PES get their own block */
+            block_t *p_block = CopyTSPacket( p_pkt, i_pkt_size );
+            if( unlikely(p_block == NULL) )
+                break;
+            if( p_sys->p_workers )
+                b_frame = DispatchTSPacket( p_demux, p_pid, p_block, false );
+            else
+                b_frame = ProcessTSPacket( p_demux, p_pid, p_block );
             break;
 
         case TYPE_SDT:
         case TYPE_TDT:
         case TYPE_EIT:
             if( p_sys->b_dvb_meta )
-                dvbpsi_packet_push( p_pid->u.p_psi->handle, p_pkt->p_buffer );
-            block_Release( p_pkt );
+                dvbpsi_packet_push( p_pid->u.p_psi->handle, p_pkt );
             break;
 
         case TYPE_PSIP:
             if( p_pid->u.p_psip->handle->p_decoder )
-                dvbpsi_packet_push( p_pid->u.p_psip->handle, p_pkt->p_buffer );
-            block_Release( p_pkt );
+                dvbpsi_packet_push( p_pid->u.p_psip->handle, p_pkt );
             break;
 
         default:
             /* We have to handle PCR if present */
-            PCRHandle( p_demux, p_pid, p_pkt );
-            block_Release( p_pkt );
+            if( !p_sys->p_workers )
+                PCRHandle( p_demux, p_pid, p_pkt );
+            else if( GetPCR( p_pkt ) >= 0 )
+                DispatchTSPacket( p_demux, p_pid, CopyTSPacket( p_pkt, i_pkt_size ), true );
             break;
         }
 
@@ -874,6 +970,9 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
     const ts_pmt_t *p_pmt = NULL;
     const ts_pat_t *p_pat = GetPID(p_sys, 0)->u.p_pat;
 
+    /* the programs must be at rest to be queried or changed */
+    DrainWorkers( p_sys );
+
     for( int i=0; i<p_pat->programs.i_size && !p_pmt; i++ )
     {
         if( p_pat->programs.p_elems[i]->u.p_pmt->b_selected )
@@ -918,7 +1017,9 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
 
         if( (i64 = stream_Size( p_sys->stream) ) > 0 )
         {
-            int64_t offset = stream_Tell( p_sys->stream );
+            /* the packets read ahead are not demuxed yet */
+            int64_t offset = stream_Tell( p_sys->stream ) -
+                             ( p_sys->batch.i_size - p_sys->batch.i_offset );
             *pf = (double)offset / (double)i64;
             return VLC_SUCCESS;
         }
@@ -1094,10 +1195,16 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
     }
 
     case DEMUX_SET_TITLE:
-        return stream_vaControl( p_sys->stream, STREAM_SET_TITLE, args );
+        if( stream_vaControl( p_sys->stream, STREAM_SET_TITLE, args ) )
+            return VLC_EGENERIC;
+        ResetTSBatch( p_sys );
+        return VLC_SUCCESS;
 
     case DEMUX_SET_SEEKPOINT:
-        return stream_vaControl( p_sys->stream, STREAM_SET_SEEKPOINT, args );
+        if( stream_vaControl( p_sys->stream, STREAM_SET_SEEKPOINT, args ) )
+            return VLC_EGENERIC;
+        ResetTSBatch( p_sys );
+        return VLC_SUCCESS;
 
     case DEMUX_GET_META:
         return stream_vaControl( p_sys->stream, STREAM_GET_META, args );
@@ -1678,10 +1785,120 @@ static block_t* ReadTSPacket( demux_t *p_demux )
     return p_pkt;
 }
 
-static mtime_t GetPCR( block_t *p_pkt )
+static void ResetTSBatch( demux_sys_t *p_sys )
 {
-    const uint8_t *p = p_pkt->p_buffer;
+    p_sys->batch.i_size = p_sys->batch.i_synced = p_sys->batch.i_offset = 0;
+}
+
+/* Reads the next packets after the ones left in the batch */
+static bool FillTSBatch( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const size_t i_alloc = (size_t) p_sys->batch.i_packets * p_sys->i_packet_size;
+
+    if( unlikely(p_sys->batch.p_buffer == NULL) )
+    {
+        p_sys->batch.p_buffer = malloc( i_alloc );
+        if( unlikely(p_sys->batch.p_buffer == NULL) )
+            return false;
+    }
+
+    const size_t i_left = p_sys->batch.i_size - p_sys->batch.i_offset;
+    memmove( p_sys->batch.p_buffer, &p_sys->batch.p_buffer[p_sys->batch.i_offset], i_left );
+    p_sys->batch.i_size = i_left;
+    p_sys->batch.i_synced = p_sys->batch.i_offset = 0;
+
+    ssize_t i_read = stream_Read( p_sys->stream, &p_sys->batch.p_buffer[i_left],
+                                  i_alloc - i_left );
+    if( i_read <= 0 )
+    {
+        int64_t size = stream_Size( p_sys->stream );
+        if( size >= 0 && (uint64_t)size == stream_Tell( p_sys->stream ) )
+            msg_Dbg( p_demux, "EOF at %"PRId64, stream_Tell( p_sys->stream ) );
+        else
+            msg_Dbg( p_demux, "Can't read TS packet at %"PRId64, stream_Tell(p_sys->stream) );
+        return false;
+    }
+    p_sys->batch.i_size += i_read;
+    return true;
+}
+
+/* Checks the sync bytes of the packets read, skipping garbage.
+ * Returns false if more data is needed */
+static bool SyncTSBatch( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const uint8_t *p_buffer = p_sys->batch.p_buffer;
+    const size_t i_packet = p_sys->i_packet_size;
+    const size_t i_header = p_sys->i_packet_header_size;
+    const size_t i_size = p_sys->batch.i_size;
+
+    for( ;; )
+    {
+        /* A single byte per packet, which stays in the cache lines of the
+         * read, checking them all upfront keeps the per packet loop free */
+        size_t i_pos = p_sys->batch.i_offset;
+        while( i_pos + i_packet <= i_size && p_buffer[i_pos + i_header] == 0x47 )
+            i_pos += i_packet;
+
+        if( i_pos > p_sys->batch.i_offset )
+        {
+            p_sys->batch.i_synced = i_pos;
+            p_sys->batch.b_lost = false;
+            return true;
+        }
+
+        /* not enough data to check a packet and the next sync byte */
+        if( i_pos + i_packet + i_header + 2 > i_size )
+            return false;
+
+        if( !p_sys->batch.b_lost )
+        {
+            msg_Warn( p_demux, "lost synchro" );
+            p_sys->batch.b_lost = true;
+        }
+
+        /* Look for a sync byte followed by another one a packet later,
+         * memchr being vectorized by the C library */
+        const uint8_t *p = &p_buffer[i_pos + i_header + 1];
+        const uint8_t *p_end = &p_buffer[i_size - i_packet];
+        while( p < p_end && (p = memchr( p, 0x47, p_end - p )) != NULL &&
+               p[i_packet] != 0x47 )
+            p++;
+
+        size_t i_skip;
+        if( p != NULL && p < p_end )
+            i_skip = p - p_buffer - i_header - i_pos;
+        else /* the remaining data cannot be checked yet */
+            i_skip = i_size - i_packet - i_header - i_pos;
+
+        msg_Dbg( p_demux, "skipping %zu bytes of garbage", i_skip );
+        p_sys->batch.i_offset += i_skip;
+        p_sys->batch.i_synced = p_sys->batch.i_offset;
+        if( p == NULL || p >= p_end )
+            return false;
+    }
+}
+
+/* Returns the next packet, without its header, from the data read ahead.
+ * It remains valid until the next read. */
+static uint8_t *ReadBatchedTSPacket( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    while( p_sys->batch.i_offset == p_sys->batch.i_synced )
+    {
+        if( !SyncTSBatch( p_demux ) && !FillTSBatch( p_demux ) )
+            return NULL;
+    }
+
+    uint8_t *p_pkt = &p_sys->batch.p_buffer[p_sys->batch.i_offset];
+    p_sys->batch.i_offset += p_sys->i_packet_size;
+    return p_pkt + p_sys->i_packet_header_size;
+}
 
+static mtime_t GetPCR( const uint8_t *p )
+{
     mtime_t i_pcr = -1;
 
     if( ( p[3]&0x20 ) && /* adaptation */
@@ -1748,6 +1965,8 @@ static void ReadyQueuesPostSeek( demux_t *p_demux )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
 
+    ResetTSBatch( p_sys );
+
     ts_pat_t *p_pat = GetPID(p_sys, 0)->u.p_pat;
     for( int i=0; i< p_pat->programs.i_size; i++ )
     {
@@ -1786,6 +2005,8 @@ static void ReadyQueuesPostSeek( demux_t *p_demux )
             FlushESBuffer( pid->u.p_pes );
         }
         p_pmt->pcr.i_current = -1;
+        /* back to the demux thread until its clock is settled again */
+        p_pmt->i_worker = -1;
     }
 }
 
@@ -1797,14 +2018,32 @@ static int SeekToTime( demux_t *p_demux, const ts_pmt_t *p_pmt, int64_t i_scaled
     if( p_pmt->pcr.i_first == i_scaledtime && p_sys->b_canseek )
         return stream_Seek( p_sys->stream, 0 );
 
+    /* Start with the indexed PCR around that time */
+    ts_index_point_t before, after;
+    if( p_sys->p_index &&
+        ts_index_Find( p_sys->p_index, p_pmt->i_number, i_scaledtime - p_pmt->pcr.i_first,
+                       &before, &after ) &&
+        before.i_pos > -1 &&
+        i_scaledtime - p_pmt->pcr.i_first - before.i_time < TO_SCALE(VLC_TS_0 + CLOCK_FREQ / 2) &&
+        stream_Seek( p_sys->stream, before.i_pos ) == VLC_SUCCESS )
+        return VLC_SUCCESS;
+
     if( !p_sys->b_canfastseek )
         return VLC_EGENERIC;
 
     int64_t i_initial_pos = stream_Tell( p_sys->stream );
 
-    /* Find the time position by using binary search algorithm. */
+    /* Find the time position by using binary search algorithm,
+       between the closest indexed positions */
     int64_t i_head_pos = 0;
     int64_t i_tail_pos = stream_Size( p_sys->stream ) - p_sys->i_packet_size;
+    if( p_sys->p_index )
+    {
+        if( before.i_pos > -1 )
+            i_head_pos = before.i_pos;
+        if( after.i_pos > -1 && after.i_pos < i_tail_pos )
+            i_tail_pos = after.i_pos;
+    }
     if( i_head_pos >= i_tail_pos )
         return VLC_EGENERIC;
 
@@ -1832,7 +2071,7 @@ static int SeekToTime( demux_t *p_demux, const ts_pmt_t *p_pmt, int64_t i_scaled
             else
                 i_pos = stream_Tell( p_sys->stream );
 
-            int i_pid = PIDGet( p_pkt );
+            int i_pid = PIDGet( p_pkt->p_buffer );
             ts_pid_t *p_pid = GetPID(p_sys, i_pid);
             if( i_pid != 0x1FFF && p_pid->type == TYPE_PES &&
                 ts_pes_Find_es( p_pid->u.p_pes, p_pmt ) &&
@@ -1845,7 +2084,7 @@ static int SeekToTime( demux_t *p_demux, const ts_pmt_t *p_pmt, int64_t i_scaled
                 {
                     if( p_pkt->i_buffer >= 4 + 2 + 5 )
                     {
-                        i_pcr = GetPCR( p_pkt );
+                        i_pcr = GetPCR( p_pkt->p_buffer );
                         i_skip += 1 + p_pkt->p_buffer[4];
                     }
                 }
@@ -1908,7 +2147,7 @@ static int ProbeChunk( demux_t *p_demux, int i_program, bool b_end, int64_t *pi_
             break;
         }
 
-        const int i_pid = PIDGet( p_pkt );
+        const int i_pid = PIDGet( p_pkt->p_buffer );
         ts_pid_t *p_pid = GetPID(p_sys, i_pid);
 
         p_pid->i_flags |= FLAG_SEEN;
@@ -1919,7 +2158,7 @@ static int ProbeChunk( demux_t *p_demux, int i_program, bool b_end, int64_t *pi_
             bool b_adaptfield = p_pkt->p_buffer[3] & 0x20;
 
             if( b_adaptfield && p_pkt->i_buffer >= 4 + 2 + 5 )
-                *pi_pcr = GetPCR( p_pkt );
+                *pi_pcr = GetPCR( p_pkt->p_buffer );
 
             if( *pi_pcr == -1 &&
                 (p_pkt->p_buffer[1] & 0xC0) == 0x40 && /* payload start */
@@ -2142,11 +2381,11 @@ static void PCRCheckDTS( demux_t *p_demux, ts_pmt_t *p_pmt, mtime_t i_pcr)
     }
 }
 
-static void PCRHandle( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
+static void PCRHandle( demux_t *p_demux, ts_pid_t *pid, const uint8_t *p_pkt )
 {
     demux_sys_t   *p_sys = p_demux->p_sys;
 
-    mtime_t i_pcr = GetPCR( p_bk );
+    mtime_t i_pcr = GetPCR( p_pkt );
     if( i_pcr < 0 )
         return;
 
@@ -2356,7 +2595,7 @@ static bool ProcessTSPacket( demux_t *p_demux, ts_pid_t *pid, block_t *p_pkt )
         }
     }
 
-    PCRHandle( p_demux, pid, p_pkt );
+    PCRHandle( p_demux, pid, p_pkt->p_buffer );
 
     if( i_skip >= 188 )
     {
@@ -2435,6 +2674,155 @@ static bool GatherPESData( demux_t *p_demux, ts_pid_t *pid, block_t *p_pkt,
     return i_ret;
 }
 
+/* Indexes the position of the PCR of the programs clocks carried by that
+ * packet, which was just read from the batch */
+static void IndexPCR( demux_t *p_demux, const ts_pid_t *pid, const uint8_t *p_pkt )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const ts_pid_t *patpid = GetPID(p_sys, 0);
+
+    mtime_t i_pcr = GetPCR( p_pkt );
+    if( i_pcr < 0 || patpid->type != TYPE_PAT )
+        return;
+
+    int64_t i_pos = -1;
+    const ts_pat_t *p_pat = patpid->u.p_pat;
+    for( int i = 0; i < p_pat->programs.i_size; i++ )
+    {
+        const ts_pmt_t *p_pmt = p_pat->programs.p_elems[i]->u.p_pmt;
+        if( p_pmt->i_pid_pcr != pid->i_pid || p_pmt->pcr.i_first == -1 )
+            continue;
+
+        if( i_pos == -1 )
+            i_pos = stream_Tell( p_sys->stream ) - p_sys->i_packet_size -
+                    ( p_sys->batch.i_size - p_sys->batch.i_offset );
+        ts_index_Add( p_sys->p_index, p_pmt->i_number,
+                      TimeStampWrapAround( p_pmt->pcr.i_first, i_pcr ) - p_pmt->pcr.i_first,
+                      i_pos );
+    }
+}
+
+static void StartIndexScan( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const ts_pid_t *patpid = GetPID(p_sys, 0);
+    if( patpid->type != TYPE_PAT )
+        return;
+
+    const ts_pat_t *p_pat = patpid->u.p_pat;
+    ts_index_clock_t *p_clocks = malloc( p_pat->programs.i_size * sizeof(*p_clocks) );
+    if( p_clocks == NULL )
+        return;
+
+    unsigned i_clocks = 0;
+    for( int i = 0; i < p_pat->programs.i_size; i++ )
+    {
+        const ts_pmt_t *p_pmt = p_pat->programs.p_elems[i]->u.p_pmt;
+        if( p_pmt->i_pid_pcr == 0x1FFF || p_pmt->pcr.i_first == -1 )
+            continue;
+        p_clocks[i_clocks].i_program = p_pmt->i_number;
+        p_clocks[i_clocks].i_pcr_pid = p_pmt->i_pid_pcr;
+        p_clocks[i_clocks++].i_first_pcr = p_pmt->pcr.i_first;
+    }
+
+    char *psz_url;
+    if( i_clocks &&
+        asprintf( &psz_url, "%s://%s", p_demux->psz_access, p_demux->psz_location ) != -1 )
+    {
+        ts_index_StartScan( p_sys->p_index, p_demux, psz_url, p_sys->i_packet_size,
+                            p_sys->i_packet_header_size, p_clocks, i_clocks );
+        free( psz_url );
+    }
+    free( p_clocks );
+}
+
+static block_t *CopyTSPacket( const uint8_t *p_pkt, size_t i_size )
+{
+    block_t *p_block = block_Alloc( i_size );
+    if( likely(p_block != NULL) )
+        memcpy( p_block->p_buffer, p_pkt, i_size );
+    return p_block;
+}
+
+static bool ProcessProgramPacket( demux_t *p_demux, ts_pid_t *pid, block_t *p_pkt,
+                                  bool b_pcr_only )
+{
+    if( b_pcr_only )
+    {
+        PCRHandle( p_demux, pid, p_pkt->p_buffer );
+        block_Release( p_pkt );
+        return false;
+    }
+    return ProcessTSPacket( p_demux, pid, p_pkt );
+}
+
+/* Returns the only program whose ES or clock is carried by that pid,
+ * or NULL if none or several are */
+static ts_pmt_t *GetPIDProgram( demux_sys_t *p_sys, const ts_pid_t *pid )
+{
+    ts_pmt_t *p_owner = NULL;
+
+    if( pid->type == TYPE_PES )
+    {
+        for( const ts_pes_es_t *p_es = pid->u.p_pes->p_es; p_es; p_es = p_es->p_next )
+        {
+            if( p_owner && p_owner != p_es->p_program )
+                return NULL;
+            p_owner = p_es->p_program;
+        }
+    }
+
+    const ts_pid_t *patpid = GetPID(p_sys, 0);
+    if( patpid->type != TYPE_PAT )
+        return NULL;
+
+    const ts_pat_t *p_pat = patpid->u.p_pat;
+    for( int i = 0; i < p_pat->programs.i_size; i++ )
+    {
+        ts_pmt_t *p_pmt = p_pat->programs.p_elems[i]->u.p_pmt;
+        if( p_pmt->i_pid_pcr == pid->i_pid ||
+            ( p_pmt->i_pid_pcr == 0x1FFF && PIDReferencedByProgram( p_pmt, pid->i_pid ) ) )
+        {
+            if( p_owner && p_owner != p_pmt )
+                return NULL;
+            p_owner = p_pmt;
+        }
+    }
+
+    return p_owner;
+}
+
+/* Packets of a program are handed to its worker once its clock is settled.
+ * Until then, and for the pids shared between programs, they are processed
+ * here once the workers are idle, as the other programs states are used. */
+static bool DispatchTSPacket( demux_t *p_demux, ts_pid_t *pid, block_t *p_pkt,
+                              bool b_pcr_only )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    if( unlikely(p_pkt == NULL) )
+        return false;
+
+    ts_pmt_t *p_pmt = GetPIDProgram( p_sys, pid );
+    if( p_pmt && p_pmt->i_worker >= 0 )
+    {
+        ts_workers_Queue( p_sys->p_workers, p_pmt->i_worker, pid, p_pkt, b_pcr_only );
+        return false;
+    }
+
+    ts_workers_Drain( p_sys->p_workers );
+    bool b_frame = ProcessProgramPacket( p_demux, pid, p_pkt, b_pcr_only );
+
+    if( p_pmt && p_pmt->pcr.b_fix_done && p_pmt->pcr.i_current > -1 )
+    {
+        p_pmt->i_worker = p_sys->i_next_worker++ % ts_workers_Count( p_sys->p_workers );
+        msg_Dbg( p_demux, "program %d demuxed by worker %d",
+                 p_pmt->i_number, p_pmt->i_worker );
+    }
+
+    return b_frame;
+}
+
 /****************************************************************************
  ****************************************************************************
  ** libdvbpsi callbacks
@@ -27,6 +27,8 @@
     typedef struct arib_instance_t arib_instance_t;
 #endif
 typedef struct csa_t csa_t;
+typedef struct ts_workers_t ts_workers_t;
+typedef struct ts_index_t ts_index_t;
 
 #define TS_USER_PMT_NUMBER (0)
 
@@ -58,6 +60,17 @@ struct demux_sys_t
     /* how many TS packet we read at once */
     unsigned    i_ts_read;
 
+    /* packets read ahead from the stream, demuxed in place */
+    struct
+    {
+        uint8_t    *p_buffer;
+        unsigned    i_packets; /* read at once */
+        size_t      i_size;    /* bytes read */
+        size_t      i_synced;  /* end of the packets with checked sync */
+        size_t      i_offset;  /* next packet to demux */
+        bool        b_lost;    /* lost synchro was reported */
+    } batch;
+
     bool        b_force_seek_per_percent;
 
     bool        b_atsc;
@@ -119,12 +132,22 @@ struct demux_sys_t
 
     /* */
     bool        b_start_record;
+
+    /* threads processing the programs packets, NULL for none */
+    ts_workers_t *p_workers;
+    unsigned    i_next_worker;
+
+    /* positions of the PCR, for seeking, NULL if not seekable */
+    ts_index_t *p_index;
 };
 
 bool ProgramIsSelected( demux_sys_t *, uint16_t i_pgrm );
 
 void UpdatePESFilters( demux_t *p_demux, bool b_all );
 
+/* Waits for the program workers, before changing the tables or pids */
+void DrainWorkers( demux_sys_t * );
+
 int ProbeStart( demux_t *p_demux, int i_program );
 int ProbeEnd( demux_t *p_demux, int i_program );
 
@@ -0,0 +1,469 @@
+/*****************************************************************************
+ * ts_index.c: TS Demux PCR positions index
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_demux.h>
+#include <vlc_interrupt.h>
+
+#include "../index_cache.h"
+#include "timestamps.h"
+#include "ts_index.h"
+
+#define TS_INDEX_CACHE_FORMAT  VLC_FOURCC('t','s',' ',' ')
+#define TS_INDEX_CACHE_VERSION 1
+#define TS_INDEX_CACHE_INFO    0 /* followed by one record per program */
+
+#define TS_INDEX_SCAN_PACKETS  1024
+
+typedef struct
+{
+    int64_t  i_scanned;
+    uint32_t i_programs;
+    uint32_t i_reserved;
+} ts_index_cache_info_t;
+
+/* followed by the points */
+typedef struct
+{
+    uint32_t i_program;
+    uint32_t i_points;
+} ts_index_cache_program_t;
+
+typedef struct
+{
+    uint16_t          i_program;
+    ts_index_point_t *p_points; /* by time, and so by position */
+    size_t            i_points;
+    size_t            i_alloc;
+} ts_index_program_t;
+
+struct ts_index_t
+{
+    vlc_mutex_t         lock;
+    ts_index_program_t *p_programs;
+    unsigned            i_programs;
+    int64_t             i_scanned; /* the file is indexed up to there */
+    bool                b_changed;
+
+    /* pre-scan */
+    vlc_interrupt_t    *p_interrupt;
+    vlc_thread_t        thread;
+    demux_t            *p_demux;
+    char               *psz_url;
+    unsigned            i_packet_size;
+    unsigned            i_packet_header_size;
+    ts_index_clock_t   *p_clocks;
+    unsigned            i_clocks;
+};
+
+ts_index_t * ts_index_New( void )
+{
+    ts_index_t *p_index = calloc( 1, sizeof(*p_index) );
+    if( unlikely(p_index == NULL) )
+        return NULL;
+    vlc_mutex_init( &p_index->lock );
+    return p_index;
+}
+
+void ts_index_Delete( ts_index_t *p_index )
+{
+    ts_index_StopScan( p_index );
+    for( unsigned i = 0; i < p_index->i_programs; i++ )
+        free( p_index->p_programs[i].p_points );
+    free( p_index->p_programs );
+    vlc_mutex_destroy( &p_index->lock );
+    free( p_index );
+}
+
+static ts_index_program_t *GetProgram( ts_index_t *p_index, uint16_t i_program,
+                                       bool b_create )
+{
+    for( unsigned i = 0; i < p_index->i_programs; i++ )
+        if( p_index->p_programs[i].i_program == i_program )
+            return &p_index->p_programs[i];
+
+    if( !b_create )
+        return NULL;
+
+    ts_index_program_t *p_programs = realloc( p_index->p_programs,
+                                              (p_index->i_programs + 1) * sizeof(*p_programs) );
+    if( unlikely(p_programs == NULL) )
+        return NULL;
+    p_index->p_programs = p_programs;
+
+    ts_index_program_t *p_prog = &p_programs[p_index->i_programs++];
+    p_prog->i_program = i_program;
+    p_prog->p_points = NULL;
+    p_prog->i_points = p_prog->i_alloc = 0;
+    return p_prog;
+}
+
+/* Returns the index of the first point after that time */
+static size_t UpperBound( const ts_index_program_t *p_prog, int64_t i_time )
+{
+    size_t i_low = 0, i_high = p_prog->i_points;
+    while( i_low < i_high )
+    {
+        size_t i_mid = i_low + (i_high - i_low) / 2;
+        if( p_prog->p_points[i_mid].i_time <= i_time )
+            i_low = i_mid + 1;
+        else
+            i_high = i_mid;
+    }
+    return i_low;
+}
+
+static bool AddPoint( ts_index_t *p_index, uint16_t i_program,
+                      int64_t i_time, int64_t i_pos )
+{
+    ts_index_program_t *p_prog = GetProgram( p_index, i_program, true );
+    if( unlikely(p_prog == NULL) )
+        return false;
+
+    /* playback mostly appends */
+    size_t i = p_prog->i_points;
+    if( i > 0 && p_prog->p_points[i - 1].i_time > i_time )
+        i = UpperBound( p_prog, i_time );
+
+    const ts_index_point_t *p_prev = i > 0 ? &p_prog->p_points[i - 1] : NULL;
+    const ts_index_point_t *p_next = i < p_prog->i_points ? &p_prog->p_points[i] : NULL;
+    if( ( p_prev && ( i_time - p_prev->i_time < TS_INDEX_INTERVAL ||
+                      i_pos <= p_prev->i_pos ) ) ||
+        ( p_next && ( p_next->i_time - i_time < TS_INDEX_INTERVAL ||
+                      i_pos >= p_next->i_pos ) ) )
+        return false;
+
+    if( p_prog->i_points == p_prog->i_alloc )
+    {
+        size_t i_alloc = p_prog->i_alloc ? p_prog->i_alloc * 2 : 256;
+        ts_index_point_t *p_points = realloc( p_prog->p_points,
+                                              i_alloc * sizeof(*p_points) );
+        if( unlikely(p_points == NULL) )
+            return false;
+        p_prog->p_points = p_points;
+        p_prog->i_alloc = i_alloc;
+    }
+
+    memmove( &p_prog->p_points[i + 1], &p_prog->p_points[i],
+             (p_prog->i_points - i) * sizeof(*p_prog->p_points) );
+    p_prog->p_points[i].i_time = i_time;
+    p_prog->p_points[i].i_pos = i_pos;
+    p_prog->i_points++;
+    return true;
+}
+
+bool ts_index_Add( ts_index_t *p_index, uint16_t i_program, int64_t i_time, int64_t i_pos )
+{
+    if( i_time < 0 || i_pos < 0 )
+        return false;
+
+    vlc_mutex_lock( &p_index->lock );
+    bool b_added = AddPoint( p_index, i_program, i_time, i_pos );
+    p_index->b_changed |= b_added;
+    vlc_mutex_unlock( &p_index->lock );
+
+    return b_added;
+}
+
+bool ts_index_Find( ts_index_t *p_index, uint16_t i_program, int64_t i_time,
+                    ts_index_point_t *p_before, ts_index_point_t *p_after )
+{
+    p_before->i_pos = p_after->i_pos = -1;
+
+    vlc_mutex_lock( &p_index->lock );
+    const ts_index_program_t *p_prog = GetProgram( p_index, i_program, false );
+    if( p_prog && p_prog->i_points )
+    {
+        size_t i = UpperBound( p_prog, i_time );
+        if( i > 0 )
+            *p_before = p_prog->p_points[i - 1];
+        if( i < p_prog->i_points )
+            *p_after = p_prog->p_points[i];
+    }
+    vlc_mutex_unlock( &p_index->lock );
+
+    return p_before->i_pos > -1 || p_after->i_pos > -1;
+}
+
+int ts_index_Load( ts_index_t *p_index, demux_t *p_demux )
+{
+    index_cache_t *p_cache = index_cache_Open( p_demux, TS_INDEX_CACHE_FORMAT,
+                                               TS_INDEX_CACHE_VERSION );
+    if( p_cache == NULL )
+        return VLC_EGENERIC;
+
+    size_t i_size;
+    const ts_index_cache_info_t *p_info =
+            index_cache_Get( p_cache, TS_INDEX_CACHE_INFO, &i_size );
+    if( p_info == NULL || i_size != sizeof(*p_info) )
+    {
+        index_cache_Close( p_cache );
+        return VLC_EGENERIC;
+    }
+
+    size_t i_points = 0;
+    vlc_mutex_lock( &p_index->lock );
+    for( uint32_t i = 0; i < p_info->i_programs; i++ )
+    {
+        const ts_index_cache_program_t *p_prog =
+                index_cache_Get( p_cache, TS_INDEX_CACHE_INFO + 1 + i, &i_size );
+        if( p_prog == NULL || i_size < sizeof(*p_prog) ||
+            p_prog->i_points > (i_size - sizeof(*p_prog)) / sizeof(ts_index_point_t) )
+            continue;
+
+        const ts_index_point_t *p_points = (const void *) &p_prog[1];
+        for( uint32_t j = 0; j < p_prog->i_points; j++ )
+            i_points += AddPoint( p_index, p_prog->i_program,
+                                  p_points[j].i_time, p_points[j].i_pos );
+    }
+    p_index->i_scanned = __MAX( p_index->i_scanned, p_info->i_scanned );
+    p_index->b_changed = false;
+    vlc_mutex_unlock( &p_index->lock );
+
+    index_cache_Close( p_cache );
+
+    msg_Dbg( p_demux, "using %zu cached PCR positions", i_points );
+    return VLC_SUCCESS;
+}
+
+void ts_index_Save( ts_index_t *p_index, demux_t *p_demux )
+{
+    vlc_mutex_lock( &p_index->lock );
+    if( !p_index->b_changed || !p_index->i_programs )
+    {
+        vlc_mutex_unlock( &p_index->lock );
+        return;
+    }
+
+    const unsigned i_records = 1 + p_index->i_programs;
+    index_cache_record_t *p_records = calloc( i_records, sizeof(*p_records) );
+    uint8_t **pp_data = calloc( i_records, sizeof(*pp_data) );
+    ts_index_cache_info_t info = {
+        .i_scanned = p_index->i_scanned,
+        .i_programs = p_index->i_programs,
+    };
+    bool b_ok = p_records && pp_data;
+
+    for( unsigned i = 0; i < p_index->i_programs && b_ok; i++ )
+    {
+        const ts_index_program_t *p_prog = &p_index->p_programs[i];
+        const size_t i_points = p_prog->i_points * sizeof(*p_prog->p_points);
+        ts_index_cache_program_t header = {
+            .i_program = p_prog->i_program,
+            .i_points = p_prog->i_points,
+        };
+
+        pp_data[1 + i] = malloc( sizeof(header) + i_points );
+        if( unlikely(pp_data[1 + i] == NULL) )
+        {
+            b_ok = false;
+            break;
+        }
+        memcpy( pp_data[1 + i], &header, sizeof(header) );
+        if( i_points )
+            memcpy( &pp_data[1 + i][sizeof(header)], p_prog->p_points, i_points );
+
+        p_records[1 + i].i_id = TS_INDEX_CACHE_INFO + 1 + i;
+        p_records[1 + i].p_data = pp_data[1 + i];
+        p_records[1 + i].i_size = sizeof(header) + i_points;
+    }
+    p_index->b_changed = !b_ok;
+    vlc_mutex_unlock( &p_index->lock );
+
+    if( b_ok )
+    {
+        p_records[0].i_id = TS_INDEX_CACHE_INFO;
+        p_records[0].p_data = &info;
+        p_records[0].i_size = sizeof(info);
+        index_cache_Write( p_demux, TS_INDEX_CACHE_FORMAT, TS_INDEX_CACHE_VERSION,
+                           p_records, i_records );
+    }
+
+    for( unsigned i = 0; pp_data && i < i_records; i++ )
+        free( pp_data[i] );
+    free( pp_data );
+    free( p_records );
+}
+
+static int64_t ScanPCR( const uint8_t *p )
+{
+    if( !( p[3] & 0x20 ) || p[4] < 7 || !( p[5] & 0x10 ) )
+        return -1;
+
+    return ( (int64_t)p[6] << 25 ) | ( (int64_t)p[7] << 17 ) |
+           ( (int64_t)p[8] << 9 ) | ( (int64_t)p[9] << 1 ) |
+           ( (int64_t)p[10] >> 7 );
+}
+
+static void ScanPacket( ts_index_t *p_index, const uint8_t *p, int64_t i_pos )
+{
+    const uint16_t i_pid = ( (p[1] & 0x1f) << 8 ) | p[2];
+    int64_t i_pcr = -1;
+
+    for( unsigned i = 0; i < p_index->i_clocks; i++ )
+    {
+        const ts_index_clock_t *p_clock = &p_index->p_clocks[i];
+        if( p_clock->i_pcr_pid != i_pid )
+            continue;
+        if( i_pcr == -1 && ( i_pcr = ScanPCR( p ) ) == -1 )
+            return;
+        ts_index_Add( p_index, p_clock->i_program,
+                      TimeStampWrapAround( p_clock->i_first_pcr, i_pcr ) - p_clock->i_first_pcr,
+                      i_pos );
+    }
+}
+
+static void Scan( ts_index_t *p_index )
+{
+    demux_t *p_demux = p_index->p_demux;
+    const size_t i_packet = p_index->i_packet_size;
+    const size_t i_header = p_index->i_packet_header_size;
+
+    stream_t *s = stream_UrlNew( p_demux, p_index->psz_url );
+    if( s == NULL )
+    {
+        msg_Warn( p_demux, "cannot open %s for indexing", p_index->psz_url );
+        return;
+    }
+
+    uint8_t *p_buffer = malloc( i_packet * TS_INDEX_SCAN_PACKETS );
+    if( unlikely(p_buffer == NULL) )
+    {
+        stream_Delete( s );
+        return;
+    }
+
+    /* start from what was already scanned */
+    vlc_mutex_lock( &p_index->lock );
+    int64_t i_pos = p_index->i_scanned - p_index->i_scanned % i_packet;
+    vlc_mutex_unlock( &p_index->lock );
+    if( i_pos > 0 && stream_Seek( s, i_pos ) != VLC_SUCCESS )
+        i_pos = 0;
+
+    size_t i_left = 0;
+    bool b_lost = false;
+    while( !vlc_killed() )
+    {
+        ssize_t i_read = stream_Read( s, &p_buffer[i_left],
+                                      i_packet * TS_INDEX_SCAN_PACKETS - i_left );
+        if( i_read <= 0 )
+            break;
+
+        const size_t i_size = i_left + i_read;
+        size_t i_offset = 0;
+        while( i_offset + i_packet <= i_size )
+        {
+            const uint8_t *p = &p_buffer[i_offset + i_header];
+            /* resync on two consecutive sync bytes */
+            if( p[0] != 0x47 ||
+                ( b_lost && i_offset + 2 * i_packet <= i_size && p[i_packet] != 0x47 ) )
+            {
+                b_lost = true;
+                i_offset++;
+                continue;
+            }
+            b_lost = false;
+
+            ScanPacket( p_index, p, i_pos + i_offset );
+            i_offset += i_packet;
+        }
+
+        i_left = i_size - i_offset;
+        memmove( p_buffer, &p_buffer[i_offset], i_left );
+        i_pos += i_offset;
+
+        vlc_mutex_lock( &p_index->lock );
+        if( i_pos > p_index->i_scanned )
+        {
+            p_index->i_scanned = i_pos;
+            p_index->b_changed = true;
+        }
+        vlc_mutex_unlock( &p_index->lock );
+    }
+
+    msg_Dbg( p_demux, "indexed PCR positions up to %"PRId64"%s", i_pos,
+             vlc_killed() ? " (interrupted)" : "" );
+
+    free( p_buffer );
+    stream_Delete( s );
+}
+
+static void *ScanThread( void *p_data )
+{
+    ts_index_t *p_index = p_data;
+
+    vlc_interrupt_set( p_index->p_interrupt );
+    Scan( p_index );
+    return NULL;
+}
+
+int ts_index_StartScan( ts_index_t *p_index, demux_t *p_demux, const char *psz_url,
+                        unsigned i_packet_size, unsigned i_packet_header_size,
+                        const ts_index_clock_t *p_clocks, unsigned i_clocks )
+{
+    if( p_index->p_interrupt != NULL || i_clocks == 0 )
+        return VLC_EGENERIC;
+
+    p_index->p_demux = p_demux;
+    p_index->i_packet_size = i_packet_size;
+    p_index->i_packet_header_size = i_packet_header_size;
+    p_index->psz_url = strdup( psz_url );
+    p_index->p_clocks = malloc( i_clocks * sizeof(*p_clocks) );
+    p_index->p_interrupt = vlc_interrupt_create();
+    if( unlikely(p_index->psz_url == NULL || p_index->p_clocks == NULL ||
+                 p_index->p_interrupt == NULL) )
+        goto error;
+
+    memcpy( p_index->p_clocks, p_clocks, i_clocks * sizeof(*p_clocks) );
+    p_index->i_clocks = i_clocks;
+
+    if( vlc_clone( &p_index->thread, ScanThread, p_index, VLC_THREAD_PRIORITY_LOW ) )
+        goto error;
+
+    return VLC_SUCCESS;
+
+error:
+    msg_Warn( p_demux, "cannot start the PCR indexer" );
+    if( p_index->p_interrupt )
+        vlc_interrupt_destroy( p_index->p_interrupt );
+    p_index->p_interrupt = NULL;
+    free( p_index->p_clocks );
+    p_index->p_clocks = NULL;
+    free( p_index->psz_url );
+    p_index->psz_url = NULL;
+    return VLC_EGENERIC;
+}
+
+void ts_index_StopScan( ts_index_t *p_index )
+{
+    if( p_index->p_interrupt == NULL )
+        return;
+
+    vlc_interrupt_kill( p_index->p_interrupt );
+    vlc_join( p_index->thread, NULL );
+    vlc_interrupt_destroy( p_index->p_interrupt );
+    p_index->p_interrupt = NULL;
+    free( p_index->p_clocks );
+    p_index->p_clocks = NULL;
+    free( p_index->psz_url );
+    p_index->psz_url = NULL;
+}
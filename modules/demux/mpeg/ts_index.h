@@ -0,0 +1,69 @@
+/*****************************************************************************
+ * ts_index.h: TS Demux PCR positions index
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+#ifndef VLC_TS_INDEX_H
+#define VLC_TS_INDEX_H
+
+/* Byte positions of the PCR packets of the programs, so that seeking does
+ * not need to bisect the file. Times are in 90kHz units, relative to the
+ * first PCR of the program.
+ *
+ * Points are at least TS_INDEX_INTERVAL apart. With a PCR every 100ms at
+ * most, the playback of a range leaves no gap larger than the 500ms
+ * precision of the bisection. */
+#define TS_INDEX_INTERVAL (90000 * 2 / 5)
+
+typedef struct ts_index_t ts_index_t;
+
+typedef struct
+{
+    int64_t i_time;
+    int64_t i_pos; /* start of the PCR packet, -1 for none */
+} ts_index_point_t;
+
+/* Clock of a program, for the pre-scan */
+typedef struct
+{
+    uint16_t i_program;
+    uint16_t i_pcr_pid;
+    int64_t  i_first_pcr;
+} ts_index_clock_t;
+
+ts_index_t * ts_index_New( void );
+void ts_index_Delete( ts_index_t * );
+
+/* Adds the position of a PCR, unless it is too close to an indexed one
+ * or inconsistent with them (discontinuities). Thread-safe. */
+bool ts_index_Add( ts_index_t *, uint16_t i_program, int64_t i_time, int64_t i_pos );
+
+/* Returns the last indexed point at or before that time, and the first one
+ * after it, if any. */
+bool ts_index_Find( ts_index_t *, uint16_t i_program, int64_t i_time,
+                    ts_index_point_t *p_before, ts_index_point_t *p_after );
+
+/* Index cache of local files, see index_cache.h */
+int ts_index_Load( ts_index_t *, demux_t * );
+void ts_index_Save( ts_index_t *, demux_t * );
+
+/* Indexes the rest of the file from its own stream, in the background */
+int ts_index_StartScan( ts_index_t *, demux_t *, const char *psz_url,
+                        unsigned i_packet_size, unsigned i_packet_header_size,
+                        const ts_index_clock_t *, unsigned i_clocks );
+void ts_index_StopScan( ts_index_t * );
+
+#endif
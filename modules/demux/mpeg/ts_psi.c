@@ -119,6 +119,8 @@ void PATCallBack( void *data, dvbpsi_pat_t *p_dvbpsipat )
         return;
     }
 
+    DrainWorkers( p_sys );
+
     msg_Dbg( p_demux, "new PAT ts_id=%d version=%d current_next=%d",
              p_dvbpsipat->i_ts_id, p_dvbpsipat->i_version, p_dvbpsipat->b_current_next );
 
@@ -1426,6 +1428,8 @@ void PMTCallBack( void *data, dvbpsi_pmt_t *p_dvbpsipmt )
         return;
     }
 
+    DrainWorkers( p_sys );
+
     /* Save old es array */
     DECL_ARRAY(ts_pid_t *) pid_to_decref;
     pid_to_decref.i_alloc = p_pmt->e_streams.i_alloc;
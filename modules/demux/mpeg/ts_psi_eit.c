@@ -125,6 +125,8 @@ static void SDTCallBack( demux_t *p_demux, dvbpsi_sdt_t *p_sdt )
         return;
     }
 
+    DrainWorkers( p_sys );
+
     msg_Dbg( p_demux, "new SDT ts_id=%d version=%d current_next=%d "
              "network_id=%d",
              p_sdt->i_extension,
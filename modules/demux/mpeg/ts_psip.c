@@ -622,6 +622,8 @@ static void ATSC_MGT_Callback( void *p_cb_basepid, dvbpsi_atsc_mgt_t* p_mgt )
         return;
     }
 
+    DrainWorkers( p_demux->p_sys );
+
     /* Easy way, delete and recreate every child if any new version comes
      * (We don't need to keep PID active as with video/PMT update) */
     if( p_mgtpsip->i_version != -1 )
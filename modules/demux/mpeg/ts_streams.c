@@ -135,6 +135,8 @@ ts_pmt_t *ts_pmt_New( demux_t *p_demux )
     pmt->eit.i_event_length = 0;
     pmt->eit.i_event_start = 0;
 
+    pmt->i_worker = -1;
+
     return pmt;
 }
 
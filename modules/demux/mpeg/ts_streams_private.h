@@ -70,6 +70,9 @@ struct ts_pmt_t
 
     mtime_t i_last_dts;
 
+    /* worker processing the program packets, once its clock is settled,
+       -1 for the demux thread */
+    int             i_worker;
 };
 
 struct ts_pes_es_t
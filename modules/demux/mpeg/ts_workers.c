@@ -0,0 +1,204 @@
+/*****************************************************************************
+ * ts_workers.c: TS Demux program worker threads
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_demux.h>
+
+#include "ts_pid.h"
+#include "ts_workers.h"
+
+#define TS_WORKER_QUEUE 1024 /* packets */
+
+typedef struct
+{
+    ts_pid_t *pid;
+    block_t  *p_pkt;
+    bool      b_pcr_only;
+} ts_worker_packet_t;
+
+typedef struct
+{
+    ts_workers_t *p_workers;
+    vlc_thread_t  thread;
+
+    vlc_mutex_t   lock;
+    vlc_cond_t    wait;  /* packets queued or quitting */
+    vlc_cond_t    done;  /* packets processed */
+
+    /* packets stay in the queue until processed, so that the
+       worker can process them without holding the lock */
+    ts_worker_packet_t queue[TS_WORKER_QUEUE];
+    unsigned      i_first;
+    unsigned      i_count;
+    bool          b_quit;
+} ts_worker_t;
+
+struct ts_workers_t
+{
+    demux_t      *p_demux;
+    ts_worker_process_cb pf_process;
+
+    ts_worker_t  *p_workers;
+    unsigned      i_workers;
+};
+
+static void *Run( void *p_data )
+{
+    ts_worker_t *p_worker = p_data;
+    ts_workers_t *p_workers = p_worker->p_workers;
+
+    vlc_mutex_lock( &p_worker->lock );
+    for( ;; )
+    {
+        while( p_worker->i_count == 0 && !p_worker->b_quit )
+            vlc_cond_wait( &p_worker->wait, &p_worker->lock );
+        if( p_worker->i_count == 0 )
+            break;
+
+        const unsigned i_first = p_worker->i_first;
+        const unsigned i_count = p_worker->i_count;
+        vlc_mutex_unlock( &p_worker->lock );
+
+        for( unsigned i = 0; i < i_count; i++ )
+        {
+            ts_worker_packet_t *p = &p_worker->queue[(i_first + i) % TS_WORKER_QUEUE];
+            p_workers->pf_process( p_workers->p_demux, p->pid, p->p_pkt, p->b_pcr_only );
+        }
+
+        vlc_mutex_lock( &p_worker->lock );
+        p_worker->i_first = (i_first + i_count) % TS_WORKER_QUEUE;
+        p_worker->i_count -= i_count;
+        vlc_cond_signal( &p_worker->done );
+    }
+    vlc_mutex_unlock( &p_worker->lock );
+
+    return NULL;
+}
+
+static void StopWorker( ts_worker_t *p_worker )
+{
+    vlc_mutex_lock( &p_worker->lock );
+    p_worker->b_quit = true;
+    vlc_cond_signal( &p_worker->wait );
+    vlc_mutex_unlock( &p_worker->lock );
+
+    vlc_join( p_worker->thread, NULL );
+
+    vlc_cond_destroy( &p_worker->done );
+    vlc_cond_destroy( &p_worker->wait );
+    vlc_mutex_destroy( &p_worker->lock );
+}
+
+ts_workers_t * ts_workers_New( demux_t *p_demux, unsigned i_threads,
+                               ts_worker_process_cb pf_process )
+{
+    ts_workers_t *p_workers = malloc( sizeof(*p_workers) );
+    if( unlikely(p_workers == NULL) )
+        return NULL;
+
+    p_workers->p_workers = calloc( i_threads, sizeof(*p_workers->p_workers) );
+    if( unlikely(p_workers->p_workers == NULL) )
+    {
+        free( p_workers );
+        return NULL;
+    }
+    p_workers->p_demux = p_demux;
+    p_workers->pf_process = pf_process;
+    p_workers->i_workers = 0;
+
+    while( p_workers->i_workers < i_threads )
+    {
+        ts_worker_t *p_worker = &p_workers->p_workers[p_workers->i_workers];
+
+        p_worker->p_workers = p_workers;
+        vlc_mutex_init( &p_worker->lock );
+        vlc_cond_init( &p_worker->wait );
+        vlc_cond_init( &p_worker->done );
+        p_worker->i_first = 0;
+        p_worker->i_count = 0;
+        p_worker->b_quit = false;
+
+        if( vlc_clone( &p_worker->thread, Run, p_worker, VLC_THREAD_PRIORITY_INPUT ) )
+        {
+            vlc_cond_destroy( &p_worker->done );
+            vlc_cond_destroy( &p_worker->wait );
+            vlc_mutex_destroy( &p_worker->lock );
+            break;
+        }
+        p_workers->i_workers++;
+    }
+
+    if( p_workers->i_workers == 0 )
+    {
+        free( p_workers->p_workers );
+        free( p_workers );
+        return NULL;
+    }
+
+    msg_Dbg( p_demux, "demuxing programs with %u threads", p_workers->i_workers );
+    return p_workers;
+}
+
+void ts_workers_Delete( ts_workers_t *p_workers )
+{
+    for( unsigned i = 0; i < p_workers->i_workers; i++ )
+        StopWorker( &p_workers->p_workers[i] );
+
+    free( p_workers->p_workers );
+    free( p_workers );
+}
+
+unsigned ts_workers_Count( const ts_workers_t *p_workers )
+{
+    return p_workers->i_workers;
+}
+
+void ts_workers_Queue( ts_workers_t *p_workers, unsigned i_worker,
+                       ts_pid_t *pid, block_t *p_pkt, bool b_pcr_only )
+{
+    ts_worker_t *p_worker = &p_workers->p_workers[i_worker % p_workers->i_workers];
+
+    vlc_mutex_lock( &p_worker->lock );
+    while( p_worker->i_count == TS_WORKER_QUEUE )
+        vlc_cond_wait( &p_worker->done, &p_worker->lock );
+
+    ts_worker_packet_t *p = &p_worker->queue[(p_worker->i_first + p_worker->i_count) % TS_WORKER_QUEUE];
+    p->pid = pid;
+    p->p_pkt = p_pkt;
+    p->b_pcr_only = b_pcr_only;
+    if( p_worker->i_count++ == 0 )
+        vlc_cond_signal( &p_worker->wait );
+    vlc_mutex_unlock( &p_worker->lock );
+}
+
+void ts_workers_Drain( ts_workers_t *p_workers )
+{
+    for( unsigned i = 0; i < p_workers->i_workers; i++ )
+    {
+        ts_worker_t *p_worker = &p_workers->p_workers[i];
+
+        vlc_mutex_lock( &p_worker->lock );
+        while( p_worker->i_count > 0 )
+            vlc_cond_wait( &p_worker->done, &p_worker->lock );
+        vlc_mutex_unlock( &p_worker->lock );
+    }
+}
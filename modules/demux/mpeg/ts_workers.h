@@ -0,0 +1,42 @@
+/*****************************************************************************
+ * ts_workers.h: TS Demux program worker threads
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+#ifndef VLC_TS_WORKERS_H
+#define VLC_TS_WORKERS_H
+
+/* Threads processing the packets of the programs, each program being
+ * handled by a single worker so that its packets stay in order.
+ * The demux thread must drain the workers before touching any state
+ * shared by the programs (PSI, pids setup, filters, seeking). */
+typedef struct ts_workers_t ts_workers_t;
+
+typedef bool (* ts_worker_process_cb)( demux_t *, ts_pid_t *, block_t *, bool b_pcr_only );
+
+ts_workers_t * ts_workers_New( demux_t *, unsigned i_threads, ts_worker_process_cb );
+void ts_workers_Delete( ts_workers_t * );
+
+unsigned ts_workers_Count( const ts_workers_t * );
+
+/* Queues the packet to the worker, waiting when its queue is full */
+void ts_workers_Queue( ts_workers_t *, unsigned i_worker,
+                       ts_pid_t *, block_t *, bool b_pcr_only );
+
+/* Waits for all the queued packets to be processed */
+void ts_workers_Drain( ts_workers_t * );
+
+#endif
@@ -299,7 +299,7 @@ block_t * ForgedInitSegment::buildMoovBox()
     return moov;
 }
 
-SegmentChunk * ForgedInitSegment::getChunk(const std::string &, HTTPConnectionManager *)
+SegmentChunk * ForgedInitSegment::getChunk(const std::string &, HTTPConnectionManager *, bool)
 {
     block_t *moov = buildMoovBox();
     if(moov)
@@ -222,6 +222,119 @@ static void Destroy( vlc_object_t *p_this )
     free( p_sys );
 }
 
+typedef struct
+{
+    filter_sys_t *p_sys;
+    const picture_t *p_pic;
+    picture_t *p_outpic;
+    const int *pi_luma;
+    bool b_16bit;
+    bool b_clip;
+    int i_sat, i_sin, i_cos, i_x, i_y;
+} adjust_slice_t;
+
+/*****************************************************************************
+ * Run the filter on the rows of a slice of a Planar YUV picture
+ *****************************************************************************/
+static void PlanarSlice( filter_t *p_filter, void *data,
+                         unsigned slice, unsigned slices )
+{
+    VLC_UNUSED(p_filter);
+    const adjust_slice_t *ctx = data;
+    picture_t in, out;
+
+    SlicePicture( &in, ctx->p_pic, slice, slices );
+    SlicePicture( &out, ctx->p_outpic, slice, slices );
+
+    /*
+     * Do the Y plane
+     */
+    if ( ctx->b_16bit )
+    {
+        uint16_t *p_in, *p_in_end, *p_line_end;
+        uint16_t *p_out;
+        p_in = (uint16_t *) in.p[Y_PLANE].p_pixels;
+        p_in_end = p_in + in.p[Y_PLANE].i_visible_lines
+            * (in.p[Y_PLANE].i_pitch >> 1) - 8;
+
+        p_out = (uint16_t *) out.p[Y_PLANE].p_pixels;
+
+        for( ; p_in < p_in_end ; )
+        {
+            p_line_end = p_in + (in.p[Y_PLANE].i_visible_pitch >> 1) - 8;
+
+            for( ; p_in < p_line_end ; )
+            {
+                /* Do 8 pixels at a time */
+                *p_out++ = ctx->pi_luma[ *p_in++ ]; *p_out++ = ctx->pi_luma[ *p_in++ ];
+                *p_out++ = ctx->pi_luma[ *p_in++ ]; *p_out++ = ctx->pi_luma[ *p_in++ ];
+                *p_out++ = ctx->pi_luma[ *p_in++ ]; *p_out++ = ctx->pi_luma[ *p_in++ ];
+                *p_out++ = ctx->pi_luma[ *p_in++ ]; *p_out++ = ctx->pi_luma[ *p_in++ ];
+            }
+
+            p_line_end += 8;
+
+            for( ; p_in < p_line_end ; )
+            {
+                *p_out++ = ctx->pi_luma[ *p_in++ ];
+            }
+
+            p_in += (in.p[Y_PLANE].i_pitch >> 1)
+                - (in.p[Y_PLANE].i_visible_pitch >> 1);
+            p_out += (out.p[Y_PLANE].i_pitch >> 1)
+                - (out.p[Y_PLANE].i_visible_pitch >> 1);
+        }
+    }
+    else
+    {
+        uint8_t *p_in, *p_in_end, *p_line_end;
+        uint8_t *p_out;
+        p_in = in.p[Y_PLANE].p_pixels;
+        p_in_end = p_in + in.p[Y_PLANE].i_visible_lines
+                 * in.p[Y_PLANE].i_pitch - 8;
+
+        p_out = out.p[Y_PLANE].p_pixels;
+
+        for( ; p_in < p_in_end ; )
+        {
+            p_line_end = p_in + in.p[Y_PLANE].i_visible_pitch - 8;
+
+            for( ; p_in < p_line_end ; )
+            {
+                /* Do 8 pixels at a time */
+                *p_out++ = ctx->pi_luma[ *p_in++ ]; *p_out++ = ctx->pi_luma[ *p_in++ ];
+                *p_out++ = ctx->pi_luma[ *p_in++ ]; *p_out++ = ctx->pi_luma[ *p_in++ ];
+                *p_out++ = ctx->pi_luma[ *p_in++ ]; *p_out++ = ctx->pi_luma[ *p_in++ ];
+                *p_out++ = ctx->pi_luma[ *p_in++ ]; *p_out++ = ctx->pi_luma[ *p_in++ ];
+            }
+
+            p_line_end += 8;
+
+            for( ; p_in < p_line_end ; )
+            {
+                *p_out++ = ctx->pi_luma[ *p_in++ ];
+            }
+
+            p_in += in.p[Y_PLANE].i_pitch
+                  - in.p[Y_PLANE].i_visible_pitch;
+            p_out += out.p[Y_PLANE].i_pitch
+                   - out.p[Y_PLANE].i_visible_pitch;
+        }
+    }
+
+    /*
+     * Do the U and V planes
+     */
+    /* Currently no errors are implemented in the functions, if any are added
+     * check them here */
+    if ( ctx->b_clip )
+        ctx->p_sys->pf_process_sat_hue_clip( &in, &out, ctx->i_sin, ctx->i_cos,
+                                             ctx->i_sat, ctx->i_x, ctx->i_y );
+    else
+        ctx->p_sys->pf_process_sat_hue( &in, &out, ctx->i_sin, ctx->i_cos,
+                                        ctx->i_sat, ctx->i_x, ctx->i_y );
+}
+
 /*****************************************************************************
  * Run the filter on a Planar YUV picture
  *****************************************************************************/
@@ -316,107 +429,26 @@ static picture_t *FilterPlanar( filter_t *p_filter, picture_t *p_pic )
         i_sat = 0;
     }
 
-    /*
-     * Do the Y plane
-     */
-    if ( b_16bit )
-    {
-        uint16_t *p_in, *p_in_end, *p_line_end;
-        uint16_t *p_out;
-        p_in = (uint16_t *) p_pic->p[Y_PLANE].p_pixels;
-        p_in_end = p_in + p_pic->p[Y_PLANE].i_visible_lines
-            * (p_pic->p[Y_PLANE].i_pitch >> 1) - 8;
-
-        p_out = (uint16_t *) p_outpic->p[Y_PLANE].p_pixels;
-
-        for( ; p_in < p_in_end ; )
-        {
-            p_line_end = p_in + (p_pic->p[Y_PLANE].i_visible_pitch >> 1) - 8;
-
-            for( ; p_in < p_line_end ; )
-            {
-                /* Do 8 pixels at a time */
-                *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
-                *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
-                *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
-                *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
-            }
-
-            p_line_end += 8;
-
-            for( ; p_in < p_line_end ; )
-            {
-                *p_out++ = pi_luma[ *p_in++ ];
-            }
-
-            p_in += (p_pic->p[Y_PLANE].i_pitch >> 1)
-                - (p_pic->p[Y_PLANE].i_visible_pitch >> 1);
-            p_out += (p_outpic->p[Y_PLANE].i_pitch >> 1)
-                - (p_outpic->p[Y_PLANE].i_visible_pitch >> 1);
-        }
-    }
-    else
-    {
-        uint8_t *p_in, *p_in_end, *p_line_end;
-        uint8_t *p_out;
-        p_in = p_pic->p[Y_PLANE].p_pixels;
-        p_in_end = p_in + p_pic->p[Y_PLANE].i_visible_lines
-                 * p_pic->p[Y_PLANE].i_pitch - 8;
-
-        p_out = p_outpic->p[Y_PLANE].p_pixels;
-
-        for( ; p_in < p_in_end ; )
-        {
-            p_line_end = p_in + p_pic->p[Y_PLANE].i_visible_pitch - 8;
-
-            for( ; p_in < p_line_end ; )
-            {
-                /* Do 8 pixels at a time */
-                *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
-                *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
-                *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
-                *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
-            }
-
-            p_line_end += 8;
-
-            for( ; p_in < p_line_end ; )
-            {
-                *p_out++ = pi_luma[ *p_in++ ];
-            }
-
-            p_in += p_pic->p[Y_PLANE].i_pitch
-                  - p_pic->p[Y_PLANE].i_visible_pitch;
-            p_out += p_outpic->p[Y_PLANE].i_pitch
-                   - p_outpic->p[Y_PLANE].i_visible_pitch;
-        }
-    }
-
     /*
      * Do the U and V planes
      */
 
-    int i_sin = sinf(f_hue) * f_max;
-    int i_cos = cosf(f_hue) * f_max;
-
-    /* pow(2, (bpp * 2) - 1) */
-    int i_x = ( cosf(f_hue) + sinf(f_hue) ) * f_range * i_mid;
-    int i_y = ( cosf(f_hue) - sinf(f_hue) ) * f_range * i_mid;
-
-    if ( i_sat > i_range )
-    {
-        /* Currently no errors are implemented in the function, if any are added
-         * check them here */
-        p_sys->pf_process_sat_hue_clip( p_pic, p_outpic, i_sin, i_cos, i_sat,
-                                        i_x, i_y );
-    }
-    else
-    {
-        /* Currently no errors are implemented in the function, if any are added
-         * check them here */
-        p_sys->pf_process_sat_hue( p_pic, p_outpic, i_sin, i_cos, i_sat,
-                                        i_x, i_y );
-    }
+    adjust_slice_t ctx = {
+        .p_sys = p_sys,
+        .p_pic = p_pic,
+        .p_outpic = p_outpic,
+        .pi_luma = pi_luma,
+        .b_16bit = b_16bit,
+        .b_clip = i_sat > i_range,
+        .i_sat = i_sat,
+        .i_sin = sinf(f_hue) * f_max,
+        .i_cos = cosf(f_hue) * f_max,
+        /* pow(2, (bpp * 2) - 1) */
+        .i_x = ( cosf(f_hue) + sinf(f_hue) ) * f_range * i_mid,
+        .i_y = ( cosf(f_hue) - sinf(f_hue) ) * f_range * i_mid,
+    };
+
+    filter_RunSlices( p_filter, PlanarSlice, &ctx, 0 );
 
     return CopyInfoAndRelease( p_outpic, p_pic );
 }
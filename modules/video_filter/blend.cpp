@@ -629,6 +629,38 @@ struct filter_sys_t {
     blend_function_t blend;
 };
 
+#define BLEND_SLICE_MIN_PIXELS (256 * 256)
+
+struct blend_slice_t {
+    picture_t       *dst;
+    const picture_t *src;
+    int x_offset, y_offset;
+    int width, height;
+    int alpha;
+};
+
+/* The chroma of subsampled pictures is only written on the even lines, the
+ * slices can start on any line. */
+static void BlendSlice(filter_t *filter, void *data,
+                       unsigned slice, unsigned slices)
+{
+    filter_sys_t *sys = filter->p_sys;
+    const blend_slice_t *ctx = (const blend_slice_t *)data;
+    int first, last;
+
+    filter_GetSliceRows(ctx->height, slice, slices, &first, &last);
+    if (first >= last)
+        return;
+
+    sys->blend(CPicture(ctx->dst, &filter->fmt_out.video,
+                        filter->fmt_out.video.i_x_offset + ctx->x_offset,
+                        filter->fmt_out.video.i_y_offset + ctx->y_offset + first),
+               CPicture(ctx->src, &filter->fmt_in.video,
+                        filter->fmt_in.video.i_x_offset,
+                        filter->fmt_in.video.i_y_offset + first),
+               ctx->width, last - first, ctx->alpha);
+}
+
 /**
  * It blends 2 picture together.
  */
@@ -636,8 +668,6 @@ static void Blend(filter_t *filter,
                   picture_t *dst, const picture_t *src,
                   int x_offset, int y_offset, int alpha)
 {
-    filter_sys_t *sys = filter->p_sys;
-
     if( x_offset < 0 || y_offset < 0 )
     {
         msg_Err( filter, "Blend cannot process negative offsets" );
@@ -654,13 +684,11 @@ static void Blend(filter_t *filter,
     video_format_FixRgb(&filter->fmt_out.video);
     video_format_FixRgb(&filter->fmt_in.video);
 
-    sys->blend(CPicture(dst, &filter->fmt_out.video,
-                        filter->fmt_out.video.i_x_offset + x_offset,
-                        filter->fmt_out.video.i_y_offset + y_offset),
-               CPicture(src, &filter->fmt_in.video,
-                        filter->fmt_in.video.i_x_offset,
-                        filter->fmt_in.video.i_y_offset),
-               width, height, alpha);
+    blend_slice_t ctx = { dst, src, x_offset, y_offset, width, height, alpha };
+
+    /* Small regions (most subtitles) are not worth the synchronization */
+    filter_RunSlices(filter, BlendSlice, &ctx,
+                     width * height < BLEND_SLICE_MIN_PIXELS ? 1 : 0);
 }
 
 static int Open(vlc_object_t *object)
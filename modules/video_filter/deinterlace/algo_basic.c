@@ -179,21 +179,28 @@ void RenderLinear( filter_t *p_filter,
  * RenderMean: Half-resolution blender
  *****************************************************************************/
 
-void RenderMean( filter_t *p_filter,
-                 picture_t *p_outpic, picture_t *p_pic )
+static void RenderMeanSlice( filter_t *p_filter, void *data,
+                             unsigned slice, unsigned slices )
 {
+    picture_t *p_outpic = ((picture_t **)data)[0];
+    const picture_t *p_pic = ((picture_t **)data)[1];
     int i_plane;
 
-    /* Copy image and skip lines */
     for( i_plane = 0 ; i_plane < p_pic->i_planes ; i_plane++ )
     {
         uint8_t *p_in, *p_out_end, *p_out;
+        int i_first, i_last;
 
-        p_in = p_pic->p[i_plane].p_pixels;
+        filter_GetSliceRows( p_outpic->p[i_plane].i_visible_lines,
+                             slice, slices, &i_first, &i_last );
 
-        p_out = p_outpic->p[i_plane].p_pixels;
-        p_out_end = p_out + p_outpic->p[i_plane].i_pitch
-                             * p_outpic->p[i_plane].i_visible_lines;
+        p_in = p_pic->p[i_plane].p_pixels
+                   + 2 * i_first * p_pic->p[i_plane].i_pitch;
+
+        p_out = p_outpic->p[i_plane].p_pixels
+                    + i_first * p_outpic->p[i_plane].i_pitch;
+        p_out_end = p_outpic->p[i_plane].p_pixels
+                        + i_last * p_outpic->p[i_plane].i_pitch;
 
         /* All lines: mean value */
         for( ; p_out < p_out_end ; )
@@ -208,29 +215,50 @@ void RenderMean( filter_t *p_filter,
     EndMerge();
 }
 
+void RenderMean( filter_t *p_filter,
+                 picture_t *p_outpic, picture_t *p_pic )
+{
+    picture_t *pp_pics[2] = { p_outpic, p_pic };
+
+    filter_RunSlices( p_filter, RenderMeanSlice, pp_pics, 0 );
+}
+
 /*****************************************************************************
  * RenderBlend: Full-resolution blender
  *****************************************************************************/
 
-void RenderBlend( filter_t *p_filter,
-                  picture_t *p_outpic, picture_t *p_pic )
+static void RenderBlendSlice( filter_t *p_filter, void *data,
+                              unsigned slice, unsigned slices )
 {
+    picture_t *p_outpic = ((picture_t **)data)[0];
+    const picture_t *p_pic = ((picture_t **)data)[1];
     int i_plane;
 
-    /* Copy image and skip lines */
     for( i_plane = 0 ; i_plane < p_pic->i_planes ; i_plane++ )
     {
         uint8_t *p_in, *p_out_end, *p_out;
+        int i_first, i_last;
 
-        p_in = p_pic->p[i_plane].p_pixels;
+        filter_GetSliceRows( p_outpic->p[i_plane].i_visible_lines,
+                             slice, slices, &i_first, &i_last );
+        if( i_first == i_last )
+            continue;
 
-        p_out = p_outpic->p[i_plane].p_pixels;
-        p_out_end = p_out + p_outpic->p[i_plane].i_pitch
-                             * p_outpic->p[i_plane].i_visible_lines;
+        p_out = p_outpic->p[i_plane].p_pixels
+                    + i_first * p_outpic->p[i_plane].i_pitch;
+        p_out_end = p_outpic->p[i_plane].p_pixels
+                        + i_last * p_outpic->p[i_plane].i_pitch;
 
-        /* First line: simple copy */
-        memcpy( p_out, p_in, p_pic->p[i_plane].i_pitch );
-        p_out += p_outpic->p[i_plane].i_pitch;
+        if( i_first == 0 )
+        {
+            /* First line: simple copy */
+            p_in = p_pic->p[i_plane].p_pixels;
+            memcpy( p_out, p_in, p_pic->p[i_plane].i_pitch );
+            p_out += p_outpic->p[i_plane].i_pitch;
+        }
+        else
+            p_in = p_pic->p[i_plane].p_pixels
+                       + (i_first - 1) * p_pic->p[i_plane].i_pitch;
 
         /* Remaining lines: mean value */
         for( ; p_out < p_out_end ; )
@@ -244,3 +272,11 @@ void RenderBlend( filter_t *p_filter,
     }
     EndMerge();
 }
+
+void RenderBlend( filter_t *p_filter,
+                  picture_t *p_outpic, picture_t *p_pic )
+{
+    picture_t *pp_pics[2] = { p_outpic, p_pic };
+
+    filter_RunSlices( p_filter, RenderBlendSlice, pp_pics, 0 );
+}
@@ -163,3 +163,23 @@ static inline picture_t *CopyInfoAndRelease( picture_t *p_outpic, picture_t *p_i
 
     return p_outpic;
 }
+
+/**
+ * Makes a picture out of the rows of a slice of another picture, for the
+ * slice callbacks of filter_RunSlices(). The pixels are shared.
+ */
+static inline void SlicePicture( picture_t *p_slice, const picture_t *p_pic,
+                                 unsigned slice, unsigned slices )
+{
+    *p_slice = *p_pic;
+    for( int i = 0; i < p_pic->i_planes; i++ )
+    {
+        int i_first, i_last;
+
+        filter_GetSliceRows( p_pic->p[i].i_visible_lines, slice, slices,
+                             &i_first, &i_last );
+        p_slice->p[i].p_pixels += i_first * p_pic->p[i].i_pitch;
+        p_slice->p[i].i_lines =
+        p_slice->p[i].i_visible_lines = i_last - i_first;
+    }
+}
@@ -171,6 +171,42 @@ static void Close(vlc_object_t *object)
     free(sys);
 }
 
+typedef struct {
+    const picture_t *src;
+    picture_t       *dst;
+    size_t           buf_size; /* per plane */
+} gradfun_slice_t;
+
+/* The blur of a plane runs from top to bottom, the planes are the slices */
+static void FilterPlane(filter_t *filter, void *data,
+                        unsigned plane, unsigned planes)
+{
+    filter_sys_t *sys = filter->p_sys;
+    const gradfun_slice_t *ctx = data;
+    const video_format_t *fmt = &filter->fmt_in.video;
+    const plane_t *srcp = &ctx->src->p[plane];
+    plane_t       *dstp = &ctx->dst->p[plane];
+    VLC_UNUSED(planes);
+
+    /* each plane has its own part of the blur buffer */
+    struct vf_priv_s cfg = sys->cfg;
+    if (cfg.buf)
+        cfg.buf += plane * ctx->buf_size;
+
+    const vlc_chroma_description_t *chroma = sys->chroma;
+    int w = fmt->i_width  * chroma->p[plane].w.num / chroma->p[plane].w.den;
+    int h = fmt->i_height * chroma->p[plane].h.num / chroma->p[plane].h.den;
+    int r = (cfg.radius  * chroma->p[plane].w.num / chroma->p[plane].w.den +
+             cfg.radius  * chroma->p[plane].h.num / chroma->p[plane].h.den) / 2;
+    r = VLC_CLIP((r + 1) & ~1, RADIUS_MIN, RADIUS_MAX);
+    if (__MIN(w, h) > 2 * r && cfg.buf) {
+        filter_plane(&cfg, dstp->p_pixels, srcp->p_pixels,
+                     w, h, dstp->i_pitch, srcp->i_pitch, r);
+    } else {
+        plane_CopyPixels(dstp, srcp);
+    }
+}
+
 static picture_t *Filter(filter_t *filter, picture_t *src)
 {
     filter_sys_t *sys = filter->p_sys;
@@ -188,31 +224,21 @@ static picture_t *Filter(filter_t *filter, picture_t *src)
 
     const video_format_t *fmt = &filter->fmt_in.video;
     struct vf_priv_s *cfg = &sys->cfg;
+    gradfun_slice_t ctx = {
+        .src = src,
+        .dst = dst,
+        .buf_size = ((fmt->i_width + 15) & ~15) * (radius + 1) / 2 + 32,
+    };
 
     cfg->thresh = (1 << 15) / strength;
     if (cfg->radius != radius) {
         cfg->radius = radius;
-        cfg->buf    = vlc_memalign(16,
-                                   (((fmt->i_width + 15) & ~15) * (cfg->radius + 1) / 2 + 32) * sizeof(*cfg->buf));
+        vlc_free(cfg->buf);
+        cfg->buf    = vlc_memalign(16, ctx.buf_size * VOUT_MAX_PLANES *
+                                       sizeof(*cfg->buf));
     }
 
-    for (int i = 0; i < dst->i_planes; i++) {
-        const plane_t *srcp = &src->p[i];
-        plane_t       *dstp = &dst->p[i];
-
-        const vlc_chroma_description_t *chroma = sys->chroma;
-        int w = fmt->i_width  * chroma->p[i].w.num / chroma->p[i].w.den;
-        int h = fmt->i_height * chroma->p[i].h.num / chroma->p[i].h.den;
-        int r = (cfg->radius  * chroma->p[i].w.num / chroma->p[i].w.den +
-                 cfg->radius  * chroma->p[i].h.num / chroma->p[i].h.den) / 2;
-        r = VLC_CLIP((r + 1) & ~1, RADIUS_MIN, RADIUS_MAX);
-        if (__MIN(w, h) > 2 * r && cfg->buf) {
-            filter_plane(cfg, dstp->p_pixels, srcp->p_pixels,
-                         w, h, dstp->i_pitch, srcp->i_pitch, r);
-        } else {
-            plane_CopyPixels(dstp, srcp);
-        }
-    }
+    filter_RunSlices(filter, FilterPlane, &ctx, dst->i_planes);
 
     picture_CopyProperties(dst, src);
     picture_Release(src);
@@ -90,6 +90,7 @@ struct filter_sys_t
 {
     const vlc_chroma_description_t *chroma;
     int w[3], h[3];
+    int wmax;
 
     struct vf_priv_s cfg;
     bool   b_recalc_coefs;
@@ -137,7 +138,9 @@ static int Open(vlc_object_t *this)
         if (sys->w[i] > wmax) wmax = sys->w[i];
         sys->h[i] = fmt_out->i_height * chroma->p[i].h.num / chroma->p[i].h.den;
     }
-    cfg->Line = malloc(wmax*sizeof(unsigned int));
+    /* one line per plane, as the planes are denoised concurrently */
+    sys->wmax = wmax;
+    cfg->Line = malloc(3*wmax*sizeof(unsigned int));
     if (!cfg->Line) {
         free(sys);
         return VLC_ENOMEM;
@@ -188,6 +191,30 @@ static void Close(vlc_object_t *this)
     free(sys);
 }
 
+typedef struct {
+    const picture_t *src;
+    picture_t       *dst;
+} hqdn3d_slice_t;
+
+/* The vertical and temporal filters of a plane run from top to bottom,
+ * the planes are the slices */
+static void FilterPlane(filter_t *filter, void *data,
+                        unsigned plane, unsigned planes)
+{
+    filter_sys_t *sys = filter->p_sys;
+    struct vf_priv_s *cfg = &sys->cfg;
+    const hqdn3d_slice_t *ctx = data;
+    int *spat = cfg->Coefs[plane ? 2 : 0];
+    int *temp = cfg->Coefs[plane ? 3 : 1];
+    VLC_UNUSED(planes);
+
+    deNoise(ctx->src->p[plane].p_pixels, ctx->dst->p[plane].p_pixels,
+            cfg->Line + plane * sys->wmax, &cfg->Frame[plane],
+            sys->w[plane], sys->h[plane],
+            ctx->src->p[plane].i_pitch, ctx->dst->p[plane].i_pitch,
+            spat, spat, temp);
+}
+
 /*****************************************************************************
  * Filter
  *****************************************************************************/
@@ -220,24 +247,8 @@ static picture_t *Filter(filter_t *filter, picture_t *src)
     }
     vlc_mutex_unlock( &sys->coefs_mutex );
 
-    deNoise(src->p[0].p_pixels, dst->p[0].p_pixels,
-            cfg->Line, &cfg->Frame[0], sys->w[0], sys->h[0],
-            src->p[0].i_pitch, dst->p[0].i_pitch,
-            cfg->Coefs[0],
-            cfg->Coefs[0],
-            cfg->Coefs[1]);
-    deNoise(src->p[1].p_pixels, dst->p[1].p_pixels,
-            cfg->Line, &cfg->Frame[1], sys->w[1], sys->h[1],
-            src->p[1].i_pitch, dst->p[1].i_pitch,
-            cfg->Coefs[2],
-            cfg->Coefs[2],
-            cfg->Coefs[3]);
-    deNoise(src->p[2].p_pixels, dst->p[2].p_pixels,
-            cfg->Line, &cfg->Frame[2], sys->w[2], sys->h[2],
-            src->p[2].i_pitch, dst->p[2].i_pitch,
-            cfg->Coefs[2],
-            cfg->Coefs[2],
-            cfg->Coefs[3]);
+    hqdn3d_slice_t ctx = { .src = src, .dst = dst };
+    filter_RunSlices(filter, FilterPlane, &ctx, 3);
 
     if(unlikely(!cfg->Frame[0] || !cfg->Frame[1] || !cfg->Frame[2]))
     {
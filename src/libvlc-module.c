@@ -379,6 +379,18 @@ static const char *const ppsz_pos_descriptions[] =
     "picture quality, for instance deinterlacing, or distort " \
     "the video.")
 
+#define VIDEO_FILTER_THREADS_TEXT N_("Video filter threads")
+#define VIDEO_FILTER_THREADS_LONGTEXT N_( \
+    "Number of threads processing the slices of the pictures for the " \
+    "video filters that support it (0 = one per CPU, 1 = no threads).")
+
+#define VIDEO_FILTER_PIPELINE_TEXT N_("Pipelined video filters")
+#define VIDEO_FILTER_PIPELINE_LONGTEXT N_( \
+    "Run each video filter on its own thread, so that the next pictures " \
+    "are filtered while the current one is displayed. This is the maximum " \
+    "number of pictures being filtered at once, which adds as many " \
+    "pictures of latency (0 = filter the pictures one at a time).")
+
 #define SNAP_PATH_TEXT N_("Video snapshot directory (or filename)")
 #define SNAP_PATH_LONGTEXT N_( \
     "Directory where the video snapshots will be stored.")
@@ -1014,6 +1026,11 @@ static const char *const ppsz_prefres[] = {
     "priorities. You can use it to tune VLC priority against other " \
     "programs, or against other VLC instances.")
 
+#define BLOCK_CACHE_TEXT N_("Cache the data blocks")
+#define BLOCK_CACHE_LONGTEXT N_( \
+    "Recycle the small data blocks, instead of allocating each of them " \
+    "from the system heap.")
+
 #define USE_STREAM_IMMEDIATE_LONGTEXT N_( \
      "This option is useful if you want to lower the latency when " \
      "reading a stream")
@@ -1602,6 +1619,12 @@ vlc_module_begin ()
     set_subcategory( SUBCAT_VIDEO_VFILTER )
     add_module_list_cat( "video-filter", SUBCAT_VIDEO_VFILTER, NULL,
                 VIDEO_FILTER_TEXT, VIDEO_FILTER_LONGTEXT, false )
+    add_integer_with_range( "video-filter-threads", 0, 0, 64,
+                            VIDEO_FILTER_THREADS_TEXT,
+                            VIDEO_FILTER_THREADS_LONGTEXT, true )
+    add_integer_with_range( "video-filter-pipeline", 0, 0, 16,
+                            VIDEO_FILTER_PIPELINE_TEXT,
+                            VIDEO_FILTER_PIPELINE_LONGTEXT, true )
 
     set_subcategory( SUBCAT_VIDEO_SPLITTER )
     add_module_list( "video-splitter", "video splitter", NULL,
@@ -1962,6 +1985,9 @@ vlc_module_begin ()
 
     set_section( N_("Performance options"), NULL )
 
+    add_bool( "block-cache", true, BLOCK_CACHE_TEXT,
+              BLOCK_CACHE_LONGTEXT, true )
+
 #if defined (LIBVLC_USE_PTHREAD) && !defined (__APPLE__)
     add_bool( "rt-priority", false, RT_PRIORITY_TEXT,
               RT_PRIORITY_LONGTEXT, true )
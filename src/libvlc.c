@@ -360,6 +360,8 @@ dbus_out:
 #endif // HAVE_DBUS
 
     vlc_CPU_dump( VLC_OBJECT(p_libvlc) );
+    vlc_block_cache_Init( p_libvlc );
+    vlc_filter_slices_Init( p_libvlc );
 
     priv->b_stats = var_InheritBool( p_libvlc, "stats" );
 
@@ -545,6 +547,9 @@ void libvlc_InternalCleanup( libvlc_int_t *p_libvlc )
     if( !var_InheritBool( p_libvlc, "ignore-config" ) )
         config_AutoSaveConfigFile( VLC_OBJECT(p_libvlc) );
 
+    vlc_filter_slices_Deinit( );
+    vlc_block_cache_Deinit( p_libvlc );
+
     /* Free module bank. It is refcounted, so we call this each time  */
     vlc_LogDeinit (p_libvlc);
     module_EndBank (true);
@@ -48,6 +48,18 @@ size_t EnumClockSource( vlc_object_t *, const char *, char ***, char *** );
 void vlc_CPU_init(void);
 void vlc_CPU_dump(vlc_object_t *);
 
+/*
+ * Blocks cache
+ */
+void vlc_block_cache_Init(libvlc_int_t *);
+void vlc_block_cache_Deinit(libvlc_int_t *);
+
+/*
+ * Video filters slices workers
+ */
+void vlc_filter_slices_Init(libvlc_int_t *);
+void vlc_filter_slices_Deinit(void);
+
 /*
  * Threads subsystem
  */
@@ -37,6 +37,8 @@
 #include <vlc_common.h>
 #include <vlc_block.h>
 #include <vlc_fs.h>
+#include <vlc_atomic.h>
+#include "libvlc.h"
 
 /**
  * @section Block handling functions.
@@ -124,15 +126,317 @@ static void BlockMetaCopy( block_t *restrict out, const block_t *in )
 /** Initial reserved header and footer size. */
 #define BLOCK_PADDING      32
 
+/**
+ * @section Blocks cache
+ *
+ * Allocations of up to BLOCK_CACHE_MAX bytes are rounded up to a power of
+ * two size class, and released blocks are kept on free lists for reuse.
+ * Each thread has its own lists, so that most allocations take no lock.
+ * Blocks move between the threads by batches, through a global depot: a
+ * thread that only releases blocks (e.g. an output) hands them over to the
+ * threads that only allocate them (e.g. a demuxer).
+ *
+ * The cache is enabled by the "block-cache" option of LibVLC, and can be
+ * switched at run-time. Blocks can always be released by either path.
+ */
+#define BLOCK_CACHE_MIN_SHIFT 8 /* 256 bytes */
+#define BLOCK_CACHE_CLASSES   8 /* up to 32 kiB */
+#define BLOCK_CACHE_MAX       ((size_t)1 << (BLOCK_CACHE_MIN_SHIFT + BLOCK_CACHE_CLASSES - 1))
+#define BLOCK_CACHE_DEPOT     8 /* batches per size class */
+
+typedef struct
+{
+    block_t *list[BLOCK_CACHE_CLASSES]; /* linked through p_next */
+    unsigned count[BLOCK_CACHE_CLASSES];
+    uint64_t hits;
+    uint64_t misses;
+} block_cache_thread_t;
+
+static struct
+{
+    vlc_mutex_t lock;
+    unsigned refs;
+    vlc_threadvar_t key;
+    atomic_bool enabled;
+
+    block_t *batches[BLOCK_CACHE_CLASSES][BLOCK_CACHE_DEPOT];
+    unsigned count[BLOCK_CACHE_CLASSES];
+    size_t footprint; /* bytes in the depot */
+    size_t peak;
+
+    uint64_t hits;     /* allocations from the cache */
+    uint64_t misses;   /* allocations from the heap */
+    uint64_t releases; /* blocks returned to the heap */
+} block_cache = { .lock = VLC_STATIC_MUTEX };
+
+static size_t block_cache_Size (unsigned i)
+{
+    return (size_t)1 << (BLOCK_CACHE_MIN_SHIFT + i);
+}
+
+/* Number of blocks moved at once between a thread and the depot.
+ * Large blocks are moved by smaller batches to bound the footprint. */
+static unsigned block_cache_Batch (unsigned i)
+{
+    return VLC_CLIP (32768 / block_cache_Size (i), 4, 32);
+}
+
+static unsigned block_cache_Class (size_t alloc)
+{
+    unsigned i = 0;
+
+    while (block_cache_Size (i) < alloc)
+        i++;
+    return i;
+}
+
+static void block_cache_Free (block_t *list)
+{
+    while (list != NULL)
+    {
+        block_t *next = list->p_next;
+
+        free (list);
+        list = next;
+    }
+}
+
+/* Moves a batch of blocks of a thread to the depot, or to the heap if the
+ * depot is full. */
+static void block_cache_Put (block_cache_thread_t *tc, unsigned i,
+                             unsigned count)
+{
+    block_t *batch = tc->list[i], **pp = &tc->list[i];
+
+    assert (count <= tc->count[i]);
+    for (unsigned n = 0; n < count; n++)
+        pp = &(*pp)->p_next;
+    tc->list[i] = *pp;
+    tc->count[i] -= count;
+    *pp = NULL;
+
+    vlc_mutex_lock (&block_cache.lock);
+    block_cache.hits += tc->hits;
+    block_cache.misses += tc->misses;
+    tc->hits = tc->misses = 0;
+    if (count > 0 && block_cache.count[i] < BLOCK_CACHE_DEPOT)
+    {
+        block_cache.batches[i][block_cache.count[i]++] = batch;
+        block_cache.footprint += count * block_cache_Size (i);
+        if (block_cache.peak < block_cache.footprint)
+            block_cache.peak = block_cache.footprint;
+        batch = NULL;
+    }
+    else
+        block_cache.releases += count;
+    vlc_mutex_unlock (&block_cache.lock);
+
+    block_cache_Free (batch);
+}
+
+/* Refills the list of a thread with a batch from the depot */
+static bool block_cache_Get (block_cache_thread_t *tc, unsigned i)
+{
+    block_t *batch = NULL;
+
+    vlc_mutex_lock (&block_cache.lock);
+    if (block_cache.count[i] > 0)
+    {
+        batch = block_cache.batches[i][--block_cache.count[i]];
+        block_cache.footprint -= block_cache_Batch (i) * block_cache_Size (i);
+    }
+    vlc_mutex_unlock (&block_cache.lock);
+
+    if (batch == NULL)
+        return false;
+
+    assert (tc->list[i] == NULL);
+    tc->list[i] = batch;
+    tc->count[i] = block_cache_Batch (i);
+    return true;
+}
+
+/* Returns the lists of a thread to the depot, when the thread exits */
+static void block_cache_Flush (void *data)
+{
+    block_cache_thread_t *tc = data;
+
+    for (unsigned i = 0; i < BLOCK_CACHE_CLASSES; i++)
+    {
+        unsigned batch = block_cache_Batch (i);
+
+        while (tc->count[i] >= batch)
+            block_cache_Put (tc, i, batch);
+        /* incomplete batch */
+        block_cache_Free (tc->list[i]);
+        vlc_mutex_lock (&block_cache.lock);
+        block_cache.releases += tc->count[i];
+        vlc_mutex_unlock (&block_cache.lock);
+        tc->list[i] = NULL;
+        tc->count[i] = 0;
+    }
+    block_cache_Put (tc, 0, 0); /* statistics */
+    free (tc);
+}
+
+static block_cache_thread_t *block_cache_Thread (void)
+{
+    block_cache_thread_t *tc = vlc_threadvar_get (block_cache.key);
+    if (unlikely(tc == NULL))
+    {
+        tc = calloc (1, sizeof (*tc));
+        if (unlikely(tc == NULL))
+            return NULL;
+        if (vlc_threadvar_set (block_cache.key, tc))
+        {
+            free (tc);
+            return NULL;
+        }
+    }
+    return tc;
+}
+
+static void block_cache_Release (block_t *block)
+{
+    assert (block->p_start == (unsigned char *)(block + 1));
+    block_Invalidate (block);
+
+    block_cache_thread_t *tc = NULL;
+    if (atomic_load_explicit (&block_cache.enabled, memory_order_relaxed))
+        tc = block_cache_Thread ();
+    if (tc == NULL)
+    {
+        free (block);
+        return;
+    }
+
+    unsigned i = block_cache_Class (sizeof (*block) + block->i_size);
+    assert (block_cache_Size (i) == sizeof (*block) + block->i_size);
+
+    block->p_next = tc->list[i];
+    tc->list[i] = block;
+    /* Keep up to two batches, so that a thread alternating allocations
+     * and releases around the limit does not go to the depot each time. */
+    if (++tc->count[i] >= 2 * block_cache_Batch (i))
+        block_cache_Put (tc, i, block_cache_Batch (i));
+}
+
+static block_t *block_cache_Alloc (size_t *restrict alloc)
+{
+    if (*alloc > BLOCK_CACHE_MAX
+     || !atomic_load_explicit (&block_cache.enabled, memory_order_relaxed))
+        return NULL;
+
+    block_cache_thread_t *tc = block_cache_Thread ();
+    if (unlikely(tc == NULL))
+        return NULL;
+
+    unsigned i = block_cache_Class (*alloc);
+    block_t *b = tc->list[i];
+
+    *alloc = block_cache_Size (i);
+    if (b == NULL && block_cache_Get (tc, i))
+        b = tc->list[i];
+    if (b == NULL)
+    {
+        b = malloc (*alloc);
+        if (likely(b != NULL))
+            tc->misses++;
+        return b;
+    }
+
+    tc->list[i] = b->p_next;
+    tc->count[i]--;
+    tc->hits++;
+    return b;
+}
+
+static int block_cache_Changed (vlc_object_t *obj, const char *name,
+                                vlc_value_t oldval, vlc_value_t newval,
+                                void *data)
+{
+    VLC_UNUSED(obj); VLC_UNUSED(name); VLC_UNUSED(oldval); VLC_UNUSED(data);
+
+    atomic_store (&block_cache.enabled, newval.b_bool);
+    return VLC_SUCCESS;
+}
+
+/**
+ * Enables the blocks cache as configured for the LibVLC instance.
+ * The cache is shared by all the instances.
+ */
+void vlc_block_cache_Init (libvlc_int_t *libvlc)
+{
+    vlc_mutex_lock (&block_cache.lock);
+    if (block_cache.refs++ == 0)
+    {
+        vlc_threadvar_create (&block_cache.key, block_cache_Flush);
+        atomic_store (&block_cache.enabled,
+                      var_InheritBool (libvlc, "block-cache"));
+    }
+    vlc_mutex_unlock (&block_cache.lock);
+
+    var_Create (libvlc, "block-cache", VLC_VAR_BOOL | VLC_VAR_DOINHERIT);
+    var_AddCallback (libvlc, "block-cache", block_cache_Changed, NULL);
+}
+
+/**
+ * Releases the blocks cache, when the last LibVLC instance is destroyed.
+ * The other threads must have exited.
+ */
+void vlc_block_cache_Deinit (libvlc_int_t *libvlc)
+{
+    var_DelCallback (libvlc, "block-cache", block_cache_Changed, NULL);
+
+    vlc_mutex_lock (&block_cache.lock);
+    assert (block_cache.refs > 0);
+    if (--block_cache.refs > 0)
+    {
+        vlc_mutex_unlock (&block_cache.lock);
+        return;
+    }
+    atomic_store (&block_cache.enabled, false);
+    vlc_mutex_unlock (&block_cache.lock);
+
+    block_cache_thread_t *tc = vlc_threadvar_get (block_cache.key);
+    if (tc != NULL)
+    {
+        vlc_threadvar_set (block_cache.key, NULL);
+        block_cache_Flush (tc);
+    }
+    vlc_threadvar_delete (&block_cache.key);
+
+    vlc_mutex_lock (&block_cache.lock);
+    uint64_t total = block_cache.hits + block_cache.misses;
+    if (total > 0)
+        msg_Dbg (libvlc, "blocks cache: %"PRIu64" allocations, %"PRIu64"%% "
+                 "hits, %"PRIu64" blocks returned to the heap, "
+                 "depot peak footprint %zu kiB", total,
+                 block_cache.hits * 100 / total, block_cache.releases,
+                 block_cache.peak >> 10);
+
+    for (unsigned i = 0; i < BLOCK_CACHE_CLASSES; i++)
+    {
+        while (block_cache.count[i] > 0)
+            block_cache_Free (block_cache.batches[i][--block_cache.count[i]]);
+    }
+    block_cache.footprint = block_cache.peak = 0;
+    block_cache.hits = block_cache.misses = block_cache.releases = 0;
+    vlc_mutex_unlock (&block_cache.lock);
+}
+
 block_t *block_Alloc (size_t size)
 {
     /* 2 * BLOCK_PADDING: pre + post padding */
-    const size_t alloc = sizeof (block_t) + BLOCK_ALIGN + (2 * BLOCK_PADDING)
-                       + size;
+    size_t alloc = sizeof (block_t) + BLOCK_ALIGN + (2 * BLOCK_PADDING)
+                 + size;
     if (unlikely(alloc <= size))
         return NULL;
 
-    block_t *b = malloc (alloc);
+    block_t *b = block_cache_Alloc (&alloc);
+    bool cached = b != NULL;
+    if (!cached)
+        b = malloc (alloc);
     if (unlikely(b == NULL))
         return NULL;
 
@@ -142,7 +446,7 @@ block_t *block_Alloc (size_t size)
     b->p_buffer += BLOCK_PADDING + BLOCK_ALIGN - 1;
     b->p_buffer = (void *)(((uintptr_t)b->p_buffer) & ~(BLOCK_ALIGN - 1));
     b->i_buffer = size;
-    b->pf_release = block_generic_Release;
+    b->pf_release = cached ? block_cache_Release : block_generic_Release;
     return b;
 }
 
@@ -25,6 +25,8 @@
 # include "config.h"
 #endif
 
+#include <assert.h>
+
 #include <vlc_common.h>
 #include <libvlc.h>
 #include <vlc_filter.h>
@@ -111,6 +113,195 @@ void filter_DeleteBlend( filter_t *p_blend )
     vlc_object_release( p_blend );
 }
 
+/* Slices of the pictures being processed by a filter */
+typedef struct filter_slices_job_t
+{
+    struct filter_slices_job_t *next;
+    filter_t        *filter;
+    filter_slice_cb  cb;
+    void            *data;
+    unsigned         slices;
+    unsigned         started; /* slices taken by a thread */
+    unsigned         pending; /* slices not completed yet */
+} filter_slices_job_t;
+
+/* Worker threads shared by all the filters of the process */
+static struct
+{
+    vlc_mutex_t   lock;
+    vlc_cond_t    wait; /* jobs queued */
+    vlc_cond_t    done; /* slices completed */
+    unsigned      refs;
+    unsigned      max; /* worker threads to start */
+    unsigned      count; /* worker threads started */
+    vlc_thread_t *threads;
+    bool          started;
+    bool          exiting;
+    filter_slices_job_t *jobs;
+} slices = { .lock = VLC_STATIC_MUTEX };
+
+/* Runs the next slice of a job, with the lock held */
+static void filter_slices_Run( filter_slices_job_t *job )
+{
+    unsigned slice = job->started++;
+
+    if( job->started == job->slices )
+    {   /* No more slices to start, dequeue */
+        filter_slices_job_t **pp = &slices.jobs;
+        while( *pp != job )
+            pp = &(*pp)->next;
+        *pp = job->next;
+    }
+
+    vlc_mutex_unlock( &slices.lock );
+    job->cb( job->filter, job->data, slice, job->slices );
+    vlc_mutex_lock( &slices.lock );
+
+    /* The job belongs to the filter thread, which may return at once */
+    if( --job->pending == 0 )
+        vlc_cond_broadcast( &slices.done );
+}
+
+static void *filter_slices_Thread( void *data )
+{
+    VLC_UNUSED(data);
+
+    vlc_mutex_lock( &slices.lock );
+    for( ;; )
+    {
+        while( slices.jobs == NULL && !slices.exiting )
+            vlc_cond_wait( &slices.wait, &slices.lock );
+        if( slices.jobs == NULL )
+            break;
+        filter_slices_Run( slices.jobs );
+    }
+    vlc_mutex_unlock( &slices.lock );
+    return NULL;
+}
+
+/* Starts the worker threads, with the lock held */
+static void filter_slices_Start( void )
+{
+    slices.started = true;
+    if( slices.max == 0 )
+        return;
+
+    slices.threads = malloc( slices.max * sizeof (vlc_thread_t) );
+    if( slices.threads != NULL )
+        while( slices.count < slices.max
+            && !vlc_clone( &slices.threads[slices.count], filter_slices_Thread,
+                           NULL, VLC_THREAD_PRIORITY_VIDEO ) )
+            slices.count++;
+}
+
+void filter_RunSlices( filter_t *p_filter, filter_slice_cb cb, void *data,
+                       unsigned count )
+{
+    vlc_mutex_lock( &slices.lock );
+    /* Most instances never filter any video: start on first use */
+    if( !slices.started && slices.refs > 0 )
+    {
+        filter_slices_Start();
+        msg_Dbg( p_filter, "using %u video filter threads", slices.count + 1 );
+    }
+    if( count == 0 )
+        count = slices.count + 1;
+
+    if( slices.count == 0 || count == 1 )
+    {   /* No worker threads: run the slices in order */
+        vlc_mutex_unlock( &slices.lock );
+        for( unsigned i = 0; i < count; i++ )
+            cb( p_filter, data, i, count );
+        return;
+    }
+
+    filter_slices_job_t job = {
+        .next = NULL,
+        .filter = p_filter,
+        .cb = cb,
+        .data = data,
+        .slices = count,
+        .started = 0,
+        .pending = count,
+    };
+
+    filter_slices_job_t **pp = &slices.jobs;
+    while( *pp != NULL )
+        pp = &(*pp)->next;
+    *pp = &job;
+    vlc_cond_broadcast( &slices.wait );
+
+    /* The calling thread works too */
+    while( job.started < job.slices )
+        filter_slices_Run( &job );
+    while( job.pending > 0 )
+        vlc_cond_wait( &slices.done, &slices.lock );
+    vlc_mutex_unlock( &slices.lock );
+}
+
+/**
+ * Sets the number of slices worker threads, if they are not set yet.
+ * The threads start when a filter first runs slices.
+ */
+void vlc_filter_slices_Init( libvlc_int_t *p_libvlc )
+{
+    vlc_mutex_lock( &slices.lock );
+    if( slices.refs++ > 0 )
+    {
+        vlc_mutex_unlock( &slices.lock );
+        return;
+    }
+
+    unsigned count = var_InheritInteger( p_libvlc, "video-filter-threads" );
+    if( count == 0 )
+        count = vlc_GetCPUCount();
+    /* The filter thread processes slices too */
+    count = (count > 1) ? count - 1 : 0;
+
+    vlc_cond_init( &slices.wait );
+    vlc_cond_init( &slices.done );
+    slices.exiting = false;
+    slices.jobs = NULL;
+    slices.max = count;
+    slices.count = 0;
+    slices.threads = NULL;
+    slices.started = false;
+    vlc_mutex_unlock( &slices.lock );
+}
+
+/**
+ * Stops the slices worker threads, if started, when the last instance exits.
+ */
+void vlc_filter_slices_Deinit( void )
+{
+    vlc_mutex_lock( &slices.lock );
+    assert( slices.refs > 0 );
+    if( --slices.refs > 0 )
+    {
+        vlc_mutex_unlock( &slices.lock );
+        return;
+    }
+    assert( slices.jobs == NULL );
+    if( slices.count > 0 )
+    {
+        slices.exiting = true;
+        vlc_cond_broadcast( &slices.wait );
+        vlc_mutex_unlock( &slices.lock );
+
+        for( unsigned i = 0; i < slices.count; i++ )
+            vlc_join( slices.threads[i], NULL );
+
+        vlc_mutex_lock( &slices.lock );
+    }
+    free( slices.threads );
+    slices.threads = NULL;
+    slices.count = 0;
+    slices.started = false;
+    vlc_cond_destroy( &slices.done );
+    vlc_cond_destroy( &slices.wait );
+    vlc_mutex_unlock( &slices.lock );
+}
+
 /* */
 #include <vlc_video_splitter.h>
 
@@ -39,6 +39,10 @@ typedef struct chained_filter_t
     struct chained_filter_t *prev, *next;
     vlc_mouse_t *mouse;
     picture_t *pending;
+    /* Pipelined chain */
+    vlc_mutex_t lock; /**< Serializes the filter and mouse callbacks */
+    vlc_thread_t thread;
+    picture_t *queue, **queue_last; /**< Pictures to filter */
 } chained_filter_t;
 
 /* Only use this with filter objects from _this_ C module */
@@ -59,6 +63,20 @@ struct filter_chain_t
     es_format_t fmt_out; /**< Chain current output format */
     unsigned length; /**< Number of filters */
     bool b_allow_fmt_out_change; /**< Can the output format be changed? */
+
+    struct
+    {
+        vlc_mutex_t lock;
+        vlc_cond_t  wait; /**< Pictures queued, filtered or dropped */
+        unsigned depth; /**< Maximum pictures in the filters, 0 if synchronous */
+        unsigned count; /**< Pictures queued to or being filtered */
+        bool running;
+        bool exiting;
+        picture_t *out, **out_last; /**< Pictures out of the last filter */
+        void (*ready)( void * );
+        void *opaque;
+    } pipeline;
+
     char psz_capability[1]; /**< Module capability for all chained filters */
 };
 
@@ -66,6 +84,7 @@ struct filter_chain_t
  * Local prototypes
  */
 static void FilterDeletePictures( picture_t * );
+static void FilterChainPipelineStop( filter_chain_t * );
 
 static filter_chain_t *filter_chain_NewInner( const filter_owner_t *callbacks,
     const char *cap, bool fmt_out_change, const filter_owner_t *owner )
@@ -86,6 +105,16 @@ static filter_chain_t *filter_chain_NewInner( const filter_owner_t *callbacks,
     es_format_Init( &chain->fmt_out, UNKNOWN_ES, 0 );
     chain->length = 0;
     chain->b_allow_fmt_out_change = fmt_out_change;
+    vlc_mutex_init( &chain->pipeline.lock );
+    vlc_cond_init( &chain->pipeline.wait );
+    chain->pipeline.depth = 0;
+    chain->pipeline.count = 0;
+    chain->pipeline.running = false;
+    chain->pipeline.exiting = false;
+    chain->pipeline.out = NULL;
+    chain->pipeline.out_last = &chain->pipeline.out;
+    chain->pipeline.ready = NULL;
+    chain->pipeline.opaque = NULL;
     strcpy( chain->psz_capability, cap );
 
     return chain;
@@ -152,6 +181,8 @@ void filter_chain_Delete( filter_chain_t *p_chain )
 
     es_format_Clean( &p_chain->fmt_in );
     es_format_Clean( &p_chain->fmt_out );
+    vlc_cond_destroy( &p_chain->pipeline.wait );
+    vlc_mutex_destroy( &p_chain->pipeline.lock );
 
     free( p_chain );
 }
@@ -182,6 +213,9 @@ filter_t *filter_chain_AppendFilter( filter_chain_t *chain, const char *name,
                                      const es_format_t *fmt_out )
 {
     vlc_object_t *parent = chain->callbacks.sys;
+
+    FilterChainPipelineStop( chain );
+
     chained_filter_t *chained =
         vlc_custom_create( parent, sizeof(*chained), "filter" );
     if( unlikely(chained == NULL) )
@@ -236,6 +270,9 @@ filter_t *filter_chain_AppendFilter( filter_chain_t *chain, const char *name,
         vlc_mouse_Init( mouse );
     chained->mouse = mouse;
     chained->pending = NULL;
+    vlc_mutex_init( &chained->lock );
+    chained->queue = NULL;
+    chained->queue_last = &chained->queue;
 
     msg_Dbg( parent, "Filter '%s' (%p) appended to chain",
              (name != NULL) ? name : module_get_name(filter->p_module, false),
@@ -259,6 +296,8 @@ void filter_chain_DeleteFilter( filter_chain_t *chain, filter_t *filter )
     vlc_object_t *obj = chain->callbacks.sys;
     chained_filter_t *chained = (chained_filter_t *)filter;
 
+    FilterChainPipelineStop( chain );
+
     /* Remove it from the chain */
     if( chained->prev != NULL )
         chained->prev->next = chained->next;
@@ -283,6 +322,7 @@ void filter_chain_DeleteFilter( filter_chain_t *chain, filter_t *filter )
 
     msg_Dbg( obj, "Filter %p removed from chain", (void *)filter );
     FilterDeletePictures( chained->pending );
+    vlc_mutex_destroy( &chained->lock );
 
     free( chained->mouse );
     es_format_Clean( &filter->fmt_out );
@@ -371,7 +411,9 @@ static picture_t *FilterChainVideoFilter( chained_filter_t *f, picture_t *p_pic
     for( ; f != NULL; f = f->next )
     {
         filter_t *p_filter = &f->filter;
+        vlc_mutex_lock( &f->lock );
         p_pic = p_filter->pf_video_filter( p_filter, p_pic );
+        vlc_mutex_unlock( &f->lock );
         if( !p_pic )
             break;
         if( f->pending )
@@ -385,8 +427,171 @@ static picture_t *FilterChainVideoFilter( chained_filter_t *f, picture_t *p_pic
     return p_pic;
 }
 
+/* Pipelined chain: each filter runs on its own thread, and passes its
+ * pictures to the queue of the next one. */
+static void *FilterChainPipelineThread( void *data )
+{
+    chained_filter_t *f = data;
+    filter_chain_t *chain = f->filter.owner.sys;
+
+    vlc_mutex_lock( &chain->pipeline.lock );
+    for( ;; )
+    {
+        while( f->queue == NULL && !chain->pipeline.exiting )
+            vlc_cond_wait( &chain->pipeline.wait, &chain->pipeline.lock );
+        if( chain->pipeline.exiting )
+            break;
+
+        picture_t *pic = f->queue;
+        f->queue = pic->p_next;
+        if( f->queue == NULL )
+            f->queue_last = &f->queue;
+        pic->p_next = NULL;
+        vlc_mutex_unlock( &chain->pipeline.lock );
+
+        vlc_mutex_lock( &f->lock );
+        pic = f->filter.pf_video_filter( &f->filter, pic );
+        vlc_mutex_unlock( &f->lock );
+
+        vlc_mutex_lock( &chain->pipeline.lock );
+        /* The filter may drop the picture, or output several ones */
+        chain->pipeline.count--;
+        if( pic == NULL )
+        {
+            vlc_cond_broadcast( &chain->pipeline.wait );
+            continue;
+        }
+
+        picture_t ***pp_last = f->next != NULL ? &f->next->queue_last
+                                               : &chain->pipeline.out_last;
+        **pp_last = pic;
+        for( ;; )
+        {
+            if( f->next != NULL )
+                chain->pipeline.count++;
+            if( pic->p_next == NULL )
+                break;
+            pic = pic->p_next;
+        }
+        *pp_last = &pic->p_next;
+        vlc_cond_broadcast( &chain->pipeline.wait );
+
+        if( f->next == NULL && chain->pipeline.ready != NULL )
+        {
+            vlc_mutex_unlock( &chain->pipeline.lock );
+            chain->pipeline.ready( chain->pipeline.opaque );
+            vlc_mutex_lock( &chain->pipeline.lock );
+        }
+    }
+    vlc_mutex_unlock( &chain->pipeline.lock );
+    return NULL;
+}
+
+static int FilterChainPipelineStart( filter_chain_t *chain )
+{
+    for( chained_filter_t *f = chain->first; f != NULL; f = f->next )
+    {
+        if( vlc_clone( &f->thread, FilterChainPipelineThread, f,
+                       VLC_THREAD_PRIORITY_VIDEO ) )
+        {
+            vlc_mutex_lock( &chain->pipeline.lock );
+            chain->pipeline.exiting = true;
+            vlc_cond_broadcast( &chain->pipeline.wait );
+            vlc_mutex_unlock( &chain->pipeline.lock );
+
+            for( chained_filter_t *g = chain->first; g != f; g = g->next )
+                vlc_join( g->thread, NULL );
+            chain->pipeline.exiting = false;
+            return VLC_EGENERIC;
+        }
+    }
+    chain->pipeline.running = true;
+    return VLC_SUCCESS;
+}
+
+/* Joins the threads, and drops the pictures in the chain */
+static void FilterChainPipelineStop( filter_chain_t *chain )
+{
+    if( !chain->pipeline.running )
+        return;
+
+    vlc_mutex_lock( &chain->pipeline.lock );
+    chain->pipeline.exiting = true;
+    vlc_cond_broadcast( &chain->pipeline.wait );
+    vlc_mutex_unlock( &chain->pipeline.lock );
+
+    for( chained_filter_t *f = chain->first; f != NULL; f = f->next )
+        vlc_join( f->thread, NULL );
+
+    /* The chain may be checked for pictures from another thread */
+    vlc_mutex_lock( &chain->pipeline.lock );
+    for( chained_filter_t *f = chain->first; f != NULL; f = f->next )
+    {
+        FilterDeletePictures( f->queue );
+        f->queue = NULL;
+        f->queue_last = &f->queue;
+    }
+    FilterDeletePictures( chain->pipeline.out );
+    chain->pipeline.out = NULL;
+    chain->pipeline.out_last = &chain->pipeline.out;
+    chain->pipeline.count = 0;
+    chain->pipeline.exiting = false;
+    vlc_mutex_unlock( &chain->pipeline.lock );
+    chain->pipeline.running = false;
+}
+
+/* Takes the next picture out of the chain, with the lock held */
+static picture_t *FilterChainPipelinePop( filter_chain_t *chain )
+{
+    picture_t *pic = chain->pipeline.out;
+
+    if( pic != NULL )
+    {
+        chain->pipeline.out = pic->p_next;
+        if( chain->pipeline.out == NULL )
+            chain->pipeline.out_last = &chain->pipeline.out;
+        pic->p_next = NULL;
+    }
+    return pic;
+}
+
+static picture_t *FilterChainPipelineFilter( filter_chain_t *chain,
+                                             picture_t *pic )
+{
+    vlc_mutex_lock( &chain->pipeline.lock );
+    if( pic != NULL )
+    {
+        *chain->first->queue_last = pic;
+        chain->first->queue_last = &pic->p_next;
+        chain->pipeline.count++;
+        vlc_cond_broadcast( &chain->pipeline.wait );
+
+        /* Wait for room in the filters. The pictures out of the chain do
+         * not count, as a filter can output several pictures per input. */
+        while( chain->pipeline.count > chain->pipeline.depth )
+            vlc_cond_wait( &chain->pipeline.wait, &chain->pipeline.lock );
+    }
+    pic = FilterChainPipelinePop( chain );
+    vlc_mutex_unlock( &chain->pipeline.lock );
+    return pic;
+}
+
+void filter_chain_SetPipeline( filter_chain_t *chain, unsigned depth,
+                               void (*ready)( void * ), void *opaque )
+{
+    FilterChainPipelineStop( chain );
+    chain->pipeline.depth = depth;
+    chain->pipeline.ready = ready;
+    chain->pipeline.opaque = opaque;
+}
+
 picture_t *filter_chain_VideoFilter( filter_chain_t *p_chain, picture_t *p_pic )
 {
+    if( p_chain->pipeline.depth > 0 && p_chain->first != NULL
+     && (p_chain->pipeline.running
+      || FilterChainPipelineStart( p_chain ) == VLC_SUCCESS) )
+        return FilterChainPipelineFilter( p_chain, p_pic );
+
     if( p_pic )
     {
         p_pic = FilterChainVideoFilter( p_chain->first, p_pic );
@@ -408,8 +613,32 @@ picture_t *filter_chain_VideoFilter( filter_chain_t *p_chain, picture_t *p_pic )
     return NULL;
 }
 
+picture_t *filter_chain_VideoDrain( filter_chain_t *p_chain )
+{
+    if( !p_chain->pipeline.running )
+        return filter_chain_VideoFilter( p_chain, NULL );
+
+    vlc_mutex_lock( &p_chain->pipeline.lock );
+    while( p_chain->pipeline.out == NULL && p_chain->pipeline.count > 0 )
+        vlc_cond_wait( &p_chain->pipeline.wait, &p_chain->pipeline.lock );
+    picture_t *pic = FilterChainPipelinePop( p_chain );
+    vlc_mutex_unlock( &p_chain->pipeline.lock );
+    return pic;
+}
+
+bool filter_chain_VideoIsEmpty( filter_chain_t *p_chain )
+{
+    vlc_mutex_lock( &p_chain->pipeline.lock );
+    bool b_empty = p_chain->pipeline.count == 0
+                && p_chain->pipeline.out == NULL;
+    vlc_mutex_unlock( &p_chain->pipeline.lock );
+    return b_empty;
+}
+
 void filter_chain_VideoFlush( filter_chain_t *p_chain )
 {
+    FilterChainPipelineStop( p_chain );
+
     for( chained_filter_t *f = p_chain->first; f != NULL; f = f->next )
     {
         filter_t *p_filter = &f->filter;
@@ -476,7 +705,11 @@ int filter_chain_MouseFilter( filter_chain_t *p_chain, vlc_mouse_t *p_dst, const
             vlc_mouse_t filtered;
 
             *p_mouse = current;
-            if( p_filter->pf_video_mouse( p_filter, &filtered, &old, &current ) )
+            vlc_mutex_lock( &f->lock );
+            int ret = p_filter->pf_video_mouse( p_filter, &filtered, &old,
+                                                &current );
+            vlc_mutex_unlock( &f->lock );
+            if( ret )
                 return VLC_EGENERIC;
             current = filtered;
         }
@@ -34,7 +34,14 @@
 #include <vlc_atomic.h>
 #include "picture.h"
 
-static const uintptr_t pool_max = CHAR_BIT * sizeof (unsigned long long);
+/* The offset of a picture in its pool is stored in the low bits of the pool
+ * pointer, see picture_pool_ClonePicture(). */
+#define POOL_MAX 1024
+static const uintptr_t pool_max = POOL_MAX;
+
+/* Free pictures bitmap words */
+#define POOL_WORD_BITS (CHAR_BIT * sizeof (unsigned long long))
+#define POOL_WORDS (POOL_MAX / POOL_WORD_BITS)
 
 struct picture_pool_t {
     int       (*pic_lock)(picture_t *);
@@ -42,13 +49,35 @@ struct picture_pool_t {
     vlc_mutex_t lock;
     vlc_cond_t  wait;
 
-    bool               canceled;
-    unsigned long long available;
+    atomic_bool        canceled;
+    atomic_uint        waiters;
+    atomic_ullong      available[POOL_WORDS];
     atomic_ushort      refs;
     unsigned short     picture_count;
+
+    /* contention statistics */
+    atomic_ulong       retries;
+    atomic_ulong       waits;
+
     picture_t  *picture[];
 };
 
+static unsigned picture_pool_Words(const picture_pool_t *pool)
+{
+    return (pool->picture_count + POOL_WORD_BITS - 1) / POOL_WORD_BITS;
+}
+
+/* Bits of the pictures of a bitmap word */
+static unsigned long long picture_pool_Mask(const picture_pool_t *pool,
+                                            unsigned w)
+{
+    unsigned count = pool->picture_count - w * POOL_WORD_BITS;
+
+    if (count >= POOL_WORD_BITS)
+        return ~0ULL;
+    return (1ULL << count) - 1;
+}
+
 static void picture_pool_Destroy(picture_pool_t *pool)
 {
     if (atomic_fetch_sub(&pool->refs, 1) != 1)
@@ -66,6 +95,25 @@ void picture_pool_Release(picture_pool_t *pool)
     picture_pool_Destroy(pool);
 }
 
+/* Returns a picture to the free bitmap, and wakes up a waiting thread */
+static void picture_pool_Put(picture_pool_t *pool, unsigned offset)
+{
+    unsigned long long bit = 1ULL << (offset % POOL_WORD_BITS);
+    unsigned long long old =
+        atomic_fetch_or(&pool->available[offset / POOL_WORD_BITS], bit);
+
+    assert(!(old & bit));
+    (void) old;
+
+    /* The waiter registers before checking the bitmap, so either it sees the
+     * picture, or it is seen here. */
+    if (atomic_load(&pool->waiters) > 0) {
+        vlc_mutex_lock(&pool->lock);
+        vlc_cond_signal(&pool->wait);
+        vlc_mutex_unlock(&pool->lock);
+    }
+}
+
 static void picture_pool_ReleasePicture(picture_t *clone)
 {
     picture_priv_t *priv = (picture_priv_t *)clone;
@@ -80,12 +128,7 @@ static void picture_pool_ReleasePicture(picture_t *clone)
         pool->pic_unlock(picture);
     picture_Release(picture);
 
-    vlc_mutex_lock(&pool->lock);
-    assert(!(pool->available & (1ULL << offset)));
-    pool->available |= 1ULL << offset;
-    vlc_cond_signal(&pool->wait);
-    vlc_mutex_unlock(&pool->lock);
-
+    picture_pool_Put(pool, offset);
     picture_pool_Destroy(pool);
 }
 
@@ -127,12 +170,17 @@ picture_pool_t *picture_pool_NewExtended(const picture_pool_configuration_t *cfg
     pool->pic_unlock = cfg->unlock;
     vlc_mutex_init(&pool->lock);
     vlc_cond_init(&pool->wait);
-    pool->available = (1ULL << cfg->picture_count) - 1;
     atomic_init(&pool->refs,  1);
     pool->picture_count = cfg->picture_count;
+    for (unsigned w = 0; w < POOL_WORDS; w++)
+        atomic_init(&pool->available[w], (w < picture_pool_Words(pool))
+                                         ? picture_pool_Mask(pool, w) : 0);
     memcpy(pool->picture, cfg->picture,
            cfg->picture_count * sizeof (picture_t *));
-    pool->canceled = false;
+    atomic_init(&pool->canceled, false);
+    atomic_init(&pool->waiters, 0);
+    atomic_init(&pool->retries, 0);
+    atomic_init(&pool->waits, 0);
     return pool;
 }
 
@@ -193,96 +241,114 @@ error:
     return NULL;
 }
 
-/** Find next (bit) set */
-static int fnsll(unsigned long long x, unsigned i)
+/**
+ * Takes a free picture from the bitmap, without locking.
+ * @param tried pictures not to take (per bitmap word) [IN/OUT]
+ * @return the offset of the picture, or -1 if none is free
+ */
+static int picture_pool_Take(picture_pool_t *pool, unsigned long long *tried)
 {
-    if (i >= CHAR_BIT * sizeof (x))
-        return 0;
-    return ffsll(x & ~((1ULL << i) - 1));
+    for (unsigned w = 0; w < picture_pool_Words(pool); w++) {
+        unsigned long long avail = atomic_load(&pool->available[w]);
+
+        for (;;) {
+            unsigned long long candidates = avail & ~tried[w];
+            if (candidates == 0)
+                break;
+
+            unsigned long long bit = candidates & -candidates;
+            if (atomic_compare_exchange_weak(&pool->available[w], &avail,
+                                             avail & ~bit)) {
+                tried[w] |= bit;
+                return w * POOL_WORD_BITS + ffsll(bit) - 1;
+            }
+            /* another thread changed the word, avail was reloaded */
+            atomic_fetch_add_explicit(&pool->retries, 1, memory_order_relaxed);
+        }
+    }
+    return -1;
+}
+
+static picture_t *picture_pool_Acquire(picture_pool_t *pool, unsigned offset)
+{
+    picture_t *clone = picture_pool_ClonePicture(pool, offset);
+    if (clone != NULL) {
+        assert(clone->p_next == NULL);
+        atomic_fetch_add(&pool->refs, 1);
+    }
+    return clone;
 }
 
 picture_t *picture_pool_Get(picture_pool_t *pool)
 {
-    vlc_mutex_lock(&pool->lock);
-    assert(pool->refs > 0);
+    unsigned long long tried[POOL_WORDS] = { 0 };
+    int offset;
 
-    if (pool->canceled)
-    {
-        vlc_mutex_unlock(&pool->lock);
-        return NULL;
-    }
+    assert(atomic_load(&pool->refs) > 0);
 
-    for (unsigned i = ffsll(pool->available); i; i = fnsll(pool->available, i))
-    {
-        pool->available &= ~(1ULL << (i - 1));
-        vlc_mutex_unlock(&pool->lock);
+    if (atomic_load(&pool->canceled))
+        return NULL;
 
-        picture_t *picture = pool->picture[i - 1];
+    while ((offset = picture_pool_Take(pool, tried)) >= 0) {
+        picture_t *picture = pool->picture[offset];
 
+        /* Skip the pictures that fail to lock */
         if (pool->pic_lock != NULL && pool->pic_lock(picture) != VLC_SUCCESS) {
-            vlc_mutex_lock(&pool->lock);
-            pool->available |= 1ULL << (i - 1);
+            picture_pool_Put(pool, offset);
             continue;
         }
 
-        picture_t *clone = picture_pool_ClonePicture(pool, i - 1);
-        if (clone != NULL) {
-            assert(clone->p_next == NULL);
-            atomic_fetch_add(&pool->refs, 1);
-        }
-        return clone;
+        return picture_pool_Acquire(pool, offset);
     }
-
-    vlc_mutex_unlock(&pool->lock);
     return NULL;
 }
 
 picture_t *picture_pool_Wait(picture_pool_t *pool)
 {
-    unsigned i;
+    unsigned long long tried[POOL_WORDS] = { 0 };
+    int offset;
 
-    vlc_mutex_lock(&pool->lock);
-    assert(pool->refs > 0);
+    assert(atomic_load(&pool->refs) > 0);
 
-    while (pool->available == 0)
-    {
-        if (pool->canceled)
-        {
-            vlc_mutex_unlock(&pool->lock);
-            return NULL;
+    offset = picture_pool_Take(pool, tried);
+    if (offset < 0) {
+        vlc_mutex_lock(&pool->lock);
+        atomic_fetch_add(&pool->waiters, 1);
+        atomic_fetch_add_explicit(&pool->waits, 1, memory_order_relaxed);
+
+        for (;;) {
+            if (atomic_load(&pool->canceled))
+                break;
+
+            memset(tried, 0, sizeof (tried));
+            offset = picture_pool_Take(pool, tried);
+            if (offset >= 0)
+                break;
+            vlc_cond_wait(&pool->wait, &pool->lock);
         }
-        vlc_cond_wait(&pool->wait, &pool->lock);
-    }
 
-    i = ffsll(pool->available);
-    assert(i > 0);
-    pool->available &= ~(1ULL << (i - 1));
-    vlc_mutex_unlock(&pool->lock);
+        atomic_fetch_sub(&pool->waiters, 1);
+        vlc_mutex_unlock(&pool->lock);
+        if (offset < 0)
+            return NULL;
+    }
 
-    picture_t *picture = pool->picture[i - 1];
+    picture_t *picture = pool->picture[offset];
 
     if (pool->pic_lock != NULL && pool->pic_lock(picture) != VLC_SUCCESS) {
-        vlc_mutex_lock(&pool->lock);
-        pool->available |= 1ULL << (i - 1);
-        vlc_cond_signal(&pool->wait);
-        vlc_mutex_unlock(&pool->lock);
+        picture_pool_Put(pool, offset);
         return NULL;
     }
 
-    picture_t *clone = picture_pool_ClonePicture(pool, i - 1);
-    if (clone != NULL) {
-        assert(clone->p_next == NULL);
-        atomic_fetch_add(&pool->refs, 1);
-    }
-    return clone;
+    return picture_pool_Acquire(pool, offset);
 }
 
 void picture_pool_Cancel(picture_pool_t *pool, bool canceled)
 {
     vlc_mutex_lock(&pool->lock);
-    assert(pool->refs > 0);
+    assert(atomic_load(&pool->refs) > 0);
 
-    pool->canceled = canceled;
+    atomic_store(&pool->canceled, canceled);
     if (canceled)
         vlc_cond_broadcast(&pool->wait);
     vlc_mutex_unlock(&pool->lock);
@@ -290,18 +356,27 @@ void picture_pool_Cancel(picture_pool_t *pool, bool canceled)
 
 unsigned picture_pool_Reset(picture_pool_t *pool)
 {
-    unsigned ret;
+    unsigned ret = pool->picture_count;
 
     vlc_mutex_lock(&pool->lock);
-    assert(pool->refs > 0);
-    ret = pool->picture_count - popcountll(pool->available);
-    pool->available = (1ULL << pool->picture_count) - 1;
-    pool->canceled = false;
+    assert(atomic_load(&pool->refs) > 0);
+    for (unsigned w = 0; w < picture_pool_Words(pool); w++)
+        ret -= popcountll(atomic_exchange(&pool->available[w],
+                                          picture_pool_Mask(pool, w)));
+    atomic_store(&pool->canceled, false);
+    vlc_cond_broadcast(&pool->wait);
     vlc_mutex_unlock(&pool->lock);
 
     return ret;
 }
 
+void picture_pool_GetStats(picture_pool_t *pool, unsigned long *retries,
+                           unsigned long *waits)
+{
+    *retries = atomic_load(&pool->retries);
+    *waits = atomic_load(&pool->waits);
+}
+
 unsigned picture_pool_GetSize(const picture_pool_t *pool)
 {
     return pool->picture_count;
@@ -50,7 +50,16 @@ static struct
     vlc_mutex_t lock;
     module_t *head;
     unsigned usage;
-} modules = { VLC_STATIC_MUTEX, NULL, 0 };
+    module_t **caps; /* modules sorted by capability, then score */
+    size_t caps_count;
+#ifdef HAVE_DYNAMIC_PLUGINS
+    module_cache_map_t *caches; /* mapped plugins caches in use */
+#endif
+} modules = { VLC_STATIC_MUTEX, NULL, 0, NULL, 0,
+#ifdef HAVE_DYNAMIC_PLUGINS
+    NULL
+#endif
+};
 
 /*****************************************************************************
  * Local prototypes
@@ -67,6 +76,32 @@ static void module_StoreBank (module_t *module)
     modules.head = module;
 }
 
+static int modulecapcmp (const void *a, const void *b)
+{
+    const module_t *const *ma = a, *const *mb = b;
+    int ret = strcmp (module_get_capability (*ma),
+                      module_get_capability (*mb));
+    /* Highest score first */
+    return ret ? ret : (*mb)->i_score - (*ma)->i_score;
+}
+
+/**
+ * Sorts the modules of the bank by capability, so that module_list_cap()
+ * does not need to go through all the modules.
+ */
+static void module_SortBank (void)
+{
+    /*vlc_assert_locked (&modules.lock);*/
+    size_t count;
+    module_t **tab = module_list_get (&count);
+
+    free (modules.caps);
+    modules.caps = tab;
+    modules.caps_count = (tab != NULL) ? count : 0;
+    if (tab != NULL)
+        qsort (tab, count, sizeof (*tab), modulecapcmp);
+}
+
 #if defined(__ELF__) || !HAVE_DYNAMIC_PLUGINS
 # ifdef __GNUC__
 __attribute__((weak))
@@ -111,6 +146,7 @@ void module_InitBank (void)
         if (likely(module != NULL))
             module_StoreBank (module);
         config_SortConfig ();
+        module_SortBank ();
     }
     modules.usage++;
 
@@ -131,6 +167,10 @@ void module_InitBank (void)
 void module_EndBank (bool b_plugins)
 {
     module_t *head = NULL;
+    module_t **caps = NULL;
+#ifdef HAVE_DYNAMIC_PLUGINS
+    module_cache_map_t *caches = NULL;
+#endif
 
     /* If plugins were _not_ loaded, then the caller still has the bank lock
      * from module_InitBank(). */
@@ -145,9 +185,18 @@ void module_EndBank (bool b_plugins)
         config_UnsortConfig ();
         head = modules.head;
         modules.head = NULL;
+        caps = modules.caps;
+        modules.caps = NULL;
+        modules.caps_count = 0;
+#ifdef HAVE_DYNAMIC_PLUGINS
+        caches = modules.caches;
+        modules.caches = NULL;
+#endif
     }
     vlc_mutex_unlock (&modules.lock);
 
+    free (caps);
+
     while (head != NULL)
     {
         module_t *module = head;
@@ -162,6 +211,17 @@ void module_EndBank (bool b_plugins)
 #endif
         vlc_module_destroy (module);
     }
+
+#ifdef HAVE_DYNAMIC_PLUGINS
+    /* The cached modules point into their caches */
+    while (caches != NULL)
+    {
+        module_cache_map_t *map = caches;
+
+        caches = map->next;
+        CacheUnmap (map);
+    }
+#endif
 }
 
 #undef module_LoadPlugins
@@ -185,6 +245,7 @@ size_t module_LoadPlugins (vlc_object_t *obj)
 #endif
         config_UnsortConfig ();
         config_SortConfig ();
+        module_SortBank ();
     }
     vlc_mutex_unlock (&modules.lock);
 
@@ -239,14 +300,6 @@ module_t **module_list_get (size_t *n)
     return tab;
 }
 
-static int modulecmp (const void *a, const void *b)
-{
-    const module_t *const *ma = a, *const *mb = b;
-    /* Note that qsort() uses _ascending_ order,
-     * so the smallest module is the one with the biggest score. */
-    return (*mb)->i_score - (*ma)->i_score;
-}
-
 /**
  * Builds a sorted list of all VLC modules with a given capability.
  * The list is sorted from the highest module score to the lowest.
@@ -257,36 +310,33 @@ static int modulecmp (const void *a, const void *b)
  */
 ssize_t module_list_cap (module_t ***restrict list, const char *cap)
 {
-    /* TODO: This is quite inefficient. List should be sorted by capability. */
-    ssize_t n = 0;
+    size_t lo = 0, hi = modules.caps_count;
 
     assert (list != NULL);
 
-    for (module_t *mod = modules.head; mod != NULL; mod = mod->next)
+    /* Lower bound of the capability in the sorted table */
+    while (lo < hi)
     {
-         if (module_provides (mod, cap))
-             n++;
-         for (module_t *subm = mod->submodule; subm != NULL; subm = subm->next)
-             if (module_provides (subm, cap))
-                 n++;
+        size_t mid = (lo + hi) / 2;
+
+        if (strcmp (module_get_capability (modules.caps[mid]), cap) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
     }
 
+    size_t n = 0;
+    while (lo + n < modules.caps_count
+        && !strcmp (module_get_capability (modules.caps[lo + n]), cap))
+        n++;
+
     module_t **tab = malloc (sizeof (*tab) * n);
     *list = tab;
-    if (unlikely(tab == NULL))
+    if (unlikely(tab == NULL && n > 0))
         return -1;
 
-    for (module_t *mod = modules.head; mod != NULL; mod = mod->next)
-    {
-         if (module_provides (mod, cap))
-             *(tab++)= mod;
-         for (module_t *subm = mod->submodule; subm != NULL; subm = subm->next)
-             if (module_provides (subm, cap))
-                 *(tab++) = subm;
-    }
-
-    assert (tab == *list + n);
-    qsort (*list, n, sizeof (*tab), modulecmp);
+    if (n > 0)
+        memcpy (tab, modules.caps + lo, sizeof (*tab) * n);
     return n;
 }
 
@@ -373,12 +423,13 @@ static void AllocatePluginPath (vlc_object_t *p_this, const char *path,
 {
     module_bank_t bank;
     module_cache_t *cache = NULL;
+    module_cache_map_t *map = NULL;
     size_t count = 0;
 
     switch( mode )
     {
         case CACHE_USE:
-            count = CacheLoad( p_this, path, &cache );
+            count = CacheLoad( p_this, path, &cache, &map );
             break;
         case CACHE_RESET:
             CacheDelete( p_this, path );
@@ -403,18 +454,33 @@ static void AllocatePluginPath (vlc_object_t *p_this, const char *path,
     switch( mode )
     {
         case CACHE_USE:
+        {
+            bool used = false;
+
             /* Discard unmatched cache entries */
             for( size_t i = 0; i < count; i++ )
             {
                 if (cache[i].p_module != NULL)
                    vlc_module_destroy (cache[i].p_module);
-                free (cache[i].path);
+                else
+                   used = true;
             }
             free( cache );
+
+            /* Keep the cache mapped as long as its modules are in the bank */
+            if (used)
+            {
+                map->next = modules.caches;
+                modules.caches = map;
+            }
+            else if (map != NULL)
+                CacheUnmap (map);
+
             for (size_t i = 0; i < bank.i_cache; i++)
                 free (bank.cache[i].path);
             free (bank.cache);
             break;
+        }
         case CACHE_RESET:
             CacheSave (p_this, path, bank.cache, bank.i_cache);
         case CACHE_IGNORE:
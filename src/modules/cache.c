@@ -33,8 +33,15 @@
 #include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <assert.h>
+#ifdef HAVE_SEARCH_H
+# include <search.h>
+#endif
+#ifdef HAVE_MMAP
+# include <sys/mman.h>
+#endif
 
 #include <vlc_common.h>
 #include "libvlc.h"
@@ -55,12 +62,92 @@
 #ifdef HAVE_DYNAMIC_PLUGINS
 /* Sub-version number
  * (only used to avoid breakage in dev version when cache structure changes) */
-#define CACHE_SUBVERSION_NUM 23
+#define CACHE_SUBVERSION_NUM 24
 
 /* Cache filename */
 #define CACHE_NAME "plugins.dat"
 /* Magic for the cache filename */
 #define CACHE_STRING "cache "PACKAGE_NAME" "PACKAGE_VERSION
+#ifdef DISTRO_VERSION
+/* Allow binary maintaner to pass a string to detect new binary version*/
+# define CACHE_MAGIC CACHE_STRING DISTRO_VERSION
+#else
+# define CACHE_MAGIC CACHE_STRING
+#endif
+#define CACHE_HEADER_OFFSET ((sizeof (CACHE_MAGIC) - 1 + 7) & ~7)
+
+#define CACHE_ENDIANNESS 0x01020304
+#define CACHE_NONE UINT32_MAX /* NULL string */
+
+/*
+ * The cache file is used in place, mapped in memory. After the magic string,
+ * padded to 8 bytes, come the header and the tables of native records.
+ * Records refer to each other by index, and to the strings by offset in the
+ * table of interned strings, so that the file can be mapped anywhere.
+ * The submodules records follow the record of their module.
+ */
+typedef struct
+{
+    uint32_t subversion;
+    uint32_t endianness;
+    uint32_t file_size;
+    uint32_t plugin_count;
+    uint32_t config_count;
+    uint32_t module_count; /* including submodules */
+    uint32_t list_count;   /* strings offsets or integers */
+    uint32_t strings_size;
+} cache_header_t;
+
+typedef struct
+{
+    int64_t  mtime;
+    int64_t  size;
+    uint32_t path;
+    uint32_t module;
+} cache_plugin_t;
+
+#define CACHE_CONFIG_ADVANCED   0x01
+#define CACHE_CONFIG_INTERNAL   0x02
+#define CACHE_CONFIG_UNSAVEABLE 0x04
+#define CACHE_CONFIG_SAFE       0x08
+#define CACHE_CONFIG_REMOVED    0x10
+#define CACHE_CONFIG_LIST_CB    0x20 /* choices from a callback */
+
+typedef struct
+{
+    int64_t  orig; /* integer or float value, or string offset */
+    int64_t  min;
+    int64_t  max;
+    uint32_t type;
+    uint32_t name;
+    uint32_t text;
+    uint32_t longtext;
+    uint32_t list;
+    uint32_t list_text;
+    uint16_t list_count;
+    uint8_t  i_type;
+    char     i_short;
+    uint8_t  flags;
+    uint8_t  reserved[3];
+} cache_config_t;
+
+typedef struct
+{
+    uint32_t shortname;
+    uint32_t longname;
+    uint32_t help;
+    uint32_t capability;
+    uint32_t domain;
+    uint32_t shortcuts;
+    uint32_t shortcut_count;
+    uint32_t submodule_count;
+    uint32_t config;
+    uint32_t config_count;
+    uint32_t config_items;
+    uint32_t bool_items;
+    int32_t  score;
+    uint32_t unloadable;
+} cache_module_t;
 
 
 void CacheDelete( vlc_object_t *obj, const char *dir )
@@ -76,208 +163,269 @@ void CacheDelete( vlc_object_t *obj, const char *dir )
     free( path );
 }
 
-#define LOAD_IMMEDIATE(a) \
-    if (fread (&(a), sizeof (char), sizeof (a), file) != sizeof (a)) \
-        goto error
-#define LOAD_FLAG(a) \
-    do { \
-        unsigned char b; \
-        LOAD_IMMEDIATE(b); \
-        if (b > 1) \
-            goto error; \
-        (a) = b; \
-    } while (0)
-
-static int CacheLoadString (char **p, FILE *file)
-{
-    char *psz = NULL;
-    uint16_t size;
-
-    LOAD_IMMEDIATE (size);
-    if (size > 16384)
-    {
-error:
-        return -1;
-    }
+typedef struct
+{
+    const cache_header_t *header;
+    const cache_plugin_t *plugins;
+    const cache_config_t *configs;
+    const cache_module_t *modules;
+    const uint32_t       *lists;
+    const char           *strings;
+
+    /* descriptors built in place of the records, same indexes */
+    module_config_t      *cfgs;
+    module_t             *mods;
+    char                **slots;
+} cache_tables_t;
+
+static bool CacheRange (uint32_t first, uint32_t count, uint32_t total)
+{
+    return first <= total && count <= total - first;
+}
 
-    if (size > 0)
-    {
-        psz = malloc (size+1);
-        if (unlikely(psz == NULL))
-            goto error;
-        if (fread (psz, 1, size, file) != size)
-        {
-            free (psz);
-            goto error;
-        }
-        psz[size] = '\0';
-    }
-    *p = psz;
-    return 0;
+static bool CacheString (const cache_tables_t *t, uint32_t offset, char **str)
+{
+    if (offset == CACHE_NONE)
+        *str = NULL;
+    else if (offset < t->header->strings_size)
+        *str = (char *)(t->strings + offset);
+    else
+        return false;
+    return true;
 }
 
-#define LOAD_STRING(a) \
-    if (CacheLoadString (&(a), file)) goto error
+/* Returns the table of the strings of a list, pointing into the cache */
+static bool CacheStrings (const cache_tables_t *t, uint32_t first,
+                          uint32_t count, char ***tab)
+{
+    if (!CacheRange (first, count, t->header->list_count))
+        return false;
 
-static int CacheLoadConfig (module_config_t *cfg, FILE *file)
+    for (uint32_t i = first; i < first + count; i++)
+        if (!CacheString (t, t->lists[i], &t->slots[i]))
+            return false;
+
+    *tab = count ? &t->slots[first] : NULL;
+    return true;
+}
+
+/* Placeholders for the choices callbacks: plugins with such callbacks are
+ * loaded when the bank is built, replacing the cached descriptors. */
+static int CacheStringListCb (vlc_object_t *obj, const char *name,
+                              char ***values, char ***texts)
+{
+    VLC_UNUSED(obj); VLC_UNUSED(name);
+    *values = *texts = NULL;
+    return -1;
+}
+
+static int CacheIntegerListCb (vlc_object_t *obj, const char *name,
+                               int64_t **values, char ***texts)
 {
-    LOAD_IMMEDIATE (cfg->i_type);
-    LOAD_IMMEDIATE (cfg->i_short);
-    LOAD_FLAG (cfg->b_advanced);
-    LOAD_FLAG (cfg->b_internal);
-    LOAD_FLAG (cfg->b_unsaveable);
-    LOAD_FLAG (cfg->b_safe);
-    LOAD_FLAG (cfg->b_removed);
-    LOAD_STRING (cfg->psz_type);
-    LOAD_STRING (cfg->psz_name);
-    LOAD_STRING (cfg->psz_text);
-    LOAD_STRING (cfg->psz_longtext);
-    LOAD_IMMEDIATE (cfg->list_count);
+    VLC_UNUSED(obj); VLC_UNUSED(name);
+    *values = NULL;
+    *texts = NULL;
+    return -1;
+}
+
+static bool CacheLoadConfig (const cache_tables_t *t, uint32_t index)
+{
+    const cache_config_t *rec = &t->configs[index];
+    module_config_t *cfg = &t->cfgs[index];
+
+    cfg->i_type = rec->i_type;
+    cfg->i_short = rec->i_short;
+    cfg->b_advanced = !!(rec->flags & CACHE_CONFIG_ADVANCED);
+    cfg->b_internal = !!(rec->flags & CACHE_CONFIG_INTERNAL);
+    cfg->b_unsaveable = !!(rec->flags & CACHE_CONFIG_UNSAVEABLE);
+    cfg->b_safe = !!(rec->flags & CACHE_CONFIG_SAFE);
+    cfg->b_removed = !!(rec->flags & CACHE_CONFIG_REMOVED);
+    if (!CacheString (t, rec->type, &cfg->psz_type)
+     || !CacheString (t, rec->name, &cfg->psz_name)
+     || !CacheString (t, rec->text, &cfg->psz_text)
+     || !CacheString (t, rec->longtext, &cfg->psz_longtext))
+        return false;
+    cfg->list_count = rec->list_count;
 
     if (IsConfigStringType (cfg->i_type))
     {
-        LOAD_STRING (cfg->orig.psz);
+        if (rec->orig > UINT32_MAX
+         || !CacheString (t, rec->orig, &cfg->orig.psz))
+            return false;
+
+        /* the value changes, the default does not */
         if (cfg->orig.psz != NULL)
+        {
             cfg->value.psz = strdup (cfg->orig.psz);
-        else
-            cfg->value.psz = NULL;
+            if (unlikely(cfg->value.psz == NULL))
+                return false;
+        }
 
         if (cfg->list_count)
-            cfg->list.psz = xmalloc (cfg->list_count * sizeof (char *));
-        else /* TODO: fix config_GetPszChoices() instead of this hack: */
-            LOAD_IMMEDIATE(cfg->list.psz_cb);
-        for (unsigned i = 0; i < cfg->list_count; i++)
         {
-            LOAD_STRING (cfg->list.psz[i]);
-            if (cfg->list.psz[i] == NULL /* NULL -> empty string */
-             && (cfg->list.psz[i] = calloc (1, 1)) == NULL)
-                goto error;
+            if (!CacheStrings (t, rec->list, cfg->list_count, &cfg->list.psz))
+                return false;
         }
+        else if (rec->flags & CACHE_CONFIG_LIST_CB)
+            cfg->list.psz_cb = CacheStringListCb;
     }
     else
     {
-        LOAD_IMMEDIATE (cfg->orig);
-        LOAD_IMMEDIATE (cfg->min);
-        LOAD_IMMEDIATE (cfg->max);
+        memcpy (&cfg->orig, &rec->orig, sizeof (rec->orig));
+        memcpy (&cfg->min, &rec->min, sizeof (rec->min));
+        memcpy (&cfg->max, &rec->max, sizeof (rec->max));
         cfg->value = cfg->orig;
 
         if (cfg->list_count)
-            cfg->list.i = xmalloc (cfg->list_count * sizeof (int));
-        else /* TODO: fix config_GetPszChoices() instead of this hack: */
-            LOAD_IMMEDIATE(cfg->list.i_cb);
-        for (unsigned i = 0; i < cfg->list_count; i++)
-             LOAD_IMMEDIATE (cfg->list.i[i]);
-    }
-    cfg->list_text = xmalloc (cfg->list_count * sizeof (char *));
-    for (unsigned i = 0; i < cfg->list_count; i++)
-    {
-        LOAD_STRING (cfg->list_text[i]);
-        if (cfg->list_text[i] == NULL /* NULL -> empty string */
-         && (cfg->list_text[i] = calloc (1, 1)) == NULL)
-            goto error;
+        {
+            if (!CacheRange (rec->list, cfg->list_count, t->header->list_count))
+                return false;
+            cfg->list.i = (int *)&t->lists[rec->list];
+        }
+        else if (rec->flags & CACHE_CONFIG_LIST_CB)
+            cfg->list.i_cb = CacheIntegerListCb;
     }
 
-    return 0;
-error:
-    return -1; /* FIXME: leaks */
+    return CacheStrings (t, rec->list_text, cfg->list_count, &cfg->list_text);
 }
 
-static int CacheLoadModuleConfig (module_t *module, FILE *file)
+static bool CacheLoadModule (const cache_tables_t *t, uint32_t index,
+                             module_t *parent)
 {
-    uint16_t lines;
+    const cache_module_t *rec = &t->modules[index];
+    module_t *module = &t->mods[index];
+
+    module->next = NULL;
+    module->parent = parent;
+    module->submodule = NULL;
+    module->submodule_count = 0;
+    module->i_score = rec->score;
+    module->b_loaded = false;
+    module->b_unloadable = parent == NULL && rec->unloadable;
+    module->b_cached = true;
+    module->pf_activate = NULL;
+    module->pf_deactivate = NULL;
+    module->p_config = NULL;
+    module->confsize = 0;
+    module->i_config_items = 0;
+    module->i_bool_items = 0;
+    module->psz_filename = NULL;
+
+    if (rec->shortcut_count > MODULE_SHORTCUT_MAX
+     || !CacheStrings (t, rec->shortcuts, rec->shortcut_count,
+                       &module->pp_shortcuts)
+     || !CacheString (t, rec->shortname, &module->psz_shortname)
+     || !CacheString (t, rec->longname, &module->psz_longname)
+     || !CacheString (t, rec->help, &module->psz_help)
+     || !CacheString (t, rec->capability, &module->psz_capability)
+     || !CacheString (t, rec->domain, &module->domain))
+        return false;
+    module->i_shortcuts = rec->shortcut_count;
+
+    if (parent != NULL)
+        return true;
+
+    if (!CacheRange (rec->config, rec->config_count, t->header->config_count))
+        return false;
+    for (uint32_t i = rec->config; i < rec->config + rec->config_count; i++)
+        if (!CacheLoadConfig (t, i))
+            return false;
+    module->p_config = rec->config_count ? &t->cfgs[rec->config] : NULL;
+    module->confsize = rec->config_count;
+    module->i_config_items = rec->config_items;
+    module->i_bool_items = rec->bool_items;
 
-    /* Calculate the structure length */
-    LOAD_IMMEDIATE (module->i_config_items);
-    LOAD_IMMEDIATE (module->i_bool_items);
-    LOAD_IMMEDIATE (lines);
+    if (module->domain != NULL)
+        vlc_bindtextdomain (module->domain);
 
-    /* Allocate memory */
-    if (lines)
+    /* submodules, in the order of the list */
+    if (!CacheRange (index + 1, rec->submodule_count, t->header->module_count))
+        return false;
+    module_t **pp_next = &module->submodule;
+    for (uint32_t i = index + 1; i <= index + rec->submodule_count; i++)
     {
-        module->p_config = malloc (lines * sizeof (module_config_t));
-        if (unlikely(module->p_config == NULL))
-        {
-            module->confsize = 0;
-            return -1;
-        }
+        if (t->modules[i].submodule_count != 0
+         || !CacheLoadModule (t, i, module))
+            return false;
+        *pp_next = &t->mods[i];
+        pp_next = &t->mods[i].next;
     }
-    else
-        module->p_config = NULL;
-    module->confsize = lines;
+    module->submodule_count = rec->submodule_count;
+    return true;
+}
 
-    /* Do the duplication job */
-    for (size_t i = 0; i < lines; i++)
-        if (CacheLoadConfig (module->p_config + i, file))
-            return -1;
-    return 0;
-error:
-    return -1; /* FIXME: leaks */
+static void CacheRelease (module_cache_map_t *map)
+{
+#ifdef HAVE_MMAP
+    if (map->mapped)
+        munmap (map->addr, map->length);
+    else
+#endif
+        free (map->addr);
+    free (map->arena);
+    free (map);
 }
 
-static module_t *CacheLoadModule (FILE *file)
+/**
+ * Releases a plugins cache, once the modules described in it are destroyed.
+ */
+void CacheUnmap (module_cache_map_t *map)
 {
-    module_t *module = vlc_module_create (NULL);
-    if (unlikely(module == NULL))
-        return NULL;
+    const module_config_t *cfgs = map->arena;
 
-    /* Load additional infos */
-    LOAD_STRING(module->psz_shortname);
-    LOAD_STRING(module->psz_longname);
-    LOAD_STRING(module->psz_help);
+    /* only the values of the string items were allocated */
+    for (size_t i = 0; i < map->config_count; i++)
+        if (IsConfigStringType (cfgs[i].i_type))
+            free (cfgs[i].value.psz);
+    CacheRelease (map);
+}
 
-    LOAD_IMMEDIATE(module->i_shortcuts);
-    if (module->i_shortcuts > MODULE_SHORTCUT_MAX)
-        goto error;
-    else
+static module_cache_map_t *CacheMap (vlc_object_t *obj, const char *path)
+{
+    int fd = vlc_open (path, O_RDONLY);
+    if (fd == -1)
     {
-        module->pp_shortcuts =
-            xmalloc (sizeof (*module->pp_shortcuts) * module->i_shortcuts);
-        for (unsigned j = 0; j < module->i_shortcuts; j++)
-            LOAD_STRING(module->pp_shortcuts[j]);
+        msg_Warn (obj, "cannot read %s: %s", path, vlc_strerror_c(errno));
+        return NULL;
     }
 
-    LOAD_STRING(module->psz_capability);
-    LOAD_IMMEDIATE(module->i_score);
-    LOAD_IMMEDIATE(module->b_unloadable);
-
-    /* Config stuff */
-    if (CacheLoadModuleConfig (module, file) != VLC_SUCCESS)
-        goto error;
+    struct stat st;
+    module_cache_map_t *map = NULL;
 
-    LOAD_STRING(module->domain);
-    if (module->domain != NULL)
-        vlc_bindtextdomain (module->domain);
-
-    uint32_t submodules;
-    LOAD_IMMEDIATE(submodules);
+    if (fstat (fd, &st)
+     || (uintmax_t)st.st_size < CACHE_HEADER_OFFSET + sizeof (cache_header_t)
+     || (uintmax_t)st.st_size > UINT32_MAX)
+        goto out;
 
-    for (; submodules > 0; submodules--)
+    map = malloc (sizeof (*map));
+    if (unlikely(map == NULL))
+        goto out;
+    map->next = NULL;
+    map->length = st.st_size;
+    map->mapped = false;
+    map->arena = NULL;
+    map->config_count = 0;
+
+#ifdef HAVE_MMAP
+    map->addr = mmap (NULL, map->length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map->addr != MAP_FAILED)
+        map->mapped = true;
+    else
+#endif
     {
-        module_t *submodule = vlc_module_create (module);
-
-        free (submodule->pp_shortcuts);
-        LOAD_STRING(submodule->psz_shortname);
-        LOAD_STRING(submodule->psz_longname);
-
-        LOAD_IMMEDIATE(submodule->i_shortcuts);
-        if (submodule->i_shortcuts > MODULE_SHORTCUT_MAX)
-            goto error;
-        else
+        /* malloc alignment is enough for the records */
+        map->addr = malloc (map->length);
+        if (map->addr == NULL
+         || read (fd, map->addr, map->length) != (ssize_t)map->length)
         {
-            submodule->pp_shortcuts =
-                xmalloc (sizeof (*submodule->pp_shortcuts) * submodule->i_shortcuts);
-            for (unsigned j = 0; j < submodule->i_shortcuts; j++)
-                LOAD_STRING(submodule->pp_shortcuts[j]);
+            free (map->addr);
+            free (map);
+            map = NULL;
         }
-
-        LOAD_STRING(submodule->psz_capability);
-        LOAD_IMMEDIATE(submodule->i_score);
     }
-
-    return module;
-error:
-    vlc_module_destroy(module);
-    return NULL;
+out:
+    close (fd);
+    return map;
 }
 
 /**
@@ -287,209 +435,380 @@ error:
  * will in turn be queried by AllocateAllPlugins() to see if it needs to
  * actually load the dynamically loadable module.
  * This allows us to only fully load plugins when they are actually used.
+ *
+ * The cache is mapped in memory and the module descriptors point into it,
+ * so it must be released with CacheUnmap() after they are destroyed.
  */
-size_t CacheLoad( vlc_object_t *p_this, const char *dir, module_cache_t **r )
+size_t CacheLoad( vlc_object_t *p_this, const char *dir, module_cache_t **r,
+                  module_cache_map_t **mapp )
 {
     char *psz_filename;
-    FILE *file;
-    int i_size, i_read;
-    char p_cachestring[sizeof(CACHE_STRING)];
-    int32_t i_marker;
 
     assert( dir != NULL );
 
     *r = NULL;
+    *mapp = NULL;
     if( asprintf( &psz_filename, "%s"DIR_SEP CACHE_NAME, dir ) == -1 )
         return 0;
 
     msg_Dbg( p_this, "loading plugins cache file %s", psz_filename );
 
-    file = vlc_fopen( psz_filename, "rb" );
-    if( !file )
-    {
-        msg_Warn( p_this, "cannot read %s: %s", psz_filename,
-                  vlc_strerror_c(errno) );
-        free( psz_filename );
-        return 0;
-    }
+    module_cache_map_t *map = CacheMap( p_this, psz_filename );
     free( psz_filename );
-
-    /* Check the file is a plugins cache */
-    i_size = sizeof(CACHE_STRING) - 1;
-    i_read = fread( p_cachestring, 1, i_size, file );
-    if( i_read != i_size ||
-        memcmp( p_cachestring, CACHE_STRING, i_size ) )
-    {
-        msg_Warn( p_this, "This doesn't look like a valid plugins cache" );
-        fclose( file );
+    if( map == NULL )
         return 0;
-    }
 
-#ifdef DISTRO_VERSION
-    /* Check for distribution specific version */
-    char p_distrostring[sizeof( DISTRO_VERSION )];
-    i_size = sizeof( DISTRO_VERSION ) - 1;
-    i_read = fread( p_distrostring, 1, i_size, file );
-    if( i_read != i_size ||
-        memcmp( p_distrostring, DISTRO_VERSION, i_size ) )
+    /* Check the file is a plugins cache */
+    const uint8_t *base = map->addr;
+    if( memcmp( base, CACHE_MAGIC, sizeof(CACHE_MAGIC) - 1 ) )
     {
         msg_Warn( p_this, "This doesn't look like a valid plugins cache" );
-        fclose( file );
+        CacheRelease( map );
         return 0;
     }
-#endif
 
-    /* Check sub-version number */
-    i_read = fread( &i_marker, 1, sizeof(i_marker), file );
-    if( i_read != sizeof(i_marker) || i_marker != CACHE_SUBVERSION_NUM )
+    cache_tables_t t;
+    t.header = (const void *)&base[CACHE_HEADER_OFFSET];
+
+    const cache_header_t *h = t.header;
+    const uint64_t configs = CACHE_HEADER_OFFSET + sizeof (*h)
+                           + (uint64_t)h->plugin_count * sizeof (cache_plugin_t);
+    const uint64_t modules = configs
+                           + (uint64_t)h->config_count * sizeof (cache_config_t);
+    const uint64_t lists = modules
+                         + (uint64_t)h->module_count * sizeof (cache_module_t);
+    const uint64_t strings = lists + (uint64_t)h->list_count * sizeof (uint32_t);
+
+    if( h->subversion != CACHE_SUBVERSION_NUM
+     || h->endianness != CACHE_ENDIANNESS
+     || h->file_size != map->length
+     || strings + h->strings_size != map->length
+     || ( h->strings_size > 0 && base[map->length - 1] != '\0' ) )
     {
         msg_Warn( p_this, "This doesn't look like a valid plugins cache "
                   "(corrupted header)" );
-        fclose( file );
+        CacheRelease( map );
         return 0;
     }
 
-    /* Check header marker */
-    i_read = fread( &i_marker, 1, sizeof(i_marker), file );
-    if( i_read != sizeof(i_marker) ||
-        i_marker != ftell( file ) - (int)sizeof(i_marker) )
+    t.plugins = (const void *)&h[1];
+    t.configs = (const void *)&base[configs];
+    t.modules = (const void *)&base[modules];
+    t.lists = (const void *)&base[lists];
+    t.strings = (const char *)&base[strings];
+
+    /* All the descriptors in one allocation */
+    size_t cfgs_size = h->config_count * sizeof (module_config_t);
+    size_t mods_size = h->module_count * sizeof (module_t);
+    size_t slots_size = h->list_count * sizeof (char *);
+    module_cache_t *cache = malloc( h->plugin_count * sizeof (*cache) );
+    map->arena = calloc( 1, cfgs_size + mods_size + slots_size );
+    if( unlikely(map->arena == NULL || (cache == NULL && h->plugin_count)) )
     {
-        msg_Warn( p_this, "This doesn't look like a valid plugins cache "
-                  "(corrupted header)" );
-        fclose( file );
+        free( cache );
+        CacheRelease( map );
         return 0;
     }
+    map->config_count = h->config_count;
+    t.cfgs = map->arena;
+    t.mods = (void *)((char *)map->arena + cfgs_size);
+    t.slots = (void *)((char *)map->arena + cfgs_size + mods_size);
 
-    module_cache_t *cache = NULL;
-    size_t count = 0;
-    char *path = NULL;
-
-    for (;;)
+    size_t count;
+    for( count = 0; count < h->plugin_count; count++ )
     {
-        module_t *module = CacheLoadModule (file);
-        if (module == NULL)
-        {
-            if (feof (file))
-                break;
-            goto error;
-        }
-
-        struct stat st;
+        const cache_plugin_t *plugin = &t.plugins[count];
 
-        /* Load common info */
-        LOAD_STRING(path);
-        if (path == NULL)
-            goto error;
-        LOAD_IMMEDIATE(st.st_mtime);
-        LOAD_IMMEDIATE(st.st_size);
+        if( plugin->module >= h->module_count
+         || !CacheString( &t, plugin->path, &cache[count].path )
+         || cache[count].path == NULL
+         || !CacheLoadModule( &t, plugin->module, NULL ) )
+            break;
 
-        CacheAdd (&cache, &count, path, &st, module);
-        free (path);
-        path = NULL;
-        /* TODO: deal with errors */
+        cache[count].mtime = plugin->mtime;
+        cache[count].size = plugin->size;
+        cache[count].p_module = &t.mods[plugin->module];
     }
 
-    fclose( file );
+    if( count < h->plugin_count )
+    {
+        msg_Warn( p_this, "plugins cache not loaded (corrupted)" );
+        free( cache );
+        CacheUnmap( map );
+        return 0;
+    }
 
     *r = cache;
+    *mapp = map;
     return count;
+}
 
-error:
-    free( path );
-    if (ferror (file))
-        msg_Err(p_this, "plugins cache read error: %s", vlc_strerror_c(errno));
-    msg_Warn( p_this, "plugins cache not loaded (corrupted)" );
+/*
+ * The tables are built in memory, then written at once.
+ */
+typedef struct
+{
+    uint8_t *data;
+    size_t   size;
+    size_t   alloc;
+} cache_table_t;
 
-    /* TODO: cleanup */
-    fclose( file );
+typedef struct
+{
+    const char *str;
+    uint32_t    offset;
+} cache_string_t;
+
+typedef struct
+{
+    cache_table_t plugins;
+    cache_table_t configs;
+    cache_table_t modules;
+    cache_table_t lists;
+    cache_table_t strings;
+    void         *interned; /* tree of cache_string_t */
+} cache_writer_t;
+
+static int CacheAppend (cache_table_t *table, const void *data, size_t size)
+{
+    if (table->size + size > table->alloc)
+    {
+        size_t alloc = __MAX(table->alloc * 2, table->size + size);
+        uint8_t *buf = realloc (table->data, alloc);
+        if (unlikely(buf == NULL))
+            return -1;
+        table->data = buf;
+        table->alloc = alloc;
+    }
+    memcpy (table->data + table->size, data, size);
+    table->size += size;
     return 0;
 }
 
-#define SAVE_IMMEDIATE( a ) \
-    if (fwrite (&(a), sizeof(a), 1, file) != 1) \
-        goto error
-#define SAVE_FLAG(a) \
-    do { \
-        char b = (a); \
-        SAVE_IMMEDIATE(b); \
-    } while (0)
+static uint32_t CacheCount (const cache_table_t *table, size_t size)
+{
+    return table->size / size;
+}
 
-static int CacheSaveString (FILE *file, const char *str)
+static int CacheStringCmp (const void *a, const void *b)
 {
-    uint16_t size = (str != NULL) ? strlen (str) : 0;
+    const cache_string_t *sa = a, *sb = b;
+    return strcmp (sa->str, sb->str);
+}
 
-    SAVE_IMMEDIATE (size);
-    if (size != 0 && fwrite (str, 1, size, file) != size)
+/* Interns a string, each one is stored once */
+static int CacheSaveString (cache_writer_t *w, const char *str, uint32_t *offset)
+{
+    if (str == NULL)
     {
-error:
+        *offset = CACHE_NONE;
+        return 0;
+    }
+
+    cache_string_t key = { str, 0 };
+    cache_string_t **node = tfind (&key, &w->interned, CacheStringCmp);
+    if (node != NULL)
+    {
+        *offset = (*node)->offset;
+        return 0;
+    }
+
+    cache_string_t *entry = malloc (sizeof (*entry));
+    if (unlikely(entry == NULL))
+        return -1;
+    entry->str = str;
+    entry->offset = w->strings.size;
+
+    if (w->strings.size >= CACHE_NONE - strlen (str)
+     || CacheAppend (&w->strings, str, strlen (str) + 1)
+     || tsearch (entry, &w->interned, CacheStringCmp) == NULL)
+    {
+        free (entry);
         return -1;
     }
+    *offset = entry->offset;
     return 0;
 }
 
-#define SAVE_STRING( a ) \
-    if (CacheSaveString (file, (a))) \
-        goto error
-
-static int CacheSaveConfig (FILE *file, const module_config_t *cfg)
-{
-    SAVE_IMMEDIATE (cfg->i_type);
-    SAVE_IMMEDIATE (cfg->i_short);
-    SAVE_FLAG (cfg->b_advanced);
-    SAVE_FLAG (cfg->b_internal);
-    SAVE_FLAG (cfg->b_unsaveable);
-    SAVE_FLAG (cfg->b_safe);
-    SAVE_FLAG (cfg->b_removed);
-    SAVE_STRING (cfg->psz_type);
-    SAVE_STRING (cfg->psz_name);
-    SAVE_STRING (cfg->psz_text);
-    SAVE_STRING (cfg->psz_longtext);
-    SAVE_IMMEDIATE (cfg->list_count);
+/* Appends strings to the lists, NULL strings being saved as empty */
+static int CacheSaveList (cache_writer_t *w, char *const *tab, size_t count,
+                          uint32_t *first)
+{
+    *first = CacheCount (&w->lists, sizeof (uint32_t));
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t offset;
+        if (CacheSaveString (w, (tab[i] != NULL) ? tab[i] : "", &offset)
+         || CacheAppend (&w->lists, &offset, sizeof (offset)))
+            return -1;
+    }
+    return 0;
+}
+
+static int CacheSaveConfig (cache_writer_t *w, const module_config_t *cfg)
+{
+    cache_config_t rec;
+
+    memset (&rec, 0, sizeof (rec));
+    rec.i_type = cfg->i_type;
+    rec.i_short = cfg->i_short;
+    rec.flags = (cfg->b_advanced ? CACHE_CONFIG_ADVANCED : 0)
+              | (cfg->b_internal ? CACHE_CONFIG_INTERNAL : 0)
+              | (cfg->b_unsaveable ? CACHE_CONFIG_UNSAVEABLE : 0)
+              | (cfg->b_safe ? CACHE_CONFIG_SAFE : 0)
+              | (cfg->b_removed ? CACHE_CONFIG_REMOVED : 0);
+    if (CacheSaveString (w, cfg->psz_type, &rec.type)
+     || CacheSaveString (w, cfg->psz_name, &rec.name)
+     || CacheSaveString (w, cfg->psz_text, &rec.text)
+     || CacheSaveString (w, cfg->psz_longtext, &rec.longtext))
+        return -1;
+    rec.list_count = cfg->list_count;
 
     if (IsConfigStringType (cfg->i_type))
     {
-        SAVE_STRING (cfg->orig.psz);
+        uint32_t orig;
+        if (CacheSaveString (w, cfg->orig.psz, &orig))
+            return -1;
+        rec.orig = orig;
+
         if (cfg->list_count == 0)
-            SAVE_IMMEDIATE (cfg->list.psz_cb); /* XXX: see CacheLoadConfig() */
-        for (unsigned i = 0; i < cfg->list_count; i++)
-            SAVE_STRING (cfg->list.psz[i]);
+        {
+            /* XXX: see AllocatePluginFile() */
+            if (cfg->list.psz_cb != NULL)
+                rec.flags |= CACHE_CONFIG_LIST_CB;
+        }
+        else if (CacheSaveList (w, cfg->list.psz, cfg->list_count, &rec.list))
+            return -1;
     }
     else
     {
-        SAVE_IMMEDIATE (cfg->orig);
-        SAVE_IMMEDIATE (cfg->min);
-        SAVE_IMMEDIATE (cfg->max);
+        memcpy (&rec.orig, &cfg->orig, sizeof (rec.orig));
+        memcpy (&rec.min, &cfg->min, sizeof (rec.min));
+        memcpy (&rec.max, &cfg->max, sizeof (rec.max));
+
+        rec.list = CacheCount (&w->lists, sizeof (uint32_t));
         if (cfg->list_count == 0)
-            SAVE_IMMEDIATE (cfg->list.i_cb); /* XXX: see CacheLoadConfig() */
+        {
+            if (cfg->list.i_cb != NULL)
+                rec.flags |= CACHE_CONFIG_LIST_CB;
+        }
         for (unsigned i = 0; i < cfg->list_count; i++)
-             SAVE_IMMEDIATE (cfg->list.i[i]);
+        {
+            int32_t val = cfg->list.i[i];
+            if (CacheAppend (&w->lists, &val, sizeof (val)))
+                return -1;
+        }
     }
-    for (unsigned i = 0; i < cfg->list_count; i++)
-        SAVE_STRING (cfg->list_text[i]);
 
-    return 0;
-error:
-    return -1;
+    if (CacheSaveList (w, cfg->list_text, cfg->list_count, &rec.list_text))
+        return -1;
+
+    return CacheAppend (&w->configs, &rec, sizeof (rec));
 }
 
-static int CacheSaveModuleConfig (FILE *file, const module_t *module)
+static int CacheSaveModule (cache_writer_t *w, const module_t *module)
 {
-    uint16_t lines = module->confsize;
+    cache_module_t rec;
+
+    memset (&rec, 0, sizeof (rec));
+    if (CacheSaveString (w, module->psz_shortname, &rec.shortname)
+     || CacheSaveString (w, module->psz_longname, &rec.longname)
+     || CacheSaveString (w, module->psz_help, &rec.help)
+     || CacheSaveString (w, module->psz_capability, &rec.capability)
+     || CacheSaveString (w, module->domain, &rec.domain)
+     || CacheSaveList (w, module->pp_shortcuts, module->i_shortcuts,
+                       &rec.shortcuts))
+        return -1;
+    rec.shortcut_count = module->i_shortcuts;
+    rec.score = module->i_score;
 
-    SAVE_IMMEDIATE (module->i_config_items);
-    SAVE_IMMEDIATE (module->i_bool_items);
-    SAVE_IMMEDIATE (lines);
+    if (module->parent == NULL)
+    {
+        rec.unloadable = module->b_unloadable;
+        rec.submodule_count = module->submodule_count;
+        rec.config_items = module->i_config_items;
+        rec.bool_items = module->i_bool_items;
+        rec.config = CacheCount (&w->configs, sizeof (cache_config_t));
+        rec.config_count = module->confsize;
+        for (size_t i = 0; i < module->confsize; i++)
+            if (CacheSaveConfig (w, module->p_config + i))
+                return -1;
+    }
 
-    for (size_t i = 0; i < lines; i++)
-        if (CacheSaveConfig (file, module->p_config + i))
-           goto error;
+    if (CacheAppend (&w->modules, &rec, sizeof (rec)))
+        return -1;
 
+    if (module->parent == NULL)
+        for (const module_t *sub = module->submodule; sub; sub = sub->next)
+            if (CacheSaveModule (w, sub))
+                return -1;
     return 0;
-error:
-    return -1;
 }
 
-static int CacheSaveBank( FILE *file, const module_cache_t *, size_t );
+static int CacheSaveBank (FILE *file, const module_cache_t *cache,
+                          size_t i_cache)
+{
+    cache_writer_t w;
+    int ret = -1;
+
+    memset (&w, 0, sizeof (w));
+
+    for (size_t i = 0; i < i_cache; i++)
+    {
+        cache_plugin_t rec;
+
+        memset (&rec, 0, sizeof (rec));
+        rec.mtime = cache[i].mtime;
+        rec.size = cache[i].size;
+        rec.module = CacheCount (&w.modules, sizeof (cache_module_t));
+        if (CacheSaveString (&w, cache[i].path, &rec.path)
+         || CacheSaveModule (&w, cache[i].p_module)
+         || CacheAppend (&w.plugins, &rec, sizeof (rec)))
+            goto error;
+    }
+
+    static const char padding[8] = { 0 };
+    cache_header_t header = {
+        .subversion = CACHE_SUBVERSION_NUM,
+        .endianness = CACHE_ENDIANNESS,
+        .plugin_count = CacheCount (&w.plugins, sizeof (cache_plugin_t)),
+        .config_count = CacheCount (&w.configs, sizeof (cache_config_t)),
+        .module_count = CacheCount (&w.modules, sizeof (cache_module_t)),
+        .list_count = CacheCount (&w.lists, sizeof (uint32_t)),
+        .strings_size = w.strings.size,
+    };
+    const uint64_t size = CACHE_HEADER_OFFSET + sizeof (header) + w.plugins.size
+                        + w.configs.size + w.modules.size + w.lists.size
+                        + w.strings.size;
+    if (size > UINT32_MAX)
+        goto error;
+    header.file_size = size;
+
+    if (fwrite (CACHE_MAGIC, 1, sizeof (CACHE_MAGIC) - 1, file)
+            != sizeof (CACHE_MAGIC) - 1
+     || fwrite (padding, 1, CACHE_HEADER_OFFSET - (sizeof (CACHE_MAGIC) - 1),
+                file) != CACHE_HEADER_OFFSET - (sizeof (CACHE_MAGIC) - 1)
+     || fwrite (&header, sizeof (header), 1, file) != 1
+     || fwrite (w.plugins.data, 1, w.plugins.size, file) != w.plugins.size
+     || fwrite (w.configs.data, 1, w.configs.size, file) != w.configs.size
+     || fwrite (w.modules.data, 1, w.modules.size, file) != w.modules.size
+     || fwrite (w.lists.data, 1, w.lists.size, file) != w.lists.size
+     || fwrite (w.strings.data, 1, w.strings.size, file) != w.strings.size)
+        goto error;
+
+    if (fflush (file)) /* flush libc buffers */
+        goto error;
+    ret = 0; /* success! */
+
+error:
+    tdestroy (w.interned, free);
+    free (w.plugins.data);
+    free (w.configs.data);
+    free (w.modules.data);
+    free (w.lists.data);
+    free (w.strings.data);
+    return ret;
+}
 
 /**
  * Saves a module cache to disk, and release cache data from memory.
@@ -542,95 +861,6 @@ out:
     free (entries);
 }
 
-static int CacheSaveSubmodule (FILE *, const module_t *);
-
-static int CacheSaveBank (FILE *file, const module_cache_t *cache,
-                          size_t i_cache)
-{
-    uint32_t i_file_size = 0;
-
-    /* Contains version number */
-    if (fputs (CACHE_STRING, file) == EOF)
-        goto error;
-#ifdef DISTRO_VERSION
-    /* Allow binary maintaner to pass a string to detect new binary version*/
-    if (fputs( DISTRO_VERSION, file ) == EOF)
-        goto error;
-#endif
-    /* Sub-version number (to avoid breakage in the dev version when cache
-     * structure changes) */
-    i_file_size = CACHE_SUBVERSION_NUM;
-    if (fwrite (&i_file_size, sizeof (i_file_size), 1, file) != 1 )
-        goto error;
-
-    /* Header marker */
-    i_file_size = ftell( file );
-    if (fwrite (&i_file_size, sizeof (i_file_size), 1, file) != 1)
-        goto error;
-
-    for (unsigned i = 0; i < i_cache; i++)
-    {
-        module_t *module = cache[i].p_module;
-        uint32_t i_submodule;
-
-        /* Save additional infos */
-        SAVE_STRING(module->psz_shortname);
-        SAVE_STRING(module->psz_longname);
-        SAVE_STRING(module->psz_help);
-        SAVE_IMMEDIATE(module->i_shortcuts);
-        for (unsigned j = 0; j < module->i_shortcuts; j++)
-            SAVE_STRING(module->pp_shortcuts[j]);
-
-        SAVE_STRING(module->psz_capability);
-        SAVE_IMMEDIATE(module->i_score);
-        SAVE_IMMEDIATE(module->b_unloadable);
-
-        /* Config stuff */
-        if (CacheSaveModuleConfig (file, module))
-            goto error;
-
-        SAVE_STRING(module->domain);
-
-        i_submodule = module->submodule_count;
-        SAVE_IMMEDIATE( i_submodule );
-        if (CacheSaveSubmodule (file, module->submodule))
-            goto error;
-
-        /* Save common info */
-        SAVE_STRING(cache[i].path);
-        SAVE_IMMEDIATE(cache[i].mtime);
-        SAVE_IMMEDIATE(cache[i].size);
-    }
-
-    if (fflush (file)) /* flush libc buffers */
-        goto error;
-    return 0; /* success! */
-
-error:
-    return -1;
-}
-
-static int CacheSaveSubmodule( FILE *file, const module_t *p_module )
-{
-    if( !p_module )
-        return 0;
-    if( CacheSaveSubmodule( file, p_module->next ) )
-        goto error;
-
-    SAVE_STRING( p_module->psz_shortname );
-    SAVE_STRING( p_module->psz_longname );
-    SAVE_IMMEDIATE( p_module->i_shortcuts );
-    for( unsigned j = 0; j < p_module->i_shortcuts; j++ )
-         SAVE_STRING( p_module->pp_shortcuts[j] );
-
-    SAVE_STRING( p_module->psz_capability );
-    SAVE_IMMEDIATE( p_module->i_score );
-    return 0;
-
-error:
-    return -1;
-}
-
 /*****************************************************************************
  * CacheMerge: Merge a cache module descriptor with a full module descriptor.
  *****************************************************************************/
@@ -71,6 +71,7 @@ module_t *vlc_module_create (module_t *parent)
     module->i_score = (parent != NULL) ? parent->i_score : 1;
     module->b_loaded = false;
     module->b_unloadable = parent == NULL;
+    module->b_cached = false;
     module->pf_activate = NULL;
     module->pf_deactivate = NULL;
     module->p_config = NULL;
@@ -97,6 +98,12 @@ void vlc_module_destroy (module_t *module)
         vlc_module_destroy (m);
     }
 
+    if (module->b_cached)
+    {   /* Descriptors belong to the plugins cache, see CacheUnmap() */
+        free (module->psz_filename);
+        return;
+    }
+
     config_Free (module->p_config, module->confsize);
 
     free (module->domain);
@@ -25,6 +25,7 @@
 # define LIBVLC_MODULES_H 1
 
 typedef struct module_cache_t module_cache_t;
+typedef struct module_cache_map_t module_cache_map_t;
 
 /*****************************************************************************
  * Module cache description structure
@@ -40,6 +41,21 @@ struct module_cache_t
     module_t *p_module;
 };
 
+/**
+ * Plugins cache file mapped in memory
+ *
+ * The descriptors of the cached modules point into it.
+ */
+struct module_cache_map_t
+{
+    module_cache_map_t *next;
+    void   *addr;
+    size_t  length;
+    bool    mapped;
+    void   *arena; /* modules and configuration items */
+    size_t  config_count;
+};
+
 
 #define MODULE_SHORTCUT_MAX 20
 
@@ -78,6 +94,7 @@ struct module_t
 
     bool          b_loaded;        /* Set to true if the dll is loaded */
     bool b_unloadable;                        /**< Can we be dlclosed? */
+    bool b_cached;         /* Set to true if described by the cache */
 
     /* Callbacks */
     void *pf_activate;
@@ -122,7 +139,9 @@ void module_Unload (module_handle_t);
 /* Plugins cache */
 void   CacheMerge (vlc_object_t *, module_t *, module_t *);
 void   CacheDelete(vlc_object_t *, const char *);
-size_t CacheLoad  (vlc_object_t *, const char *, module_cache_t **);
+size_t CacheLoad  (vlc_object_t *, const char *, module_cache_t **,
+                   module_cache_map_t **);
+void   CacheUnmap (module_cache_map_t *);
 
 struct stat;
 
@@ -106,6 +106,42 @@ static void test(bool zombie)
             picture_Release(pics[i]);
 }
 
+static void test_large(void)
+{
+    const unsigned count = 200; /* more than a bitmap word */
+    picture_t *pics[200];
+
+    pool = picture_pool_NewFromFormat(&fmt, count);
+    assert(pool != NULL);
+    assert(picture_pool_GetSize(pool) == count);
+
+    for (unsigned i = 0; i < count; i++) {
+        pics[i] = picture_pool_Get(pool);
+        assert(pics[i] != NULL);
+    }
+    assert(picture_pool_Get(pool) == NULL);
+
+    /* Release from the last word */
+    picture_Release(pics[count - 1]);
+    pics[count - 1] = picture_pool_Wait(pool);
+    assert(pics[count - 1] != NULL);
+    assert(picture_pool_Get(pool) == NULL);
+
+    for (unsigned i = 0; i < count; i++)
+        picture_Release(pics[i]);
+
+    reserve = picture_pool_Reserve(pool, count - 1);
+    assert(reserve != NULL);
+    assert(picture_pool_GetSize(reserve) == count - 1);
+    pics[0] = picture_pool_Get(pool);
+    assert(pics[0] != NULL);
+    assert(picture_pool_Get(pool) == NULL);
+    picture_Release(pics[0]);
+
+    picture_pool_Release(reserve);
+    picture_pool_Release(pool);
+}
+
 int main(void)
 {
     video_format_Setup(&fmt, VLC_CODEC_I420, 320, 200, 320, 200, 1, 1);
@@ -122,6 +158,7 @@ int main(void)
 
     test(false);
     test(true);
+    test_large();
 
     return 0;
 }
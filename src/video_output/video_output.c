@@ -338,15 +338,32 @@ void vout_Reset(vout_thread_t *vout)
     vout_control_WaitEmpty(&vout->p->control);
 }
 
-bool vout_IsEmpty(vout_thread_t *vout)
+static bool PictureFifoIsEmpty(picture_fifo_t *fifo)
 {
-    picture_t *picture = picture_fifo_Peek(vout->p->decoder_fifo);
+    picture_t *picture = picture_fifo_Peek(fifo);
     if (picture)
         picture_Release(picture);
 
     return !picture;
 }
 
+bool vout_IsEmpty(vout_thread_t *vout)
+{
+    if (vout->p->filter.pipeline == 0)
+        return PictureFifoIsEmpty(vout->p->decoder_fifo);
+
+    /* The pictures taken from the decoder fifo are still to be displayed
+     * while they are in the pipelined chain */
+    vlc_mutex_lock(&vout->p->filter.lock);
+    bool empty = !vout->p->filter.transit &&
+                 PictureFifoIsEmpty(vout->p->decoder_fifo) &&
+                 PictureFifoIsEmpty(vout->p->filter.filtered) &&
+                 filter_chain_VideoIsEmpty(vout->p->filter.chain_static);
+    vlc_mutex_unlock(&vout->p->filter.lock);
+
+    return empty;
+}
+
 void vout_NextPicture(vout_thread_t *vout, mtime_t *duration)
 {
     vout_control_cmd_t cmd;
@@ -634,13 +651,165 @@ static picture_t *VoutVideoFilterStaticNewPicture(filter_t *filter)
 {
     vout_thread_t *vout = filter->owner.sys;
 
-    vlc_assert_locked(&vout->p->filter.lock);
+    /* With a pipelined chain, this runs on the filter threads, without the
+     * lock. The chains are only changed by the vout thread, after it
+     * flushed the pipeline. */
+    if (vout->p->filter.pipeline == 0)
+        vlc_assert_locked(&vout->p->filter.lock);
     if (filter_chain_GetLength(vout->p->filter.chain_interactive) == 0)
         return VoutVideoFilterInteractiveNewPicture(filter);
 
     return picture_NewFromFormat(&filter->fmt_out.video);
 }
 
+static void VoutVideoFilterStaticReady(void *data)
+{
+    vout_thread_t *vout = data;
+
+    vout_control_Wake(&vout->p->control);
+}
+
+/* The decoded pictures are remembered until their filtered pictures come
+ * out of the pipelined chain, so that the displayed state follows them */
+static void ThreadFilterQueueDecoded(vout_thread_t *vout, picture_t *decoded)
+{
+    vout_thread_sys_t *sys = vout->p;
+
+    /* The pictures dropped by the filters go with the next ones, or here */
+    if (sys->filter.queued_count == sys->filter.pipeline + 2) {
+        picture_Release(sys->filter.queued[0]);
+        sys->filter.queued_count--;
+        memmove(&sys->filter.queued[0], &sys->filter.queued[1],
+                sys->filter.queued_count * sizeof(*sys->filter.queued));
+    }
+    sys->filter.queued[sys->filter.queued_count++] = picture_Hold(decoded);
+}
+
+static void ThreadFilterSetDisplayed(vout_thread_t *vout,
+                                     const picture_t *filtered)
+{
+    vout_thread_sys_t *sys = vout->p;
+    picture_t *decoded = NULL;
+    unsigned count = 0;
+
+    while (count < sys->filter.queued_count &&
+           sys->filter.queued[count]->date <= filtered->date) {
+        if (decoded)
+            picture_Release(decoded);
+        decoded = sys->filter.queued[count++];
+    }
+    if (!decoded) {
+        /* The decoded picture was not remembered, the steps still need
+         * the date of the displayed one */
+        sys->displayed.timestamp = filtered->date;
+        return;
+    }
+
+    sys->filter.queued_count -= count;
+    memmove(&sys->filter.queued[0], &sys->filter.queued[count],
+            sys->filter.queued_count * sizeof(*sys->filter.queued));
+
+    if (sys->displayed.decoded)
+        picture_Release(sys->displayed.decoded);
+    sys->displayed.decoded       = decoded;
+    sys->displayed.timestamp     = decoded->date;
+    sys->displayed.is_interlaced = !decoded->b_progressive;
+}
+
+/* Filters a picture with the static chain, and returns the next picture
+ * out of it, if any */
+static picture_t *ThreadFilterStatic(vout_thread_t *vout, picture_t *decoded,
+                                     bool wait)
+{
+    vout_thread_sys_t *sys = vout->p;
+    filter_chain_t *chain = sys->filter.chain_static;
+
+    vlc_assert_locked(&sys->filter.lock);
+    if (sys->filter.pipeline == 0)
+        return filter_chain_VideoFilter(chain, decoded);
+
+    if (decoded)
+        ThreadFilterQueueDecoded(vout, decoded);
+
+    /* Only this thread changes the chains: wait for the filter threads
+     * without holding up the mouse events */
+    sys->filter.transit = true;
+    vlc_mutex_unlock(&sys->filter.lock);
+    picture_t *picture = filter_chain_VideoFilter(chain, decoded);
+    /* The pictures kept by a flush come first */
+    if (picture)
+        picture_fifo_Push(sys->filter.filtered, picture);
+    picture = picture_fifo_Pop(sys->filter.filtered);
+    if (!picture && wait)
+        picture = filter_chain_VideoDrain(chain);
+    vlc_mutex_lock(&sys->filter.lock);
+    sys->filter.transit = false;
+
+    if (picture)
+        ThreadFilterSetDisplayed(vout, picture);
+    return picture;
+}
+
+static void ThreadFilterFlushPipeline(vout_thread_t *vout, bool below,
+                                      mtime_t date)
+{
+    vout_thread_sys_t *sys = vout->p;
+    unsigned count = 0;
+
+    picture_fifo_Flush(sys->filter.filtered, date, below);
+    for (unsigned i = 0; i < sys->filter.queued_count; i++) {
+        picture_t *decoded = sys->filter.queued[i];
+        if (( below && decoded->date <= date) ||
+            (!below && decoded->date >= date))
+            picture_Release(decoded);
+        else
+            sys->filter.queued[count++] = decoded;
+    }
+    sys->filter.queued_count = count;
+}
+
+static void ThreadFilterOffsetPipeline(vout_thread_t *vout, mtime_t duration)
+{
+    vout_thread_sys_t *sys = vout->p;
+
+    /* A filtered picture may be the decoded one, offset it only once */
+    for (unsigned i = 0; i < sys->filter.queued_count; i++)
+        if (sys->filter.queued[i] != sys->displayed.decoded)
+            sys->filter.queued[i]->date += duration;
+
+    picture_t *list = NULL, **last = &list, *picture;
+    while ((picture = picture_fifo_Pop(sys->filter.filtered)) != NULL) {
+        bool offset = picture != sys->displayed.decoded;
+        for (unsigned i = 0; i < sys->filter.queued_count; i++)
+            if (sys->filter.queued[i] == picture)
+                offset = false;
+        if (offset)
+            picture->date += duration;
+        *last = picture;
+        last = &picture->p_next;
+    }
+    while (list) {
+        picture = list;
+        list = picture->p_next;
+        picture->p_next = NULL;
+        picture_fifo_Push(sys->filter.filtered, picture);
+    }
+}
+
+static void ThreadFilterCleanPipeline(vout_thread_t *vout)
+{
+    vout_thread_sys_t *sys = vout->p;
+
+    for (unsigned i = 0; i < sys->filter.queued_count; i++)
+        picture_Release(sys->filter.queued[i]);
+    free(sys->filter.queued);
+    sys->filter.queued = NULL;
+    sys->filter.queued_count = 0;
+    if (sys->filter.filtered)
+        picture_fifo_Delete(sys->filter.filtered);
+    sys->filter.filtered = NULL;
+}
+
 static void ThreadFilterFlush(vout_thread_t *vout, bool is_locked)
 {
     if (vout->p->displayed.current)
@@ -653,6 +822,19 @@ static void ThreadFilterFlush(vout_thread_t *vout, bool is_locked)
 
     if (!is_locked)
         vlc_mutex_lock(&vout->p->filter.lock);
+
+    /* The pictures in the pipelined chain were taken from the decoder
+     * fifo: keep them for display */
+    if (vout->p->filter.pipeline > 0) {
+        vout->p->filter.transit = true;
+        vlc_mutex_unlock(&vout->p->filter.lock);
+        picture_t *picture;
+        while ((picture = filter_chain_VideoDrain(vout->p->filter.chain_static)) != NULL)
+            picture_fifo_Push(vout->p->filter.filtered, picture);
+        vlc_mutex_lock(&vout->p->filter.lock);
+        vout->p->filter.transit = false;
+    }
+
     filter_chain_VideoFlush(vout->p->filter.chain_static);
     filter_chain_VideoFlush(vout->p->filter.chain_interactive);
     if (!is_locked)
@@ -686,7 +868,10 @@ static void ThreadChangeFilters(vout_thread_t *vout,
             vout_filter_t *e = xmalloc(sizeof(*e));
             e->name = name;
             e->cfg  = cfg;
-            if (!strcmp(e->name, "deinterlace") ||
+            /* The pipelined static chain runs all the filters, at the
+             * expense of the interactivity while paused */
+            if (vout->p->filter.pipeline > 0 ||
+                !strcmp(e->name, "deinterlace") ||
                 !strcmp(e->name, "postproc")) {
                 vlc_array_append(&array_static, e);
             } else {
@@ -709,6 +894,9 @@ static void ThreadChangeFilters(vout_thread_t *vout,
 
     es_format_t fmt_current = fmt_target;
 
+    es_format_t fmt_filtered;
+    es_format_Copy(&fmt_filtered, filter_chain_GetFmtOut(vout->p->filter.chain_static));
+
     for (int a = 0; a < 2; a++) {
         vlc_array_t    *array = a == 0 ? &array_static :
                                          &array_interactive;
@@ -742,6 +930,24 @@ static void ThreadChangeFilters(vout_thread_t *vout,
 
     es_format_Clean(&fmt_target);
 
+    /* The pictures kept from the previous pipelined chain must match the
+     * format out of the new one */
+    if (vout->p->filter.pipeline > 0 &&
+        !es_format_IsSimilar(&fmt_filtered,
+                             filter_chain_GetFmtOut(vout->p->filter.chain_static))) {
+        unsigned lost = 0;
+        picture_t *picture;
+        while ((picture = picture_fifo_Pop(vout->p->filter.filtered)) != NULL) {
+            picture_Release(picture);
+            lost++;
+        }
+        if (lost > 0) {
+            msg_Warn(vout, "dropping %u filtered pictures", lost);
+            vout_statistic_AddLost(&vout->p->statistic, lost);
+        }
+    }
+    es_format_Clean(&fmt_filtered);
+
     if (vout->p->filter.configuration != filters) {
         free(vout->p->filter.configuration);
         vout->p->filter.configuration = filters ? strdup(filters) : NULL;
@@ -760,11 +966,12 @@ static void ThreadChangeFilters(vout_thread_t *vout,
 static int ThreadDisplayPreparePicture(vout_thread_t *vout, bool reuse, bool frame_by_frame)
 {
     bool is_late_dropped = vout->p->is_late_dropped && !vout->p->pause.is_on && !frame_by_frame;
+    const bool wait = reuse || frame_by_frame;
 
     vlc_mutex_lock(&vout->p->filter.lock);
 
-    picture_t *picture = filter_chain_VideoFilter(vout->p->filter.chain_static, NULL);
-    assert(!reuse || !picture);
+    picture_t *picture = ThreadFilterStatic(vout, NULL, false);
+    assert(!reuse || !picture || vout->p->filter.pipeline > 0);
 
     while (!picture) {
         picture_t *decoded;
@@ -794,16 +1001,26 @@ static int ThreadDisplayPreparePicture(vout_thread_t *vout, bool reuse, bool fra
             break;
         reuse = false;
 
-        if (vout->p->displayed.decoded)
-            picture_Release(vout->p->displayed.decoded);
+        /* Pipelined, this is set when the picture comes out of the chain */
+        if (vout->p->filter.pipeline == 0) {
+            if (vout->p->displayed.decoded)
+                picture_Release(vout->p->displayed.decoded);
 
-        vout->p->displayed.decoded       = picture_Hold(decoded);
-        vout->p->displayed.timestamp     = decoded->date;
-        vout->p->displayed.is_interlaced = !decoded->b_progressive;
+            vout->p->displayed.decoded       = picture_Hold(decoded);
+            vout->p->displayed.timestamp     = decoded->date;
+            vout->p->displayed.is_interlaced = !decoded->b_progressive;
+        }
 
-        picture = filter_chain_VideoFilter(vout->p->filter.chain_static, decoded);
+        picture = ThreadFilterStatic(vout, decoded, false);
+        /* A step takes a single picture through the pipelined chain */
+        if (frame_by_frame && vout->p->filter.pipeline > 0)
+            break;
     }
 
+    /* The pictures may still be in the pipelined chain */
+    if (!picture && wait)
+        picture = ThreadFilterStatic(vout, NULL, true);
+
     vlc_mutex_unlock(&vout->p->filter.lock);
 
     if (!picture)
@@ -1140,6 +1357,8 @@ static void ThreadChangePause(vout_thread_t *vout, bool is_paused, mtime_t date)
         spu_OffsetSubtitleDate(vout->p->spu, duration);
 
         ThreadFilterFlush(vout, false);
+        if (vout->p->filter.pipeline > 0)
+            ThreadFilterOffsetPipeline(vout, duration);
     } else {
         vout->p->step.timestamp = VLC_TS_INVALID;
         vout->p->step.last      = VLC_TS_INVALID;
@@ -1154,6 +1373,8 @@ static void ThreadFlush(vout_thread_t *vout, bool below, mtime_t date)
     vout->p->step.last      = VLC_TS_INVALID;
 
     ThreadFilterFlush(vout, false); /* FIXME too much */
+    if (vout->p->filter.pipeline > 0)
+        ThreadFilterFlushPipeline(vout, below, date);
 
     picture_t *last = vout->p->displayed.decoded;
     if (last) {
@@ -1299,6 +1520,24 @@ static int ThreadStart(vout_thread_t *vout, const vout_display_state_t *state)
 
     vout->p->filter.configuration = NULL;
     video_format_Copy(&vout->p->filter.format, &vout->p->original);
+    vout->p->filter.pipeline = var_InheritInteger(vout, "video-filter-pipeline");
+    vout->p->filter.queued = NULL;
+    vout->p->filter.queued_count = 0;
+    vout->p->filter.filtered = NULL;
+    vout->p->filter.transit = false;
+    if (vout->p->filter.pipeline > 0) {
+        vout->p->filter.queued = malloc((vout->p->filter.pipeline + 2) *
+                                        sizeof(*vout->p->filter.queued));
+        vout->p->filter.filtered = picture_fifo_New();
+        if (!vout->p->filter.queued || !vout->p->filter.filtered) {
+            free(vout->p->filter.queued);
+            vout->p->filter.queued = NULL;
+            if (vout->p->filter.filtered)
+                picture_fifo_Delete(vout->p->filter.filtered);
+            vout->p->filter.filtered = NULL;
+            vout->p->filter.pipeline = 0;
+        }
+    }
 
     filter_owner_t owner = {
         .sys = vout,
@@ -1308,6 +1547,10 @@ static int ThreadStart(vout_thread_t *vout, const vout_display_state_t *state)
     };
     vout->p->filter.chain_static =
         filter_chain_NewVideo( vout, true, &owner );
+    if (vout->p->filter.pipeline > 0)
+        filter_chain_SetPipeline(vout->p->filter.chain_static,
+                                 vout->p->filter.pipeline,
+                                 VoutVideoFilterStaticReady, vout);
 
     owner.video.buffer_new = VoutVideoFilterInteractiveNewPicture;
     vout->p->filter.chain_interactive =
@@ -1357,6 +1600,7 @@ error:
         filter_chain_Delete(vout->p->filter.chain_interactive);
     if (vout->p->filter.chain_static != NULL)
         filter_chain_Delete(vout->p->filter.chain_static);
+    ThreadFilterCleanPipeline(vout);
     video_format_Clean(&vout->p->filter.format);
     if (vout->p->decoder_fifo != NULL)
         picture_fifo_Delete(vout->p->decoder_fifo);
@@ -1380,6 +1624,7 @@ static void ThreadStop(vout_thread_t *vout, vout_display_state_t *state)
     /* Destroy the video filters2 */
     filter_chain_Delete(vout->p->filter.chain_interactive);
     filter_chain_Delete(vout->p->filter.chain_static);
+    ThreadFilterCleanPipeline(vout);
     video_format_Clean(&vout->p->filter.format);
     free(vout->p->filter.configuration);
 
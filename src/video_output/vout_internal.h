@@ -117,6 +117,11 @@ struct vout_thread_sys_t
         vlc_mutex_t     lock;
         char            *configuration;
         video_format_t  format;
+        unsigned        pipeline; /* pictures in the static chain, 0 if synchronous */
+        picture_t       **queued; /* decoded pictures in the pipelined chain */
+        unsigned        queued_count;
+        picture_fifo_t  *filtered; /* pictures out of the pipelined chain */
+        bool            transit; /* pictures moved without the lock */
         struct filter_chain_t *chain_static;
         struct filter_chain_t *chain_interactive;
     } filter;
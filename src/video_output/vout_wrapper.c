@@ -124,9 +124,12 @@ int vout_InitWrapper(vout_thread_t *vout)
 
     sys->display.use_dr = !vout_IsDisplayFiltered(vd);
     const bool allow_dr = !vd->info.has_pictures_invalid && !vd->info.is_slow && sys->display.use_dr;
-    const unsigned private_picture  = 4; /* XXX 3 for filter, 1 for SPU */
+    const unsigned private_picture  = 4 /* XXX 3 for filter, 1 for SPU */
+                                    + sys->filter.pipeline;
     const unsigned decoder_picture  = 1 + sys->dpb_size;
-    const unsigned kept_picture     = 1; /* last displayed picture */
+    /* last displayed picture, and the decoded ones in the pipelined chain */
+    const unsigned kept_picture     = 1 + (sys->filter.pipeline > 0 ?
+                                           sys->filter.pipeline + 2 : 0);
     const unsigned reserved_picture = DISPLAY_PICTURE_COUNT +
                                       private_picture +
                                       kept_picture;
@@ -176,6 +179,11 @@ void vout_EndWrapper(vout_thread_t *vout)
     if (sys->private_pool)
         picture_pool_Release(sys->private_pool);
 
+    unsigned long retries, waits;
+    picture_pool_GetStats(sys->decoder_pool, &retries, &waits);
+    msg_Dbg(vout, "decoder pool contention: %lu retries, %lu waits",
+            retries, waits);
+
     if (sys->decoder_pool != sys->display_pool)
         picture_pool_Release(sys->decoder_pool);
 }
@@ -0,0 +1,195 @@
+/*****************************************************************************
+ * block_cache.c: test for the blocks cache
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+
+/* More than the depot of a size class can hold (8 batches of up to 32) */
+#define BLOCKS 640
+
+static const size_t sizes[] = { 1, 100, 1000, 4000, 30000, 100000 };
+
+static void fill_blocks( block_t **pp_blocks, unsigned i_count, size_t i_size )
+{
+    for( unsigned i = 0; i < i_count; i++ )
+    {
+        block_t *p_block = block_Alloc( i_size );
+        assert( p_block != NULL );
+        assert( p_block->i_buffer == i_size );
+        assert( ((uintptr_t)p_block->p_buffer % 32) == 0 );
+        memset( p_block->p_buffer, i & 0xFF, i_size );
+        pp_blocks[i] = p_block;
+    }
+}
+
+/* Checks no block was handed out twice, nor overlaps another one */
+static void check_blocks( block_t **pp_blocks, unsigned i_count, size_t i_size )
+{
+    for( unsigned i = 0; i < i_count; i++ )
+    {
+        const block_t *p_block = pp_blocks[i];
+        for( size_t j = 0; j < i_size; j++ )
+            assert( p_block->p_buffer[j] == (i & 0xFF) );
+    }
+}
+
+static void release_blocks( block_t **pp_blocks, unsigned i_count )
+{
+    for( unsigned i = 0; i < i_count; i++ )
+        block_Release( pp_blocks[i] );
+}
+
+static bool reused_block( block_t **pp_blocks, unsigned i_count,
+                          void *const *pp_old, unsigned i_old )
+{
+    for( unsigned i = 0; i < i_count; i++ )
+        for( unsigned j = 0; j < i_old; j++ )
+            if( (void *)pp_blocks[i] == pp_old[j] )
+                return true;
+    return false;
+}
+
+struct release_thread
+{
+    block_t **pp_blocks;
+    unsigned  i_count;
+};
+
+static void *release_thread( void *data )
+{
+    struct release_thread *p_thread = data;
+
+    release_blocks( p_thread->pp_blocks, p_thread->i_count );
+    return NULL;
+}
+
+/* Releases the blocks on another thread, which then exits */
+static void release_blocks_on_thread( block_t **pp_blocks, unsigned i_count )
+{
+    struct release_thread thread = { pp_blocks, i_count };
+    vlc_thread_t th;
+
+    assert( vlc_clone( &th, release_thread, &thread,
+                       VLC_THREAD_PRIORITY_LOW ) == 0 );
+    vlc_join( th, NULL );
+}
+
+static void test_cross_thread( size_t i_size, bool b_enabled )
+{
+    block_t *pp_blocks[128];
+    void *pp_old[128];
+
+    fill_blocks( pp_blocks, 128, i_size );
+    check_blocks( pp_blocks, 128, i_size );
+    for( unsigned i = 0; i < 128; i++ )
+        pp_old[i] = pp_blocks[i];
+
+    /* The other thread hands its complete batches to the depot on exit */
+    release_blocks_on_thread( pp_blocks, 128 );
+
+    fill_blocks( pp_blocks, 128, i_size );
+    check_blocks( pp_blocks, 128, i_size );
+    if( b_enabled && i_size <= 30000 )
+        assert( reused_block( pp_blocks, 128, pp_old, 128 ) );
+    release_blocks( pp_blocks, 128 );
+}
+
+static void test_depot( size_t i_size )
+{
+    block_t **pp_blocks = malloc( BLOCKS * sizeof(*pp_blocks) );
+    assert( pp_blocks != NULL );
+
+    /* Overflows the depot, then refills from it and from the heap */
+    for( unsigned i = 0; i < 3; i++ )
+    {
+        fill_blocks( pp_blocks, BLOCKS, i_size );
+        check_blocks( pp_blocks, BLOCKS, i_size );
+        if( i == 1 )
+            release_blocks_on_thread( pp_blocks, BLOCKS );
+        else
+            release_blocks( pp_blocks, BLOCKS );
+    }
+    free( pp_blocks );
+}
+
+static void test_blocks( bool b_enabled )
+{
+    for( unsigned i = 0; i < ARRAY_SIZE(sizes); i++ )
+    {
+        test_cross_thread( sizes[i], b_enabled );
+        test_depot( sizes[i] );
+    }
+}
+
+static void test_toggle( libvlc_int_t *p_libvlc )
+{
+    block_t *pp_blocks[64];
+
+    /* Blocks from the heap released to the cache, and conversely */
+    var_SetBool( p_libvlc, "block-cache", false );
+    fill_blocks( pp_blocks, 64, 100 );
+    var_SetBool( p_libvlc, "block-cache", true );
+    check_blocks( pp_blocks, 64, 100 );
+    release_blocks( pp_blocks, 64 );
+
+    fill_blocks( pp_blocks, 64, 100 );
+    var_SetBool( p_libvlc, "block-cache", false );
+    check_blocks( pp_blocks, 64, 100 );
+    release_blocks_on_thread( pp_blocks, 64 );
+
+    fill_blocks( pp_blocks, 64, 100 );
+    var_SetBool( p_libvlc, "block-cache", true );
+    release_blocks_on_thread( pp_blocks, 64 );
+
+    assert( var_GetBool( p_libvlc, "block-cache" ) );
+}
+
+int main( void )
+{
+    libvlc_instance_t *p_vlc;
+
+    test_init();
+
+    p_vlc = libvlc_new( test_defaults_nargs, test_defaults_args );
+    assert( p_vlc != NULL );
+
+    libvlc_int_t *p_libvlc = p_vlc->p_libvlc_int;
+
+    log( "Testing the blocks cache\n" );
+    var_SetBool( p_libvlc, "block-cache", true );
+    test_blocks( true );
+
+    log( "Testing the blocks without cache\n" );
+    var_SetBool( p_libvlc, "block-cache", false );
+    test_blocks( false );
+
+    log( "Testing the cache switching\n" );
+    test_toggle( p_libvlc );
+    test_blocks( true );
+
+    libvlc_release( p_vlc );
+
+    return 0;
+}
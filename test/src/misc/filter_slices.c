@@ -0,0 +1,117 @@
+/*****************************************************************************
+ * filter_slices.c: test for the slices of the video filters
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+#include <vlc_atomic.h>
+#include <vlc_filter.h>
+
+#define MAX_ROWS    1081
+#define MAX_SLICES  16
+
+/* Heights which do not all divide evenly by the number of slices */
+static const int heights[] = { 1, 2, 7, 480, 1081 };
+static const unsigned counts[] = { 0, 1, 2, 3, 4, 16 };
+
+struct slices_ctx
+{
+    int         i_rows;
+    atomic_uint rows[MAX_ROWS];
+    atomic_uint done[MAX_SLICES];
+};
+
+static void CountRows( filter_t *p_filter, void *data,
+                       unsigned slice, unsigned slices )
+{
+    struct slices_ctx *ctx = data;
+    int i_first, i_last;
+
+    VLC_UNUSED(p_filter);
+    assert( slice < slices && slices <= MAX_SLICES );
+    atomic_fetch_add( &ctx->done[slice], 1 );
+
+    filter_GetSliceRows( ctx->i_rows, slice, slices, &i_first, &i_last );
+    assert( 0 <= i_first && i_first <= i_last && i_last <= ctx->i_rows );
+    for( int y = i_first; y < i_last; y++ )
+        atomic_fetch_add( &ctx->rows[y], 1 );
+}
+
+static void test_slices( filter_t *p_filter, unsigned i_threads )
+{
+    for( unsigned i = 0; i < ARRAY_SIZE(heights); i++ )
+        for( unsigned j = 0; j < ARRAY_SIZE(counts); j++ )
+        {
+            struct slices_ctx ctx = { .i_rows = heights[i] };
+            unsigned slices = counts[j] ? counts[j] : i_threads;
+
+            for( int y = 0; y < MAX_ROWS; y++ )
+                atomic_init( &ctx.rows[y], 0 );
+            for( unsigned k = 0; k < MAX_SLICES; k++ )
+                atomic_init( &ctx.done[k], 0 );
+
+            filter_RunSlices( p_filter, CountRows, &ctx, counts[j] );
+
+            /* Each slice ran once, and each row belongs to one slice */
+            for( unsigned k = 0; k < MAX_SLICES; k++ )
+                assert( atomic_load( &ctx.done[k] ) == (k < slices) );
+            for( int y = 0; y < MAX_ROWS; y++ )
+                assert( atomic_load( &ctx.rows[y] ) == (y < heights[i]) );
+        }
+}
+
+static void test_threads( unsigned i_threads )
+{
+    char psz_threads[32];
+    const char *args[] = {
+        "-v",
+        psz_threads,
+    };
+
+    snprintf( psz_threads, sizeof (psz_threads),
+              "--video-filter-threads=%u", i_threads );
+    log( "Testing the slices on %u thread(s)\n", i_threads );
+
+    libvlc_instance_t *p_vlc = libvlc_new( ARRAY_SIZE(args), args );
+    assert( p_vlc != NULL );
+
+    filter_t *p_filter = vlc_object_create( p_vlc->p_libvlc_int,
+                                            sizeof (*p_filter) );
+    assert( p_filter != NULL );
+
+    /* Several times, as the worker threads start on first use */
+    for( unsigned i = 0; i < 3; i++ )
+        test_slices( p_filter, i_threads );
+
+    vlc_object_release( p_filter );
+    libvlc_release( p_vlc );
+}
+
+int main( void )
+{
+    test_init();
+
+    test_threads( 1 );
+    test_threads( 4 );
+    test_threads( 7 );
+
+    return 0;
+}
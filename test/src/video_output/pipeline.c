@@ -0,0 +1,257 @@
+/*****************************************************************************
+ * pipeline.c: test for the pipelined video filters
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+
+#include <limits.h>
+
+#include <vlc_common.h>
+
+/* The still image is played as a video of FRAMES pictures */
+#define FRAMES 25
+
+static const char *const media_options[] = {
+    ":image-duration=0.5",
+    ":image-fps=50/1",
+};
+
+struct display
+{
+    vlc_mutex_t lock;
+    vlc_cond_t  wait;
+    unsigned    count; /* pictures displayed, redisplays included */
+    bool        ended;
+    bool        error;
+    uint8_t    *pixels;
+    size_t      plane_size;
+};
+
+static unsigned Setup( void **opaque, char *chroma,
+                       unsigned *width, unsigned *height,
+                       unsigned *pitches, unsigned *lines )
+{
+    struct display *d = *opaque;
+
+    VLC_UNUSED(chroma);
+    /* Enough room for the planes of any chroma */
+    for( unsigned i = 0; i < 3; i++ )
+    {
+        pitches[i] = (*width + 32) * 4;
+        lines[i] = *height + 32;
+    }
+    d->plane_size = pitches[0] * lines[0];
+    d->pixels = malloc( 3 * d->plane_size );
+    assert( d->pixels != NULL );
+    return 1;
+}
+
+static void Cleanup( void *opaque )
+{
+    struct display *d = opaque;
+
+    free( d->pixels );
+    d->pixels = NULL;
+}
+
+static void *Lock( void *opaque, void **planes )
+{
+    struct display *d = opaque;
+
+    for( unsigned i = 0; i < 3; i++ )
+        planes[i] = d->pixels + i * d->plane_size;
+    return NULL;
+}
+
+static void Display( void *opaque, void *picture )
+{
+    struct display *d = opaque;
+
+    assert( picture == NULL );
+    vlc_mutex_lock( &d->lock );
+    d->count++;
+    vlc_cond_signal( &d->wait );
+    vlc_mutex_unlock( &d->lock );
+}
+
+static void OnEvent( const libvlc_event_t *event, void *opaque )
+{
+    struct display *d = opaque;
+
+    vlc_mutex_lock( &d->lock );
+    d->ended = true;
+    d->error = event->type == libvlc_MediaPlayerEncounteredError;
+    vlc_cond_signal( &d->wait );
+    vlc_mutex_unlock( &d->lock );
+}
+
+/* Waits until the given number of pictures is displayed, or the end */
+static unsigned wait_displayed( struct display *d, unsigned count )
+{
+    vlc_mutex_lock( &d->lock );
+    while( d->count < count && !d->ended )
+        vlc_cond_wait( &d->wait, &d->lock );
+    assert( !d->error );
+    count = d->count;
+    vlc_mutex_unlock( &d->lock );
+    return count;
+}
+
+static unsigned wait_ended( struct display *d )
+{
+    return wait_displayed( d, UINT_MAX );
+}
+
+static void wait_paused( libvlc_media_player_t *mp )
+{
+    libvlc_state_t state;
+    do
+        state = libvlc_media_player_get_state( mp );
+    while( state != libvlc_Paused && state != libvlc_Ended );
+    assert( state == libvlc_Paused );
+}
+
+static libvlc_media_player_t *play( libvlc_instance_t *vlc,
+                                    struct display *d )
+{
+    libvlc_media_t *md =
+        libvlc_media_new_path( vlc, SRCDIR"/samples/image.jpg" );
+    assert( md != NULL );
+    for( unsigned i = 0; i < ARRAY_SIZE(media_options); i++ )
+        libvlc_media_add_option( md, media_options[i] );
+
+    libvlc_media_player_t *mp = libvlc_media_player_new_from_media( md );
+    assert( mp != NULL );
+    libvlc_media_release( md );
+
+    vlc_mutex_init( &d->lock );
+    vlc_cond_init( &d->wait );
+    d->count = 0;
+    d->ended = false;
+    d->error = false;
+    d->pixels = NULL;
+
+    libvlc_video_set_callbacks( mp, Lock, NULL, Display, d );
+    libvlc_video_set_format_callbacks( mp, Setup, Cleanup );
+
+    libvlc_event_manager_t *em = libvlc_media_player_event_manager( mp );
+    assert( !libvlc_event_attach( em, libvlc_MediaPlayerEndReached,
+                                  OnEvent, d ) );
+    assert( !libvlc_event_attach( em, libvlc_MediaPlayerEncounteredError,
+                                  OnEvent, d ) );
+
+    assert( libvlc_media_player_play( mp ) == 0 );
+    return mp;
+}
+
+static void stop( libvlc_media_player_t *mp, struct display *d )
+{
+    libvlc_media_player_stop( mp );
+    libvlc_media_player_release( mp );
+    vlc_cond_destroy( &d->wait );
+    vlc_mutex_destroy( &d->lock );
+}
+
+/* The pictures in the filters are displayed before the end */
+static void test_eos( libvlc_instance_t *vlc )
+{
+    struct display d;
+    libvlc_media_player_t *mp = play( vlc, &d );
+
+    unsigned count = wait_ended( &d );
+    log( "  end: %u pictures displayed\n", count );
+    assert( count >= FRAMES );
+    stop( mp, &d );
+}
+
+/* The steps go on with the next pictures, and the playback resumes */
+static void test_step( libvlc_instance_t *vlc )
+{
+    struct display d;
+    libvlc_media_player_t *mp = play( vlc, &d );
+
+    unsigned count = wait_displayed( &d, FRAMES / 4 );
+    libvlc_media_player_set_pause( mp, true );
+    wait_paused( mp );
+
+    for( unsigned i = 0; i < 2; i++ )
+    {
+        libvlc_media_player_next_frame( mp );
+        count = wait_displayed( &d, count + 1 );
+    }
+
+    libvlc_media_player_set_pause( mp, false );
+    count = wait_ended( &d );
+    log( "  step: %u pictures displayed\n", count );
+    assert( count >= FRAMES );
+    stop( mp, &d );
+}
+
+/* Seeking back flushes the filters, then displays all the pictures again */
+static void test_seek( libvlc_instance_t *vlc )
+{
+    struct display d;
+    libvlc_media_player_t *mp = play( vlc, &d );
+
+    unsigned count = wait_displayed( &d, FRAMES / 2 );
+    libvlc_media_player_set_time( mp, 0 );
+
+    count = wait_ended( &d ) - count;
+    log( "  seek: %u pictures displayed after the seek\n", count );
+    assert( count >= FRAMES );
+    stop( mp, &d );
+}
+
+static void test_pipeline( unsigned pipeline )
+{
+    char psz_pipeline[32];
+    const char *args[] = {
+        "-v",
+        "--video-filter=invert",
+        "--no-drop-late-frames",
+        "--no-skip-frames",
+        "--no-osd",
+        psz_pipeline,
+    };
+
+    snprintf( psz_pipeline, sizeof (psz_pipeline),
+              "--video-filter-pipeline=%u", pipeline );
+    log( "Testing the video filters with a pipeline of %u picture(s)\n",
+         pipeline );
+
+    libvlc_instance_t *vlc = libvlc_new( ARRAY_SIZE(args), args );
+    assert( vlc != NULL );
+
+    test_eos( vlc );
+    test_step( vlc );
+    test_seek( vlc );
+
+    libvlc_release( vlc );
+}
+
+int main( void )
+{
+    test_init();
+
+    /* The synchronous filters are the reference */
+    test_pipeline( 0 );
+    test_pipeline( 4 );
+
+    return 0;
+}